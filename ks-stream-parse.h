@@ -0,0 +1,205 @@
+#ifndef KS_STREAM_PARSE_H
+#define KS_STREAM_PARSE_H
+/*
+ * Number parsing for ks-stream, in a header so it can be tested on its
+ * own and still inline in the tool's inner loop.
+ */
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static const double ks_stream_powers_of_ten[] = {
+	1e0,
+	1e1,
+	1e2,
+	1e3,
+	1e4,
+	1e5,
+	1e6,
+	1e7,
+	1e8,
+	1e9,
+	1e10,
+	1e11,
+	1e12,
+	1e13,
+	1e14,
+	1e15,
+	1e16,
+	1e17,
+	1e18,
+	1e19,
+	1e20,
+	1e21,
+	1e22,
+};
+
+#define KS_STREAM_MAX_POWER_OF_TEN 22
+
+/* Compilers turn these into plain loads on little-endian targets. */
+static inline uint32_t ks_stream_load_le32(const void *src)
+{
+	const uint8_t *p = (const uint8_t *)src;
+
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16
+	    | (uint32_t)p[3] << 24;
+}
+
+static inline uint64_t ks_stream_load_le64(const void *src)
+{
+	const uint8_t *p = (const uint8_t *)src;
+
+	return (uint64_t)ks_stream_load_le32(p)
+	    | (uint64_t)ks_stream_load_le32(p + 4) << 32;
+}
+
+static inline bool ks_stream_is_digit(char c)
+{
+	return (unsigned char)(c - '0') < 10;
+}
+
+/*
+ * Returns the number of leading decimal digits in the 8 bytes of
+ * `word`.  A byte is a digit iff its high nibble is 3, and adding 6
+ * doesn't carry into it; carries out of a byte only affect later
+ * bytes, after a non-digit.
+ */
+static inline unsigned int ks_stream_count_digits(uint64_t word)
+{
+	const uint64_t high = 0xf0f0f0f0f0f0f0f0ULL;
+	const uint64_t plus_6 = word + 0x0606060606060606ULL;
+	const uint64_t not_digit = ((word & high) | (plus_6 & high) >> 4)
+	    ^ 0x3333333333333333ULL;
+
+	return (not_digit == 0) ? 8 : __builtin_ctzll(not_digit) / 8;
+}
+
+/*
+ * Returns the value of the first `n` (1 to 8) digits in `word`,
+ * combining pairs of adjacent digits, then of pairs, then of quads.
+ */
+static inline uint64_t ks_stream_parse_digits(uint64_t word, unsigned int n)
+{
+	/* Leading zero bytes don't change the value. */
+	word = (word & 0x0f0f0f0f0f0f0f0fULL) << (8 * (8 - n));
+	word = (10 * word + (word >> 8)) & 0x00ff00ff00ff00ffULL;
+	word = (100 * word + (word >> 16)) & 0x0000ffff0000ffffULL;
+	return (10000 * word + (word >> 32)) & 0xffffffffULL;
+}
+
+/*
+ * Same as `ks_stream_parse_value`, one digit at a time.  Digits past
+ * the 18th only count for magnitude, which is plenty for bucketing.
+ */
+static inline bool ks_stream_parse_long_value(const char **pos, double *out)
+{
+	const uint64_t max_mantissa = 100000000000000000ULL;
+	const char *p = *pos;
+	uint64_t mantissa = 0;
+	long exponent = 0;
+	bool any = false;
+	double ret;
+
+	for (; ks_stream_is_digit(*p); ++p) {
+		any = true;
+		if (mantissa < max_mantissa) {
+			mantissa = 10 * mantissa + (uint64_t)(*p - '0');
+		} else {
+			++exponent;
+		}
+	}
+
+	if (*p == '.') {
+		for (++p; ks_stream_is_digit(*p); ++p) {
+			any = true;
+			if (mantissa < max_mantissa) {
+				mantissa
+				    = 10 * mantissa + (uint64_t)(*p - '0');
+				--exponent;
+			}
+		}
+	}
+
+	if (!any) {
+		return false;
+	}
+
+	ret = (double)mantissa;
+	for (; exponent > KS_STREAM_MAX_POWER_OF_TEN;
+	     exponent -= KS_STREAM_MAX_POWER_OF_TEN) {
+		ret *= ks_stream_powers_of_ten[KS_STREAM_MAX_POWER_OF_TEN];
+	}
+
+	for (; exponent < -KS_STREAM_MAX_POWER_OF_TEN;
+	     exponent += KS_STREAM_MAX_POWER_OF_TEN) {
+		ret /= ks_stream_powers_of_ten[KS_STREAM_MAX_POWER_OF_TEN];
+	}
+
+	if (exponent >= 0) {
+		ret *= ks_stream_powers_of_ten[exponent];
+	} else {
+		ret /= ks_stream_powers_of_ten[-exponent];
+	}
+
+	*pos = p;
+	*out = ret;
+	return true;
+}
+
+/*
+ * Parses a non-negative decimal number, with an optional fraction, at
+ * `*pos`, and advances `*pos` past it.  Returns false if there's no
+ * digit.  The number must be followed by a newline, and 8 readable
+ * bytes: integer and fractional parts of fewer than 8 digits each take
+ * one word load and no per-digit branch.
+ */
+static inline bool ks_stream_parse_value(const char **pos, double *out)
+{
+	const char *p = *pos;
+	uint64_t word = ks_stream_load_le64(p);
+	unsigned int num_digits = ks_stream_count_digits(word);
+	unsigned int num_fraction = 0;
+	uint64_t mantissa = 0;
+
+	if (num_digits == 8) {
+		return ks_stream_parse_long_value(pos, out);
+	}
+
+	if (num_digits > 0) {
+		mantissa = ks_stream_parse_digits(word, num_digits);
+		p += num_digits;
+	}
+
+	if (*p == '.') {
+		word = ks_stream_load_le64(p + 1);
+		num_fraction = ks_stream_count_digits(word);
+		if (num_fraction == 8) {
+			return ks_stream_parse_long_value(pos, out);
+		}
+
+		if (num_fraction > 0) {
+			mantissa = ks_stream_parse_digits(word, num_fraction)
+			    + mantissa
+				* (uint64_t)ks_stream_powers_of_ten
+				    [num_fraction];
+		}
+
+		p += 1 + num_fraction;
+	}
+
+	if (num_digits + num_fraction == 0) {
+		return false;
+	}
+
+	*pos = p;
+	*out = (double)mantissa / ks_stream_powers_of_ten[num_fraction];
+	return true;
+}
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /* !KS_STREAM_PARSE_H */
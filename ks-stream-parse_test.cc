@@ -0,0 +1,160 @@
+#include "ks-stream-parse.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace {
+// The parsers may load 8 bytes past the number's newline.
+std::string padded(const std::string &line)
+{
+	return line + '\n' + std::string(16, '\0');
+}
+
+uint64_t word(const std::string &bytes)
+{
+	char buf[8] = { 0 };
+
+	memcpy(buf, bytes.data(), std::min<size_t>(8, bytes.size()));
+	return ks_stream_load_le64(buf);
+}
+
+// Parses `line`, and checks that parsing stops at the newline.
+bool parse(const std::string &line, double *out)
+{
+	const std::string buf = padded(line);
+	const char *pos = buf.data();
+
+	if (!ks_stream_parse_value(&pos, out)) {
+		EXPECT_EQ(pos, buf.data()) << line;
+		return false;
+	}
+
+	EXPECT_EQ(*pos, '\n') << line;
+	return true;
+}
+
+TEST(KsStreamParse, CountDigits)
+{
+	// Every byte value after every prefix of digits.
+	for (size_t n = 0; n < 8; ++n) {
+		for (int c = 0; c < 256; ++c) {
+			std::string bytes = std::string(n, '7') + char(c)
+			    + std::string(7 - n, '9');
+			const size_t expected
+			    = (c >= '0' && c <= '9') ? 8 : n;
+
+			EXPECT_EQ(expected,
+			    ks_stream_count_digits(word(bytes)))
+			    << n << " " << c;
+		}
+	}
+
+	EXPECT_EQ(8u, ks_stream_count_digits(word("01234567")));
+	EXPECT_EQ(3u, ks_stream_count_digits(word("012/4567")));
+	EXPECT_EQ(3u, ks_stream_count_digits(word("012:4567")));
+}
+
+TEST(KsStreamParse, ParseDigits)
+{
+	std::mt19937_64 rng(1);
+
+	for (size_t i = 0; i < 100000; ++i) {
+		const unsigned int n = 1 + rng() % 8;
+		std::string digits;
+		uint64_t expected = 0;
+
+		for (unsigned int j = 0; j < n; ++j) {
+			const int digit = rng() % 10;
+
+			digits += char('0' + digit);
+			expected = 10 * expected + digit;
+		}
+
+		EXPECT_EQ(expected,
+		    ks_stream_parse_digits(word(digits + "\n"), n))
+		    << digits;
+	}
+}
+
+TEST(KsStreamParse, ParseValue)
+{
+	double value;
+
+	ASSERT_TRUE(parse("0", &value));
+	EXPECT_EQ(0, value);
+	ASSERT_TRUE(parse("1234567", &value));
+	EXPECT_EQ(1234567, value);
+	ASSERT_TRUE(parse("12.5", &value));
+	EXPECT_EQ(12.5, value);
+	ASSERT_TRUE(parse(".25", &value));
+	EXPECT_EQ(0.25, value);
+	ASSERT_TRUE(parse("3.", &value));
+	EXPECT_EQ(3, value);
+
+	// Eight digits or more, before or after the point, take the
+	// long path.
+	ASSERT_TRUE(parse("12345678", &value));
+	EXPECT_EQ(12345678, value);
+	ASSERT_TRUE(parse("0.12345678", &value));
+	EXPECT_DOUBLE_EQ(0.12345678, value);
+	ASSERT_TRUE(parse("123456789012345678901234567890", &value));
+	EXPECT_DOUBLE_EQ(1.2345678901234568e29, value);
+	ASSERT_TRUE(parse("0.000000000000000000000000000001", &value));
+	EXPECT_DOUBLE_EQ(1e-30, value);
+
+	EXPECT_FALSE(parse("", &value));
+	EXPECT_FALSE(parse(".", &value));
+	EXPECT_FALSE(parse("x1", &value));
+	EXPECT_FALSE(parse("-1", &value));
+
+	// Parsing stops at the first character that can't continue the
+	// number.
+	const std::string buf = padded("12.5.5");
+	const char *pos = buf.data();
+	ASSERT_TRUE(ks_stream_parse_value(&pos, &value));
+	EXPECT_EQ(12.5, value);
+	EXPECT_EQ(pos, buf.data() + 4);
+}
+
+// Random numbers of every length agree with strtod, to within the
+// rounding of dividing the mantissa by a power of 10.
+TEST(KsStreamParse, MatchesStrtod)
+{
+	std::mt19937_64 rng(2);
+
+	for (size_t i = 0; i < 100000; ++i) {
+		const size_t num_integer = rng() % 20;
+		const size_t num_fraction = rng() % 20;
+		std::string line;
+
+		for (size_t j = 0; j < num_integer; ++j) {
+			line += char('0' + rng() % 10);
+		}
+
+		if (num_fraction > 0 || rng() % 2 == 0) {
+			line += '.';
+		}
+
+		for (size_t j = 0; j < num_fraction; ++j) {
+			line += char('0' + rng() % 10);
+		}
+
+		double value;
+		if (num_integer + num_fraction == 0) {
+			EXPECT_FALSE(parse(line, &value)) << line;
+			continue;
+		}
+
+		const double expected = std::strtod(line.c_str(), nullptr);
+		ASSERT_TRUE(parse(line, &value)) << line;
+		EXPECT_NEAR(expected, value, 1e-15 * expected) << line;
+	}
+}
+} // namespace
@@ -0,0 +1,706 @@
+/*
+ * Sequential two-sample test over a stream of labelled values, e.g.,
+ *
+ *   tail -F access.log | ks-stream --arms canary,baseline --log-eps -13.8
+ *
+ * Text input has one observation per line: an arm label, blanks, and
+ * a non-negative decimal value.  Lines for other labels are ignored,
+ * and malformed lines are counted and skipped.  With `--binary`, the
+ * input is instead a sequence of 16-byte records, as described in
+ * `one-sided-ks-reader.h`; arm 0 is the first name.
+ *
+ * The first arm is A and the second B: the i-th value for A is
+ * paired with the i-th value for B, and the test rejects once
+ * `one_sided_ks_pair_threshold` shows that A is faster than B at some
+ * quantile.  Values are counted in log-linear histograms, and D+ is
+ * only recomputed when `one_sided_ks_pair_next_check` says it could
+ * cross the threshold.
+ *
+ * Values for the arm that's ahead wait in a queue until the other arm
+ * catches up.  Past `--max-pending` waiting values, new values for
+ * that arm are dropped (and counted), rather than buffered without
+ * bound when the other arm never shows up.
+ *
+ * Prints the decision as soon as the test rejects, or at the end of
+ * the input, and exits with 0 if the test rejected, 1 if not, and 2
+ * on error.
+ */
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ks-stream-parse.h"
+#include "one-sided-ks-hist.h"
+#include "one-sided-ks.h"
+
+#define BUFFER_SIZE ((size_t)1 << 20)
+/* Room for a final newline, and for word loads just past it. */
+#define BUFFER_PADDING 16
+
+#define RECORD_SIZE 16
+#define VALUE_OFFSET 8
+
+#define DEFAULT_MAX_PENDING ((uint64_t)1 << 22)
+
+#define DEFAULT_PRECISION_BITS 7
+#define MAX_PRECISION_BITS 16
+
+/*
+ * Values less than 2^MIN_EXPONENT share the first bucket, and values
+ * of at least 2^MAX_EXPONENT the last.
+ */
+#define MIN_EXPONENT (-32)
+#define MAX_EXPONENT 64
+
+#define DOUBLE_MANTISSA_BITS 52
+#define DOUBLE_EXPONENT_BIAS 1023
+
+enum { EXIT_REJECT = 0, EXIT_ACCEPT = 1, EXIT_ERROR = 2 };
+
+/* Buckets for the arm that's ahead (0 for A, 1 for B), unpaired. */
+struct queue {
+	uint32_t *buckets;
+	size_t head;
+	size_t tail;
+	size_t capacity;
+	unsigned int arm;
+};
+
+struct stream {
+	const char *names[2];
+	size_t name_lengths[2];
+	/* The first (up to) 8 bytes of each name, and their mask. */
+	uint64_t name_words[2];
+	uint64_t name_masks[2];
+	uint64_t min_count;
+	double log_eps;
+	unsigned int bits;
+
+	size_t num_buckets;
+	uint64_t *counts[2];
+	/* Range of non-empty buckets, if any. */
+	size_t lo;
+	size_t hi;
+	struct queue pending;
+	uint64_t max_pending;
+
+	/* Observations per arm, and number of pairs. */
+	uint64_t num_values[2];
+	uint64_t num_pairs;
+	/* Observations dropped because the queue was full. */
+	uint64_t num_dropped;
+	uint64_t next_check;
+	/* Lines (or records) read, and those skipped. */
+	uint64_t num_lines;
+	uint64_t num_malformed;
+
+	/* Statistic and threshold at the last check. */
+	double d_plus;
+	size_t d_plus_bucket;
+	double threshold;
+};
+
+static void die(const char *message)
+{
+	fprintf(stderr, "ks-stream: %s\n", message);
+	exit(EXIT_ERROR);
+}
+
+static size_t num_buckets(unsigned int bits)
+{
+	return ((size_t)(MAX_EXPONENT - MIN_EXPONENT) << bits) + 2;
+}
+
+static uint64_t min_repr(unsigned int bits)
+{
+	return (uint64_t)(DOUBLE_EXPONENT_BIAS + MIN_EXPONENT) << bits;
+}
+
+/*
+ * The bit patterns of non-negative doubles are ordered like their
+ * values, so the exponent and the top `bits` bits of the mantissa
+ * yield log-linear buckets.
+ */
+static size_t find_bucket(double value, unsigned int bits)
+{
+	const uint64_t max_repr = min_repr(bits)
+	    + ((uint64_t)(MAX_EXPONENT - MIN_EXPONENT) << bits);
+	uint64_t repr;
+
+	memcpy(&repr, &value, sizeof(repr));
+	repr >>= DOUBLE_MANTISSA_BITS - bits;
+	if (repr < min_repr(bits)) {
+		return 0;
+	}
+
+	if (repr >= max_repr) {
+		return num_buckets(bits) - 1;
+	}
+
+	return (size_t)(repr - min_repr(bits)) + 1;
+}
+
+/* Returns the least value in the bucket after `bucket`. */
+static double bucket_limit(size_t bucket, unsigned int bits)
+{
+	const uint64_t repr = (bucket + min_repr(bits))
+	    << (DOUBLE_MANTISSA_BITS - bits);
+	double ret;
+
+	if (bucket + 1 >= num_buckets(bits)) {
+		return HUGE_VAL;
+	}
+
+	memcpy(&ret, &repr, sizeof(ret));
+	return ret;
+}
+
+static bool is_blank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static void push(struct queue *queue, uint32_t bucket)
+{
+	if (queue->tail == queue->capacity) {
+		const size_t size = queue->tail - queue->head;
+
+		/* Only compact when that frees at least half the queue. */
+		if (queue->head >= queue->capacity / 2 && queue->head > 0) {
+			memmove(queue->buckets, &queue->buckets[queue->head],
+			    size * sizeof(queue->buckets[0]));
+		} else {
+			const size_t capacity = (queue->capacity == 0)
+			    ? 1024
+			    : 2 * queue->capacity;
+			uint32_t *buckets = realloc(queue->buckets,
+			    capacity * sizeof(queue->buckets[0]));
+
+			if (buckets == NULL) {
+				die("out of memory");
+			}
+
+			queue->buckets = buckets;
+			queue->capacity = capacity;
+			memmove(queue->buckets, &queue->buckets[queue->head],
+			    size * sizeof(queue->buckets[0]));
+		}
+
+		queue->head = 0;
+		queue->tail = size;
+	}
+
+	queue->buckets[queue->tail++] = bucket;
+}
+
+static uint32_t pop(struct queue *queue)
+{
+	const uint32_t ret = queue->buckets[queue->head++];
+
+	if (queue->head == queue->tail) {
+		queue->head = 0;
+		queue->tail = 0;
+	}
+
+	return ret;
+}
+
+/* Recomputes D+; returns whether it exceeds the threshold. */
+static bool check(struct stream *stream)
+{
+	struct one_sided_ks_hist_result hist;
+	const uint64_t n = stream->num_pairs;
+	const size_t lo = stream->lo;
+
+	/*
+	 * Both arms have `n` values, so the prefix differences are 0
+	 * outside the non-empty range.
+	 */
+	if (n == 0
+	    || one_sided_ks_hist_dplus(&stream->counts[0][lo],
+		   &stream->counts[1][lo], stream->hi - lo + 1, &hist)
+		!= 0) {
+		return false;
+	}
+
+	stream->d_plus = hist.d_plus;
+	stream->d_plus_bucket = lo + hist.d_plus_bucket;
+	stream->threshold = one_sided_ks_pair_threshold(
+	    n, stream->min_count, stream->log_eps);
+	if (stream->d_plus > stream->threshold) {
+		return true;
+	}
+
+	stream->next_check = one_sided_ks_pair_next_check(
+	    n, stream->d_plus, stream->min_count, stream->log_eps);
+	if (stream->next_check <= n) {
+		stream->next_check = n + 1;
+	}
+
+	return false;
+}
+
+/* Adds one observation; returns whether the test rejects. */
+static bool add(struct stream *stream, unsigned int arm, double value)
+{
+	const uint32_t bucket = (uint32_t)find_bucket(value, stream->bits);
+	struct queue *pending = &stream->pending;
+	uint32_t other;
+
+	if (pending->head == pending->tail || pending->arm == arm) {
+		if (pending->tail - pending->head >= stream->max_pending) {
+			if (stream->num_dropped++ == 0) {
+				fprintf(stderr,
+				    "ks-stream: more than %" PRIu64
+				    " unpaired values for %s; dropping "
+				    "new ones\n",
+				    stream->max_pending, stream->names[arm]);
+			}
+
+			return false;
+		}
+
+		++stream->num_values[arm];
+		pending->arm = arm;
+		push(pending, bucket);
+		return false;
+	}
+
+	++stream->num_values[arm];
+
+	other = pop(pending);
+	++stream->counts[arm][bucket];
+	++stream->counts[pending->arm][other];
+	++stream->num_pairs;
+	if (bucket < stream->lo || other < stream->lo) {
+		stream->lo = (bucket < other) ? bucket : other;
+	}
+
+	if (bucket > stream->hi || other > stream->hi) {
+		stream->hi = (bucket > other) ? bucket : other;
+	}
+
+	return stream->num_pairs >= stream->next_check && check(stream);
+}
+
+/*
+ * Processes the line at `p`, up to the first newline before `end`.
+ * Returns the start of the next line, and sets `*reject` if the test
+ * rejects.
+ */
+static const char *add_line(
+    struct stream *stream, const char *p, const char *end, bool *reject)
+{
+	unsigned int arm;
+	double value;
+
+	++stream->num_lines;
+	while (is_blank(*p)) {
+		++p;
+	}
+
+	/* Names must be followed by a blank or the newline, all <= ' '. */
+	for (arm = 0; arm < 2; ++arm) {
+		const size_t length = stream->name_lengths[arm];
+
+		if ((size_t)(end - p) > length
+		    && ((ks_stream_load_le64(p) ^ stream->name_words[arm])
+			   & stream->name_masks[arm])
+			== 0
+		    && (length <= 8
+			|| memcmp(p + 8, stream->names[arm] + 8, length - 8)
+			    == 0)
+		    && (unsigned char)p[length] <= ' ') {
+			break;
+		}
+	}
+
+	if (arm < 2) {
+		p += stream->name_lengths[arm];
+		while (is_blank(*p)) {
+			++p;
+		}
+
+		if (ks_stream_parse_value(&p, &value)) {
+			while (is_blank(*p)) {
+				++p;
+			}
+
+			if (*p == '\n') {
+				*reject = add(stream, arm, value);
+				return p + 1;
+			}
+		}
+
+		++stream->num_malformed;
+	}
+
+	return (const char *)memchr(p, '\n', (size_t)(end - p)) + 1;
+}
+
+/* Fills `buf` after the first `used` bytes; returns 0 at EOF. */
+static size_t fill(char *buf, size_t used)
+{
+	for (;;) {
+		const ssize_t r = read(STDIN_FILENO, buf + used,
+		    BUFFER_SIZE - used);
+
+		if (r >= 0) {
+			return (size_t)r;
+		}
+
+		if (errno != EINTR) {
+			die("read failed");
+		}
+	}
+}
+
+/* Returns the last newline in `[begin, end)`, or NULL. */
+static char *find_last_newline(char *begin, char *end)
+{
+	while (end > begin) {
+		if (*--end == '\n') {
+			return end;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Returns whether the test rejects before the end of the input.
+ * `buf` must have BUFFER_PADDING zero bytes after BUFFER_SIZE.
+ */
+static bool run_text(struct stream *stream, char *buf)
+{
+	size_t used = 0;
+	/* Whether we're discarding a line that doesn't fit in `buf`. */
+	bool skip = false;
+	bool eof = false;
+
+	while (!eof) {
+		const char *p = buf;
+		size_t r = fill(buf, used);
+		char *end;
+
+		eof = (r == 0);
+		if (skip) {
+			const char *newline = memchr(buf, '\n', r);
+
+			if (newline == NULL) {
+				continue;
+			}
+
+			skip = false;
+			r -= (size_t)(newline + 1 - buf);
+			memmove(buf, newline + 1, r);
+		}
+
+		/* Lines are only parsed once they're complete. */
+		end = find_last_newline(buf + used, buf + used + r);
+		used += r;
+		if (end == NULL) {
+			if (used == BUFFER_SIZE) {
+				++stream->num_lines;
+				++stream->num_malformed;
+				used = 0;
+				skip = true;
+				continue;
+			}
+
+			if (!eof || used == 0) {
+				continue;
+			}
+
+			/* Terminate the last line. */
+			end = &buf[used++];
+			*end = '\n';
+		}
+
+		++end;
+		while (p < end) {
+			bool reject = false;
+
+			p = add_line(stream, p, end, &reject);
+			if (reject) {
+				return true;
+			}
+		}
+
+		used -= (size_t)(end - buf);
+		memmove(buf, end, used);
+	}
+
+	return false;
+}
+
+static bool run_binary(struct stream *stream, char *buf)
+{
+	size_t used = 0;
+	size_t r;
+
+	while ((r = fill(buf, used)) > 0) {
+		const uint8_t *records = (const uint8_t *)buf;
+		const size_t size = used + r;
+		size_t i;
+
+		for (i = 0; i + RECORD_SIZE <= size; i += RECORD_SIZE) {
+			const uint8_t *record = &records[i];
+			const uint32_t arm = ks_stream_load_le32(record);
+
+			++stream->num_lines;
+			const double value = (double)ks_stream_load_le64(
+			    &record[VALUE_OFFSET]);
+
+			if (arm <= 1 && add(stream, arm, value)) {
+				return true;
+			}
+		}
+
+		used = size - i;
+		memmove(buf, &buf[i], used);
+	}
+
+	if (used > 0) {
+		fprintf(stderr, "ks-stream: ignoring truncated record\n");
+		++stream->num_malformed;
+	}
+
+	return false;
+}
+
+static void report(const struct stream *stream, bool reject)
+{
+	const double deltas[] = { 0.1, 0.05, 0.01 };
+	const char *a = stream->names[0];
+	const char *b = stream->names[1];
+
+	if (reject) {
+		printf("reject: %s is faster than %s at some quantile\n", a,
+		    b);
+	} else {
+		printf("accept: no evidence yet that %s is ever faster "
+		       "than %s\n",
+		    a, b);
+	}
+
+	printf("pairs: %" PRIu64 " (%s: %" PRIu64 ", %s: %" PRIu64
+	       ", lines: %" PRIu64 ", malformed: %" PRIu64
+	       ", dropped: %" PRIu64 ")\n",
+	    stream->num_pairs, a, stream->num_values[0], b,
+	    stream->num_values[1], stream->num_lines, stream->num_malformed,
+	    stream->num_dropped);
+	if (stream->num_pairs > 0) {
+		printf("d_plus: %g, threshold: %g, below %g\n",
+		    stream->d_plus, stream->threshold,
+		    bucket_limit(stream->d_plus_bucket, stream->bits));
+	}
+
+	printf("expected pairs to reject (min_count %" PRIu64 "):",
+	    stream->min_count);
+	if (stream->d_plus > 0) {
+		printf(" %.4g at delta %g (observed),",
+		    one_sided_ks_expected_iter(
+			stream->min_count, stream->log_eps, stream->d_plus),
+		    stream->d_plus);
+	}
+
+	for (size_t i = 0; i < sizeof(deltas) / sizeof(deltas[0]); ++i) {
+		printf(" %.4g at delta %g%s",
+		    one_sided_ks_expected_iter(
+			stream->min_count, stream->log_eps, deltas[i]),
+		    deltas[i],
+		    (i + 1 < sizeof(deltas) / sizeof(deltas[0])) ? ","
+								  : "\n");
+	}
+}
+
+static void usage(FILE *out)
+{
+	fprintf(out,
+	    "usage: ks-stream [--arms A,B] [--log-eps LOG_EPS] "
+	    "[--min-count N]\n"
+	    "                 [--precision-bits BITS] [--max-pending N] "
+	    "[--binary]\n"
+	    "\n"
+	    "Reads `label value` lines (or 16-byte binary records) from "
+	    "stdin, and\n"
+	    "rejects once the values for A are faster than those for B "
+	    "at some\n"
+	    "quantile.  Defaults: --arms a,b --log-eps -13.8 "
+	    "--precision-bits 7\n"
+	    "--max-pending 4194304.\n"
+	    "Exits with 0 on rejection, 1 at the end of the input, 2 on "
+	    "error.\n");
+}
+
+static double parse_double(const char *arg, const char *name)
+{
+	char *end;
+	double ret;
+
+	errno = 0;
+	ret = strtod(arg, &end);
+	if (errno != 0 || end == arg || *end != '\0') {
+		fprintf(stderr, "ks-stream: invalid %s: %s\n", name, arg);
+		exit(EXIT_ERROR);
+	}
+
+	return ret;
+}
+
+static uint64_t parse_uint64(const char *arg, const char *name)
+{
+	char *end;
+	unsigned long long ret;
+
+	errno = 0;
+	ret = strtoull(arg, &end, 10);
+	if (errno != 0 || end == arg || *end != '\0' || arg[0] == '-') {
+		fprintf(stderr, "ks-stream: invalid %s: %s\n", name, arg);
+		exit(EXIT_ERROR);
+	}
+
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option options[] = {
+		{ "arms", required_argument, NULL, 'a' },
+		{ "binary", no_argument, NULL, 'b' },
+		{ "help", no_argument, NULL, 'h' },
+		{ "log-eps", required_argument, NULL, 'e' },
+		{ "max-pending", required_argument, NULL, 'q' },
+		{ "min-count", required_argument, NULL, 'm' },
+		{ "precision-bits", required_argument, NULL, 'p' },
+		{ NULL, 0, NULL, 0 },
+	};
+	struct stream stream = {
+		.names = { "a", "b" },
+		.name_lengths = { 1, 1 },
+		.log_eps = -13.8,
+		.bits = DEFAULT_PRECISION_BITS,
+		.max_pending = DEFAULT_MAX_PENDING,
+		.d_plus = 0,
+		.threshold = HUGE_VAL,
+	};
+	bool binary = false;
+	bool have_min_count = false;
+	uint64_t min_count = 0;
+	char *comma;
+	char *buf;
+	bool reject;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "", options, NULL)) != -1) {
+		switch (c) {
+		case 'a':
+			comma = strchr(optarg, ',');
+			if (comma == NULL || comma == optarg
+			    || comma[1] == '\0' || strchr(comma + 1, ',')) {
+				die("--arms takes two names, e.g., A,B");
+			}
+
+			*comma = '\0';
+			stream.names[0] = optarg;
+			stream.names[1] = comma + 1;
+			stream.name_lengths[0] = strlen(stream.names[0]);
+			stream.name_lengths[1] = strlen(stream.names[1]);
+			break;
+		case 'b':
+			binary = true;
+			break;
+		case 'h':
+			usage(stdout);
+			return 0;
+		case 'e':
+			stream.log_eps = parse_double(optarg, "--log-eps");
+			break;
+		case 'm':
+			min_count = parse_uint64(optarg, "--min-count");
+			have_min_count = true;
+			break;
+		case 'p':
+			stream.bits = (unsigned int)parse_uint64(
+			    optarg, "--precision-bits");
+			if (stream.bits > MAX_PRECISION_BITS) {
+				die("--precision-bits must be at most 16");
+			}
+
+			break;
+		case 'q':
+			stream.max_pending
+			    = parse_uint64(optarg, "--max-pending");
+			break;
+		default:
+			usage(stderr);
+			return EXIT_ERROR;
+		}
+	}
+
+	if (optind != argc) {
+		usage(stderr);
+		return EXIT_ERROR;
+	}
+
+	if (strcmp(stream.names[0], stream.names[1]) == 0) {
+		die("--arms must name two different arms");
+	}
+
+	if (!(stream.log_eps < 0)) {
+		die("--log-eps must be negative");
+	}
+
+	if (stream.max_pending == 0) {
+		die("--max-pending must be positive");
+	}
+
+	if (have_min_count
+	    && !one_sided_ks_min_count_valid(min_count, stream.log_eps)) {
+		die("--min-count is too low for --log-eps");
+	}
+
+	stream.min_count = have_min_count
+	    ? min_count
+	    : one_sided_ks_find_min_count(stream.log_eps);
+
+	for (size_t i = 0; i < 2; ++i) {
+		const uint8_t *name = (const uint8_t *)stream.names[i];
+
+		for (size_t j = 0; j < 8 && j < stream.name_lengths[i]; ++j) {
+			stream.name_words[i] |= (uint64_t)name[j] << (8 * j);
+			stream.name_masks[i] |= (uint64_t)0xff << (8 * j);
+		}
+	}
+
+	stream.num_buckets = num_buckets(stream.bits);
+	stream.lo = stream.num_buckets;
+	stream.counts[0] = calloc(stream.num_buckets, sizeof(uint64_t));
+	stream.counts[1] = calloc(stream.num_buckets, sizeof(uint64_t));
+	buf = calloc(BUFFER_SIZE + BUFFER_PADDING, 1);
+	if (stream.counts[0] == NULL || stream.counts[1] == NULL
+	    || buf == NULL) {
+		die("out of memory");
+	}
+
+	stream.next_check = (stream.min_count > 0) ? stream.min_count : 1;
+	reject = binary ? run_binary(&stream, buf) : run_text(&stream, buf);
+	if (!reject) {
+		reject = check(&stream);
+	}
+
+	report(&stream, reject);
+	free(buf);
+	free(stream.pending.buckets);
+	free(stream.counts[0]);
+	free(stream.counts[1]);
+	return reject ? EXIT_REJECT : EXIT_ACCEPT;
+}
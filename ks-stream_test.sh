@@ -0,0 +1,79 @@
+#!/bin/bash
+# End-to-end tests for ks-stream: feeds known input, and checks the
+# report and the exit code.
+#
+# usage: ks-stream_test.sh path/to/ks-stream
+set -eu
+
+KS_STREAM="$1"
+OUT="$(mktemp)"
+trap 'rm -f "$OUT"' EXIT
+# expect NAME STATUS PATTERN [ARGS...] < input: runs ks-stream with
+# ARGS, and checks its exit status and that stdout matches PATTERN
+# (if not empty).  Exits on the first failure: `expect` often runs in
+# a pipeline's subshell.
+expect() {
+	local name="$1" status="$2" pattern="$3"
+	shift 3
+
+	local actual=0
+	"$KS_STREAM" "$@" >"$OUT" 2>/dev/null || actual=$?
+	if [ "$actual" -ne "$status" ]; then
+		echo "FAIL $name: exit $actual, expected $status" >&2
+		cat "$OUT" >&2
+		exit 1
+	elif [ -n "$pattern" ] && ! grep -q -e "$pattern" "$OUT"; then
+		echo "FAIL $name: no match for '$pattern'" >&2
+		cat "$OUT" >&2
+		exit 1
+	fi
+}
+
+# A clearly faster, with values on the short and long parse paths.
+for i in $(seq 100); do
+	echo "canary 1.5"
+	echo "baseline 1000.25"
+	echo "canary 12345678.5"
+	echo "baseline 123456789.123456789"
+done | expect reject 0 '^reject: canary is faster than baseline' \
+    --arms canary,baseline
+
+# Same distribution, over several buffer refills: never rejects.
+for i in $(seq 150000); do
+	echo "a 1.5"
+	echo "b 1.5"
+done | expect refill 1 \
+    'pairs: 150000 (a: 150000, b: 150000, lines: 300000, malformed: 0'
+
+# Malformed lines, blank lines, other labels, and an unterminated
+# last line.
+printf 'a 1\nb\nb x\nc 3\n\n  \na  2.5\nb 2' \
+    | expect malformed 1 'pairs: 1 (a: 2, b: 1, lines: 8, malformed: 2,'
+printf 'a 1\nb 2' | expect unterminated 1 'pairs: 1 (a: 1, b: 1,'
+
+# A line longer than the buffer is skipped, and counted as malformed.
+{
+	head -c 3000000 /dev/zero | tr '\0' '7'
+	printf '\na 1\nb 2\n'
+} | expect oversized 1 'pairs: 1 (a: 1, b: 1, lines: 3, malformed: 1,'
+
+# Values for an arm that never shows up are capped.
+for i in $(seq 10); do
+	echo "a $i"
+done | expect max_pending 1 'pairs: 0 (a: 4, b: 0, .*dropped: 6)' \
+    --max-pending 4
+
+# Binary records: arm 0 = 1, arm 1 = 2, arm 7 (ignored), and a
+# truncated record.
+RECORD_A='\0\0\0\0\0\0\0\0\1\0\0\0\0\0\0\0'
+RECORD_B='\1\0\0\0\0\0\0\0\2\0\0\0\0\0\0\0'
+RECORD_OTHER='\7\0\0\0\0\0\0\0\2\0\0\0\0\0\0\0'
+printf "$RECORD_A$RECORD_B$RECORD_OTHER\1\0\0" \
+    | expect binary 1 'pairs: 1 (a: 1, b: 1, lines: 3, malformed: 1,' \
+    --binary
+
+# Errors.
+expect bad_option 2 '' --bogus </dev/null
+expect bad_log_eps 2 '' --log-eps 1 </dev/null
+expect bad_max_pending 2 '' --max-pending 0 </dev/null
+expect bad_arms 2 '' --arms a </dev/null
@@ -0,0 +1,280 @@
+#include "one-sided-ks-alpha.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "one-sided-ks.h"
+
+/* Levels are multiples of -ln(2) / LEVELS_PER_HALVING. */
+#define LEVELS_PER_HALVING 8
+
+/* Relative rounding error tolerated in the sum of weights. */
+#define WEIGHT_SLACK 1e-9
+
+/* Budgets below 2^-1024 are useless anyway. */
+#define MAX_LEVEL (LEVELS_PER_HALVING * 1024)
+
+struct level {
+	/* 0 until the level is first used. */
+	uint64_t min_count;
+	struct one_sided_ks_table *table;
+};
+
+struct one_sided_ks_alpha {
+	struct one_sided_ks_alpha_params params;
+	/* Number of tests so far. */
+	uint64_t num_tests;
+	/* ONE_SIDED_KS_ALPHA_WEIGHTED: sum of weights so far. */
+	double total_weight;
+
+	/* ONE_SIDED_KS_ALPHA_LORD: remaining wealth. */
+	double wealth;
+	/* Index of the last test that rejected or stopped, 0 if none. */
+	uint64_t last_resolved;
+	/* Index of the last rejection, 0 if none. */
+	uint64_t last_reject;
+	/* Wealth right after the last rejection. */
+	double last_reject_wealth;
+
+	/* Indexed by level. */
+	struct level *levels;
+	size_t num_levels;
+};
+
+struct one_sided_ks_alpha *one_sided_ks_alpha_create(
+    const struct one_sided_ks_alpha_params *params)
+{
+	struct one_sided_ks_alpha *ret;
+
+	if (!(params->log_eps < 0)) {
+		return NULL;
+	}
+
+	switch (params->policy) {
+	case ONE_SIDED_KS_ALPHA_BONFERRONI:
+		if (params->max_tests == 0) {
+			return NULL;
+		}
+		break;
+	case ONE_SIDED_KS_ALPHA_WEIGHTED:
+		if (!(params->total_weight > 0)
+		    || !isfinite(params->total_weight)) {
+			return NULL;
+		}
+		break;
+	case ONE_SIDED_KS_ALPHA_SPENDING:
+	case ONE_SIDED_KS_ALPHA_LORD:
+		break;
+	default:
+		return NULL;
+	}
+
+	ret = calloc(1, sizeof(*ret));
+	if (ret == NULL) {
+		return NULL;
+	}
+
+	ret->params = *params;
+	ret->wealth = exp(params->log_eps) / 2;
+	ret->last_reject_wealth = ret->wealth;
+	return ret;
+}
+
+void one_sided_ks_alpha_destroy(struct one_sided_ks_alpha *alpha)
+{
+	if (alpha == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < alpha->num_levels; ++i) {
+		one_sided_ks_table_destroy(alpha->levels[i].table);
+	}
+
+	free(alpha->levels);
+	free(alpha);
+}
+
+/* The spending sequence, 1 / (j (j + 1)) for j >= 1, in log space. */
+static double log_gamma(uint64_t j)
+{
+	return -log((double)j) - log1p((double)j);
+}
+
+/*
+ * Returns the log of the budget for the next test, or NAN if there's
+ * none left.
+ */
+static double next_log_eps(struct one_sided_ks_alpha *alpha, double weight)
+{
+	const struct one_sided_ks_alpha_params *params = &alpha->params;
+	const uint64_t j = alpha->num_tests + 1;
+
+	switch (params->policy) {
+	case ONE_SIDED_KS_ALPHA_BONFERRONI:
+		if (alpha->num_tests >= params->max_tests) {
+			return NAN;
+		}
+
+		return params->log_eps - log((double)params->max_tests);
+	case ONE_SIDED_KS_ALPHA_WEIGHTED: {
+		const double total = alpha->total_weight + weight;
+
+		/*
+		 * Let weights like 0.1 add up to 1, and scale budgets down
+		 * by the same slack, so they still add up to at most eps.
+		 */
+		const double slack_weight
+		    = params->total_weight * (1 + WEIGHT_SLACK);
+
+		if (!(weight > 0) || !(total <= slack_weight)) {
+			return NAN;
+		}
+
+		return params->log_eps + log(weight / slack_weight);
+	}
+	case ONE_SIDED_KS_ALPHA_SPENDING:
+		return params->log_eps + log_gamma(j);
+	case ONE_SIDED_KS_ALPHA_LORD:
+		return log(alpha->last_reject_wealth)
+		    + log_gamma(j - alpha->last_reject);
+	}
+
+	return NAN;
+}
+
+static double level_log_eps(long index)
+{
+	return -index * (log(2.0) / LEVELS_PER_HALVING);
+}
+
+/*
+ * Returns the level of the greatest multiple of -ln(2) / 8 that's at
+ * most `log_eps`, or -1 if it's out of range.
+ */
+static long level_of(double log_eps)
+{
+	const double scaled
+	    = ceil(-log_eps * LEVELS_PER_HALVING / log(2.0));
+
+	if (!(scaled >= 1 && scaled <= MAX_LEVEL)) {
+		return -1;
+	}
+
+	long ret = (long)scaled;
+	if (level_log_eps(ret) > log_eps) {
+		++ret;
+	}
+
+	return ret;
+}
+
+/* Returns the (initialised) level `index`, or NULL on failure. */
+static struct level *get_level(struct one_sided_ks_alpha *alpha, long index)
+{
+	const double log_eps = level_log_eps(index);
+	struct level *level;
+
+	if ((size_t)index >= alpha->num_levels) {
+		size_t num_levels = (alpha->num_levels == 0)
+		    ? 4 * LEVELS_PER_HALVING
+		    : alpha->num_levels;
+
+		while (num_levels <= (size_t)index) {
+			num_levels *= 2;
+		}
+
+		struct level *grown = realloc(
+		    alpha->levels, num_levels * sizeof(*alpha->levels));
+		if (grown == NULL) {
+			return NULL;
+		}
+
+		for (size_t i = alpha->num_levels; i < num_levels; ++i) {
+			grown[i] = (struct level) { 0 };
+		}
+
+		alpha->levels = grown;
+		alpha->num_levels = num_levels;
+	}
+
+	level = &alpha->levels[index];
+	if (level->min_count != 0) {
+		return level;
+	}
+
+	if (alpha->params.table_max_n > 0) {
+		const uint64_t min_count
+		    = one_sided_ks_find_min_count(log_eps);
+
+		level->table = one_sided_ks_pair_table_create(
+		    min_count, log_eps, alpha->params.table_max_n);
+		if (level->table == NULL) {
+			return NULL;
+		}
+
+		level->min_count = min_count;
+	} else {
+		level->min_count = one_sided_ks_find_min_count(log_eps);
+	}
+
+	return level;
+}
+
+int one_sided_ks_alpha_add(struct one_sided_ks_alpha *alpha, double weight,
+    struct one_sided_ks_alpha_test *out)
+{
+	const double log_eps = next_log_eps(alpha, weight);
+	const long index = level_of(log_eps);
+	struct level *level;
+
+	/* LORD's budgets assume that every earlier test has completed. */
+	if (index < 0
+	    || (alpha->params.policy == ONE_SIDED_KS_ALPHA_LORD
+		&& alpha->last_resolved != alpha->num_tests)) {
+		return -1;
+	}
+
+	level = get_level(alpha, index);
+	if (level == NULL) {
+		return -1;
+	}
+
+	++alpha->num_tests;
+	if (alpha->params.policy == ONE_SIDED_KS_ALPHA_WEIGHTED) {
+		alpha->total_weight += weight;
+	} else if (alpha->params.policy == ONE_SIDED_KS_ALPHA_LORD) {
+		alpha->wealth -= exp(log_eps);
+	}
+
+	*out = (struct one_sided_ks_alpha_test) {
+		.index = alpha->num_tests,
+		.log_eps = level_log_eps(index),
+		.min_count = level->min_count,
+		.table = level->table,
+	};
+	return 0;
+}
+
+void one_sided_ks_alpha_reject(
+    struct one_sided_ks_alpha *alpha, uint64_t index)
+{
+	if (index != alpha->num_tests || index <= alpha->last_resolved) {
+		return;
+	}
+
+	alpha->last_resolved = index;
+	alpha->wealth += exp(alpha->params.log_eps) / 2;
+	alpha->last_reject = index;
+	alpha->last_reject_wealth = alpha->wealth;
+}
+
+void one_sided_ks_alpha_stop(
+    struct one_sided_ks_alpha *alpha, uint64_t index)
+{
+	if (index != alpha->num_tests || index <= alpha->last_resolved) {
+		return;
+	}
+
+	alpha->last_resolved = index;
+}
@@ -0,0 +1,121 @@
+#ifndef ONE_SIDED_KS_ALPHA_H
+#define ONE_SIDED_KS_ALPHA_H
+#include <stdint.h>
+
+#include "one-sided-ks-table.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Splits a false positive budget `exp(log_eps)` across many tests.
+ *
+ * - ONE_SIDED_KS_ALPHA_BONFERRONI gives each of at most `max_tests`
+ *   tests `eps / max_tests`.
+ * - ONE_SIDED_KS_ALPHA_WEIGHTED gives each test `eps * weight /
+ *   total_weight`, until the tests' weights add up to `total_weight`.
+ *   Weights may exceed `total_weight` by a relative 1e-9, for rounding
+ *   errors, and budgets are scaled down by as much to compensate.
+ * - ONE_SIDED_KS_ALPHA_SPENDING gives the j-th test (from 1) `eps /
+ *   (j (j + 1))`; these add up to less than `eps`, for any number of
+ *   tests, so tests can start at any time.
+ *
+ * In all three cases, the family-wise error rate (the probability
+ * that any test falsely rejects) is at most `eps`, by the union bound.
+ * Budget isn't returned when a test stops: it may have been spent.
+ *
+ * - ONE_SIDED_KS_ALPHA_LORD implements LORD (Javanmard and Montanari,
+ *   "Online rules for control of false discovery rate", 2018, version
+ *   3): the j-th test gets `gamma(j - tau) W(tau)`, where `tau` is the
+ *   last rejection reported with `one_sided_ks_alpha_reject`, `W` the
+ *   wealth at that point, and `gamma` the sequence above.  Wealth
+ *   starts at `eps / 2`, and each rejection earns `eps / 2`.  This
+ *   controls the false discovery rate at `eps` rather than the
+ *   family-wise error rate, and lets budget grow with true
+ *   discoveries.
+ *
+ *   That guarantee assumes tests complete sequentially, so every
+ *   budget accounts for all earlier outcomes: each test must be
+ *   resolved with `one_sided_ks_alpha_reject` or
+ *   `one_sided_ks_alpha_stop` before the next one can be added.  Tests
+ *   that overlap in time need LORD_async (Zrnic, Ramdas, and Jordan,
+ *   2021), which isn't implemented here, or
+ *   ONE_SIDED_KS_ALPHA_SPENDING.
+ *
+ * Each test's `log_eps` is rounded down to a multiple of ln(2) / 8, so
+ * tests share `min_count` values and, optionally, threshold tables
+ * (and batch well in a `one_sided_ks_monitor`).  Adding a test takes
+ * constant time, plus the construction of a table the first time a
+ * level is used.
+ */
+enum one_sided_ks_alpha_policy {
+	ONE_SIDED_KS_ALPHA_BONFERRONI = 0,
+	ONE_SIDED_KS_ALPHA_WEIGHTED = 1,
+	ONE_SIDED_KS_ALPHA_SPENDING = 2,
+	ONE_SIDED_KS_ALPHA_LORD = 3,
+};
+
+struct one_sided_ks_alpha_params {
+	enum one_sided_ks_alpha_policy policy;
+	/* The log of the total false positive budget. */
+	double log_eps;
+	/* ONE_SIDED_KS_ALPHA_BONFERRONI only. */
+	uint64_t max_tests;
+	/* ONE_SIDED_KS_ALPHA_WEIGHTED only. */
+	double total_weight;
+	/* If non-zero, build pair threshold tables up to `table_max_n`. */
+	uint64_t table_max_n;
+};
+
+struct one_sided_ks_alpha_test {
+	/* Sequence number of the test, from 1. */
+	uint64_t index;
+	double log_eps;
+	/* The least valid `min_count` for `log_eps`. */
+	uint64_t min_count;
+	/* Shared by tests with the same `log_eps`, or NULL. */
+	const struct one_sided_ks_table *table;
+};
+
+struct one_sided_ks_alpha;
+
+/* Returns a new allocator, or NULL if `params` is invalid. */
+struct one_sided_ks_alpha *one_sided_ks_alpha_create(
+    const struct one_sided_ks_alpha_params *params);
+
+/* Also destroys the threshold tables. */
+void one_sided_ks_alpha_destroy(struct one_sided_ks_alpha *alpha);
+
+/*
+ * Allocates budget for a new test with `weight` (only used by
+ * ONE_SIDED_KS_ALPHA_WEIGHTED), and describes it in `out`.
+ *
+ * Returns 0 on success, -1 if the budget is exhausted, `weight` is
+ * invalid, the previous ONE_SIDED_KS_ALPHA_LORD test is unresolved, or
+ * on allocation failure.
+ */
+int one_sided_ks_alpha_add(struct one_sided_ks_alpha *alpha, double weight,
+    struct one_sided_ks_alpha_test *out);
+
+/*
+ * Reports that test `index` rejected.  Only affects
+ * ONE_SIDED_KS_ALPHA_LORD, where rejections earn more budget and
+ * resolve the test; reports for any test but the latest, or for
+ * resolved tests, are ignored.
+ */
+void one_sided_ks_alpha_reject(
+    struct one_sided_ks_alpha *alpha, uint64_t index);
+
+/*
+ * Reports that test `index` stopped without rejecting (it accepted, or
+ * was abandoned).  Only affects ONE_SIDED_KS_ALPHA_LORD, where it
+ * resolves the test, so that the next one can be added; reports for
+ * any test but the latest, or for resolved tests, are ignored.
+ */
+void one_sided_ks_alpha_stop(
+    struct one_sided_ks_alpha *alpha, uint64_t index);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /* !ONE_SIDED_KS_ALPHA_H */
@@ -0,0 +1,258 @@
+#include "one-sided-ks-alpha.h"
+
+#include <cmath>
+#include <cstdint>
+
+#include "gtest/gtest.h"
+#include "one-sided-ks.h"
+
+namespace {
+const double kLogEps = std::log(1e-3);
+
+one_sided_ks_alpha_params make_params(one_sided_ks_alpha_policy policy)
+{
+	one_sided_ks_alpha_params ret = {};
+
+	ret.policy = policy;
+	ret.log_eps = kLogEps;
+	return ret;
+}
+
+// Every test must have a valid min_count, and a budget within one
+// level of `log_eps`.
+void check_test(const one_sided_ks_alpha_test &test, double log_eps)
+{
+	EXPECT_LE(test.log_eps, log_eps);
+	EXPECT_GT(test.log_eps, log_eps - std::log(2.0) / 8 - 1e-12);
+	EXPECT_EQ(test.min_count, one_sided_ks_find_min_count(test.log_eps));
+}
+
+TEST(OneSidedKsAlpha, Invalid)
+{
+	one_sided_ks_alpha_params params
+	    = make_params(ONE_SIDED_KS_ALPHA_BONFERRONI);
+
+	EXPECT_EQ(nullptr, one_sided_ks_alpha_create(&params));
+	params.max_tests = 10;
+	params.log_eps = 0;
+	EXPECT_EQ(nullptr, one_sided_ks_alpha_create(&params));
+
+	params = make_params(ONE_SIDED_KS_ALPHA_WEIGHTED);
+	EXPECT_EQ(nullptr, one_sided_ks_alpha_create(&params));
+	params.total_weight = INFINITY;
+	EXPECT_EQ(nullptr, one_sided_ks_alpha_create(&params));
+
+	one_sided_ks_alpha_destroy(nullptr);
+}
+
+TEST(OneSidedKsAlpha, Bonferroni)
+{
+	one_sided_ks_alpha_params params
+	    = make_params(ONE_SIDED_KS_ALPHA_BONFERRONI);
+	one_sided_ks_alpha_test test;
+
+	params.max_tests = 100;
+	one_sided_ks_alpha *alpha = one_sided_ks_alpha_create(&params);
+	ASSERT_NE(alpha, nullptr);
+
+	for (uint64_t i = 1; i <= 100; ++i) {
+		ASSERT_EQ(0, one_sided_ks_alpha_add(alpha, 1, &test));
+		EXPECT_EQ(i, test.index);
+		check_test(test, kLogEps - std::log(100.0));
+		EXPECT_EQ(nullptr, test.table);
+	}
+
+	EXPECT_EQ(-1, one_sided_ks_alpha_add(alpha, 1, &test));
+	one_sided_ks_alpha_destroy(alpha);
+}
+
+TEST(OneSidedKsAlpha, Weighted)
+{
+	one_sided_ks_alpha_params params
+	    = make_params(ONE_SIDED_KS_ALPHA_WEIGHTED);
+	one_sided_ks_alpha_test test;
+
+	params.total_weight = 1;
+	one_sided_ks_alpha *alpha = one_sided_ks_alpha_create(&params);
+	ASSERT_NE(alpha, nullptr);
+
+	EXPECT_EQ(-1, one_sided_ks_alpha_add(alpha, 0, &test));
+	EXPECT_EQ(-1, one_sided_ks_alpha_add(alpha, 1.5, &test));
+
+	ASSERT_EQ(0, one_sided_ks_alpha_add(alpha, 0.5, &test));
+	check_test(test, kLogEps + std::log(0.5));
+
+	// 0.1 doesn't add up to 0.5 exactly.
+	for (size_t i = 0; i < 5; ++i) {
+		ASSERT_EQ(0, one_sided_ks_alpha_add(alpha, 0.1, &test));
+		check_test(test, kLogEps + std::log(0.1));
+	}
+
+	EXPECT_EQ(-1, one_sided_ks_alpha_add(alpha, 0.01, &test));
+	one_sided_ks_alpha_destroy(alpha);
+}
+
+// Weights may add up to a bit more than total_weight, but budgets must
+// still add up to at most eps, even when they fall exactly on levels.
+TEST(OneSidedKsAlpha, WeightedSlack)
+{
+	one_sided_ks_alpha_params params
+	    = make_params(ONE_SIDED_KS_ALPHA_WEIGHTED);
+	one_sided_ks_alpha_test test;
+	double total = 0;
+
+	params.log_eps = -std::log(2.0);
+	params.total_weight = 1;
+	one_sided_ks_alpha *alpha = one_sided_ks_alpha_create(&params);
+	ASSERT_NE(alpha, nullptr);
+
+	for (const double weight : { 0.5, 0.5, 1e-10 }) {
+		ASSERT_EQ(0, one_sided_ks_alpha_add(alpha, weight, &test));
+		total += std::exp(test.log_eps);
+	}
+
+	EXPECT_LE(total, 0.5);
+	one_sided_ks_alpha_destroy(alpha);
+}
+
+TEST(OneSidedKsAlpha, Spending)
+{
+	one_sided_ks_alpha *alpha = nullptr;
+	one_sided_ks_alpha_params params
+	    = make_params(ONE_SIDED_KS_ALPHA_SPENDING);
+	double total = 0;
+
+	alpha = one_sided_ks_alpha_create(&params);
+	ASSERT_NE(alpha, nullptr);
+
+	for (uint64_t j = 1; j <= 100000; ++j) {
+		one_sided_ks_alpha_test test;
+
+		ASSERT_EQ(0, one_sided_ks_alpha_add(alpha, 1, &test));
+		if (j % 997 == 1) {
+			check_test(test,
+			    kLogEps - std::log(j * (j + 1.0)));
+		}
+
+		total += std::exp(test.log_eps);
+	}
+
+	EXPECT_LT(total, std::exp(kLogEps));
+	one_sided_ks_alpha_destroy(alpha);
+}
+
+TEST(OneSidedKsAlpha, Lord)
+{
+	one_sided_ks_alpha_params params
+	    = make_params(ONE_SIDED_KS_ALPHA_LORD);
+	one_sided_ks_alpha_test test;
+	double total = 0;
+
+	one_sided_ks_alpha *alpha = one_sided_ks_alpha_create(&params);
+	ASSERT_NE(alpha, nullptr);
+
+	// Without rejections, LORD spends eps / 2 like SPENDING.
+	for (uint64_t j = 1; j <= 1000; ++j) {
+		ASSERT_EQ(0, one_sided_ks_alpha_add(alpha, 1, &test));
+		total += std::exp(test.log_eps);
+		if (j < 1000) {
+			one_sided_ks_alpha_stop(alpha, j);
+		}
+	}
+
+	EXPECT_LT(total, std::exp(kLogEps) / 2);
+	check_test(test, kLogEps - std::log(2 * 1000.0 * 1001.0));
+
+	// A rejection restarts the sequence with the remaining wealth, plus
+	// eps / 2.
+	const double eps = std::exp(kLogEps);
+	const double wealth = eps - eps / 2 * 1000 / 1001;
+
+	one_sided_ks_alpha_reject(alpha, 1000);
+	ASSERT_EQ(0, one_sided_ks_alpha_add(alpha, 1, &test));
+	EXPECT_EQ(1001, test.index);
+	check_test(test, std::log(wealth / 2));
+
+	// Older, repeated, and future rejections are ignored.
+	one_sided_ks_alpha_reject(alpha, 999);
+	one_sided_ks_alpha_reject(alpha, 1000);
+	one_sided_ks_alpha_reject(alpha, 1002);
+	one_sided_ks_alpha_stop(alpha, 1001);
+	ASSERT_EQ(0, one_sided_ks_alpha_add(alpha, 1, &test));
+	check_test(test, std::log(wealth / 6));
+
+	one_sided_ks_alpha_destroy(alpha);
+}
+
+// LORD tests must complete sequentially: a new test can only be added
+// once the previous one rejected or stopped.
+TEST(OneSidedKsAlpha, LordSequential)
+{
+	one_sided_ks_alpha_params params
+	    = make_params(ONE_SIDED_KS_ALPHA_LORD);
+	one_sided_ks_alpha_test test;
+
+	one_sided_ks_alpha *alpha = one_sided_ks_alpha_create(&params);
+	ASSERT_NE(alpha, nullptr);
+
+	ASSERT_EQ(0, one_sided_ks_alpha_add(alpha, 1, &test));
+	EXPECT_EQ(1, test.index);
+	EXPECT_EQ(-1, one_sided_ks_alpha_add(alpha, 1, &test));
+	one_sided_ks_alpha_stop(alpha, 2);
+	EXPECT_EQ(-1, one_sided_ks_alpha_add(alpha, 1, &test));
+
+	// Stopping resolves the test without earning anything, and a
+	// later rejection of a stopped test is ignored.
+	one_sided_ks_alpha_stop(alpha, 1);
+	one_sided_ks_alpha_reject(alpha, 1);
+	ASSERT_EQ(0, one_sided_ks_alpha_add(alpha, 1, &test));
+	EXPECT_EQ(2, test.index);
+	check_test(test, kLogEps - std::log(2 * 2.0 * 3.0));
+
+	// Rejecting resolves the test too.
+	const double eps = std::exp(kLogEps);
+	const double wealth = eps - eps / 2 * 2 / 3;
+
+	one_sided_ks_alpha_reject(alpha, test.index);
+	one_sided_ks_alpha_stop(alpha, test.index);
+	ASSERT_EQ(0, one_sided_ks_alpha_add(alpha, 1, &test));
+	EXPECT_EQ(3, test.index);
+	check_test(test, std::log(wealth / 2));
+
+	one_sided_ks_alpha_destroy(alpha);
+}
+
+TEST(OneSidedKsAlpha, SharedTables)
+{
+	one_sided_ks_alpha_params params
+	    = make_params(ONE_SIDED_KS_ALPHA_WEIGHTED);
+	one_sided_ks_alpha_test x;
+	one_sided_ks_alpha_test y;
+	one_sided_ks_alpha_test z;
+
+	params.total_weight = 10;
+	params.table_max_n = 1000;
+	one_sided_ks_alpha *alpha = one_sided_ks_alpha_create(&params);
+	ASSERT_NE(alpha, nullptr);
+
+	// x and y round to the same level, z doesn't.
+	ASSERT_EQ(0, one_sided_ks_alpha_add(alpha, 1, &x));
+	ASSERT_EQ(0, one_sided_ks_alpha_add(alpha, 1.01, &y));
+	ASSERT_EQ(0, one_sided_ks_alpha_add(alpha, 4, &z));
+
+	ASSERT_NE(x.table, nullptr);
+	EXPECT_EQ(x.table, y.table);
+	EXPECT_EQ(x.log_eps, y.log_eps);
+	EXPECT_NE(x.table, z.table);
+	EXPECT_LT(z.min_count, x.min_count);
+
+	for (uint64_t n : { x.min_count, x.min_count + 1, uint64_t(999) }) {
+		EXPECT_EQ(one_sided_ks_pair_threshold(
+			      n, x.min_count, x.log_eps),
+		    one_sided_ks_table_threshold(x.table, n))
+		    << n;
+	}
+
+	one_sided_ks_alpha_destroy(alpha);
+}
+} // namespace
@@ -0,0 +1,451 @@
+#include "one-sided-ks-btree.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "one-sided-ks-ratio.h"
+
+/* Maximum number of values (leaves) or children (internal nodes). */
+#define FANOUT 16
+
+#define NONE UINT32_MAX
+
+/*
+ * Summary of (+1 for each A, -1 for each B) over a range of values,
+ * where prefixes include the empty one, and only stop between
+ * distinct values.
+ */
+struct summary {
+	uint64_t count[2];
+	int64_t sum;
+	int64_t max_prefix;
+	int64_t min_prefix;
+};
+
+struct node {
+	uint32_t size;
+	bool leaf;
+	/* Next leaf, in key order, or NONE. */
+	uint32_t next;
+	/* Leaves: distinct values; internal: least value in each child. */
+	double keys[FANOUT];
+	/* Leaves: each value's summary; internal: each child's. */
+	struct summary entries[FANOUT];
+	/* Internal nodes only. */
+	uint32_t children[FANOUT];
+};
+
+struct one_sided_ks_btree {
+	/*
+	 * All nodes live in this array, and refer to each other by
+	 * index.  Splits always create the right sibling, so node 0
+	 * is always the leftmost leaf.
+	 */
+	struct node *nodes;
+	size_t num_nodes;
+	size_t capacity;
+	uint32_t root;
+	/* Number of levels, including the leaves. */
+	size_t height;
+	/* Summary of the root. */
+	struct summary total;
+};
+
+struct one_sided_ks_btree *one_sided_ks_btree_create(void)
+{
+	const size_t initial_capacity = 16;
+	struct one_sided_ks_btree *tree = calloc(1, sizeof(*tree));
+	if (tree == NULL) {
+		return NULL;
+	}
+
+	tree->nodes = calloc(initial_capacity, sizeof(struct node));
+	if (tree->nodes == NULL) {
+		one_sided_ks_btree_destroy(tree);
+		return NULL;
+	}
+
+	tree->capacity = initial_capacity;
+	tree->num_nodes = 1;
+	tree->root = 0;
+	tree->height = 1;
+	tree->nodes[0].leaf = true;
+	tree->nodes[0].next = NONE;
+	return tree;
+}
+
+void one_sided_ks_btree_destroy(struct one_sided_ks_btree *tree)
+{
+	if (tree == NULL) {
+		return;
+	}
+
+	free(tree->nodes);
+	free(tree);
+}
+
+static int64_t max64(int64_t x, int64_t y)
+{
+	return (x > y) ? x : y;
+}
+
+static int64_t min64(int64_t x, int64_t y)
+{
+	return (x < y) ? x : y;
+}
+
+static struct summary summarise(const struct node *node)
+{
+	struct summary ret = { { 0, 0 }, 0, 0, 0 };
+
+	for (size_t i = 0; i < node->size; ++i) {
+		const struct summary *entry = &node->entries[i];
+
+		ret.count[0] += entry->count[0];
+		ret.count[1] += entry->count[1];
+		ret.max_prefix
+		    = max64(ret.max_prefix, ret.sum + entry->max_prefix);
+		ret.min_prefix
+		    = min64(ret.min_prefix, ret.sum + entry->min_prefix);
+		ret.sum += entry->sum;
+	}
+
+	return ret;
+}
+
+/* Adds one value from `arm` to a leaf entry. */
+static void bump(struct summary *entry, enum one_sided_ks_arm arm)
+{
+	++entry->count[arm];
+	entry->sum += (arm == ONE_SIDED_KS_ARM_A) ? 1 : -1;
+	entry->max_prefix = max64(0, entry->sum);
+	entry->min_prefix = min64(0, entry->sum);
+}
+
+/*
+ * Makes sure we can allocate `count` more nodes without failing.
+ * Returns 0 on success, -1 on failure.
+ */
+static int reserve(struct one_sided_ks_btree *tree, size_t count)
+{
+	size_t capacity = tree->capacity;
+	struct node *nodes;
+
+	if (count <= tree->capacity - tree->num_nodes) {
+		return 0;
+	}
+
+	while (count > capacity - tree->num_nodes) {
+		if (capacity > NONE / 2
+		    || capacity > SIZE_MAX / (2 * sizeof(struct node))) {
+			return -1;
+		}
+
+		capacity *= 2;
+	}
+
+	nodes = realloc(tree->nodes, capacity * sizeof(struct node));
+	if (nodes == NULL) {
+		return -1;
+	}
+
+	tree->nodes = nodes;
+	tree->capacity = capacity;
+	return 0;
+}
+
+/*
+ * Moves the upper half of `index`'s entries to a new right sibling,
+ * and returns the sibling's index.  `reserve` must have made room.
+ */
+static uint32_t split(struct one_sided_ks_btree *tree, uint32_t index)
+{
+	const uint32_t ret = tree->num_nodes++;
+	struct node *node = &tree->nodes[index];
+	struct node *sibling = &tree->nodes[ret];
+	const size_t half = FANOUT / 2;
+
+	memset(sibling, 0, sizeof(*sibling));
+	sibling->size = node->size - half;
+	sibling->leaf = node->leaf;
+	memcpy(sibling->keys, node->keys + half,
+	    sibling->size * sizeof(node->keys[0]));
+	memcpy(sibling->entries, node->entries + half,
+	    sibling->size * sizeof(node->entries[0]));
+	memcpy(sibling->children, node->children + half,
+	    sibling->size * sizeof(node->children[0]));
+	node->size = half;
+
+	sibling->next = NONE;
+	if (node->leaf) {
+		sibling->next = node->next;
+		node->next = ret;
+	}
+
+	return ret;
+}
+
+/* Inserts an entry at position `i`, which must be <= size < FANOUT. */
+static void insert_at(struct node *node, size_t i, double key,
+    const struct summary *entry, uint32_t child)
+{
+	const size_t tail = node->size - i;
+
+	memmove(node->keys + i + 1, node->keys + i,
+	    tail * sizeof(node->keys[0]));
+	memmove(node->entries + i + 1, node->entries + i,
+	    tail * sizeof(node->entries[0]));
+	memmove(node->children + i + 1, node->children + i,
+	    tail * sizeof(node->children[0]));
+	node->keys[i] = key;
+	node->entries[i] = *entry;
+	node->children[i] = child;
+	++node->size;
+}
+
+/*
+ * Inserts at position `i` in node `index`, splitting it first if
+ * it's full.  Returns the new sibling's index, or NONE.
+ */
+static uint32_t insert_or_split(struct one_sided_ks_btree *tree,
+    uint32_t index, size_t i, double key, const struct summary *entry,
+    uint32_t child)
+{
+	uint32_t ret = NONE;
+
+	if (tree->nodes[index].size == FANOUT) {
+		ret = split(tree, index);
+		if (i > FANOUT / 2) {
+			index = ret;
+			i -= FANOUT / 2;
+		}
+	}
+
+	insert_at(&tree->nodes[index], i, key, entry, child);
+	return ret;
+}
+
+/* Index of the first key >= value. */
+static size_t lower_bound(const struct node *node, double value)
+{
+	size_t i = 0;
+
+	while (i < node->size && node->keys[i] < value) {
+		++i;
+	}
+
+	return i;
+}
+
+/* Index of the child that should hold value. */
+static size_t child_index(const struct node *node, double value)
+{
+	size_t i = 1;
+
+	while (i < node->size && node->keys[i] <= value) {
+		++i;
+	}
+
+	return i - 1;
+}
+
+/*
+ * Adds `value` to the subtree rooted at `index`, and returns the
+ * index of the subtree's new right sibling if it had to split.
+ */
+static uint32_t insert(struct one_sided_ks_btree *tree, uint32_t index,
+    enum one_sided_ks_arm arm, double value)
+{
+	struct node *node = &tree->nodes[index];
+
+	if (node->leaf) {
+		const size_t i = lower_bound(node, value);
+		struct summary entry = { { 0, 0 }, 0, 0, 0 };
+
+		if (i < node->size && node->keys[i] == value) {
+			bump(&node->entries[i], arm);
+			return NONE;
+		}
+
+		bump(&entry, arm);
+		return insert_or_split(tree, index, i, value, &entry, NONE);
+	}
+
+	const size_t i = child_index(node, value);
+	const uint32_t child = node->children[i];
+	const uint32_t sibling = insert(tree, child, arm, value);
+
+	/* `reserve` guarantees `insert` didn't move the nodes. */
+	if (value < node->keys[i]) {
+		node->keys[i] = value;
+	}
+
+	node->entries[i] = summarise(&tree->nodes[child]);
+	if (sibling == NONE) {
+		return NONE;
+	}
+
+	const struct summary entry = summarise(&tree->nodes[sibling]);
+	return insert_or_split(tree, index, i + 1,
+	    tree->nodes[sibling].keys[0], &entry, sibling);
+}
+
+/* Inserts `value`, after `reserve` made room for the splits. */
+static void add(struct one_sided_ks_btree *tree, enum one_sided_ks_arm arm,
+    double value)
+{
+	const uint32_t sibling = insert(tree, tree->root, arm, value);
+
+	if (sibling != NONE) {
+		const uint32_t root = tree->num_nodes++;
+		struct node *node = &tree->nodes[root];
+		struct summary entry;
+
+		memset(node, 0, sizeof(*node));
+		node->leaf = false;
+		node->next = NONE;
+		entry = summarise(&tree->nodes[tree->root]);
+		insert_at(node, 0, tree->nodes[tree->root].keys[0], &entry,
+		    tree->root);
+		entry = summarise(&tree->nodes[sibling]);
+		insert_at(node, 1, tree->nodes[sibling].keys[0], &entry,
+		    sibling);
+		tree->root = root;
+		++tree->height;
+	}
+
+	tree->total = summarise(&tree->nodes[tree->root]);
+}
+
+int one_sided_ks_btree_add(struct one_sided_ks_btree *tree,
+    enum one_sided_ks_arm arm, double value)
+{
+	/* One split per level, and maybe a new root. */
+	if (reserve(tree, tree->height + 1) != 0) {
+		return -1;
+	}
+
+	add(tree, arm, value);
+	return 0;
+}
+
+int one_sided_ks_btree_add_pair(
+    struct one_sided_ks_btree *tree, double a, double b)
+{
+	/* The first insertion may add a level for the second. */
+	if (reserve(tree, 2 * tree->height + 3) != 0) {
+		return -1;
+	}
+
+	add(tree, ONE_SIDED_KS_ARM_A, a);
+	add(tree, ONE_SIDED_KS_ARM_B, b);
+	return 0;
+}
+
+uint64_t one_sided_ks_btree_count(
+    const struct one_sided_ks_btree *tree, enum one_sided_ks_arm arm)
+{
+	return tree->total.count[arm];
+}
+
+uint64_t one_sided_ks_btree_rank(const struct one_sided_ks_btree *tree,
+    enum one_sided_ks_arm arm, double value)
+{
+	const struct node *node = &tree->nodes[tree->root];
+	uint64_t ret = 0;
+
+	while (!node->leaf) {
+		const size_t i = child_index(node, value);
+
+		/* Everything in children before i is < keys[i] <= value. */
+		for (size_t j = 0; j < i; ++j) {
+			ret += node->entries[j].count[arm];
+		}
+
+		node = &tree->nodes[node->children[i]];
+	}
+
+	for (size_t i = 0; i < node->size && node->keys[i] <= value; ++i) {
+		ret += node->entries[i].count[arm];
+	}
+
+	return ret;
+}
+
+uint64_t one_sided_ks_btree_r_plus(const struct one_sided_ks_btree *tree)
+{
+	return tree->total.max_prefix;
+}
+
+uint64_t one_sided_ks_btree_r_minus(const struct one_sided_ks_btree *tree)
+{
+	return -tree->total.min_prefix;
+}
+
+/*
+ * max_x [n_y #{x <= value} - n_x #{y <= value}] / (n_x n_y), by a
+ * linear walk over the leaves, in 128-bit integer arithmetic.
+ */
+static double scan_delta(const struct one_sided_ks_btree *tree,
+    enum one_sided_ks_arm x, enum one_sided_ks_arm y)
+{
+	const unsigned __int128 n_x = tree->total.count[x];
+	const unsigned __int128 n_y = tree->total.count[y];
+	__int128 best = 0;
+	uint64_t sum_x = 0;
+	uint64_t sum_y = 0;
+
+	for (uint32_t index = 0; index != NONE;
+	     index = tree->nodes[index].next) {
+		const struct node *node = &tree->nodes[index];
+
+		for (size_t i = 0; i < node->size; ++i) {
+			sum_x += node->entries[i].count[x];
+			sum_y += node->entries[i].count[y];
+
+			const __int128 delta = (__int128)(n_y * sum_x)
+			    - (__int128)(n_x * sum_y);
+			if (delta > best) {
+				best = delta;
+			}
+		}
+	}
+
+	return one_sided_ks_ratio_down(best, n_x * n_y);
+}
+
+double one_sided_ks_btree_d_plus(const struct one_sided_ks_btree *tree)
+{
+	const uint64_t n_a = tree->total.count[ONE_SIDED_KS_ARM_A];
+	const uint64_t n_b = tree->total.count[ONE_SIDED_KS_ARM_B];
+
+	if (n_a == 0 || n_b == 0) {
+		return 0;
+	}
+
+	if (n_a == n_b) {
+		return one_sided_ks_ratio_down(
+		    one_sided_ks_btree_r_plus(tree), n_a);
+	}
+
+	return scan_delta(tree, ONE_SIDED_KS_ARM_A, ONE_SIDED_KS_ARM_B);
+}
+
+double one_sided_ks_btree_d_minus(const struct one_sided_ks_btree *tree)
+{
+	const uint64_t n_a = tree->total.count[ONE_SIDED_KS_ARM_A];
+	const uint64_t n_b = tree->total.count[ONE_SIDED_KS_ARM_B];
+
+	if (n_a == 0 || n_b == 0) {
+		return 0;
+	}
+
+	if (n_a == n_b) {
+		return one_sided_ks_ratio_down(
+		    one_sided_ks_btree_r_minus(tree), n_a);
+	}
+
+	return scan_delta(tree, ONE_SIDED_KS_ARM_B, ONE_SIDED_KS_ARM_A);
+}
@@ -0,0 +1,78 @@
+#ifndef ONE_SIDED_KS_BTREE_H
+#define ONE_SIDED_KS_BTREE_H
+#include <stddef.h>
+#include <stdint.h>
+
+#include "one-sided-ks-ecdf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Exact two-sample statistics over raw values, updated on every
+ * insertion.
+ *
+ * Both samples live in a single B+ tree keyed on the distinct
+ * values, with nodes allocated from one growable array.  Each entry
+ * summarises its value or subtree: how many values come from A and
+ * B, and the total, max prefix and min prefix of (+1 for each A,
+ * -1 for each B), with ties collapsed into one step.  Insertion
+ * updates these summaries on the way back up in O(log n), and the
+ * root's summary yields `r_plus` and `r_minus` in O(1), so we can
+ * compare against `one_sided_ks_pair_min_reject` after every pair.
+ *
+ * `d_plus` and `d_minus` are also O(1) when both samples have the
+ * same size.  Otherwise, each sample's weight depends on the other's
+ * size, and we must walk all the distinct values in order.
+ *
+ * Values must not be NaN.  Equal values count as ties, across and
+ * within arms.
+ */
+struct one_sided_ks_btree;
+
+/* Returns a new empty tree, or NULL on failure. */
+struct one_sided_ks_btree *one_sided_ks_btree_create(void);
+
+void one_sided_ks_btree_destroy(struct one_sided_ks_btree *tree);
+
+/* Adds `value` to `arm`.  Returns 0 on success, -1 on failure. */
+int one_sided_ks_btree_add(struct one_sided_ks_btree *tree,
+    enum one_sided_ks_arm arm, double value);
+
+/*
+ * Adds `a` to A and `b` to B.  Returns 0 on success, -1 on failure,
+ * in which case neither value was added.
+ */
+int one_sided_ks_btree_add_pair(
+    struct one_sided_ks_btree *tree, double a, double b);
+
+/* Returns the number of values in `arm`. */
+uint64_t one_sided_ks_btree_count(
+    const struct one_sided_ks_btree *tree, enum one_sided_ks_arm arm);
+
+/* Returns the number of values <= `value` in `arm`, in O(log n). */
+uint64_t one_sided_ks_btree_rank(const struct one_sided_ks_btree *tree,
+    enum one_sided_ks_arm arm, double value);
+
+/*
+ * Returns max_x [#{A <= x} - #{B <= x}], or 0 if that's negative.
+ * When both samples have `n` values, D+ = r_plus / n.
+ */
+uint64_t one_sided_ks_btree_r_plus(const struct one_sided_ks_btree *tree);
+
+/* Same as `one_sided_ks_btree_r_plus`, with A and B swapped. */
+uint64_t one_sided_ks_btree_r_minus(const struct one_sided_ks_btree *tree);
+
+/*
+ * Returns D+ = max_x [CDF_A(x) - CDF_B(x)], rounded down, or 0 if
+ * either sample is empty.
+ */
+double one_sided_ks_btree_d_plus(const struct one_sided_ks_btree *tree);
+
+/* Returns D- = max_x [CDF_B(x) - CDF_A(x)], like `d_plus`. */
+double one_sided_ks_btree_d_minus(const struct one_sided_ks_btree *tree);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /* !ONE_SIDED_KS_BTREE_H */
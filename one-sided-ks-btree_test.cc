@@ -0,0 +1,259 @@
+#include "one-sided-ks-btree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "one-sided-ks.h"
+
+namespace {
+using ::testing::DoubleNear;
+
+// Reference implementation: sort both samples and count.
+int64_t max_count_delta(std::vector<double> x, std::vector<double> y)
+{
+	std::sort(x.begin(), x.end());
+	std::sort(y.begin(), y.end());
+
+	int64_t best = 0;
+	for (const std::vector<double> *v : { &x, &y }) {
+		for (const double value : *v) {
+			const int64_t sum_x
+			    = std::upper_bound(x.begin(), x.end(), value)
+			    - x.begin();
+			const int64_t sum_y
+			    = std::upper_bound(y.begin(), y.end(), value)
+			    - y.begin();
+
+			best = std::max(best, sum_x - sum_y);
+		}
+	}
+
+	return best;
+}
+
+double max_cdf_delta(std::vector<double> x, std::vector<double> y)
+{
+	std::sort(x.begin(), x.end());
+	std::sort(y.begin(), y.end());
+
+	double best = 0;
+	for (const std::vector<double> *v : { &x, &y }) {
+		for (const double value : *v) {
+			const double sum_x
+			    = std::upper_bound(x.begin(), x.end(), value)
+			    - x.begin();
+			const double sum_y
+			    = std::upper_bound(y.begin(), y.end(), value)
+			    - y.begin();
+
+			best = std::max(
+			    best, sum_x / x.size() - sum_y / y.size());
+		}
+	}
+
+	return best;
+}
+
+TEST(OneSidedKsBtree, Empty)
+{
+	struct one_sided_ks_btree *tree = one_sided_ks_btree_create();
+
+	EXPECT_EQ(one_sided_ks_btree_count(tree, ONE_SIDED_KS_ARM_A), 0);
+	EXPECT_EQ(one_sided_ks_btree_count(tree, ONE_SIDED_KS_ARM_B), 0);
+	EXPECT_EQ(one_sided_ks_btree_rank(tree, ONE_SIDED_KS_ARM_A, 0), 0);
+	EXPECT_EQ(one_sided_ks_btree_r_plus(tree), 0);
+	EXPECT_EQ(one_sided_ks_btree_r_minus(tree), 0);
+	EXPECT_EQ(one_sided_ks_btree_d_plus(tree), 0);
+	EXPECT_EQ(one_sided_ks_btree_d_minus(tree), 0);
+
+	// Still 0 with only one sample.
+	ASSERT_EQ(one_sided_ks_btree_add(tree, ONE_SIDED_KS_ARM_A, 1.0), 0);
+	EXPECT_EQ(one_sided_ks_btree_d_plus(tree), 0);
+	EXPECT_EQ(one_sided_ks_btree_d_minus(tree), 0);
+	EXPECT_EQ(one_sided_ks_btree_r_plus(tree), 1);
+	one_sided_ks_btree_destroy(tree);
+}
+
+// Ties across arms must cancel out.
+TEST(OneSidedKsBtree, Ties)
+{
+	struct one_sided_ks_btree *tree = one_sided_ks_btree_create();
+
+	for (size_t i = 0; i < 1000; ++i) {
+		ASSERT_EQ(one_sided_ks_btree_add_pair(tree, 1.0, 1.0), 0);
+	}
+
+	EXPECT_EQ(one_sided_ks_btree_r_plus(tree), 0);
+	EXPECT_EQ(one_sided_ks_btree_r_minus(tree), 0);
+
+	// -0.0 and 0.0 are the same value.
+	ASSERT_EQ(one_sided_ks_btree_add_pair(tree, -0.0, 0.0), 0);
+	EXPECT_EQ(one_sided_ks_btree_r_plus(tree), 0);
+
+	ASSERT_EQ(one_sided_ks_btree_add_pair(tree, 0.0, 2.0), 0);
+	EXPECT_EQ(one_sided_ks_btree_r_plus(tree), 1);
+	EXPECT_EQ(one_sided_ks_btree_r_minus(tree), 0);
+	one_sided_ks_btree_destroy(tree);
+}
+
+// Compare with sorting from scratch after every pair, for small
+// samples with plenty of ties, and (less often) for larger ones with
+// a deep tree.
+TEST(OneSidedKsBtree, PairMatchesSort)
+{
+	std::mt19937 rng(42);
+
+	for (const int range : { 1, 3, 100, 1 << 30 }) {
+		std::uniform_int_distribution<int> dist(0, range - 1);
+		std::vector<double> x;
+		std::vector<double> y;
+		struct one_sided_ks_btree *tree = one_sided_ks_btree_create();
+
+		for (size_t i = 1; i <= 20000; ++i) {
+			// Skew B towards higher values.
+			const double a = dist(rng);
+			const double b = std::max(dist(rng), dist(rng));
+
+			x.push_back(a);
+			y.push_back(b);
+			ASSERT_EQ(one_sided_ks_btree_add_pair(tree, a, b), 0);
+			if (i > 300 && i % 997 != 0) {
+				continue;
+			}
+
+			const int64_t r_plus = max_count_delta(x, y);
+			const int64_t r_minus = max_count_delta(y, x);
+			ASSERT_EQ(one_sided_ks_btree_r_plus(tree), r_plus);
+			ASSERT_EQ(one_sided_ks_btree_r_minus(tree), r_minus);
+			ASSERT_THAT(one_sided_ks_btree_d_plus(tree),
+			    DoubleNear(1.0 * r_plus / i, 1e-15));
+			ASSERT_LE(
+			    one_sided_ks_btree_d_plus(tree), 1.0 * r_plus / i);
+			ASSERT_THAT(one_sided_ks_btree_d_minus(tree),
+			    DoubleNear(1.0 * r_minus / i, 1e-15));
+		}
+
+		EXPECT_EQ(
+		    one_sided_ks_btree_count(tree, ONE_SIDED_KS_ARM_A),
+		    20000);
+		EXPECT_EQ(
+		    one_sided_ks_btree_count(tree, ONE_SIDED_KS_ARM_B),
+		    20000);
+		one_sided_ks_btree_destroy(tree);
+	}
+}
+
+TEST(OneSidedKsBtree, UnpairedMatchesSort)
+{
+	std::mt19937 rng(43);
+	std::uniform_real_distribution<double> unif(0, 1);
+	std::uniform_int_distribution<int> coin(0, 3);
+	std::vector<double> x;
+	std::vector<double> y;
+	struct one_sided_ks_btree *tree = one_sided_ks_btree_create();
+
+	for (size_t i = 1; i <= 10000; ++i) {
+		// B gets 3x as many values as A, and they're larger.
+		if (coin(rng) == 0) {
+			const double a = std::round(1000 * unif(rng));
+
+			x.push_back(a);
+			ASSERT_EQ(one_sided_ks_btree_add(
+				      tree, ONE_SIDED_KS_ARM_A, a),
+			    0);
+		} else {
+			const double b
+			    = std::round(1000 * std::sqrt(unif(rng)));
+
+			y.push_back(b);
+			ASSERT_EQ(one_sided_ks_btree_add(
+				      tree, ONE_SIDED_KS_ARM_B, b),
+			    0);
+		}
+
+		if (i % 331 != 0 || x.empty() || y.empty()) {
+			continue;
+		}
+
+		ASSERT_THAT(one_sided_ks_btree_d_plus(tree),
+		    DoubleNear(max_cdf_delta(x, y), 1e-14));
+		ASSERT_THAT(one_sided_ks_btree_d_minus(tree),
+		    DoubleNear(max_cdf_delta(y, x), 1e-14));
+		ASSERT_EQ(
+		    one_sided_ks_btree_r_plus(tree), max_count_delta(x, y));
+	}
+
+	one_sided_ks_btree_destroy(tree);
+}
+
+TEST(OneSidedKsBtree, Rank)
+{
+	std::mt19937 rng(44);
+	std::uniform_int_distribution<int> dist(0, 5000);
+	std::vector<double> values[2];
+	struct one_sided_ks_btree *tree = one_sided_ks_btree_create();
+
+	for (size_t i = 0; i < 20000; ++i) {
+		const enum one_sided_ks_arm arm = (i % 3 == 0)
+		    ? ONE_SIDED_KS_ARM_B
+		    : ONE_SIDED_KS_ARM_A;
+		const double value = dist(rng);
+
+		values[arm].push_back(value);
+		ASSERT_EQ(one_sided_ks_btree_add(tree, arm, value), 0);
+	}
+
+	for (std::vector<double> &v : values) {
+		std::sort(v.begin(), v.end());
+	}
+
+	for (const double probe : { -1.0, 0.0, 0.5, 17.0, 2500.0, 5000.0,
+		 1e10 }) {
+		for (const enum one_sided_ks_arm arm :
+		    { ONE_SIDED_KS_ARM_A, ONE_SIDED_KS_ARM_B }) {
+			const std::vector<double> &v = values[arm];
+			const uint64_t expected
+			    = std::upper_bound(v.begin(), v.end(), probe)
+			    - v.begin();
+
+			EXPECT_EQ(one_sided_ks_btree_rank(tree, arm, probe),
+			    expected)
+			    << probe;
+		}
+	}
+
+	one_sided_ks_btree_destroy(tree);
+}
+
+// A has a small shift: checking after every pair, we should reject
+// with the first integer cutoff that's exceeded.
+TEST(OneSidedKsBtree, Reject)
+{
+	const double log_eps = std::log(1e-6);
+	const uint64_t min_count = one_sided_ks_find_min_count(log_eps);
+	std::mt19937 rng(45);
+	std::normal_distribution<double> normal;
+	struct one_sided_ks_btree *tree = one_sided_ks_btree_create();
+	uint64_t n = 1;
+
+	for (; n <= 1000000; ++n) {
+		ASSERT_EQ(one_sided_ks_btree_add_pair(
+			      tree, normal(rng) - 0.1, normal(rng)),
+		    0);
+		if (one_sided_ks_btree_r_plus(tree)
+		    >= one_sided_ks_pair_min_reject(n, min_count, log_eps)) {
+			break;
+		}
+	}
+
+	EXPECT_LE(n, 1000000);
+	EXPECT_GE(one_sided_ks_btree_d_plus(tree),
+	    one_sided_ks_pair_threshold(n, min_count, log_eps));
+	one_sided_ks_btree_destroy(tree);
+}
+} // namespace
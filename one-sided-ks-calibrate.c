@@ -0,0 +1,357 @@
+#include "one-sided-ks-calibrate.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "external/csm/csm.h"
+#include "one-sided-ks-ecdf.h"
+#include "one-sided-ks.h"
+
+/* Marks trials that haven't completed yet in `steps`. */
+#define PENDING 0
+
+struct rng {
+	uint64_t s[4];
+};
+
+/* The splitmix64 output function. */
+static uint64_t mix64(uint64_t x)
+{
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+/*
+ * Seeds xoshiro256** with splitmix64, from a starting point that
+ * depends on both `seed` and `trial`.
+ */
+static void rng_init(struct rng *rng, uint64_t seed, uint64_t trial)
+{
+	uint64_t state = seed ^ mix64(trial + 1);
+
+	for (size_t i = 0; i < 4; ++i) {
+		state += 0x9e3779b97f4a7c15ULL;
+		rng->s[i] = mix64(state);
+	}
+}
+
+static inline uint64_t rotl(uint64_t x, unsigned int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rng_next(struct rng *rng)
+{
+	uint64_t *s = rng->s;
+	const uint64_t ret = rotl(s[1] * 5, 7) * 9;
+	const uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 45);
+	return ret;
+}
+
+/*
+ * Returns a value in [0, range), with Lemire's multiply-shift.  The
+ * bias, at most range / 2^64, is far below what any trial can detect.
+ */
+static inline size_t rng_below(struct rng *rng, size_t range)
+{
+	return (size_t)(((unsigned __int128)rng_next(rng) * range) >> 64);
+}
+
+static inline bool rng_bernoulli(struct rng *rng, double p)
+{
+	return (double)(rng_next(rng) >> 11) * 0x1p-53 < p;
+}
+
+static uint64_t run_trial(const struct one_sided_ks_calibrate_params *params,
+    struct one_sided_ks_ecdf *ecdf, const uint64_t *zeros, uint64_t trial)
+{
+	const size_t range = params->range;
+	const double discrepancy = params->discrepancy;
+	struct one_sided_ks_pair_reject_iter iter;
+	struct rng rng;
+
+	one_sided_ks_ecdf_load(ecdf, zeros, zeros);
+	one_sided_ks_pair_reject_iter_init(
+	    &iter, 0, params->min_count, params->log_eps);
+	rng_init(&rng, params->seed, trial);
+
+	for (uint64_t i = 1; i <= params->max_steps; ++i) {
+		const size_t a = rng_below(&rng, range);
+		const size_t b = (discrepancy > 0
+				     && rng_bernoulli(&rng, discrepancy))
+		    ? range - 1
+		    : rng_below(&rng, range);
+		const uint64_t r_min
+		    = one_sided_ks_pair_reject_iter_next(&iter);
+		uint64_t r;
+
+		one_sided_ks_ecdf_add_pair(ecdf, a, b);
+		r = one_sided_ks_ecdf_r_plus(ecdf);
+		if (params->two_sided) {
+			const uint64_t r_minus
+			    = one_sided_ks_ecdf_r_minus(ecdf);
+
+			r = (r_minus > r) ? r_minus : r;
+		}
+
+		if (params->fast_threshold) {
+			const double threshold
+			    = one_sided_ks_pair_threshold_fast(
+				i, params->min_count, params->log_eps);
+
+			if ((double)r / (double)i > threshold) {
+				return i;
+			}
+		} else if (r >= r_min) {
+			return i;
+		}
+	}
+
+	return UINT64_MAX;
+}
+
+struct shared {
+	const struct one_sided_ks_calibrate_params *params;
+	const uint64_t *zeros;
+	/* Per-trial results, PENDING until the trial completes. */
+	uint64_t *steps;
+	/* Next trial to claim, and one past the last trial to run. */
+	uint64_t next_trial;
+	uint64_t limit;
+
+	/* Everything below is protected by `lock`. */
+	pthread_mutex_t lock;
+	/* Trials [0, prefix) are complete and accounted for. */
+	uint64_t prefix;
+	uint64_t num_rejections;
+	double sum_reject_steps;
+	bool stopped;
+};
+
+struct worker {
+	struct shared *shared;
+	struct one_sided_ks_ecdf *ecdf;
+	pthread_t thread;
+	bool started;
+};
+
+static bool early_stopping(const struct one_sided_ks_calibrate_params *params)
+{
+	return params->target_rate > 0 && params->target_rate < 1;
+}
+
+/*
+ * Accounts for completed trials in index order, and applies the
+ * stopping test after each one, so the outcome doesn't depend on
+ * scheduling.
+ */
+static void advance_prefix(struct shared *shared)
+{
+	const struct one_sided_ks_calibrate_params *params = shared->params;
+	const uint64_t limit
+	    = __atomic_load_n(&shared->limit, __ATOMIC_RELAXED);
+
+	while (shared->prefix < limit
+	    && shared->steps[shared->prefix] != PENDING) {
+		const uint64_t steps = shared->steps[shared->prefix++];
+
+		if (steps != UINT64_MAX) {
+			++shared->num_rejections;
+			shared->sum_reject_steps += steps;
+		}
+
+		if (early_stopping(params)
+		    && csm(shared->prefix, params->target_rate,
+			   shared->num_rejections, params->csm_log_eps, NULL)
+			!= 0) {
+			shared->stopped = true;
+			__atomic_store_n(
+			    &shared->limit, shared->prefix, __ATOMIC_RELAXED);
+			break;
+		}
+	}
+}
+
+/*
+ * Workers claim one trial at a time from a shared counter, so idle
+ * workers always pick up the next trial, however long earlier trials
+ * run.
+ */
+static void *work(void *arg)
+{
+	struct worker *worker = arg;
+	struct shared *shared = worker->shared;
+
+	for (;;) {
+		const uint64_t trial = __atomic_fetch_add(
+		    &shared->next_trial, 1, __ATOMIC_RELAXED);
+
+		if (trial
+		    >= __atomic_load_n(&shared->limit, __ATOMIC_RELAXED)) {
+			break;
+		}
+
+		const uint64_t steps = run_trial(
+		    shared->params, worker->ecdf, shared->zeros, trial);
+
+		pthread_mutex_lock(&shared->lock);
+		shared->steps[trial] = steps;
+		advance_prefix(shared);
+		pthread_mutex_unlock(&shared->lock);
+	}
+
+	return NULL;
+}
+
+static bool params_valid(const struct one_sided_ks_calibrate_params *params)
+{
+	return params->range > 0 && params->log_eps < 0
+	    && one_sided_ks_min_count_valid(
+		params->min_count, params->log_eps)
+	    && params->discrepancy >= 0 && params->discrepancy <= 1
+	    && (!early_stopping(params) || params->csm_log_eps < 0);
+}
+
+static size_t num_workers(const struct one_sided_ks_calibrate_params *params)
+{
+	size_t ret = params->num_threads;
+
+	if (ret == 0) {
+		const long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+		ret = (num_cpus > 0) ? (size_t)num_cpus : 1;
+	}
+
+	if (ret > params->max_trials) {
+		ret = (params->max_trials > 0) ? (size_t)params->max_trials
+					       : 1;
+	}
+
+	return ret;
+}
+
+static void destroy_workers(struct worker *workers, size_t n)
+{
+	if (workers == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < n; ++i) {
+		one_sided_ks_ecdf_destroy(workers[i].ecdf);
+	}
+
+	free(workers);
+}
+
+static struct worker *create_workers(
+    struct shared *shared, size_t n, size_t range)
+{
+	struct worker *ret = calloc(n, sizeof(*ret));
+
+	if (ret == NULL) {
+		return NULL;
+	}
+
+	for (size_t i = 0; i < n; ++i) {
+		ret[i].shared = shared;
+		ret[i].ecdf = one_sided_ks_ecdf_create(range);
+		if (ret[i].ecdf == NULL) {
+			destroy_workers(ret, n);
+			return NULL;
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * The calling thread is the first worker; if we can't spawn the
+ * others, the remaining workers pick up the slack.
+ */
+static void run_workers(struct worker *workers, size_t n)
+{
+	for (size_t i = 1; i < n; ++i) {
+		const int err = pthread_create(
+		    &workers[i].thread, NULL, work, &workers[i]);
+
+		workers[i].started = (err == 0);
+	}
+
+	work(&workers[0]);
+	for (size_t i = 1; i < n; ++i) {
+		if (workers[i].started) {
+			pthread_join(workers[i].thread, NULL);
+		}
+	}
+}
+
+int one_sided_ks_calibrate_run(
+    const struct one_sided_ks_calibrate_params *params,
+    struct one_sided_ks_calibrate_result *result, uint64_t *reject_steps)
+{
+	if (!params_valid(params)
+	    || params->max_trials > SIZE_MAX / sizeof(uint64_t)) {
+		return -1;
+	}
+
+	const size_t n = num_workers(params);
+	struct shared shared = {
+		.params = params,
+		.steps = reject_steps,
+		.next_trial = 0,
+		.limit = params->max_trials,
+	};
+	uint64_t *steps = NULL;
+	uint64_t *zeros = calloc(params->range, sizeof(uint64_t));
+	struct worker *workers = create_workers(&shared, n, params->range);
+
+	if (shared.steps == NULL) {
+		steps = calloc(params->max_trials, sizeof(uint64_t));
+		shared.steps = steps;
+	}
+
+	if ((shared.steps == NULL && params->max_trials > 0) || zeros == NULL
+	    || workers == NULL) {
+		destroy_workers(workers, n);
+		free(zeros);
+		free(steps);
+		return -1;
+	}
+
+	for (uint64_t i = 0; i < params->max_trials; ++i) {
+		shared.steps[i] = PENDING;
+	}
+
+	shared.zeros = zeros;
+	pthread_mutex_init(&shared.lock, NULL);
+	run_workers(workers, n);
+	pthread_mutex_destroy(&shared.lock);
+
+	*result = (struct one_sided_ks_calibrate_result) {
+		.num_trials = shared.prefix,
+		.num_rejections = shared.num_rejections,
+		.stopped = shared.stopped,
+		.rejection_rate = (shared.prefix > 0)
+		    ? (double)shared.num_rejections / shared.prefix
+		    : 0,
+		.mean_reject_steps = (shared.num_rejections > 0)
+		    ? shared.sum_reject_steps / shared.num_rejections
+		    : 0,
+	};
+
+	destroy_workers(workers, n);
+	free(zeros);
+	free(steps);
+	return 0;
+}
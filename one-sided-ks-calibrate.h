@@ -0,0 +1,90 @@
+#ifndef ONE_SIDED_KS_CALIBRATE_H
+#define ONE_SIDED_KS_CALIBRATE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Parallel Monte Carlo calibration of the paired two-sample test.
+ *
+ * Each trial draws pairs of values uniformly from `range` buckets,
+ * except that B's value is replaced with the largest bucket with
+ * probability `discrepancy`, so D+ converges to
+ * `discrepancy * (range - 1) / range`.  A trial runs until the test
+ * rejects, or for `max_steps` pairs.  With `discrepancy = 0`, the
+ * rejection rate is the false positive rate.
+ *
+ * Trials run on `num_threads` threads, which claim trial indices from
+ * a shared counter, and trial `i` draws from its own xoshiro256**
+ * stream, seeded from `seed` and `i`, so results only depend on the
+ * parameters.  Statistics are maintained incrementally in a
+ * `one_sided_ks_ecdf`, and compared against a
+ * `one_sided_ks_pair_reject_iter`, or, with `fast_threshold`, as a
+ * double against `one_sided_ks_pair_threshold_fast` at every step.
+ *
+ * When `target_rate` is in (0, 1), the harness stops as soon as the
+ * confidence sequence method (`csm`) can tell, with log false
+ * positive rate `csm_log_eps`, whether the rejection rate is above or
+ * below `target_rate`.  The stopping test is applied to trials in
+ * index order, so early stopping is reproducible too.
+ */
+struct one_sided_ks_calibrate_params {
+	uint64_t min_count;
+	double log_eps;
+	/* Whether to reject on max(D+, D-) rather than D+. */
+	bool two_sided;
+	/*
+	 * Whether to compare D = r / n against
+	 * `one_sided_ks_pair_threshold_fast`, rather than r against the
+	 * integer cutoffs of a `one_sided_ks_pair_reject_iter`.
+	 */
+	bool fast_threshold;
+	/* Number of distinct values, at least 1. */
+	size_t range;
+	/* Probability of replacing B's value with `range - 1`. */
+	double discrepancy;
+	/* Pairs per trial, and maximum number of trials. */
+	uint64_t max_steps;
+	uint64_t max_trials;
+	/* Early stopping; disabled unless 0 < target_rate < 1. */
+	double target_rate;
+	double csm_log_eps;
+	uint64_t seed;
+	/* 0 for one thread per online CPU. */
+	size_t num_threads;
+};
+
+struct one_sided_ks_calibrate_result {
+	/* Number of trials accounted for. */
+	uint64_t num_trials;
+	/* Number of trials that rejected. */
+	uint64_t num_rejections;
+	/* Whether `csm` stopped the run. */
+	bool stopped;
+	/* num_rejections / num_trials. */
+	double rejection_rate;
+	/* Mean number of pairs before rejection, or 0 if none. */
+	double mean_reject_steps;
+};
+
+/*
+ * Runs the trials described by `params`.  If `reject_steps` is not
+ * NULL, it must have room for `max_trials` values: for each trial
+ * `i < num_trials`, `reject_steps[i]` is the number of pairs when the
+ * test rejected, or UINT64_MAX if it didn't.
+ *
+ * Returns 0 on success, -1 if the parameters are invalid (including
+ * `min_count` too small for `log_eps`), or on allocation failure.
+ * If threads can't be spawned, the calling thread runs the trials.
+ */
+int one_sided_ks_calibrate_run(
+    const struct one_sided_ks_calibrate_params *params,
+    struct one_sided_ks_calibrate_result *result, uint64_t *reject_steps);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /* !ONE_SIDED_KS_CALIBRATE_H */
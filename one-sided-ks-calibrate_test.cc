@@ -0,0 +1,194 @@
+#include "one-sided-ks-calibrate.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "one-sided-ks.h"
+
+namespace {
+const double kLogEps = std::log(0.05);
+
+one_sided_ks_calibrate_params make_params(double discrepancy)
+{
+	one_sided_ks_calibrate_params ret = {};
+
+	ret.min_count = one_sided_ks_find_min_count(kLogEps);
+	ret.log_eps = kLogEps;
+	ret.range = 10;
+	ret.discrepancy = discrepancy;
+	ret.max_steps = 5000;
+	ret.max_trials = 200;
+	ret.seed = 42;
+	return ret;
+}
+
+TEST(OneSidedKsCalibrate, Invalid)
+{
+	one_sided_ks_calibrate_result result;
+
+	one_sided_ks_calibrate_params params = make_params(0);
+	params.range = 0;
+	EXPECT_EQ(-1, one_sided_ks_calibrate_run(&params, &result, nullptr));
+
+	params = make_params(0);
+	params.min_count = 1;
+	EXPECT_EQ(-1, one_sided_ks_calibrate_run(&params, &result, nullptr));
+
+	params = make_params(1.5);
+	EXPECT_EQ(-1, one_sided_ks_calibrate_run(&params, &result, nullptr));
+
+	params = make_params(0);
+	params.target_rate = 0.1;
+	params.csm_log_eps = 0;
+	EXPECT_EQ(-1, one_sided_ks_calibrate_run(&params, &result, nullptr));
+}
+
+TEST(OneSidedKsCalibrate, NoTrials)
+{
+	one_sided_ks_calibrate_params params = make_params(0);
+	one_sided_ks_calibrate_result result;
+
+	params.max_trials = 0;
+	ASSERT_EQ(0, one_sided_ks_calibrate_run(&params, &result, nullptr));
+	EXPECT_EQ(0, result.num_trials);
+	EXPECT_EQ(0, result.num_rejections);
+	EXPECT_EQ(0, result.rejection_rate);
+}
+
+// Identical samples: we should reject less often than eps.
+TEST(OneSidedKsCalibrate, FalsePositiveRate)
+{
+	one_sided_ks_calibrate_params params = make_params(0);
+	one_sided_ks_calibrate_result result;
+	std::vector<uint64_t> steps(params.max_trials);
+
+	params.two_sided = true;
+	ASSERT_EQ(0,
+	    one_sided_ks_calibrate_run(&params, &result, steps.data()));
+	EXPECT_EQ(params.max_trials, result.num_trials);
+	EXPECT_FALSE(result.stopped);
+	EXPECT_LE(result.rejection_rate, std::exp(kLogEps));
+
+	uint64_t num_rejections = 0;
+	for (const uint64_t step : steps) {
+		if (step != UINT64_MAX) {
+			++num_rejections;
+			EXPECT_GE(step, params.min_count);
+			EXPECT_LE(step, params.max_steps);
+		}
+	}
+
+	EXPECT_EQ(num_rejections, result.num_rejections);
+}
+
+TEST(OneSidedKsCalibrate, Discrepancy)
+{
+	one_sided_ks_calibrate_params params = make_params(0.2);
+	one_sided_ks_calibrate_result result;
+
+	ASSERT_EQ(0, one_sided_ks_calibrate_run(&params, &result, nullptr));
+	EXPECT_EQ(params.max_trials, result.num_trials);
+	EXPECT_EQ(1.0, result.rejection_rate);
+	EXPECT_GE(result.mean_reject_steps, params.min_count);
+	EXPECT_LE(result.mean_reject_steps,
+	    one_sided_ks_expected_iter(
+		params.min_count, kLogEps, params.discrepancy * 0.9));
+}
+
+// Results only depend on the seed, not on scheduling.
+TEST(OneSidedKsCalibrate, Reproducible)
+{
+	one_sided_ks_calibrate_params params = make_params(0.06);
+	std::vector<uint64_t> expected(params.max_trials);
+	one_sided_ks_calibrate_result expected_result;
+
+	params.num_threads = 1;
+	ASSERT_EQ(0,
+	    one_sided_ks_calibrate_run(
+		&params, &expected_result, expected.data()));
+	EXPECT_GT(expected_result.num_rejections, 0);
+	EXPECT_LT(expected_result.num_rejections, params.max_trials);
+
+	for (const size_t num_threads : { 2, 4, 0 }) {
+		std::vector<uint64_t> steps(params.max_trials);
+		one_sided_ks_calibrate_result result;
+
+		params.num_threads = num_threads;
+		ASSERT_EQ(0,
+		    one_sided_ks_calibrate_run(
+			&params, &result, steps.data()));
+		EXPECT_EQ(expected, steps) << num_threads;
+		EXPECT_EQ(
+		    expected_result.num_rejections, result.num_rejections);
+		EXPECT_EQ(expected_result.mean_reject_steps,
+		    result.mean_reject_steps);
+	}
+
+	params.seed = 43;
+	std::vector<uint64_t> steps(params.max_trials);
+	one_sided_ks_calibrate_result result;
+	ASSERT_EQ(0,
+	    one_sided_ks_calibrate_run(&params, &result, steps.data()));
+	EXPECT_NE(expected, steps);
+}
+
+// The integer cutoffs are conservative: comparing D against
+// `one_sided_ks_pair_threshold_fast` rejects at the same time, or
+// (rarely) earlier.
+TEST(OneSidedKsCalibrate, FastThreshold)
+{
+	one_sided_ks_calibrate_params params = make_params(0.06);
+	std::vector<uint64_t> iter_steps(params.max_trials);
+	std::vector<uint64_t> fast_steps(params.max_trials);
+	one_sided_ks_calibrate_result iter_result;
+	one_sided_ks_calibrate_result fast_result;
+
+	params.two_sided = true;
+	ASSERT_EQ(0,
+	    one_sided_ks_calibrate_run(
+		&params, &iter_result, iter_steps.data()));
+	params.fast_threshold = true;
+	ASSERT_EQ(0,
+	    one_sided_ks_calibrate_run(
+		&params, &fast_result, fast_steps.data()));
+	EXPECT_GT(fast_result.num_rejections, 0);
+
+	size_t num_same = 0;
+	for (size_t i = 0; i < params.max_trials; ++i) {
+		EXPECT_LE(fast_steps[i], iter_steps[i]) << i;
+		num_same += (fast_steps[i] == iter_steps[i]);
+	}
+
+	EXPECT_GE(num_same, params.max_trials * 9 / 10);
+}
+
+// csm should stop long before max_trials, at the same trial for any
+// number of threads.
+TEST(OneSidedKsCalibrate, EarlyStopping)
+{
+	one_sided_ks_calibrate_params params = make_params(0.2);
+	one_sided_ks_calibrate_result expected;
+
+	params.max_trials = 100000;
+	params.target_rate = 0.5;
+	params.csm_log_eps = std::log(1e-4);
+	params.num_threads = 1;
+	ASSERT_EQ(0, one_sided_ks_calibrate_run(&params, &expected, nullptr));
+	EXPECT_TRUE(expected.stopped);
+	EXPECT_LT(expected.num_trials, 100);
+	EXPECT_EQ(1.0, expected.rejection_rate);
+
+	for (const size_t num_threads : { 3, 0 }) {
+		one_sided_ks_calibrate_result result;
+
+		params.num_threads = num_threads;
+		ASSERT_EQ(0,
+		    one_sided_ks_calibrate_run(&params, &result, nullptr));
+		EXPECT_TRUE(result.stopped);
+		EXPECT_EQ(expected.num_trials, result.num_trials);
+		EXPECT_EQ(expected.num_rejections, result.num_rejections);
+	}
+}
+} // namespace
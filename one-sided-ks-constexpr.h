@@ -0,0 +1,452 @@
+#ifndef ONE_SIDED_KS_CONSTEXPR_H
+#define ONE_SIDED_KS_CONSTEXPR_H
+/*
+ * C++14 constexpr versions of `one_sided_ks_min_count_valid`,
+ * `one_sided_ks_find_min_count` and the threshold functions, for
+ * callers with hard-coded `log_eps` who want to bake `min_count` and
+ * threshold tables in their binary.
+ *
+ * Everything is implemented with constexpr arithmetic: `log` is the
+ * same fdlibm transcription as `one_sided_ks_inline_log` (with the
+ * same < 1 ULP error bound, and the same results), and `next`/`prev`
+ * step by one ULP without looking at bit patterns.  The only
+ * difference is `sqrt`: we can't call the correctly rounded hardware
+ * instruction, so `sqrt_up` steps 2 ULPs up from a Newton iteration
+ * that is within 1 ULP of the correctly rounded value.  Thresholds
+ * are thus never lower than the runtime library's, and differ by a
+ * few ULPs at most.
+ *
+ * Only finite arguments are supported.  Like one-sided-ks-inline.h,
+ * this header disables FP contraction for its own functions.
+ */
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#if defined(__clang__)
+#pragma float_control(push)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace one_sided_ks {
+/* Same as `one_sided_ks_le`, `one_sided_ks_eq` and `one_sided_ks_class`. */
+constexpr double le = 0;
+constexpr double eq = -0.6931471805599454;
+constexpr double class_ = -0.6931471805599454;
+
+namespace internal {
+constexpr double kInfinity = std::numeric_limits<double>::infinity();
+constexpr double kTwo64 = 18446744073709551616.0;
+constexpr double kSqrtHalfUp = 0.7071067811865476;
+constexpr double kLogHalfDown = -0.6931471805599454;
+
+/* See one-sided-ks-inline.h. */
+constexpr double kLn2Hi = 6.93147180369123816490e-01;
+constexpr double kLn2Lo = 1.90821492927058770002e-10;
+constexpr double kLg1 = 6.666666666666735130e-01;
+constexpr double kLg2 = 3.999999999940941908e-01;
+constexpr double kLg3 = 2.857142874366239149e-01;
+constexpr double kLg4 = 2.222219843214978396e-01;
+constexpr double kLg5 = 1.818357216161805012e-01;
+constexpr double kLg6 = 1.531383769920937332e-01;
+constexpr double kLg7 = 1.479819860511658591e-01;
+constexpr int kLogErrorLimit = 2;
+
+/* 2^e, exactly, for -1074 <= e <= 1023. */
+constexpr double pow2(int e)
+{
+	double ret = 1;
+
+	for (; e >= 64; e -= 64) {
+		ret *= kTwo64;
+	}
+
+	for (; e <= -64; e += 64) {
+		ret /= kTwo64;
+	}
+
+	for (; e > 0; --e) {
+		ret *= 2;
+	}
+
+	for (; e < 0; ++e) {
+		ret /= 2;
+	}
+
+	return ret;
+}
+
+/* floor(log2(x)) for positive finite x. */
+constexpr int exponent(double x)
+{
+	int e = 0;
+
+	for (; x >= kTwo64; x /= kTwo64) {
+		e += 64;
+	}
+
+	for (; x < 1 / kTwo64; x *= kTwo64) {
+		e -= 64;
+	}
+
+	for (; x >= 2; x /= 2) {
+		++e;
+	}
+
+	for (; x < 1; x *= 2) {
+		--e;
+	}
+
+	return e;
+}
+
+/* The distance between positive finite x and the next float. */
+constexpr double ulp(double x)
+{
+	const int e = exponent(x) - 52;
+
+	return pow2(e < -1074 ? -1074 : e);
+}
+
+constexpr double prev(double x);
+
+constexpr double next(double x)
+{
+	if (x == 0) {
+		return std::numeric_limits<double>::denorm_min();
+	}
+
+	if (x < 0) {
+		return -prev(-x);
+	}
+
+	return x + ulp(x);
+}
+
+constexpr double prev(double x)
+{
+	if (x == 0) {
+		return -std::numeric_limits<double>::denorm_min();
+	}
+
+	if (x < 0) {
+		return -next(-x);
+	}
+
+	const double step = ulp(x);
+	/* Floats are denser right below a power of 2. */
+	if (x == pow2(exponent(x)) && step > pow2(-1074)) {
+		return x - step / 2;
+	}
+
+	return x - step;
+}
+
+constexpr double next_k(double x, int k)
+{
+	for (; k > 0; --k) {
+		x = next(x);
+	}
+
+	return x;
+}
+
+constexpr double prev_k(double x, int k)
+{
+	for (; k > 0; --k) {
+		x = prev(x);
+	}
+
+	return x;
+}
+} // namespace internal
+
+/*
+ * Natural logarithm of positive finite x, with the same operations
+ * (and results) as `one_sided_ks_inline_log`.
+ */
+constexpr double log(double x)
+{
+	using namespace internal;
+
+	if (x == 0) {
+		return -kInfinity;
+	}
+
+	if (x < 0) {
+		return std::numeric_limits<double>::quiet_NaN();
+	}
+
+	/* x = m 2^k, with m in [1, 2). */
+	int k = exponent(x);
+	double m = x / pow2(k);
+	/* fdlibm's hx: the high 20 bits of m's significand. */
+	const int64_t hx = static_cast<int64_t>((m - 1) * 1048576.0);
+
+	/* Normalise x or x / 2 to [sqrt(2)/2, sqrt(2)). */
+	if (((hx + 0x95F64) & 0x100000) != 0) {
+		m /= 2;
+		++k;
+	}
+
+	const double f = m - 1.0;
+	const double s = f / (2.0 + f);
+	const double dk = k;
+	const double z = s * s;
+	const double w = z * z;
+	const double t1 = w * (kLg2 + w * (kLg4 + w * kLg6));
+	const double t2 = z * (kLg1 + w * (kLg3 + w * (kLg5 + w * kLg7)));
+	const double R = t2 + t1;
+	const double hi = dk * kLn2Hi;
+	const double lo = dk * kLn2Lo;
+
+	if (((hx - 0x6147A) | (0x6B851 - hx)) > 0) {
+		const double hfsq = 0.5 * (f * f);
+
+		return hi - ((hfsq - (s * (hfsq + R) + lo)) - f);
+	}
+
+	return hi - ((s * (f - R) - lo) - f);
+}
+
+namespace internal {
+constexpr double log_up(double x)
+{
+	return next_k(one_sided_ks::log(x), kLogErrorLimit);
+}
+
+constexpr double log_down(double x)
+{
+	return prev_k(one_sided_ks::log(x), kLogErrorLimit);
+}
+
+/* sqrt of non-negative finite x, within 1 ULP. */
+constexpr double sqrt_near(double x)
+{
+	if (x == 0) {
+		return 0;
+	}
+
+	/* x = m 4^k, with m in [1, 4). */
+	const int e = exponent(x);
+	const int k = (e >= 0) ? e / 2 : -((1 - e) / 2);
+	const double m = x / pow2(2 * k);
+	/* Newton converges quadratically from 1.5; 6 steps suffice. */
+	double y = 1.5;
+
+	for (size_t i = 0; i < 6; ++i) {
+		y = 0.5 * (y + m / y);
+	}
+
+	return y * pow2(k);
+}
+
+/*
+ * One ULP to cover sqrt_near's error, and another to match the
+ * runtime's next(sqrt(x)) even when sqrt_near is 1 ULP low.
+ */
+constexpr double sqrt_up(double x)
+{
+	return next_k(sqrt_near(x), 2);
+}
+
+constexpr double log_b_up(uint64_t min_count, double log_eps)
+{
+	return next(-log_down(min_count - 1.0) - log_eps);
+}
+
+constexpr double threshold_up(double x, double log_b_up)
+{
+	const double f_x2 = next((x + 1) * next(2 * log_up(x) + log_b_up));
+
+	return next(sqrt_up(f_x2) / x);
+}
+
+constexpr double distribution_threshold_up(double x, double log_b_up)
+{
+	const double f_x2 = next(x * next(2 * log_up(x) + log_b_up));
+
+	return next(kSqrtHalfUp * next(sqrt_up(f_x2) / x));
+}
+} // namespace internal
+
+/* Same as `one_sided_ks_min_count_valid`. */
+constexpr bool min_count_valid(uint64_t min_count, double log_eps)
+{
+	using namespace internal;
+
+	if (log_eps >= 0) {
+		return true;
+	}
+
+	if (min_count <= 2) {
+		return false;
+	}
+
+	return prev(log_eps + (min_count - 1)) >= log_up(min_count + 1.0);
+}
+
+/* Same as `one_sided_ks_find_min_count`. */
+constexpr uint64_t find_min_count(double log_eps)
+{
+	if (log_eps >= 0) {
+		return 0;
+	}
+
+	size_t i = 1;
+	for (; i < 64; ++i) {
+		if (min_count_valid(1ULL << i, log_eps)) {
+			break;
+		}
+	}
+
+	if (i == 1) {
+		return 2;
+	}
+
+	if (i >= 64) {
+		return SIZE_MAX;
+	}
+
+	uint64_t low = 1ULL << (i - 1);
+	uint64_t high = 1ULL << i;
+	while (low + 1 < high) {
+		const uint64_t pivot = low + (high - low) / 2;
+
+		if (min_count_valid(pivot, log_eps)) {
+			high = pivot;
+		} else {
+			low = pivot;
+		}
+	}
+
+	return high;
+}
+
+/* Same as `one_sided_ks_pair_threshold_fast`. */
+constexpr double pair_threshold_fast(
+    uint64_t n, uint64_t min_count, double log_eps)
+{
+	using namespace internal;
+
+	if (n < min_count) {
+		return kInfinity;
+	}
+
+	if (log_eps >= 0) {
+		return -kInfinity;
+	}
+
+	if (log_eps > kLogHalfDown) {
+		log_eps = kLogHalfDown;
+	}
+
+	return threshold_up(n, log_b_up(min_count, log_eps));
+}
+
+/* Same as `one_sided_ks_distribution_threshold_fast`. */
+constexpr double distribution_threshold_fast(
+    uint64_t n, uint64_t min_count, double log_eps)
+{
+	using namespace internal;
+
+	if (n < min_count) {
+		return kInfinity;
+	}
+
+	if (log_eps >= 0) {
+		return -kInfinity;
+	}
+
+	return distribution_threshold_up(n, log_b_up(min_count, log_eps));
+}
+
+/* Same as `one_sided_ks_pair_threshold`. */
+constexpr double pair_threshold(
+    uint64_t n, uint64_t min_count, double log_eps)
+{
+	if (!min_count_valid(min_count, log_eps)) {
+		min_count = find_min_count(log_eps);
+	}
+
+	return pair_threshold_fast(n, min_count, log_eps);
+}
+
+/* Same as `one_sided_ks_distribution_threshold`. */
+constexpr double distribution_threshold(
+    uint64_t n, uint64_t min_count, double log_eps)
+{
+	if (!min_count_valid(min_count, log_eps)) {
+		min_count = find_min_count(log_eps);
+	}
+
+	return distribution_threshold_fast(n, min_count, log_eps);
+}
+
+/*
+ * Thresholds for sample sizes 0 to N - 1, e.g.,
+ *
+ *   constexpr auto table
+ *       = one_sided_ks::make_pair_threshold_table<1000>(
+ *           0, one_sided_ks::log(1e-6));
+ *
+ * `min_count` is the validated value.
+ */
+template <size_t N> struct threshold_table {
+	uint64_t min_count;
+	double thresholds[N];
+
+	constexpr double operator[](size_t n) const
+	{
+		return thresholds[n];
+	}
+};
+
+template <size_t N>
+constexpr threshold_table<N> make_pair_threshold_table(
+    uint64_t min_count, double log_eps)
+{
+	threshold_table<N> ret {};
+
+	if (!min_count_valid(min_count, log_eps)) {
+		min_count = find_min_count(log_eps);
+	}
+
+	ret.min_count = min_count;
+	for (size_t n = 0; n < N; ++n) {
+		ret.thresholds[n]
+		    = pair_threshold_fast(n, min_count, log_eps);
+	}
+
+	return ret;
+}
+
+template <size_t N>
+constexpr threshold_table<N> make_distribution_threshold_table(
+    uint64_t min_count, double log_eps)
+{
+	threshold_table<N> ret {};
+
+	if (!min_count_valid(min_count, log_eps)) {
+		min_count = find_min_count(log_eps);
+	}
+
+	ret.min_count = min_count;
+	for (size_t n = 0; n < N; ++n) {
+		ret.thresholds[n]
+		    = distribution_threshold_fast(n, min_count, log_eps);
+	}
+
+	return ret;
+}
+} // namespace one_sided_ks
+
+#if defined(__clang__)
+#pragma float_control(pop)
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+#endif /* !ONE_SIDED_KS_CONSTEXPR_H */
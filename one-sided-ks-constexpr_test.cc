@@ -0,0 +1,117 @@
+#include "one-sided-ks-constexpr.h"
+
+#include <cmath>
+#include <random>
+
+#include "gtest/gtest.h"
+#include "one-sided-ks-inline.h"
+#include "one-sided-ks.h"
+
+namespace {
+// Everything should be usable in constant expressions.
+constexpr double kLogEps = one_sided_ks::log(1e-6) + one_sided_ks::eq;
+constexpr uint64_t kMinCount = one_sided_ks::find_min_count(kLogEps);
+constexpr auto kPairTable
+    = one_sided_ks::make_pair_threshold_table<500>(0, kLogEps);
+constexpr auto kDistributionTable
+    = one_sided_ks::make_distribution_threshold_table<500>(
+	kMinCount, kLogEps);
+
+// The paper says eps = 0.05 -> min_count = 6.
+static_assert(one_sided_ks::find_min_count(one_sided_ks::log(0.05)) == 6,
+    "find_min_count");
+static_assert(one_sided_ks::min_count_valid(kMinCount, kLogEps),
+    "min_count_valid");
+static_assert(!one_sided_ks::min_count_valid(kMinCount - 1, kLogEps),
+    "min_count_valid");
+static_assert(kPairTable.min_count == kMinCount, "table min_count");
+static_assert(kPairTable[kMinCount - 1] == HUGE_VAL, "table below min");
+static_assert(kPairTable[kMinCount] < 1, "table threshold");
+
+TEST(OneSidedKsConstexpr, MinCount)
+{
+	for (double eps = 0.5; eps > 1e-100; eps /= 3) {
+		const double log_eps = std::log(eps);
+
+		EXPECT_EQ(one_sided_ks::find_min_count(log_eps),
+		    one_sided_ks_find_min_count(log_eps));
+		for (uint64_t m = 0; m < 1000; m += 7) {
+			EXPECT_EQ(one_sided_ks::min_count_valid(m, log_eps),
+			    one_sided_ks_min_count_valid(m, log_eps) != 0);
+		}
+	}
+
+	EXPECT_EQ(kMinCount, one_sided_ks_find_min_count(kLogEps));
+}
+
+// log is the same as the runtime library's.
+TEST(OneSidedKsConstexpr, Log)
+{
+	std::mt19937_64 rng(3);
+	std::uniform_real_distribution<double> exponent(-1070, 1020);
+
+	for (size_t i = 0; i < 100000; ++i) {
+		const double x = std::exp2(exponent(rng));
+
+		ASSERT_EQ(one_sided_ks::log(x), one_sided_ks_inline_log(x))
+		    << x;
+		ASSERT_EQ(one_sided_ks::log(i + 1.0),
+		    one_sided_ks_inline_log(i + 1.0));
+	}
+}
+
+// sqrt_near is within 1 ULP, and rounding up makes it an upper bound.
+TEST(OneSidedKsConstexpr, Sqrt)
+{
+	std::mt19937_64 rng(4);
+	std::uniform_real_distribution<double> exponent(-1000, 1000);
+
+	for (size_t i = 0; i < 100000; ++i) {
+		const double x = std::exp2(exponent(rng));
+		const double expected = std::sqrt(x);
+		const double actual = one_sided_ks::internal::sqrt_near(x);
+
+		ASSERT_GE(actual, std::nextafter(expected, 0)) << x;
+		ASSERT_LE(actual, std::nextafter(expected, HUGE_VAL)) << x;
+		ASSERT_GE(one_sided_ks::internal::sqrt_up(x),
+		    std::sqrt((long double)x))
+		    << x;
+	}
+}
+
+// Thresholds are never lower than the runtime's, and very close.
+TEST(OneSidedKsConstexpr, Thresholds)
+{
+	for (size_t n = 0; n < 500; ++n) {
+		const double pair
+		    = one_sided_ks_pair_threshold(n, kMinCount, kLogEps);
+		const double distribution
+		    = one_sided_ks_distribution_threshold(
+			n, kMinCount, kLogEps);
+
+		if (n < kMinCount) {
+			EXPECT_EQ(kPairTable[n], HUGE_VAL);
+			EXPECT_EQ(kDistributionTable[n], HUGE_VAL);
+			continue;
+		}
+
+		EXPECT_GE(kPairTable[n], pair);
+		EXPECT_LE(kPairTable[n], pair * (1 + 1e-15));
+		EXPECT_GE(kDistributionTable[n], distribution);
+		EXPECT_LE(kDistributionTable[n], distribution * (1 + 1e-15));
+	}
+
+	for (uint64_t n = 1; n < (1ULL << 62); n = 3 * n + 1) {
+		for (const double eps : { 0.1, 1e-3, 1e-10 }) {
+			const double log_eps = std::log(eps);
+			const double pair
+			    = one_sided_ks_pair_threshold(n, 0, log_eps);
+
+			EXPECT_GE(one_sided_ks::pair_threshold(n, 0, log_eps),
+			    pair);
+			EXPECT_LE(one_sided_ks::pair_threshold(n, 0, log_eps),
+			    pair * (1 + 1e-15));
+		}
+	}
+}
+} // namespace
@@ -0,0 +1,273 @@
+#include "one-sided-ks-ecdf.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "one-sided-ks-ratio.h"
+
+/*
+ * Each node summarises count_A[i] - count_B[i] for a range of
+ * buckets: the total, and the extreme (non-empty) prefix sums.
+ */
+struct node {
+	int64_t sum;
+	int64_t max_prefix;
+	int64_t min_prefix;
+};
+
+struct one_sided_ks_ecdf {
+	size_t num_buckets;
+	/* Number of leaves: num_buckets rounded up to a power of 2. */
+	size_t num_leaves;
+	uint64_t total[2];
+	uint64_t *counts[2];
+	/*
+	 * Implicit binary tree: the root is at index 1, children of
+	 * i are at 2i and 2i + 1, leaves start at num_leaves.
+	 */
+	struct node *tree;
+};
+
+struct one_sided_ks_ecdf *one_sided_ks_ecdf_create(size_t num_buckets)
+{
+	size_t num_leaves = 1;
+
+	if (num_buckets == 0) {
+		return NULL;
+	}
+
+	while (num_leaves < num_buckets) {
+		if (num_leaves > SIZE_MAX / (4 * sizeof(struct node))) {
+			return NULL;
+		}
+
+		num_leaves *= 2;
+	}
+
+	struct one_sided_ks_ecdf *ecdf = calloc(1, sizeof(*ecdf));
+	if (ecdf == NULL) {
+		return NULL;
+	}
+
+	ecdf->num_buckets = num_buckets;
+	ecdf->num_leaves = num_leaves;
+	ecdf->counts[ONE_SIDED_KS_ARM_A]
+	    = calloc(num_buckets, sizeof(uint64_t));
+	ecdf->counts[ONE_SIDED_KS_ARM_B]
+	    = calloc(num_buckets, sizeof(uint64_t));
+	ecdf->tree = calloc(2 * num_leaves, sizeof(struct node));
+	if (ecdf->counts[ONE_SIDED_KS_ARM_A] == NULL
+	    || ecdf->counts[ONE_SIDED_KS_ARM_B] == NULL
+	    || ecdf->tree == NULL) {
+		one_sided_ks_ecdf_destroy(ecdf);
+		return NULL;
+	}
+
+	return ecdf;
+}
+
+void one_sided_ks_ecdf_destroy(struct one_sided_ks_ecdf *ecdf)
+{
+	if (ecdf == NULL) {
+		return;
+	}
+
+	free(ecdf->counts[ONE_SIDED_KS_ARM_A]);
+	free(ecdf->counts[ONE_SIDED_KS_ARM_B]);
+	free(ecdf->tree);
+	free(ecdf);
+}
+
+size_t one_sided_ks_ecdf_num_buckets(const struct one_sided_ks_ecdf *ecdf)
+{
+	return ecdf->num_buckets;
+}
+
+static inline int64_t max64(int64_t x, int64_t y)
+{
+	return (x > y) ? x : y;
+}
+
+static inline int64_t min64(int64_t x, int64_t y)
+{
+	return (x < y) ? x : y;
+}
+
+static inline struct node merge_nodes(
+    const struct node *left, const struct node *right)
+{
+	return (struct node) {
+		.sum = left->sum + right->sum,
+		.max_prefix
+		= max64(left->max_prefix, left->sum + right->max_prefix),
+		.min_prefix
+		= min64(left->min_prefix, left->sum + right->min_prefix),
+	};
+}
+
+/* Adds `delta` to the difference in `bucket`, and updates the tree. */
+static void update(
+    struct one_sided_ks_ecdf *ecdf, size_t bucket, int64_t delta)
+{
+	size_t i = ecdf->num_leaves + bucket;
+	struct node *tree = ecdf->tree;
+
+	tree[i].sum += delta;
+	tree[i].max_prefix = tree[i].sum;
+	tree[i].min_prefix = tree[i].sum;
+	for (i /= 2; i > 0; i /= 2) {
+		tree[i] = merge_nodes(&tree[2 * i], &tree[2 * i + 1]);
+	}
+}
+
+void one_sided_ks_ecdf_add(struct one_sided_ks_ecdf *ecdf,
+    enum one_sided_ks_arm arm, size_t bucket, uint64_t count)
+{
+	assert(bucket < ecdf->num_buckets && "bucket out of range");
+	assert((arm == ONE_SIDED_KS_ARM_A || arm == ONE_SIDED_KS_ARM_B)
+	    && "invalid arm");
+
+	if (count == 0) {
+		return;
+	}
+
+	ecdf->total[arm] += count;
+	ecdf->counts[arm][bucket] += count;
+	update(ecdf, bucket,
+	    (arm == ONE_SIDED_KS_ARM_A) ? (int64_t)count : -(int64_t)count);
+}
+
+void one_sided_ks_ecdf_add_pair(
+    struct one_sided_ks_ecdf *ecdf, size_t a_bucket, size_t b_bucket)
+{
+	assert(a_bucket < ecdf->num_buckets && "bucket out of range");
+	assert(b_bucket < ecdf->num_buckets && "bucket out of range");
+
+	ecdf->total[ONE_SIDED_KS_ARM_A]++;
+	ecdf->total[ONE_SIDED_KS_ARM_B]++;
+	ecdf->counts[ONE_SIDED_KS_ARM_A][a_bucket]++;
+	ecdf->counts[ONE_SIDED_KS_ARM_B][b_bucket]++;
+	/* Nothing changes when both land in the same bucket. */
+	if (a_bucket != b_bucket) {
+		update(ecdf, a_bucket, 1);
+		update(ecdf, b_bucket, -1);
+	}
+}
+
+void one_sided_ks_ecdf_load(struct one_sided_ks_ecdf *ecdf,
+    const uint64_t *a_counts, const uint64_t *b_counts)
+{
+	const size_t num_buckets = ecdf->num_buckets;
+	const size_t num_leaves = ecdf->num_leaves;
+	struct node *tree = ecdf->tree;
+
+	ecdf->total[ONE_SIDED_KS_ARM_A] = 0;
+	ecdf->total[ONE_SIDED_KS_ARM_B] = 0;
+	for (size_t i = 0; i < num_leaves; ++i) {
+		int64_t delta = 0;
+
+		if (i < num_buckets) {
+			ecdf->counts[ONE_SIDED_KS_ARM_A][i] = a_counts[i];
+			ecdf->counts[ONE_SIDED_KS_ARM_B][i] = b_counts[i];
+			ecdf->total[ONE_SIDED_KS_ARM_A] += a_counts[i];
+			ecdf->total[ONE_SIDED_KS_ARM_B] += b_counts[i];
+			delta = (int64_t)a_counts[i] - (int64_t)b_counts[i];
+		}
+
+		tree[num_leaves + i] = (struct node) {
+			.sum = delta,
+			.max_prefix = delta,
+			.min_prefix = delta,
+		};
+	}
+
+	for (size_t i = num_leaves - 1; i > 0; --i) {
+		tree[i] = merge_nodes(&tree[2 * i], &tree[2 * i + 1]);
+	}
+}
+
+uint64_t one_sided_ks_ecdf_count(
+    const struct one_sided_ks_ecdf *ecdf, enum one_sided_ks_arm arm)
+{
+	return ecdf->total[arm];
+}
+
+uint64_t one_sided_ks_ecdf_bucket_count(const struct one_sided_ks_ecdf *ecdf,
+    enum one_sided_ks_arm arm, size_t bucket)
+{
+	assert(bucket < ecdf->num_buckets && "bucket out of range");
+	return ecdf->counts[arm][bucket];
+}
+
+uint64_t one_sided_ks_ecdf_r_plus(const struct one_sided_ks_ecdf *ecdf)
+{
+	return max64(0, ecdf->tree[1].max_prefix);
+}
+
+uint64_t one_sided_ks_ecdf_r_minus(const struct one_sided_ks_ecdf *ecdf)
+{
+	return max64(0, -ecdf->tree[1].min_prefix);
+}
+
+/*
+ * max_i [count_x[..i] / n_x - count_y[..i] / n_y], by a linear scan in
+ * 128-bit integer arithmetic.
+ */
+static double scan_delta(const struct one_sided_ks_ecdf *ecdf,
+    enum one_sided_ks_arm x, enum one_sided_ks_arm y)
+{
+	const unsigned __int128 n_x = ecdf->total[x];
+	const unsigned __int128 n_y = ecdf->total[y];
+	__int128 best = 0;
+	uint64_t sum_x = 0;
+	uint64_t sum_y = 0;
+
+	for (size_t i = 0; i < ecdf->num_buckets; ++i) {
+		sum_x += ecdf->counts[x][i];
+		sum_y += ecdf->counts[y][i];
+
+		const __int128 delta = (__int128)(n_y * sum_x)
+		    - (__int128)(n_x * sum_y);
+		if (delta > best) {
+			best = delta;
+		}
+	}
+
+	return one_sided_ks_ratio_down(best, n_x * n_y);
+}
+
+double one_sided_ks_ecdf_d_plus(const struct one_sided_ks_ecdf *ecdf)
+{
+	const uint64_t n_a = ecdf->total[ONE_SIDED_KS_ARM_A];
+	const uint64_t n_b = ecdf->total[ONE_SIDED_KS_ARM_B];
+
+	if (n_a == 0 || n_b == 0) {
+		return 0;
+	}
+
+	if (n_a == n_b) {
+		return one_sided_ks_ratio_down(
+		    one_sided_ks_ecdf_r_plus(ecdf), n_a);
+	}
+
+	return scan_delta(ecdf, ONE_SIDED_KS_ARM_A, ONE_SIDED_KS_ARM_B);
+}
+
+double one_sided_ks_ecdf_d_minus(const struct one_sided_ks_ecdf *ecdf)
+{
+	const uint64_t n_a = ecdf->total[ONE_SIDED_KS_ARM_A];
+	const uint64_t n_b = ecdf->total[ONE_SIDED_KS_ARM_B];
+
+	if (n_a == 0 || n_b == 0) {
+		return 0;
+	}
+
+	if (n_a == n_b) {
+		return one_sided_ks_ratio_down(
+		    one_sided_ks_ecdf_r_minus(ecdf), n_a);
+	}
+
+	return scan_delta(ecdf, ONE_SIDED_KS_ARM_B, ONE_SIDED_KS_ARM_A);
+}
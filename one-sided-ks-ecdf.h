@@ -0,0 +1,91 @@
+#ifndef ONE_SIDED_KS_ECDF_H
+#define ONE_SIDED_KS_ECDF_H
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Incremental two-sample statistics over bucketed values.
+ *
+ * A `one_sided_ks_ecdf` counts observations from two distributions,
+ * A and B, in `num_buckets` ordered buckets.  It maintains a segment
+ * tree over the per-bucket differences `count_A[i] - count_B[i]`,
+ * where each node stores the sum, max prefix sum and min prefix sum
+ * for its range.  Adding an observation updates O(log num_buckets)
+ * nodes, and, when both samples have the same size `n`,
+ *
+ *   D+ = max_x [CDF_A(x) - CDF_B(x)] = root max prefix / n
+ *   D- = max_x [CDF_B(x) - CDF_A(x)] = -root min prefix / n
+ *
+ * are available in constant time; compare D+ with
+ * `one_sided_ks_pair_threshold(n, min_count, log_eps)`.  When the
+ * sample sizes differ, compare D+ with
+ * `one_sided_ks_unpaired_threshold(n_a, n_b, min_count, log_eps)`.
+ */
+
+enum one_sided_ks_arm {
+	ONE_SIDED_KS_ARM_A = 0,
+	ONE_SIDED_KS_ARM_B = 1,
+};
+
+struct one_sided_ks_ecdf;
+
+/* Returns a new empty accumulator, or NULL on failure. */
+struct one_sided_ks_ecdf *one_sided_ks_ecdf_create(size_t num_buckets);
+
+void one_sided_ks_ecdf_destroy(struct one_sided_ks_ecdf *ecdf);
+
+size_t one_sided_ks_ecdf_num_buckets(const struct one_sided_ks_ecdf *ecdf);
+
+/* Adds `count` observations in `bucket` for `arm`. */
+void one_sided_ks_ecdf_add(struct one_sided_ks_ecdf *ecdf,
+    enum one_sided_ks_arm arm, size_t bucket, uint64_t count);
+
+/* Adds one observation from A in `a_bucket`, and one from B in `b_bucket`. */
+void one_sided_ks_ecdf_add_pair(
+    struct one_sided_ks_ecdf *ecdf, size_t a_bucket, size_t b_bucket);
+
+/*
+ * Replaces the contents of `ecdf` with the histograms `a_counts` and
+ * `b_counts`, each with `num_buckets` entries, in linear time.
+ */
+void one_sided_ks_ecdf_load(struct one_sided_ks_ecdf *ecdf,
+    const uint64_t *a_counts, const uint64_t *b_counts);
+
+/* Returns the total number of observations for `arm`. */
+uint64_t one_sided_ks_ecdf_count(
+    const struct one_sided_ks_ecdf *ecdf, enum one_sided_ks_arm arm);
+
+/* Returns the number of observations for `arm` in `bucket`. */
+uint64_t one_sided_ks_ecdf_bucket_count(const struct one_sided_ks_ecdf *ecdf,
+    enum one_sided_ks_arm arm, size_t bucket);
+
+/*
+ * Returns max_i sum_{j <= i} (count_A[j] - count_B[j]), or 0 if all
+ * prefix sums are negative.  When A and B both have `n`
+ * observations, D+ = r_plus / n, and we can reject when `r_plus >=
+ * one_sided_ks_pair_min_reject(n, min_count, log_eps)`.
+ */
+uint64_t one_sided_ks_ecdf_r_plus(const struct one_sided_ks_ecdf *ecdf);
+
+/* Same as `one_sided_ks_ecdf_r_plus`, with A and B swapped. */
+uint64_t one_sided_ks_ecdf_r_minus(const struct one_sided_ks_ecdf *ecdf);
+
+/*
+ * Returns D+ = max_x [CDF_A(x) - CDF_B(x)], rounded down, or 0 if
+ * either sample is empty.
+ *
+ * Constant time when both samples have the same size, linear in
+ * `num_buckets` otherwise.
+ */
+double one_sided_ks_ecdf_d_plus(const struct one_sided_ks_ecdf *ecdf);
+
+/* Returns D- = max_x [CDF_B(x) - CDF_A(x)], like `d_plus`. */
+double one_sided_ks_ecdf_d_minus(const struct one_sided_ks_ecdf *ecdf);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /* !ONE_SIDED_KS_ECDF_H */
@@ -0,0 +1,170 @@
+#include "one-sided-ks-ecdf.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "one-sided-ks.h"
+
+namespace {
+using ::testing::DoubleNear;
+
+// Reference implementation: scan both histograms.
+double max_cdf_delta(
+    const std::vector<size_t> &x, const std::vector<size_t> &y)
+{
+	size_t n_x = 0;
+	size_t n_y = 0;
+	for (size_t i = 0; i < x.size(); ++i) {
+		n_x += x[i];
+		n_y += y[i];
+	}
+
+	double max_delta = 0.0;
+	size_t sum_x = 0;
+	size_t sum_y = 0;
+	for (size_t i = 0; i < x.size(); ++i) {
+		sum_x += x[i];
+		sum_y += y[i];
+		max_delta = std::max(
+		    max_delta, 1.0 * sum_x / n_x - 1.0 * sum_y / n_y);
+	}
+
+	return max_delta;
+}
+
+TEST(OneSidedKsEcdf, Empty)
+{
+	struct one_sided_ks_ecdf *ecdf = one_sided_ks_ecdf_create(10);
+
+	EXPECT_EQ(one_sided_ks_ecdf_num_buckets(ecdf), 10);
+	EXPECT_EQ(one_sided_ks_ecdf_d_plus(ecdf), 0);
+	EXPECT_EQ(one_sided_ks_ecdf_d_minus(ecdf), 0);
+	EXPECT_EQ(one_sided_ks_ecdf_r_plus(ecdf), 0);
+	one_sided_ks_ecdf_destroy(ecdf);
+
+	EXPECT_EQ(one_sided_ks_ecdf_create(0), nullptr);
+}
+
+// With paired observations, the tree should match a linear scan.
+TEST(OneSidedKsEcdf, PairMatchesScan)
+{
+	std::mt19937 rng(42);
+
+	for (const size_t range : { 1, 2, 3, 10, 17, 64, 1000 }) {
+		std::uniform_int_distribution<size_t> dist(0, range - 1);
+		std::vector<size_t> x(range, 0);
+		std::vector<size_t> y(range, 0);
+		struct one_sided_ks_ecdf *ecdf
+		    = one_sided_ks_ecdf_create(range);
+
+		for (size_t i = 0; i < 2000; ++i) {
+			// Skew B towards higher buckets.
+			const size_t a = dist(rng);
+			const size_t b = std::max(dist(rng), dist(rng));
+
+			++x[a];
+			++y[b];
+			one_sided_ks_ecdf_add_pair(ecdf, a, b);
+
+			const double expected_plus = max_cdf_delta(x, y);
+			const double expected_minus = max_cdf_delta(y, x);
+			ASSERT_THAT(one_sided_ks_ecdf_d_plus(ecdf),
+			    DoubleNear(expected_plus, 1e-15));
+			ASSERT_THAT(one_sided_ks_ecdf_d_minus(ecdf),
+			    DoubleNear(expected_minus, 1e-15));
+			ASSERT_LE(one_sided_ks_ecdf_d_plus(ecdf),
+			    1.0 * one_sided_ks_ecdf_r_plus(ecdf) / (i + 1));
+			ASSERT_EQ(one_sided_ks_ecdf_r_plus(ecdf),
+			    std::lround(expected_plus * (i + 1)));
+		}
+
+		EXPECT_EQ(one_sided_ks_ecdf_count(ecdf, ONE_SIDED_KS_ARM_A),
+		    2000);
+		EXPECT_EQ(one_sided_ks_ecdf_count(ecdf, ONE_SIDED_KS_ARM_B),
+		    2000);
+		for (size_t i = 0; i < range; ++i) {
+			EXPECT_EQ(one_sided_ks_ecdf_bucket_count(
+				      ecdf, ONE_SIDED_KS_ARM_A, i),
+			    x[i]);
+			EXPECT_EQ(one_sided_ks_ecdf_bucket_count(
+				      ecdf, ONE_SIDED_KS_ARM_B, i),
+			    y[i]);
+		}
+
+		one_sided_ks_ecdf_destroy(ecdf);
+	}
+}
+
+// Unequal sample sizes fall back to a scan.
+TEST(OneSidedKsEcdf, UnequalCounts)
+{
+	std::mt19937 rng(1);
+	std::uniform_int_distribution<size_t> dist(0, 99);
+	std::vector<size_t> x(100, 0);
+	std::vector<size_t> y(100, 0);
+	struct one_sided_ks_ecdf *ecdf = one_sided_ks_ecdf_create(100);
+
+	for (size_t i = 0; i < 5000; ++i) {
+		const size_t bucket = dist(rng);
+		const uint64_t count = 1 + (i % 3);
+
+		if (i % 4 == 0) {
+			y[bucket] += count;
+			one_sided_ks_ecdf_add(
+			    ecdf, ONE_SIDED_KS_ARM_B, bucket, count);
+		} else {
+			x[std::min<size_t>(bucket + 5, 99)] += count;
+			one_sided_ks_ecdf_add(ecdf, ONE_SIDED_KS_ARM_A,
+			    std::min<size_t>(bucket + 5, 99), count);
+		}
+
+		if (i == 0) {
+			continue;
+		}
+
+		ASSERT_THAT(one_sided_ks_ecdf_d_plus(ecdf),
+		    DoubleNear(max_cdf_delta(x, y), 1e-15));
+		ASSERT_THAT(one_sided_ks_ecdf_d_minus(ecdf),
+		    DoubleNear(max_cdf_delta(y, x), 1e-15));
+	}
+
+	one_sided_ks_ecdf_destroy(ecdf);
+}
+
+// Shifted distributions should eventually exceed the threshold.
+TEST(OneSidedKsEcdf, Threshold)
+{
+	const double log_eps = std::log(1e-6);
+	const uint64_t min_count = one_sided_ks_find_min_count(log_eps);
+	std::mt19937 rng(2);
+	std::uniform_int_distribution<size_t> dist(0, 1 << 16);
+	struct one_sided_ks_ecdf *ecdf = one_sided_ks_ecdf_create(1 << 16);
+
+	for (uint64_t n = 1;; ++n) {
+		ASSERT_LT(n, 100000);
+		one_sided_ks_ecdf_add_pair(
+		    ecdf, dist(rng) / 2, dist(rng) / 2);
+		// A is sometimes lower, so CDF_A > CDF_B.
+		one_sided_ks_ecdf_add_pair(
+		    ecdf, dist(rng) / 3, dist(rng) / 2);
+
+		const bool reject = one_sided_ks_ecdf_d_plus(ecdf)
+		    > one_sided_ks_pair_threshold(2 * n, min_count, log_eps);
+		const bool reject_int = one_sided_ks_ecdf_r_plus(ecdf)
+		    >= one_sided_ks_pair_min_reject(
+			2 * n, min_count, log_eps);
+		// The integer cutoff is never more conservative than
+		// the double threshold.
+		EXPECT_TRUE(reject_int || !reject);
+		if (reject_int) {
+			break;
+		}
+	}
+
+	one_sided_ks_ecdf_destroy(ecdf);
+}
+} // namespace
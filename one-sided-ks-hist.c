@@ -0,0 +1,476 @@
+#include "one-sided-ks-hist.h"
+
+#include <stdint.h>
+
+#include "one-sided-ks-isa.h"
+#include "one-sided-ks-ratio.h"
+
+/*
+ * With both totals below 2^31, every product and prefix sum is less
+ * than 2^62 in magnitude, and the SIMD kernels can multiply 32-bit
+ * counts.
+ */
+#define MAX_NARROW_TOTAL ((uint64_t)1 << 31)
+
+#define MAX_TOTAL ((uint64_t)1 << 63)
+
+/*
+ * The SIMD total kernels sum the low and high 32-bit halves of counts
+ * separately, which can't overflow for this many buckets.
+ */
+#define MAX_TOTAL_CHUNK ((size_t)1 << 30)
+
+/* Running state for a scan over buckets. */
+struct scan {
+	int64_t sum;
+	int64_t max;
+	int64_t min;
+	/* The first buckets that attain `max` and `min`. */
+	size_t max_index;
+	size_t min_index;
+};
+
+/*
+ * Extends `scan` with prefix sums of n_b a_i - n_a b_i, for i in
+ * [begin, end).
+ */
+static void scan_scalar(const uint64_t *a, const uint64_t *b, size_t begin,
+    size_t end, int64_t n_a, int64_t n_b, struct scan *scan)
+{
+	int64_t sum = scan->sum;
+	int64_t max = scan->max;
+	int64_t min = scan->min;
+	size_t max_index = scan->max_index;
+	size_t min_index = scan->min_index;
+
+	for (size_t i = begin; i < end; ++i) {
+		sum += n_b * (int64_t)a[i] - n_a * (int64_t)b[i];
+		if (sum > max) {
+			max = sum;
+			max_index = i;
+		}
+
+		if (sum < min) {
+			min = sum;
+			min_index = i;
+		}
+	}
+
+	scan->sum = sum;
+	scan->max = max;
+	scan->min = min;
+	scan->max_index = max_index;
+	scan->min_index = min_index;
+}
+
+/* Scans all `k` buckets into `scan`, which must be empty. */
+typedef void scan_kernel_fn(const uint64_t *a, const uint64_t *b, size_t k,
+    int64_t n_a, int64_t n_b, struct scan *scan);
+
+static void scan_kernel_scalar(const uint64_t *a, const uint64_t *b,
+    size_t k, int64_t n_a, int64_t n_b, struct scan *scan)
+{
+	scan_scalar(a, b, 0, k, n_a, n_b, scan);
+}
+
+/* Returns the sum of `k <= MAX_TOTAL_CHUNK` counts. */
+typedef unsigned __int128 total_kernel_fn(const uint64_t *x, size_t k);
+
+static unsigned __int128 total_kernel_scalar(const uint64_t *x, size_t k)
+{
+	unsigned __int128 ret = 0;
+
+	for (size_t i = 0; i < k; ++i) {
+		ret += x[i];
+	}
+
+	return ret;
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+
+#define ONE_SIDED_KS_SIMD 1
+
+/*
+ * The SIMD kernels only track the extremes of each block of
+ * BLOCK_SIZE buckets (a multiple of 8), and find the first bucket
+ * that attains each extreme with a scalar scan of its block at the
+ * end.  Tracking bucket indices in every iteration costs more than
+ * the prefix sums themselves.
+ */
+#define BLOCK_SIZE 64
+
+/*
+ * Each lane's extreme prefix sum, the first bucket of the earliest
+ * block in which it occurs, and the running total before that block.
+ */
+struct lanes {
+	int64_t value[8];
+	int64_t block[8];
+	int64_t start[8];
+};
+
+/* Returns the first bucket from `begin` whose prefix sum is `target`. */
+static size_t find_first(const uint64_t *a, const uint64_t *b,
+    size_t begin, int64_t n_a, int64_t n_b, int64_t sum, int64_t target)
+{
+	size_t i = begin;
+
+	for (;; ++i) {
+		sum += n_b * (int64_t)a[i] - n_a * (int64_t)b[i];
+		if (sum == target) {
+			return i;
+		}
+	}
+}
+
+/*
+ * Merges per-lane extremes into `scan`, which must be empty, with
+ * ties going to the earliest block.
+ */
+static void merge_lanes(const uint64_t *a, const uint64_t *b, int64_t n_a,
+    int64_t n_b, size_t num_lanes, const struct lanes *max,
+    const struct lanes *min, struct scan *scan)
+{
+	size_t best_max = 0;
+	size_t best_min = 0;
+
+	for (size_t j = 1; j < num_lanes; ++j) {
+		if (max->value[j] > max->value[best_max]
+		    || (max->value[j] == max->value[best_max]
+			&& max->block[j] < max->block[best_max])) {
+			best_max = j;
+		}
+
+		if (min->value[j] < min->value[best_min]
+		    || (min->value[j] == min->value[best_min]
+			&& min->block[j] < min->block[best_min])) {
+			best_min = j;
+		}
+	}
+
+	scan->max = max->value[best_max];
+	scan->max_index = find_first(a, b, max->block[best_max], n_a, n_b,
+	    max->start[best_max], scan->max);
+	scan->min = min->value[best_min];
+	scan->min_index = find_first(a, b, min->block[best_min], n_a, n_b,
+	    min->start[best_min], scan->min);
+}
+
+#define AVX2 __attribute__((__target__("avx2")))
+
+static AVX2 unsigned __int128 total_kernel_avx2(const uint64_t *x, size_t k)
+{
+	const __m256i mask = _mm256_set1_epi64x(UINT32_MAX);
+	__m256i low = _mm256_setzero_si256();
+	__m256i high = _mm256_setzero_si256();
+	uint64_t lows[4];
+	uint64_t highs[4];
+	unsigned __int128 ret = 0;
+	size_t i = 0;
+
+	for (; i + 4 <= k; i += 4) {
+		const __m256i v = _mm256_loadu_si256((const __m256i *)&x[i]);
+
+		low = _mm256_add_epi64(low, _mm256_and_si256(v, mask));
+		high = _mm256_add_epi64(high, _mm256_srli_epi64(v, 32));
+	}
+
+	_mm256_storeu_si256((__m256i *)lows, low);
+	_mm256_storeu_si256((__m256i *)highs, high);
+	for (size_t j = 0; j < 4; ++j) {
+		ret += lows[j] + ((unsigned __int128)highs[j] << 32);
+	}
+
+	return ret + total_kernel_scalar(&x[i], k - i);
+}
+
+/*
+ * Each iteration computes the in-register inclusive prefix sums of
+ * 4 buckets, in 2 shift-and-add steps, independently of the running
+ * total, which then only costs one add per iteration.
+ */
+static AVX2 void scan_kernel_avx2(const uint64_t *a, const uint64_t *b,
+    size_t k, int64_t n_a, int64_t n_b, struct scan *scan)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i va = _mm256_set1_epi64x(n_a);
+	const __m256i vb = _mm256_set1_epi64x(n_b);
+	__m256i sum = _mm256_setzero_si256();
+	__m256i max = _mm256_set1_epi64x(INT64_MIN);
+	__m256i min = _mm256_set1_epi64x(INT64_MAX);
+	__m256i max_block = zero;
+	__m256i min_block = zero;
+	__m256i max_start = zero;
+	__m256i min_start = zero;
+	size_t i = 0;
+
+	for (; i + BLOCK_SIZE <= k; i += BLOCK_SIZE) {
+		const __m256i block = _mm256_set1_epi64x(i);
+		const __m256i start = sum;
+		__m256i block_max = _mm256_set1_epi64x(INT64_MIN);
+		__m256i block_min = _mm256_set1_epi64x(INT64_MAX);
+
+		for (size_t j = i; j < i + BLOCK_SIZE; j += 4) {
+			/* Counts are less than 2^31: 32-bit products do. */
+			__m256i w = _mm256_sub_epi64(
+			    _mm256_mul_epu32(
+				_mm256_loadu_si256((const __m256i *)&a[j]),
+				vb),
+			    _mm256_mul_epu32(
+				_mm256_loadu_si256((const __m256i *)&b[j]),
+				va));
+
+			/* [w0, w1, w2, w3] + [0, w0, w1, w2] */
+			w = _mm256_add_epi64(w,
+			    _mm256_blend_epi32(
+				_mm256_permute4x64_epi64(
+				    w, _MM_SHUFFLE(2, 1, 0, 0)),
+				zero, 0x03));
+			/* + [0, 0, w0, w0 + w1] */
+			w = _mm256_add_epi64(
+			    w, _mm256_permute2x128_si256(w, w, 0x08));
+
+			const __m256i total = _mm256_permute4x64_epi64(
+			    w, _MM_SHUFFLE(3, 3, 3, 3));
+			const __m256i v = _mm256_add_epi64(w, sum);
+
+			sum = _mm256_add_epi64(sum, total);
+			block_max = _mm256_blendv_epi8(
+			    block_max, v, _mm256_cmpgt_epi64(v, block_max));
+			block_min = _mm256_blendv_epi8(
+			    block_min, v, _mm256_cmpgt_epi64(block_min, v));
+		}
+
+		const __m256i gt = _mm256_cmpgt_epi64(block_max, max);
+		const __m256i lt = _mm256_cmpgt_epi64(min, block_min);
+
+		max = _mm256_blendv_epi8(max, block_max, gt);
+		max_block = _mm256_blendv_epi8(max_block, block, gt);
+		max_start = _mm256_blendv_epi8(max_start, start, gt);
+		min = _mm256_blendv_epi8(min, block_min, lt);
+		min_block = _mm256_blendv_epi8(min_block, block, lt);
+		min_start = _mm256_blendv_epi8(min_start, start, lt);
+	}
+
+	if (i > 0) {
+		struct lanes max_lanes;
+		struct lanes min_lanes;
+
+		_mm256_storeu_si256((__m256i *)max_lanes.value, max);
+		_mm256_storeu_si256((__m256i *)max_lanes.block, max_block);
+		_mm256_storeu_si256((__m256i *)max_lanes.start, max_start);
+		_mm256_storeu_si256((__m256i *)min_lanes.value, min);
+		_mm256_storeu_si256((__m256i *)min_lanes.block, min_block);
+		_mm256_storeu_si256((__m256i *)min_lanes.start, min_start);
+		scan->sum = _mm256_extract_epi64(sum, 0);
+		merge_lanes(a, b, n_a, n_b, 4, &max_lanes, &min_lanes, scan);
+	}
+
+	scan_scalar(a, b, i, k, n_a, n_b, scan);
+}
+
+#define AVX512 __attribute__((__target__("avx512f")))
+
+static AVX512 unsigned __int128 total_kernel_avx512(
+    const uint64_t *x, size_t k)
+{
+	const __m512i mask = _mm512_set1_epi64(UINT32_MAX);
+	__m512i low = _mm512_setzero_si512();
+	__m512i high = _mm512_setzero_si512();
+	uint64_t lows[8];
+	uint64_t highs[8];
+	unsigned __int128 ret = 0;
+	size_t i = 0;
+
+	for (; i + 8 <= k; i += 8) {
+		const __m512i v = _mm512_loadu_si512(&x[i]);
+
+		low = _mm512_add_epi64(low, _mm512_and_si512(v, mask));
+		high = _mm512_add_epi64(high, _mm512_srli_epi64(v, 32));
+	}
+
+	_mm512_storeu_si512(lows, low);
+	_mm512_storeu_si512(highs, high);
+	for (size_t j = 0; j < 8; ++j) {
+		ret += lows[j] + ((unsigned __int128)highs[j] << 32);
+	}
+
+	return ret + total_kernel_scalar(&x[i], k - i);
+}
+
+/* Same as `scan_kernel_avx2`, 8 buckets at a time, in 3 steps. */
+static AVX512 void scan_kernel_avx512(const uint64_t *a, const uint64_t *b,
+    size_t k, int64_t n_a, int64_t n_b, struct scan *scan)
+{
+	const __m512i zero = _mm512_setzero_si512();
+	const __m512i va = _mm512_set1_epi64(n_a);
+	const __m512i vb = _mm512_set1_epi64(n_b);
+	const __m512i last = _mm512_set1_epi64(7);
+	__m512i sum = zero;
+	__m512i max = _mm512_set1_epi64(INT64_MIN);
+	__m512i min = _mm512_set1_epi64(INT64_MAX);
+	__m512i max_block = zero;
+	__m512i min_block = zero;
+	__m512i max_start = zero;
+	__m512i min_start = zero;
+	size_t i = 0;
+
+	for (; i + BLOCK_SIZE <= k; i += BLOCK_SIZE) {
+		const __m512i block = _mm512_set1_epi64(i);
+		const __m512i start = sum;
+		__m512i block_max = _mm512_set1_epi64(INT64_MIN);
+		__m512i block_min = _mm512_set1_epi64(INT64_MAX);
+
+		for (size_t j = i; j < i + BLOCK_SIZE; j += 8) {
+			__m512i w = _mm512_sub_epi64(
+			    _mm512_mul_epu32(_mm512_loadu_si512(&a[j]), vb),
+			    _mm512_mul_epu32(_mm512_loadu_si512(&b[j]), va));
+
+			/* Shift lanes up by 1, 2 and 4, filling with 0. */
+			w = _mm512_add_epi64(
+			    w, _mm512_alignr_epi64(w, zero, 7));
+			w = _mm512_add_epi64(
+			    w, _mm512_alignr_epi64(w, zero, 6));
+			w = _mm512_add_epi64(
+			    w, _mm512_alignr_epi64(w, zero, 4));
+
+			const __m512i total
+			    = _mm512_permutexvar_epi64(last, w);
+			const __m512i v = _mm512_add_epi64(w, sum);
+
+			sum = _mm512_add_epi64(sum, total);
+			block_max = _mm512_max_epi64(block_max, v);
+			block_min = _mm512_min_epi64(block_min, v);
+		}
+
+		const __mmask8 gt = _mm512_cmpgt_epi64_mask(block_max, max);
+		const __mmask8 lt = _mm512_cmplt_epi64_mask(block_min, min);
+
+		max = _mm512_mask_mov_epi64(max, gt, block_max);
+		max_block = _mm512_mask_mov_epi64(max_block, gt, block);
+		max_start = _mm512_mask_mov_epi64(max_start, gt, start);
+		min = _mm512_mask_mov_epi64(min, lt, block_min);
+		min_block = _mm512_mask_mov_epi64(min_block, lt, block);
+		min_start = _mm512_mask_mov_epi64(min_start, lt, start);
+	}
+
+	if (i > 0) {
+		struct lanes max_lanes;
+		struct lanes min_lanes;
+
+		_mm512_storeu_si512(max_lanes.value, max);
+		_mm512_storeu_si512(max_lanes.block, max_block);
+		_mm512_storeu_si512(max_lanes.start, max_start);
+		_mm512_storeu_si512(min_lanes.value, min);
+		_mm512_storeu_si512(min_lanes.block, min_block);
+		_mm512_storeu_si512(min_lanes.start, min_start);
+		scan->sum = _mm_cvtsi128_si64(_mm512_castsi512_si128(sum));
+		merge_lanes(a, b, n_a, n_b, 8, &max_lanes, &min_lanes, scan);
+	}
+
+	scan_scalar(a, b, i, k, n_a, n_b, scan);
+}
+
+#undef AVX512
+#undef AVX2
+#endif
+
+/* Same as `scan_kernel_scalar`, in 128-bit arithmetic for large totals. */
+static void scan_wide(const uint64_t *a, const uint64_t *b, size_t k,
+    uint64_t n_a, uint64_t n_b, struct one_sided_ks_hist_result *result)
+{
+	__int128 sum = 0;
+	__int128 max = 0;
+	__int128 min = 0;
+
+	for (size_t i = 0; i < k; ++i) {
+		sum += (__int128)n_b * a[i] - (__int128)n_a * b[i];
+		if (i == 0 || sum > max) {
+			max = sum;
+			result->d_plus_bucket = i;
+		}
+
+		if (i == 0 || sum < min) {
+			min = sum;
+			result->d_minus_bucket = i;
+		}
+	}
+
+	/* The last prefix sum is 0, so max >= 0 >= min. */
+	result->d_plus = one_sided_ks_ratio_down(
+	    max, (unsigned __int128)n_a * n_b);
+	result->d_minus = one_sided_ks_ratio_down(
+	    -min, (unsigned __int128)n_a * n_b);
+}
+
+static unsigned __int128 total(
+    total_kernel_fn *kernel, const uint64_t *x, size_t k)
+{
+	unsigned __int128 ret = 0;
+
+	for (size_t begin = 0; begin < k; begin += MAX_TOTAL_CHUNK) {
+		const size_t end = (k - begin > MAX_TOTAL_CHUNK)
+		    ? begin + MAX_TOTAL_CHUNK
+		    : k;
+
+		ret += kernel(&x[begin], end - begin);
+	}
+
+	return ret;
+}
+
+int one_sided_ks_hist_dplus(const uint64_t *a, const uint64_t *b, size_t k,
+    struct one_sided_ks_hist_result *result)
+{
+	total_kernel_fn *total_kernel = total_kernel_scalar;
+	scan_kernel_fn *scan_kernel = scan_kernel_scalar;
+#ifdef ONE_SIDED_KS_SIMD
+	switch (one_sided_ks_isa_get()) {
+	case ONE_SIDED_KS_ISA_AVX512:
+		total_kernel = total_kernel_avx512;
+		scan_kernel = scan_kernel_avx512;
+		break;
+	case ONE_SIDED_KS_ISA_AVX2:
+		total_kernel = total_kernel_avx2;
+		scan_kernel = scan_kernel_avx2;
+		break;
+	case ONE_SIDED_KS_ISA_SCALAR:
+		break;
+	}
+#endif
+
+	const unsigned __int128 total_a = total(total_kernel, a, k);
+	const unsigned __int128 total_b = total(total_kernel, b, k);
+
+	if (total_a == 0 || total_b == 0 || total_a > MAX_TOTAL
+	    || total_b > MAX_TOTAL) {
+		return -1;
+	}
+
+	const uint64_t n_a = total_a;
+	const uint64_t n_b = total_b;
+
+	if (n_a >= MAX_NARROW_TOTAL || n_b >= MAX_NARROW_TOTAL) {
+		scan_wide(a, b, k, n_a, n_b, result);
+		return 0;
+	}
+
+	struct scan scan = {
+		.sum = 0,
+		.max = INT64_MIN,
+		.min = INT64_MAX,
+		.max_index = 0,
+		.min_index = 0,
+	};
+
+	scan_kernel(a, b, k, n_a, n_b, &scan);
+	result->d_plus
+	    = one_sided_ks_ratio_down(scan.max, (uint64_t)n_a * n_b);
+	result->d_minus
+	    = one_sided_ks_ratio_down(-scan.min, (uint64_t)n_a * n_b);
+	result->d_plus_bucket = scan.max_index;
+	result->d_minus_bucket = scan.min_index;
+	return 0;
+}
@@ -0,0 +1,41 @@
+#ifndef ONE_SIDED_KS_HIST_H
+#define ONE_SIDED_KS_HIST_H
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Two-sample statistics over a pair of histograms with the same `k`
+ * buckets, in one pass.
+ *
+ * With `A_i` and `B_i` the number of observations in buckets 0 to i
+ * of `a` and `b`, and `n_a`, `n_b` the totals, we compute the
+ * extremes of n_b A_i - n_a B_i exactly, in integer arithmetic, with
+ * a blocked prefix sum (AVX2 or AVX-512, when available and the
+ * totals are less than 2^31), and only divide by n_a n_b at the end.
+ */
+struct one_sided_ks_hist_result {
+	/* max_i [A_i / n_a - B_i / n_b], rounded down. */
+	double d_plus;
+	/* max_i [B_i / n_b - A_i / n_a], rounded down. */
+	double d_minus;
+	/* The first bucket i that attains `d_plus`. */
+	size_t d_plus_bucket;
+	/* The first bucket i that attains `d_minus`. */
+	size_t d_minus_bucket;
+};
+
+/*
+ * Fills `result` for histograms `a` and `b`, each with `k` buckets.
+ * Returns 0 on success, -1 if `k` is 0, either histogram is empty,
+ * or either total exceeds 2^63.
+ */
+int one_sided_ks_hist_dplus(const uint64_t *a, const uint64_t *b, size_t k,
+    struct one_sided_ks_hist_result *result);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /* !ONE_SIDED_KS_HIST_H */
@@ -0,0 +1,186 @@
+#include "one-sided-ks-hist.h"
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "one-sided-ks-isa.h"
+
+namespace {
+using ::testing::DoubleNear;
+
+struct Extremes {
+	__int128 max;
+	__int128 min;
+	size_t max_bucket;
+	size_t min_bucket;
+	// n_a n_b: dividing by it rounds once, so the exact ratio rounded
+	// down can't be any higher.
+	double den;
+};
+
+// Reference implementation: extremes of n_b A_i - n_a B_i.
+Extremes scan(const std::vector<uint64_t> &a, const std::vector<uint64_t> &b)
+{
+	unsigned __int128 n_a = 0;
+	unsigned __int128 n_b = 0;
+	Extremes ret = { 0, 0, 0, 0, 0 };
+	__int128 sum = 0;
+
+	for (size_t i = 0; i < a.size(); ++i) {
+		n_a += a[i];
+		n_b += b[i];
+	}
+
+	ret.den = double(n_a * n_b);
+	for (size_t i = 0; i < a.size(); ++i) {
+		sum += (__int128)(n_b * a[i]) - (__int128)(n_a * b[i]);
+		if (i == 0 || sum > ret.max) {
+			ret.max = sum;
+			ret.max_bucket = i;
+		}
+
+		if (i == 0 || sum < ret.min) {
+			ret.min = sum;
+			ret.min_bucket = i;
+		}
+	}
+
+	return ret;
+}
+
+TEST(OneSidedKsHist, Invalid)
+{
+	const std::vector<uint64_t> empty(4, 0);
+	const std::vector<uint64_t> one = { 0, 1, 0, 0 };
+	const std::vector<uint64_t> huge = { 1ULL << 63, 1 };
+	struct one_sided_ks_hist_result result;
+
+	EXPECT_EQ(one_sided_ks_hist_dplus(nullptr, nullptr, 0, &result), -1);
+	EXPECT_EQ(one_sided_ks_hist_dplus(
+		      empty.data(), one.data(), one.size(), &result),
+	    -1);
+	EXPECT_EQ(one_sided_ks_hist_dplus(
+		      one.data(), empty.data(), one.size(), &result),
+	    -1);
+	EXPECT_EQ(one_sided_ks_hist_dplus(
+		      huge.data(), one.data(), huge.size(), &result),
+	    -1);
+}
+
+TEST(OneSidedKsHist, Small)
+{
+	// CDFs: a = [.5, .5, 1], b = [.25, .75, 1].
+	const std::vector<uint64_t> a = { 2, 0, 2 };
+	const std::vector<uint64_t> b = { 1, 2, 1 };
+	struct one_sided_ks_hist_result result;
+
+	ASSERT_EQ(one_sided_ks_hist_dplus(a.data(), b.data(), 3, &result), 0);
+	EXPECT_THAT(result.d_plus, DoubleNear(0.25, 1e-15));
+	EXPECT_LE(result.d_plus, 0.25);
+	EXPECT_EQ(result.d_plus_bucket, 0);
+	EXPECT_THAT(result.d_minus, DoubleNear(0.25, 1e-15));
+	EXPECT_LE(result.d_minus, 0.25);
+	EXPECT_EQ(result.d_minus_bucket, 1);
+
+	// Identical histograms: all prefixes are 0, and tie at bucket 0.
+	ASSERT_EQ(one_sided_ks_hist_dplus(a.data(), a.data(), 3, &result), 0);
+	EXPECT_EQ(result.d_plus, 0);
+	EXPECT_EQ(result.d_minus, 0);
+	EXPECT_EQ(result.d_plus_bucket, 0);
+	EXPECT_EQ(result.d_minus_bucket, 0);
+}
+
+// The SIMD kernels must match the reference, including the first
+// bucket that attains each extreme, for sizes that aren't multiples
+// of the vector width.
+TEST(OneSidedKsHist, MatchesScan)
+{
+	std::mt19937_64 rng(42);
+	const one_sided_ks_isa old_limit
+	    = one_sided_ks_isa_set_limit(ONE_SIDED_KS_ISA_SCALAR);
+
+	for (const size_t k :
+	    { 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 63, 64, 65, 129, 1000 }) {
+		for (size_t trial = 0; trial < 100; ++trial) {
+			// Few distinct values, so that ties are common.
+			std::uniform_int_distribution<uint64_t> count(
+			    0, (trial % 2 == 0) ? 2 : 1000);
+			std::vector<uint64_t> a(k);
+			std::vector<uint64_t> b(k);
+
+			for (size_t i = 0; i < k; ++i) {
+				a[i] = count(rng);
+				b[i] = count(rng);
+			}
+
+			a[0] += 1;
+			b[k - 1] += 1;
+
+			const Extremes expected = scan(a, b);
+			const double d_plus = expected.max / expected.den;
+			const double d_minus = -expected.min / expected.den;
+			struct one_sided_ks_hist_result result;
+
+			one_sided_ks_isa_set_limit(ONE_SIDED_KS_ISA_SCALAR);
+			ASSERT_EQ(one_sided_ks_hist_dplus(
+				      a.data(), b.data(), k, &result),
+			    0);
+			EXPECT_THAT(result.d_plus, DoubleNear(d_plus, 1e-15));
+			EXPECT_LE(result.d_plus, d_plus);
+			EXPECT_THAT(
+			    result.d_minus, DoubleNear(d_minus, 1e-15));
+			EXPECT_LE(result.d_minus, d_minus);
+			EXPECT_EQ(
+			    result.d_plus_bucket, expected.max_bucket);
+			EXPECT_EQ(
+			    result.d_minus_bucket, expected.min_bucket);
+
+			// Every SIMD kernel the host supports must agree
+			// exactly.
+			for (int level = ONE_SIDED_KS_ISA_AVX2;
+			     level <= one_sided_ks_isa_supported(); ++level) {
+				struct one_sided_ks_hist_result simd;
+
+				one_sided_ks_isa_set_limit(
+				    one_sided_ks_isa(level));
+				ASSERT_EQ(one_sided_ks_hist_dplus(
+					      a.data(), b.data(), k, &simd),
+				    0);
+				EXPECT_EQ(simd.d_plus, result.d_plus)
+				    << level;
+				EXPECT_EQ(simd.d_minus, result.d_minus)
+				    << level;
+				EXPECT_EQ(simd.d_plus_bucket,
+				    result.d_plus_bucket)
+				    << level;
+				EXPECT_EQ(simd.d_minus_bucket,
+				    result.d_minus_bucket)
+				    << level;
+			}
+		}
+	}
+
+	one_sided_ks_isa_set_limit(old_limit);
+}
+
+// Totals of 2^31 or more take the 128-bit path.
+TEST(OneSidedKsHist, Wide)
+{
+	const std::vector<uint64_t> a = { 1ULL << 40, 1, 3ULL << 40 };
+	const std::vector<uint64_t> b = { 1, 1ULL << 62, 1 };
+	const Extremes expected = scan(a, b);
+	const double d_plus = double(expected.max) / expected.den;
+	const double d_minus = double(-expected.min) / expected.den;
+	struct one_sided_ks_hist_result result;
+
+	ASSERT_EQ(one_sided_ks_hist_dplus(a.data(), b.data(), 3, &result), 0);
+	EXPECT_THAT(result.d_plus, DoubleNear(d_plus, 1e-15));
+	EXPECT_THAT(result.d_minus, DoubleNear(d_minus, 1e-15));
+	EXPECT_GT(result.d_plus, 0.24);
+	EXPECT_EQ(result.d_plus_bucket, 0);
+	EXPECT_EQ(result.d_minus_bucket, 1);
+}
+} // namespace
@@ -0,0 +1,326 @@
+#ifndef ONE_SIDED_KS_INLINE_H
+#define ONE_SIDED_KS_INLINE_H
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Inline versions of the threshold computations in one-sided-ks.c.
+ *
+ * one-sided-ks.c is implemented in terms of these functions, so the
+ * results (and their conservative rounding) are bit-for-bit
+ * identical.  Inlining lets the compiler hoist
+ * `one_sided_ks_inline_log_b_up` out of loops with fixed parameters,
+ * and vectorise the rest when it knows how.
+ *
+ * Unlike the entry points in one-sided-ks.h, nothing here validates
+ * `min_count`: use `one_sided_ks_find_min_count` or
+ * `one_sided_ks_min_count_valid` first.
+ *
+ * Contracting `a * b + c` into an FMA would change results (and void
+ * fdlibm's error bound), so everything here is compiled without FP
+ * contraction, whatever the includer's flags.  GCC won't inline these
+ * functions in code compiled with contraction enabled (its default
+ * for GNU dialects): compile callers with -ffp-contract=off, like the
+ * library.
+ */
+#if defined(__clang__)
+#pragma float_control(push)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+/* sqrt(1/2) rounded up. */
+static const double one_sided_ks_inline_sqrt_half_up = 0.7071067811865476;
+
+/* log 1/2 rounded down = -log 2. */
+static const double one_sided_ks_inline_log_half_down = -0.6931471805599454;
+
+/*
+ * fdlibm's constants for __ieee754_log: ln 2 split in a high part
+ * with trailing zeros (so k ln2_hi is exact) and a low part, and the
+ * coefficients of the minimax polynomial for (log(1 + f) - 2s) / s,
+ * with s = f / (2 + f).
+ */
+static const double one_sided_ks_inline_ln2_hi = 6.93147180369123816490e-01;
+static const double one_sided_ks_inline_ln2_lo = 1.90821492927058770002e-10;
+static const double one_sided_ks_inline_lg1 = 6.666666666666735130e-01;
+static const double one_sided_ks_inline_lg2 = 3.999999999940941908e-01;
+static const double one_sided_ks_inline_lg3 = 2.857142874366239149e-01;
+static const double one_sided_ks_inline_lg4 = 2.222219843214978396e-01;
+static const double one_sided_ks_inline_lg5 = 1.818357216161805012e-01;
+static const double one_sided_ks_inline_lg6 = 1.531383769920937332e-01;
+static const double one_sided_ks_inline_lg7 = 1.479819860511658591e-01;
+
+/*
+ * `one_sided_ks_inline_log` is off by less than 1 ULP (fdlibm's
+ * error analysis).  Stepping 2 ULPs away covers that error even when
+ * the result is next to a power of 2, where ULPs change size.
+ */
+static const uint64_t one_sided_ks_inline_log_error_limit = 2;
+
+/*
+ * Maps doubles to integers such that the integer order matches the
+ * float order, and consecutive floats map to consecutive integers.
+ */
+static inline uint64_t one_sided_ks_inline_float_bits(double x)
+{
+	uint64_t bits;
+	uint64_t mask;
+
+	memcpy(&bits, &x, sizeof(bits));
+	/* extract the sign bit. */
+	mask = (int64_t)bits >> 63;
+	/*
+	 * If negative, flip the significand bits to convert from
+	 * sign-magnitude to 2's complement.
+	 */
+	return bits ^ (mask >> 1);
+}
+
+static inline double one_sided_ks_inline_bits_float(uint64_t bits)
+{
+	double ret;
+	uint64_t mask;
+
+	mask = (int64_t)bits >> 63;
+	/* Undo the bit-flipping above. */
+	bits ^= (mask >> 1);
+	memcpy(&ret, &bits, sizeof(ret));
+	return ret;
+}
+
+static inline double one_sided_ks_inline_next_k(double x, uint64_t delta)
+{
+	return one_sided_ks_inline_bits_float(
+	    one_sided_ks_inline_float_bits(x) + delta);
+}
+
+static inline double one_sided_ks_inline_next(double x)
+{
+	return one_sided_ks_inline_next_k(x, 1);
+}
+
+static inline double one_sided_ks_inline_prev_k(double x, uint64_t delta)
+{
+	return one_sided_ks_inline_bits_float(
+	    one_sided_ks_inline_float_bits(x) - delta);
+}
+
+static inline double one_sided_ks_inline_prev(double x)
+{
+	return one_sided_ks_inline_prev_k(x, 1);
+}
+
+/*
+ * Natural logarithm, transcribed from fdlibm's `__ieee754_log`, so
+ * we don't depend on the quality of the system's libm.  Positive
+ * normal inputs go through the same sequence of operations as the
+ * SIMD kernels in one-sided-ks.c.
+ */
+static inline double one_sided_ks_inline_log(double x)
+{
+	uint64_t bits;
+	int64_t k = 0;
+
+	memcpy(&bits, &x, sizeof(bits));
+	/* Anything but positive normal floats. */
+	if (bits - 0x0010000000000000ULL >= 0x7FE0000000000000ULL) {
+		if ((bits << 1) == 0) {
+			return -HUGE_VAL; /* log(+-0) = -inf */
+		}
+
+		/* NaN for negative x, and x itself for +inf or NaN. */
+		if ((bits >> 63) != 0) {
+			return (x - x) / 0.0;
+		}
+
+		if (bits >= 0x7FF0000000000000ULL) {
+			return x + x;
+		}
+
+		/* Subnormal: scale up to a normal value. */
+		x *= 18014398509481984.0; /* 2^54 */
+		k = -54;
+		memcpy(&bits, &x, sizeof(bits));
+	}
+
+	const uint64_t low_word = bits & 0xFFFFFFFFULL;
+	int64_t hx = (int64_t)(bits >> 32);
+
+	k += (hx >> 20) - 1023;
+	hx &= 0x000FFFFF;
+
+	/* Normalise x or x / 2 to [sqrt(2)/2, sqrt(2)). */
+	const int64_t i = (hx + 0x95F64) & 0x100000;
+	const uint64_t new_bits
+	    = ((uint64_t)(hx | (i ^ 0x3FF00000)) << 32) | low_word;
+	double normalised;
+
+	k += i >> 20;
+	memcpy(&normalised, &new_bits, sizeof(normalised));
+
+	const double f = normalised - 1.0;
+	const double s = f / (2.0 + f);
+	const double dk = (double)k;
+	const double z = s * s;
+	const double w = z * z;
+	const double t1 = w
+	    * (one_sided_ks_inline_lg2
+		+ w
+		    * (one_sided_ks_inline_lg4
+			+ w * one_sided_ks_inline_lg6));
+	const double t2 = z
+	    * (one_sided_ks_inline_lg1
+		+ w
+		    * (one_sided_ks_inline_lg3
+			+ w
+			    * (one_sided_ks_inline_lg5
+				+ w * one_sided_ks_inline_lg7)));
+	const double R = t2 + t1;
+	const double hi = dk * one_sided_ks_inline_ln2_hi;
+	const double lo = dk * one_sided_ks_inline_ln2_lo;
+
+	if (((hx - 0x6147A) | (0x6B851 - hx)) > 0) {
+		const double hfsq = 0.5 * (f * f);
+
+		return hi - ((hfsq - (s * (hfsq + R) + lo)) - f);
+	}
+
+	return hi - ((s * (f - R) - lo) - f);
+}
+
+static inline double one_sided_ks_inline_log_up(double x)
+{
+	return one_sided_ks_inline_next_k(one_sided_ks_inline_log(x),
+	    one_sided_ks_inline_log_error_limit);
+}
+
+static inline double one_sided_ks_inline_log_down(double x)
+{
+	return one_sided_ks_inline_prev_k(one_sided_ks_inline_log(x),
+	    one_sided_ks_inline_log_error_limit);
+}
+
+static inline double one_sided_ks_inline_sqrt_up(double x)
+{
+	/* sqrt is supposed to be rounded correctly. */
+	return one_sided_ks_inline_next(sqrt(x));
+}
+
+/*
+ * b = 1/[eps (min_count - 1)]
+ *
+ * log(b) = -log(eps) - log(min_count - 1), rounded up.
+ */
+static inline double one_sided_ks_inline_log_b_up(
+    uint64_t min_count, double log_eps)
+{
+	return one_sided_ks_inline_next(
+	    -one_sided_ks_inline_log_down(min_count - 1.0) - log_eps);
+}
+
+/*
+ * f(x) = ((x + 1)(2 log x + log b))^1/2, rounded up, for the
+ * two-sample case.
+ */
+static inline double one_sided_ks_inline_pair_f_up(double x, double log_b_up)
+{
+	/* Exact up to 2^53. */
+	const double xp1 = x + 1;
+	/*
+	 * compute f(x)^2 = (x + 1)(2 log x + log b).
+	 *
+	 * x = 1 is exact, and so is the multiplication by 2.
+	 */
+	const double f_x2 = one_sided_ks_inline_next(xp1
+	    * one_sided_ks_inline_next(
+		2 * one_sided_ks_inline_log_up(x) + log_b_up));
+
+	return one_sided_ks_inline_sqrt_up(f_x2);
+}
+
+/*
+ * f(x) / x, rounded up for the two-sample case.
+ */
+static inline double one_sided_ks_inline_threshold_up(
+    double x, double log_b_up)
+{
+	return one_sided_ks_inline_next(
+	    one_sided_ks_inline_pair_f_up(x, log_b_up) / x);
+}
+
+/*
+ * f(x) / x, where f(x) = (x (2 log x + log b))^1/2 for one-sample.
+ *
+ * We work with P[D+(n) >= r / n] <= exp[-2 r^2 / n], so it suffices
+ * for f^2(x) / n = 2 log x + log b.
+ */
+static inline double one_sided_ks_inline_distribution_threshold_up(
+    double x, double log_b_up)
+{
+	/*
+	 * compute f(x)^2 = x (2 log x + log b).
+	 *
+	 * x = 1 is exact, and so is the multiplication by 2.
+	 */
+	const double f_x2 = one_sided_ks_inline_next(x
+	    * one_sided_ks_inline_next(
+		2 * one_sided_ks_inline_log_up(x) + log_b_up));
+
+	return one_sided_ks_inline_next(one_sided_ks_inline_sqrt_half_up
+	    * one_sided_ks_inline_next(
+		one_sided_ks_inline_sqrt_up(f_x2) / x));
+}
+
+/* Same as `one_sided_ks_pair_threshold_fast`. */
+static inline double one_sided_ks_inline_pair_threshold_fast(
+    uint64_t n, uint64_t min_count, double log_eps)
+{
+	if (n < min_count) {
+		return HUGE_VAL;
+	}
+
+	if (log_eps >= 0) {
+		return -HUGE_VAL;
+	}
+
+	if (log_eps > one_sided_ks_inline_log_half_down) {
+		log_eps = one_sided_ks_inline_log_half_down;
+	}
+
+	return one_sided_ks_inline_threshold_up(
+	    n, one_sided_ks_inline_log_b_up(min_count, log_eps));
+}
+
+/* Same as `one_sided_ks_distribution_threshold_fast`. */
+static inline double one_sided_ks_inline_distribution_threshold_fast(
+    uint64_t n, uint64_t min_count, double log_eps)
+{
+	if (n < min_count) {
+		return HUGE_VAL;
+	}
+
+	if (log_eps >= 0) {
+		return -HUGE_VAL;
+	}
+
+	return one_sided_ks_inline_distribution_threshold_up(
+	    n, one_sided_ks_inline_log_b_up(min_count, log_eps));
+}
+
+#if defined(__clang__)
+#pragma float_control(pop)
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /* !ONE_SIDED_KS_INLINE_H */
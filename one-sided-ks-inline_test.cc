@@ -0,0 +1,114 @@
+#include "one-sided-ks-inline.h"
+
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "one-sided-ks.h"
+
+namespace {
+// Error of `actual` wrt log(x), in ULPs of the result.
+long double log_error_ulps(double x, double actual)
+{
+	const long double expected = std::log((long double)x);
+	const double rounded = expected;
+	const double magnitude = std::fabs(rounded);
+	const double ulp = std::nextafter(magnitude, HUGE_VAL) - magnitude;
+
+	return std::fabs(actual - expected) / ulp;
+}
+
+void expect_log_ok(double x)
+{
+	const double actual = one_sided_ks_inline_log(x);
+	const long double expected = std::log((long double)x);
+
+	EXPECT_LT(log_error_ulps(x, actual), 1.0) << x;
+	EXPECT_GE(one_sided_ks_inline_log_up(x), expected) << x;
+	EXPECT_LE(one_sided_ks_inline_log_down(x), expected) << x;
+}
+
+// fdlibm's log is off by less than 1 ULP, and the directed versions
+// bracket the exact value.
+TEST(OneSidedKsInline, Log)
+{
+	std::mt19937_64 rng(1);
+	std::uniform_real_distribution<double> exponent(-1070, 1020);
+	std::uniform_real_distribution<double> near_one(0.5, 2.0);
+
+	for (size_t i = 0; i < 1000000; ++i) {
+		expect_log_ok(std::exp2(exponent(rng)));
+		expect_log_ok(near_one(rng));
+		expect_log_ok(i + 1.0);
+	}
+
+	const double edge_cases[] = { DBL_MIN, std::ldexp(1.0, -1074),
+		DBL_MAX, 1.0, std::nextafter(1.0, 0), std::nextafter(1.0, 2),
+		2.0, std::sqrt(2.0), std::ldexp(1.0, 53) + 1,
+		std::ldexp(1.0, 64) };
+	for (const double x : edge_cases) {
+		expect_log_ok(x);
+	}
+
+	EXPECT_EQ(one_sided_ks_inline_log(1.0), 0);
+	EXPECT_EQ(one_sided_ks_inline_log(0.0), -HUGE_VAL);
+	EXPECT_EQ(one_sided_ks_inline_log(-0.0), -HUGE_VAL);
+	EXPECT_EQ(one_sided_ks_inline_log(HUGE_VAL), HUGE_VAL);
+	EXPECT_TRUE(std::isnan(one_sided_ks_inline_log(-1.0)));
+	EXPECT_TRUE(std::isnan(one_sided_ks_inline_log(-HUGE_VAL)));
+	EXPECT_TRUE(std::isnan(one_sided_ks_inline_log(NAN)));
+}
+
+void expect_match(uint64_t n, uint64_t min_count, double log_eps)
+{
+	EXPECT_EQ(
+	    one_sided_ks_inline_pair_threshold_fast(n, min_count, log_eps),
+	    one_sided_ks_pair_threshold_fast(n, min_count, log_eps));
+	EXPECT_EQ(one_sided_ks_inline_distribution_threshold_fast(
+		      n, min_count, log_eps),
+	    one_sided_ks_distribution_threshold_fast(n, min_count, log_eps));
+}
+
+// The inline versions must match the library bit for bit.
+TEST(OneSidedKsInline, MatchesLibrary)
+{
+	for (const double eps : { 0.5, 0.05, 1e-3, 1e-6, 1e-12, 1e-100 }) {
+		const double log_eps = std::log(eps);
+		const uint64_t m = one_sided_ks_find_min_count(log_eps);
+
+		for (uint64_t n = 0; n < (1ULL << 62); n = 2 * n + 1) {
+			expect_match(n, m, log_eps);
+			expect_match(n, 10 * m, log_eps);
+		}
+	}
+
+	expect_match(100, 10, 0);
+}
+
+// With the parameters fixed, log_b_up can be computed once.
+TEST(OneSidedKsInline, HoistedLoop)
+{
+	const double log_eps = std::log(1e-6);
+	const uint64_t min_count = one_sided_ks_find_min_count(log_eps);
+	const double log_b_up
+	    = one_sided_ks_inline_log_b_up(min_count, log_eps);
+	std::vector<double> thresholds(1000);
+
+	for (size_t i = 0; i < thresholds.size(); ++i) {
+		thresholds[i] = one_sided_ks_inline_threshold_up(
+		    min_count + i, log_b_up);
+	}
+
+	for (size_t i = 0; i < thresholds.size(); ++i) {
+		EXPECT_EQ(thresholds[i],
+		    one_sided_ks_pair_threshold(
+			min_count + i, min_count, log_eps));
+		EXPECT_EQ(one_sided_ks_inline_distribution_threshold_up(
+			      min_count + i, log_b_up),
+		    one_sided_ks_distribution_threshold(
+			min_count + i, min_count, log_eps));
+	}
+}
+} // namespace
@@ -0,0 +1,34 @@
+#include "one-sided-ks-isa.h"
+
+static enum one_sided_ks_isa isa_limit = ONE_SIDED_KS_ISA_AVX512;
+
+enum one_sided_ks_isa one_sided_ks_isa_supported(void)
+{
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")
+	    && __builtin_cpu_supports("avx512dq")) {
+		return ONE_SIDED_KS_ISA_AVX512;
+	}
+
+	if (__builtin_cpu_supports("avx2")) {
+		return ONE_SIDED_KS_ISA_AVX2;
+	}
+#endif
+
+	return ONE_SIDED_KS_ISA_SCALAR;
+}
+
+enum one_sided_ks_isa one_sided_ks_isa_get(void)
+{
+	const enum one_sided_ks_isa supported = one_sided_ks_isa_supported();
+	const enum one_sided_ks_isa limit
+	    = __atomic_load_n(&isa_limit, __ATOMIC_RELAXED);
+
+	return (supported < limit) ? supported : limit;
+}
+
+enum one_sided_ks_isa one_sided_ks_isa_set_limit(enum one_sided_ks_isa limit)
+{
+	return __atomic_exchange_n(&isa_limit, limit, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,40 @@
+#ifndef ONE_SIDED_KS_ISA_H
+#define ONE_SIDED_KS_ISA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Internal helper for the SIMD kernels: picks the instruction set
+ * level once for all dispatchers, and lets tests force lower levels,
+ * so every kernel available on the host can be compared with the
+ * scalar code.
+ */
+enum one_sided_ks_isa {
+	ONE_SIDED_KS_ISA_SCALAR = 0,
+	/* AVX2. */
+	ONE_SIDED_KS_ISA_AVX2 = 1,
+	/* AVX-512 F and DQ. */
+	ONE_SIDED_KS_ISA_AVX512 = 2,
+};
+
+/* Returns the best level the CPU supports, ignoring the limit. */
+enum one_sided_ks_isa one_sided_ks_isa_supported(void);
+
+/*
+ * Returns the level kernels should use: the best level the CPU
+ * supports, but no higher than the limit.
+ */
+enum one_sided_ks_isa one_sided_ks_isa_get(void);
+
+/*
+ * Caps the level returned by `one_sided_ks_isa_get` at `limit`, and
+ * returns the previous limit.  For tests only: the limit is global,
+ * and not synchronised with concurrent calls to the kernels.
+ */
+enum one_sided_ks_isa one_sided_ks_isa_set_limit(enum one_sided_ks_isa limit);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /* !ONE_SIDED_KS_ISA_H */
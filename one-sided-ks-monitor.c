@@ -0,0 +1,344 @@
+#include "one-sided-ks-monitor.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "one-sided-ks-ecdf.h"
+#include "one-sided-ks.h"
+
+enum state {
+	/* The id is on the free list. */
+	STATE_FREE = 0,
+	/* Counting pairs until `next_check`. */
+	STATE_IDLE,
+	/* Queued in `due`. */
+	STATE_DUE,
+	/* Rejected; ignores new pairs. */
+	STATE_DECIDED,
+	/* Removed while queued: freed by the next poll. */
+	STATE_REMOVED,
+};
+
+/* Sort key that groups due tests by threshold parameters. */
+struct batch_key {
+	double log_eps;
+	uint64_t min_count;
+	size_t test;
+};
+
+struct one_sided_ks_monitor {
+	/* Number of test ids, including free ones. */
+	size_t num_tests;
+	size_t capacity;
+
+	/* Per-test state. */
+	struct one_sided_ks_ecdf **ecdf;
+	size_t *num_buckets;
+	uint64_t *min_count;
+	double *log_eps;
+	uint64_t *n;
+	uint64_t *next_check;
+	uint8_t *state;
+
+	/* Tests with STATE_DUE or STATE_REMOVED, each exactly once. */
+	size_t *due;
+	size_t num_due;
+
+	size_t *free_ids;
+	size_t num_free;
+
+	/* Scratch space for batched thresholds. */
+	struct batch_key *batch_key;
+	uint64_t *batch_n;
+	double *batch_threshold;
+};
+
+struct one_sided_ks_monitor *one_sided_ks_monitor_create(void)
+{
+	return calloc(1, sizeof(struct one_sided_ks_monitor));
+}
+
+void one_sided_ks_monitor_destroy(struct one_sided_ks_monitor *monitor)
+{
+	if (monitor == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < monitor->num_tests; ++i) {
+		one_sided_ks_ecdf_destroy(monitor->ecdf[i]);
+	}
+
+	free(monitor->ecdf);
+	free(monitor->num_buckets);
+	free(monitor->min_count);
+	free(monitor->log_eps);
+	free(monitor->n);
+	free(monitor->next_check);
+	free(monitor->state);
+	free(monitor->due);
+	free(monitor->free_ids);
+	free(monitor->batch_key);
+	free(monitor->batch_n);
+	free(monitor->batch_threshold);
+	free(monitor);
+}
+
+/*
+ * Doubles the capacity of every per-test array.  On failure, the
+ * arrays that were already reallocated remain valid, just larger than
+ * `capacity` requires.
+ */
+static int grow(struct one_sided_ks_monitor *monitor)
+{
+	const size_t capacity
+	    = (monitor->capacity == 0) ? 16 : 2 * monitor->capacity;
+
+	if (capacity > SIZE_MAX / sizeof(struct batch_key)) {
+		return -1;
+	}
+
+#define GROW(FIELD)                                                          \
+	do {                                                                 \
+		void *grown = realloc(                                       \
+		    monitor->FIELD, capacity * sizeof(*monitor->FIELD));     \
+		if (grown == NULL) {                                         \
+			return -1;                                           \
+		}                                                            \
+                                                                             \
+		monitor->FIELD = grown;                                      \
+	} while (0)
+
+	GROW(ecdf);
+	GROW(num_buckets);
+	GROW(min_count);
+	GROW(log_eps);
+	GROW(n);
+	GROW(next_check);
+	GROW(state);
+	GROW(due);
+	GROW(free_ids);
+	GROW(batch_key);
+	GROW(batch_n);
+	GROW(batch_threshold);
+#undef GROW
+
+	monitor->capacity = capacity;
+	return 0;
+}
+
+int one_sided_ks_monitor_add(struct one_sided_ks_monitor *monitor,
+    size_t num_buckets, uint64_t min_count, double log_eps, size_t *test)
+{
+	struct one_sided_ks_ecdf *ecdf;
+	size_t id;
+
+	if (num_buckets == 0 || !(log_eps < 0)
+	    || !one_sided_ks_min_count_valid(min_count, log_eps)) {
+		return -1;
+	}
+
+	if (monitor->num_free == 0 && monitor->num_tests == monitor->capacity
+	    && grow(monitor) != 0) {
+		return -1;
+	}
+
+	ecdf = one_sided_ks_ecdf_create(num_buckets);
+	if (ecdf == NULL) {
+		return -1;
+	}
+
+	if (monitor->num_free > 0) {
+		id = monitor->free_ids[--monitor->num_free];
+	} else {
+		id = monitor->num_tests++;
+	}
+
+	monitor->ecdf[id] = ecdf;
+	monitor->num_buckets[id] = num_buckets;
+	monitor->min_count[id] = min_count;
+	monitor->log_eps[id] = log_eps;
+	monitor->n[id] = 0;
+	monitor->next_check[id]
+	    = one_sided_ks_pair_next_check(0, 0, min_count, log_eps);
+	monitor->state[id] = STATE_IDLE;
+	*test = id;
+	return 0;
+}
+
+static void release(struct one_sided_ks_monitor *monitor, size_t test)
+{
+	monitor->state[test] = STATE_FREE;
+	monitor->free_ids[monitor->num_free++] = test;
+}
+
+int one_sided_ks_monitor_remove(
+    struct one_sided_ks_monitor *monitor, size_t test)
+{
+	if (test >= monitor->num_tests) {
+		return -1;
+	}
+
+	switch (monitor->state[test]) {
+	case STATE_IDLE:
+	case STATE_DECIDED:
+		release(monitor, test);
+		break;
+	case STATE_DUE:
+		/* The id can't be reused while it's in `due`. */
+		monitor->state[test] = STATE_REMOVED;
+		break;
+	default:
+		return -1;
+	}
+
+	one_sided_ks_ecdf_destroy(monitor->ecdf[test]);
+	monitor->ecdf[test] = NULL;
+	return 0;
+}
+
+size_t one_sided_ks_monitor_ingest(struct one_sided_ks_monitor *monitor,
+    const struct one_sided_ks_monitor_pair *pairs, size_t count)
+{
+	size_t ret = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		const size_t test = pairs[i].test;
+
+		if (test >= monitor->num_tests
+		    || (monitor->state[test] != STATE_IDLE
+			&& monitor->state[test] != STATE_DUE)
+		    || pairs[i].a_bucket >= monitor->num_buckets[test]
+		    || pairs[i].b_bucket >= monitor->num_buckets[test]) {
+			continue;
+		}
+
+		one_sided_ks_ecdf_add_pair(monitor->ecdf[test],
+		    pairs[i].a_bucket, pairs[i].b_bucket);
+		++ret;
+		if (++monitor->n[test] >= monitor->next_check[test]
+		    && monitor->state[test] == STATE_IDLE) {
+			monitor->state[test] = STATE_DUE;
+			monitor->due[monitor->num_due++] = test;
+		}
+	}
+
+	return ret;
+}
+
+static int cmp_batch_key(const void *x, const void *y)
+{
+	const struct batch_key *a = x;
+	const struct batch_key *b = y;
+
+	if (a->log_eps != b->log_eps) {
+		return (a->log_eps < b->log_eps) ? -1 : 1;
+	}
+
+	if (a->min_count != b->min_count) {
+		return (a->min_count < b->min_count) ? -1 : 1;
+	}
+
+	return (a->test > b->test) - (a->test < b->test);
+}
+
+/*
+ * Checks the `count` tests in `tests`, and returns the number of
+ * rejections written to `out`.
+ */
+static size_t check(struct one_sided_ks_monitor *monitor,
+    const size_t *tests, size_t count,
+    struct one_sided_ks_monitor_decision *out)
+{
+	struct batch_key *batch_key = monitor->batch_key;
+	uint64_t *batch_n = monitor->batch_n;
+	double *batch_threshold = monitor->batch_threshold;
+	size_t ret = 0;
+
+	/*
+	 * Tests become due in ingest order, which interleaves parameter
+	 * levels; sort so that each level is a single batch.  Removed
+	 * tests keep their old parameters, so batches stay valid.
+	 */
+	for (size_t i = 0; i < count; ++i) {
+		batch_key[i] = (struct batch_key) {
+			.log_eps = monitor->log_eps[tests[i]],
+			.min_count = monitor->min_count[tests[i]],
+			.test = tests[i],
+		};
+	}
+
+	qsort(batch_key, count, sizeof(*batch_key), cmp_batch_key);
+	for (size_t i = 0; i < count; ++i) {
+		batch_n[i] = monitor->n[batch_key[i].test];
+	}
+
+	for (size_t begin = 0, end; begin < count; begin = end) {
+		const uint64_t min_count = batch_key[begin].min_count;
+		const double log_eps = batch_key[begin].log_eps;
+
+		end = begin + 1;
+		while (end < count && batch_key[end].min_count == min_count
+		    && batch_key[end].log_eps == log_eps) {
+			++end;
+		}
+
+		one_sided_ks_pair_threshold_batch(&batch_n[begin],
+		    end - begin, min_count, log_eps, &batch_threshold[begin]);
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		const size_t test = batch_key[i].test;
+
+		if (monitor->state[test] == STATE_REMOVED) {
+			release(monitor, test);
+			continue;
+		}
+
+		const double d_plus
+		    = one_sided_ks_ecdf_d_plus(monitor->ecdf[test]);
+
+		if (d_plus > batch_threshold[i]) {
+			out[ret++] = (struct one_sided_ks_monitor_decision) {
+				.test = test,
+				.n = batch_n[i],
+				.d_plus = d_plus,
+				.threshold = batch_threshold[i],
+			};
+			monitor->state[test] = STATE_DECIDED;
+			continue;
+		}
+
+		monitor->next_check[test] = one_sided_ks_pair_next_check(
+		    batch_n[i], d_plus, monitor->min_count[test],
+		    monitor->log_eps[test]);
+		monitor->state[test] = STATE_IDLE;
+	}
+
+	return ret;
+}
+
+size_t one_sided_ks_monitor_poll(struct one_sided_ks_monitor *monitor,
+    struct one_sided_ks_monitor_decision *out, size_t capacity)
+{
+	size_t ret = 0;
+
+	/* Each test yields at most one rejection, so `out` can't overflow. */
+	while (monitor->num_due > 0 && ret < capacity) {
+		const size_t count = (monitor->num_due < capacity - ret)
+		    ? monitor->num_due
+		    : capacity - ret;
+
+		monitor->num_due -= count;
+		ret += check(monitor, &monitor->due[monitor->num_due], count,
+		    &out[ret]);
+	}
+
+	return ret;
+}
+
+size_t one_sided_ks_monitor_num_due(
+    const struct one_sided_ks_monitor *monitor)
+{
+	return monitor->num_due;
+}
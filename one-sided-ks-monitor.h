@@ -0,0 +1,85 @@
+#ifndef ONE_SIDED_KS_MONITOR_H
+#define ONE_SIDED_KS_MONITOR_H
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Many concurrent paired two-sample tests.
+ *
+ * Each test has its own `one_sided_ks_ecdf`, `min_count` and
+ * `log_eps`, and the monitor keeps per-test state in parallel
+ * arrays, indexed by test id.  Pairs of observations are counted as
+ * they are ingested, but the threshold is only evaluated once a test
+ * reaches its `one_sided_ks_pair_next_check` sample size: until then,
+ * it can't possibly reject.  Tests that reach that size are queued,
+ * and `one_sided_ks_monitor_poll` only looks at queued tests: it sorts
+ * them by `log_eps` and `min_count`, and calls
+ * `one_sided_ks_pair_threshold_batch` once for all queued tests that
+ * share both, regardless of the order in which they became due.  The
+ * cost of a poll is thus proportional to the number of tests that
+ * could have rejected (times a log factor for the sort).
+ *
+ * A test stops counting pairs once it rejects, until it's removed.
+ * Test ids of removed tests are reused.  Monitors are not
+ * thread-safe.
+ */
+struct one_sided_ks_monitor;
+
+struct one_sided_ks_monitor_pair {
+	size_t test;
+	size_t a_bucket;
+	size_t b_bucket;
+};
+
+struct one_sided_ks_monitor_decision {
+	size_t test;
+	/* Number of pairs when the test rejected. */
+	uint64_t n;
+	double d_plus;
+	double threshold;
+};
+
+/* Returns a new monitor without any test, or NULL on failure. */
+struct one_sided_ks_monitor *one_sided_ks_monitor_create(void);
+
+void one_sided_ks_monitor_destroy(struct one_sided_ks_monitor *monitor);
+
+/*
+ * Adds a test over `num_buckets` buckets, and stores its id in
+ * `test`.  Returns 0 on success, -1 if `min_count` isn't valid for
+ * `log_eps`, or on allocation failure.
+ */
+int one_sided_ks_monitor_add(struct one_sided_ks_monitor *monitor,
+    size_t num_buckets, uint64_t min_count, double log_eps, size_t *test);
+
+/* Removes `test`.  Returns 0 on success, -1 if there's no such test. */
+int one_sided_ks_monitor_remove(
+    struct one_sided_ks_monitor *monitor, size_t test);
+
+/*
+ * Counts `count` pairs of observations, and returns how many were
+ * counted.  Pairs for tests that don't exist or have already
+ * rejected, and pairs with out-of-range buckets, are ignored.
+ */
+size_t one_sided_ks_monitor_ingest(struct one_sided_ks_monitor *monitor,
+    const struct one_sided_ks_monitor_pair *pairs, size_t count);
+
+/*
+ * Checks queued tests, and writes up to `capacity` rejections to
+ * `out`.  Returns the number of rejections written; when that's
+ * `capacity`, more tests may still be queued.
+ */
+size_t one_sided_ks_monitor_poll(struct one_sided_ks_monitor *monitor,
+    struct one_sided_ks_monitor_decision *out, size_t capacity);
+
+/* Returns the number of tests queued for the next poll. */
+size_t one_sided_ks_monitor_num_due(
+    const struct one_sided_ks_monitor *monitor);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /* !ONE_SIDED_KS_MONITOR_H */
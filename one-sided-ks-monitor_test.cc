@@ -0,0 +1,297 @@
+#include "one-sided-ks-monitor.h"
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "one-sided-ks-ecdf.h"
+#include "one-sided-ks.h"
+
+namespace {
+const double kLogEps = std::log(1e-4);
+const uint64_t kMinCount = one_sided_ks_find_min_count(kLogEps);
+const size_t kNumBuckets = 20;
+
+// B is shifted up by `shift` buckets in a fraction `rate` of pairs.
+one_sided_ks_monitor_pair make_pair(
+    std::mt19937_64 *rng, size_t test, double rate, size_t shift)
+{
+	std::uniform_int_distribution<size_t> bucket(
+	    0, kNumBuckets - 1 - shift);
+	std::bernoulli_distribution shifted(rate);
+	one_sided_ks_monitor_pair ret;
+
+	ret.test = test;
+	ret.a_bucket = bucket(*rng);
+	ret.b_bucket = bucket(*rng) + (shifted(*rng) ? shift : 0);
+	return ret;
+}
+
+TEST(OneSidedKsMonitor, Invalid)
+{
+	one_sided_ks_monitor *monitor = one_sided_ks_monitor_create();
+	size_t test;
+
+	ASSERT_NE(monitor, nullptr);
+	EXPECT_EQ(-1,
+	    one_sided_ks_monitor_add(monitor, 0, kMinCount, kLogEps, &test));
+	EXPECT_EQ(-1,
+	    one_sided_ks_monitor_add(
+		monitor, kNumBuckets, 1, kLogEps, &test));
+	EXPECT_EQ(-1, one_sided_ks_monitor_remove(monitor, 0));
+
+	ASSERT_EQ(0,
+	    one_sided_ks_monitor_add(
+		monitor, kNumBuckets, kMinCount, kLogEps, &test));
+
+	// Out-of-range tests and buckets are ignored.
+	const one_sided_ks_monitor_pair pairs[] = {
+		{ test + 1, 0, 0 },
+		{ test, kNumBuckets, 0 },
+		{ test, 0, kNumBuckets },
+		{ test, 0, 0 },
+	};
+	EXPECT_EQ(1, one_sided_ks_monitor_ingest(monitor, pairs, 4));
+
+	one_sided_ks_monitor_destroy(monitor);
+}
+
+// Polling after every pair should reject at the same sample size as
+// checking the threshold after every pair, even though the monitor
+// only checks at next_check.
+TEST(OneSidedKsMonitor, MatchesReference)
+{
+	for (uint64_t seed = 0; seed < 20; ++seed) {
+		std::mt19937_64 rng(seed);
+		one_sided_ks_monitor *monitor = one_sided_ks_monitor_create();
+		one_sided_ks_ecdf *ecdf
+		    = one_sided_ks_ecdf_create(kNumBuckets);
+		size_t test;
+		size_t num_checks = 0;
+		uint64_t expected = UINT64_MAX;
+		uint64_t actual = UINT64_MAX;
+
+		ASSERT_EQ(0,
+		    one_sided_ks_monitor_add(
+			monitor, kNumBuckets, kMinCount, kLogEps, &test));
+		for (uint64_t n = 1; n <= 20000 && actual == UINT64_MAX;
+		     ++n) {
+			const one_sided_ks_monitor_pair pair
+			    = make_pair(&rng, test, 0.3, 5);
+			one_sided_ks_monitor_decision decision;
+
+			one_sided_ks_ecdf_add_pair(
+			    ecdf, pair.a_bucket, pair.b_bucket);
+			if (expected == UINT64_MAX
+			    && one_sided_ks_ecdf_d_plus(ecdf)
+				> one_sided_ks_pair_threshold(
+				    n, kMinCount, kLogEps)) {
+				expected = n;
+			}
+
+			ASSERT_EQ(1,
+			    one_sided_ks_monitor_ingest(monitor, &pair, 1));
+			num_checks += one_sided_ks_monitor_num_due(monitor);
+			if (one_sided_ks_monitor_poll(monitor, &decision, 1)
+			    == 1) {
+				EXPECT_EQ(test, decision.test);
+				EXPECT_EQ(n, decision.n);
+				EXPECT_GT(
+				    decision.d_plus, decision.threshold);
+				actual = n;
+			}
+		}
+
+		ASSERT_NE(expected, UINT64_MAX) << seed;
+		EXPECT_EQ(expected, actual) << seed;
+		EXPECT_LT(num_checks, actual / 4) << seed;
+		one_sided_ks_ecdf_destroy(ecdf);
+		one_sided_ks_monitor_destroy(monitor);
+	}
+}
+
+TEST(OneSidedKsMonitor, ManyTests)
+{
+	const size_t kNumTests = 1000;
+	std::mt19937_64 rng(42);
+	one_sided_ks_monitor *monitor = one_sided_ks_monitor_create();
+	std::vector<size_t> tests;
+	std::set<size_t> decided;
+
+	ASSERT_NE(monitor, nullptr);
+	for (size_t i = 0; i < kNumTests; ++i) {
+		size_t test;
+
+		// Two sets of parameters, interleaved.
+		const double log_eps
+		    = (i % 3 == 0) ? kLogEps : kLogEps - 1;
+		const uint64_t min_count
+		    = one_sided_ks_find_min_count(log_eps);
+
+		ASSERT_EQ(0,
+		    one_sided_ks_monitor_add(
+			monitor, kNumBuckets, min_count, log_eps, &test));
+		tests.push_back(test);
+	}
+
+	// Half the tests have a discrepancy.
+	for (size_t round = 0; round < 200; ++round) {
+		std::vector<one_sided_ks_monitor_pair> pairs;
+		one_sided_ks_monitor_decision decisions[7];
+
+		for (size_t i = 0; i < 100; ++i) {
+			for (const size_t test : tests) {
+				const double rate = (test % 2 == 0) ? 0.5 : 0;
+
+				pairs.push_back(
+				    make_pair(&rng, test, rate, 5));
+			}
+		}
+
+		const size_t counted = one_sided_ks_monitor_ingest(
+		    monitor, pairs.data(), pairs.size());
+		EXPECT_EQ(pairs.size() - 100 * decided.size(), counted);
+
+		size_t num_decisions;
+		do {
+			num_decisions = one_sided_ks_monitor_poll(
+			    monitor, decisions, 7);
+			for (size_t i = 0; i < num_decisions; ++i) {
+				EXPECT_GT(decisions[i].d_plus,
+				    decisions[i].threshold);
+				EXPECT_TRUE(
+				    decided.insert(decisions[i].test).second);
+			}
+		} while (num_decisions == 7);
+
+		EXPECT_EQ(0, one_sided_ks_monitor_num_due(monitor));
+	}
+
+	size_t num_false_positives = 0;
+	for (const size_t test : tests) {
+		if (test % 2 == 0) {
+			EXPECT_EQ(1, decided.count(test)) << test;
+		} else {
+			num_false_positives += decided.count(test);
+		}
+	}
+
+	EXPECT_EQ(0, num_false_positives);
+	one_sided_ks_monitor_destroy(monitor);
+}
+
+// Tests with different parameters become due in ingest order, which
+// interleaves them; a poll must still group them by parameters, and
+// apply each test's own threshold.
+TEST(OneSidedKsMonitor, InterleavedLevels)
+{
+	const double kLevels[] = { kLogEps, kLogEps - 1, kLogEps - 2 };
+	const size_t kNumTests = 30;
+	std::mt19937_64 rng(7);
+	one_sided_ks_monitor *monitor = one_sided_ks_monitor_create();
+	std::vector<double> log_eps;
+	std::vector<uint64_t> min_count;
+	std::vector<one_sided_ks_monitor_pair> pairs;
+	std::vector<one_sided_ks_monitor_decision> decisions(kNumTests);
+
+	ASSERT_NE(monitor, nullptr);
+	for (size_t i = 0; i < kNumTests; ++i) {
+		size_t test;
+
+		log_eps.push_back(kLevels[i % 3]);
+		min_count.push_back(one_sided_ks_find_min_count(log_eps[i]));
+		ASSERT_EQ(0,
+		    one_sided_ks_monitor_add(monitor, kNumBuckets,
+			min_count[i], log_eps[i], &test));
+		ASSERT_EQ(i, test);
+	}
+
+	// Enough pairs for every test to reject at the first poll.
+	for (size_t round = 0; round < 2000; ++round) {
+		for (size_t test = 0; test < kNumTests; ++test) {
+			pairs.push_back(make_pair(&rng, test, 1, 5));
+		}
+	}
+
+	ASSERT_EQ(pairs.size(),
+	    one_sided_ks_monitor_ingest(monitor, pairs.data(), pairs.size()));
+	ASSERT_EQ(kNumTests,
+	    one_sided_ks_monitor_poll(
+		monitor, decisions.data(), decisions.size()));
+	for (size_t i = 0; i < kNumTests; ++i) {
+		const size_t test = decisions[i].test;
+
+		EXPECT_DOUBLE_EQ(decisions[i].threshold,
+		    one_sided_ks_pair_threshold(
+			decisions[i].n, min_count[test], log_eps[test]))
+		    << test;
+		EXPECT_GT(decisions[i].d_plus, decisions[i].threshold);
+		if (i > 0) {
+			EXPECT_LE(log_eps[decisions[i - 1].test],
+			    log_eps[test]);
+		}
+	}
+
+	one_sided_ks_monitor_destroy(monitor);
+}
+
+TEST(OneSidedKsMonitor, Remove)
+{
+	std::mt19937_64 rng(1);
+	one_sided_ks_monitor *monitor = one_sided_ks_monitor_create();
+	size_t x;
+	size_t y;
+	size_t z;
+
+	ASSERT_NE(monitor, nullptr);
+	ASSERT_EQ(0,
+	    one_sided_ks_monitor_add(
+		monitor, kNumBuckets, kMinCount, kLogEps, &x));
+	ASSERT_EQ(0,
+	    one_sided_ks_monitor_add(
+		monitor, kNumBuckets, kMinCount, kLogEps, &y));
+
+	// Get x queued, then remove it: its id is only reused after the
+	// next poll.
+	std::vector<one_sided_ks_monitor_pair> pairs;
+	for (uint64_t i = 0; i < kMinCount; ++i) {
+		pairs.push_back(make_pair(&rng, x, 0, 0));
+	}
+
+	EXPECT_EQ(kMinCount,
+	    one_sided_ks_monitor_ingest(monitor, pairs.data(), pairs.size()));
+	EXPECT_EQ(1, one_sided_ks_monitor_num_due(monitor));
+	ASSERT_EQ(0, one_sided_ks_monitor_remove(monitor, x));
+	EXPECT_EQ(-1, one_sided_ks_monitor_remove(monitor, x));
+	EXPECT_EQ(0,
+	    one_sided_ks_monitor_ingest(monitor, pairs.data(), pairs.size()));
+
+	ASSERT_EQ(0,
+	    one_sided_ks_monitor_add(
+		monitor, kNumBuckets, kMinCount, kLogEps, &z));
+	EXPECT_NE(x, z);
+	EXPECT_NE(y, z);
+
+	one_sided_ks_monitor_decision decision;
+	EXPECT_EQ(0, one_sided_ks_monitor_poll(monitor, &decision, 1));
+	EXPECT_EQ(0, one_sided_ks_monitor_num_due(monitor));
+
+	size_t w;
+	ASSERT_EQ(0,
+	    one_sided_ks_monitor_add(
+		monitor, kNumBuckets, kMinCount, kLogEps, &w));
+	EXPECT_EQ(x, w);
+
+	// The new test starts from scratch.
+	EXPECT_EQ(kMinCount - 1,
+	    one_sided_ks_monitor_ingest(
+		monitor, pairs.data(), pairs.size() - 1));
+	EXPECT_EQ(0, one_sided_ks_monitor_num_due(monitor));
+
+	ASSERT_EQ(0, one_sided_ks_monitor_remove(monitor, y));
+	one_sided_ks_monitor_destroy(monitor);
+}
+} // namespace
@@ -0,0 +1,411 @@
+#include "one-sided-ks-pit.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "one-sided-ks-ratio.h"
+
+/* Keep k * n (and differences of such values) within int64_t. */
+#define MAX_SCALED_COUNT ((uint64_t)1 << 62)
+
+/* The value of a prefix is intercept - n * length. */
+struct line {
+	int64_t intercept;
+	int64_t length;
+};
+
+struct node {
+	/* k * the number of observations in the node's buckets. */
+	int64_t sum;
+	/* The non-empty prefixes with extreme value for the current n. */
+	struct line max;
+	struct line min;
+	/* The least n for which `max` or `min` may be stale. */
+	uint64_t melt;
+};
+
+/* Linearly interpolated CDF, for `one_sided_ks_pit_create_table`. */
+struct table {
+	size_t count;
+	double *values;
+	double *probabilities;
+};
+
+struct one_sided_ks_pit {
+	size_t num_buckets;
+	uint64_t total;
+	one_sided_ks_cdf_fn *cdf;
+	void *context;
+	struct table table;
+	uint64_t *counts;
+	/*
+	 * Binary tree over [0, num_buckets): the root is at index 1,
+	 * and node i's children are at 2i and 2i + 1, and split its
+	 * range [l, r) at l + (r - l) / 2.
+	 */
+	struct node *tree;
+};
+
+static uint64_t min_u64(uint64_t x, uint64_t y)
+{
+	return (x < y) ? x : y;
+}
+
+static int64_t line_value(const struct line *line, uint64_t n)
+{
+	return line->intercept - (int64_t)n * line->length;
+}
+
+static void set_leaf(
+    struct one_sided_ks_pit *pit, size_t index, size_t bucket)
+{
+	struct node *node = &pit->tree[index];
+
+	node->sum = (int64_t)(pit->num_buckets * pit->counts[bucket]);
+	node->max.intercept = node->sum;
+	node->max.length = 1;
+	node->min = node->max;
+	node->melt = UINT64_MAX;
+}
+
+/*
+ * Recomputes node `index` from its children, where the left child
+ * covers `left_length` buckets.
+ *
+ * The prefixes that extend into the right child have a longer
+ * length, so they lose ground to the left child's as n grows: the
+ * maximum may switch from right to left, and the minimum from left
+ * to right, but never back until a child changes.
+ */
+static void recompute(
+    struct one_sided_ks_pit *pit, size_t index, int64_t left_length)
+{
+	struct node *node = &pit->tree[index];
+	const struct node *left = &pit->tree[2 * index];
+	const struct node *right = &pit->tree[2 * index + 1];
+	const int64_t n = (int64_t)pit->total;
+	const struct line max_right = {
+		.intercept = left->sum + right->max.intercept,
+		.length = left_length + right->max.length,
+	};
+	const struct line min_right = {
+		.intercept = left->sum + right->min.intercept,
+		.length = left_length + right->min.length,
+	};
+	uint64_t melt = min_u64(left->melt, right->melt);
+
+	node->sum = left->sum + right->sum;
+
+	{
+		/* The right line is better iff delta > n * slope. */
+		const int64_t delta
+		    = max_right.intercept - left->max.intercept;
+		const int64_t slope = max_right.length - left->max.length;
+
+		if (delta > n * slope) {
+			node->max = max_right;
+			/* First n with delta <= n * slope. */
+			melt = min_u64(melt, (delta + slope - 1) / slope);
+		} else {
+			node->max = left->max;
+		}
+	}
+
+	{
+		/* The left line is (weakly) better iff delta >= n * slope. */
+		const int64_t delta
+		    = min_right.intercept - left->min.intercept;
+		const int64_t slope = min_right.length - left->min.length;
+
+		if (delta >= n * slope) {
+			node->min = left->min;
+			/* First n with delta < n * slope. */
+			melt = min_u64(melt, delta / slope + 1);
+		} else {
+			node->min = min_right;
+		}
+	}
+
+	node->melt = melt;
+}
+
+/*
+ * Refreshes the subtree at `index`, covering [l, r), after `bucket`
+ * changed and/or the total count increased.  We only visit subtrees
+ * that contain `bucket`, or that may have a new extreme line.
+ */
+static void update(struct one_sided_ks_pit *pit, size_t index, size_t l,
+    size_t r, size_t bucket)
+{
+	const bool contains = (l <= bucket && bucket < r);
+	const size_t mid = l + (r - l) / 2;
+
+	if (r - l == 1) {
+		if (contains) {
+			set_leaf(pit, index, bucket);
+		}
+
+		return;
+	}
+
+	if (!contains && pit->tree[index].melt > pit->total) {
+		return;
+	}
+
+	update(pit, 2 * index, l, mid, bucket);
+	update(pit, 2 * index + 1, mid, r, bucket);
+	recompute(pit, index, mid - l);
+}
+
+static void build(struct one_sided_ks_pit *pit, size_t index, size_t l,
+    size_t r)
+{
+	const size_t mid = l + (r - l) / 2;
+
+	if (r - l == 1) {
+		set_leaf(pit, index, l);
+		return;
+	}
+
+	build(pit, 2 * index, l, mid);
+	build(pit, 2 * index + 1, mid, r);
+	recompute(pit, index, mid - l);
+}
+
+struct one_sided_ks_pit *one_sided_ks_pit_create(
+    size_t num_buckets, one_sided_ks_cdf_fn *cdf, void *context)
+{
+	/* We need exact bucket indices in double, and 4k tree nodes. */
+	if (num_buckets == 0 || num_buckets > ((uint64_t)1 << 52)
+	    || num_buckets > SIZE_MAX / (4 * sizeof(struct node))) {
+		return NULL;
+	}
+
+	struct one_sided_ks_pit *pit = calloc(1, sizeof(*pit));
+	if (pit == NULL) {
+		return NULL;
+	}
+
+	pit->num_buckets = num_buckets;
+	pit->cdf = cdf;
+	pit->context = context;
+	pit->counts = calloc(num_buckets, sizeof(uint64_t));
+	pit->tree = calloc(4 * num_buckets, sizeof(struct node));
+	if (pit->counts == NULL || pit->tree == NULL) {
+		one_sided_ks_pit_destroy(pit);
+		return NULL;
+	}
+
+	build(pit, 1, 0, num_buckets);
+	return pit;
+}
+
+static double table_cdf(double x, void *context)
+{
+	const struct table *table = context;
+	const double *values = table->values;
+	const double *probabilities = table->probabilities;
+	size_t low = 0;
+	size_t high = table->count - 1;
+
+	if (x != x) {
+		return x;
+	}
+
+	if (x < values[0]) {
+		return probabilities[0];
+	}
+
+	/*
+	 * Repeated values are jumps in F: F(x) is the probability at
+	 * the last repeat (the right limit), not the first.
+	 */
+	if (x >= values[high]) {
+		return probabilities[high];
+	}
+
+	/* Find values[low] <= x < values[high], with high = low + 1. */
+	while (low + 1 < high) {
+		const size_t pivot = low + (high - low) / 2;
+
+		if (values[pivot] <= x) {
+			low = pivot;
+		} else {
+			high = pivot;
+		}
+	}
+
+	const double p_low = probabilities[low];
+	const double p_high = probabilities[high];
+
+	if (x == values[low]) {
+		return p_low;
+	}
+
+	const double fraction
+	    = (x - values[low]) / (values[high] - values[low]);
+	const double ret = p_low + (p_high - p_low) * fraction;
+
+	/* Rounding must not break monotonicity. */
+	return fmin(fmax(ret, p_low), p_high);
+}
+
+struct one_sided_ks_pit *one_sided_ks_pit_create_table(size_t num_buckets,
+    const double *values, const double *probabilities, size_t count)
+{
+	struct one_sided_ks_pit *pit;
+
+	if (count == 0 || count > SIZE_MAX / sizeof(double)) {
+		return NULL;
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		if (!(probabilities[i] >= 0 && probabilities[i] <= 1)
+		    || isnan(values[i])) {
+			return NULL;
+		}
+
+		if (i > 0
+		    && !(values[i - 1] <= values[i]
+			&& probabilities[i - 1] <= probabilities[i])) {
+			return NULL;
+		}
+	}
+
+	pit = one_sided_ks_pit_create(num_buckets, table_cdf, NULL);
+	if (pit == NULL) {
+		return NULL;
+	}
+
+	pit->context = &pit->table;
+	pit->table.count = count;
+	pit->table.values = malloc(count * sizeof(double));
+	pit->table.probabilities = malloc(count * sizeof(double));
+	if (pit->table.values == NULL || pit->table.probabilities == NULL) {
+		one_sided_ks_pit_destroy(pit);
+		return NULL;
+	}
+
+	memcpy(pit->table.values, values, count * sizeof(double));
+	memcpy(pit->table.probabilities, probabilities,
+	    count * sizeof(double));
+	return pit;
+}
+
+void one_sided_ks_pit_destroy(struct one_sided_ks_pit *pit)
+{
+	if (pit == NULL) {
+		return;
+	}
+
+	free(pit->table.values);
+	free(pit->table.probabilities);
+	free(pit->counts);
+	free(pit->tree);
+	free(pit);
+}
+
+size_t one_sided_ks_pit_num_buckets(const struct one_sided_ks_pit *pit)
+{
+	return pit->num_buckets;
+}
+
+/*
+ * floor(u * k), clamped to [0, k).  The bounds need b / k <= u <=
+ * (b + 1) / k exactly, so we fix up the rounded product with fma,
+ * which computes the sign of u * k - b exactly.
+ */
+static size_t find_bucket(const struct one_sided_ks_pit *pit, double u)
+{
+	const double k = pit->num_buckets;
+	double bucket;
+
+	if (!(u > 0)) {
+		return 0;
+	}
+
+	if (u >= 1) {
+		return pit->num_buckets - 1;
+	}
+
+	bucket = floor(u * k);
+	if (fma(u, k, -bucket) < 0) {
+		bucket -= 1;
+	} else if (fma(u, k, -(bucket + 1)) >= 0) {
+		bucket += 1;
+	}
+
+	if (bucket >= k) {
+		return pit->num_buckets - 1;
+	}
+
+	return (size_t)bucket;
+}
+
+int one_sided_ks_pit_add_probability(
+    struct one_sided_ks_pit *pit, double u)
+{
+	size_t bucket;
+
+	if (isnan(u)
+	    || pit->total + 1 > MAX_SCALED_COUNT / pit->num_buckets) {
+		return -1;
+	}
+
+	bucket = find_bucket(pit, u);
+	++pit->counts[bucket];
+	++pit->total;
+	update(pit, 1, 0, pit->num_buckets, bucket);
+	return 0;
+}
+
+int one_sided_ks_pit_add(struct one_sided_ks_pit *pit, double x)
+{
+	if (pit->cdf != NULL) {
+		x = pit->cdf(x, pit->context);
+	}
+
+	return one_sided_ks_pit_add_probability(pit, x);
+}
+
+uint64_t one_sided_ks_pit_count(const struct one_sided_ks_pit *pit)
+{
+	return pit->total;
+}
+
+uint64_t one_sided_ks_pit_bucket_count(
+    const struct one_sided_ks_pit *pit, size_t bucket)
+{
+	if (bucket >= pit->num_buckets) {
+		return 0;
+	}
+
+	return pit->counts[bucket];
+}
+
+double one_sided_ks_pit_d_plus(const struct one_sided_ks_pit *pit)
+{
+	const int64_t best = line_value(&pit->tree[1].max, pit->total);
+
+	if (pit->total == 0 || best <= 0) {
+		return 0;
+	}
+
+	return one_sided_ks_ratio_down(
+	    best, (unsigned __int128)pit->total * pit->num_buckets);
+}
+
+double one_sided_ks_pit_d_minus(const struct one_sided_ks_pit *pit)
+{
+	const int64_t worst = line_value(&pit->tree[1].min, pit->total);
+
+	if (pit->total == 0 || worst >= 0) {
+		return 0;
+	}
+
+	return one_sided_ks_ratio_down(
+	    -worst, (unsigned __int128)pit->total * pit->num_buckets);
+}
@@ -0,0 +1,102 @@
+#ifndef ONE_SIDED_KS_PIT_H
+#define ONE_SIDED_KS_PIT_H
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * One-sample statistics against a reference CDF F, maintained in
+ * amortised O(log^2 k) per observation (not O(log k): see below).
+ *
+ * Each observation x is mapped to u = F(x) (the probability-integral
+ * transform), and counted in the bucket [i / k, (i + 1) / k) that
+ * contains u.  With `prefix_i` the number of observations in buckets
+ * 0 to i, and `n` the total,
+ *
+ *   D+ = sup_x [F_n(x) - F(x)] >= max_i [prefix_i / n - (i + 1) / k],
+ *   D- = sup_x [F(x) - F_n(x)] >= max_i [(i + 1) / k - prefix_i / n],
+ *
+ * and these lower bounds can be compared with
+ * `one_sided_ks_distribution_threshold(n, min_count, log_eps)`
+ * without weakening the test.  The bound on D+ holds for any F; the
+ * bound on D- assumes F is continuous.  More buckets make the bounds
+ * tighter, but the lower bounds are never more than 1 / k below the
+ * actual statistics.
+ *
+ * Both bounds are the extremes of k * prefix_i - n * (i + 1), a
+ * family of lines in n.  A kinetic segment tree over the buckets
+ * tracks the extreme line in each subtree, and the least `n` at
+ * which the extremes may change, so that each new observation
+ * updates one root-to-leaf path, and only revisits other subtrees
+ * when their extreme changes, for an amortised O(log^2 k) worst case.
+ * Each change of extreme costs O(log k), and there are amortised
+ * O(log k) of them per observation, so a plain O(log k) per
+ * observation only holds when extremes rarely change (the common case
+ * in practice), not as a bound.
+ */
+struct one_sided_ks_pit;
+
+/* A reference CDF, F(x) in [0, 1]. */
+typedef double one_sided_ks_cdf_fn(double x, void *context);
+
+/*
+ * Returns a new accumulator with `num_buckets` buckets, for the
+ * reference CDF `cdf(x, context)`, or NULL on failure.  `cdf` may be
+ * NULL, in which case observations are already in [0, 1].
+ */
+struct one_sided_ks_pit *one_sided_ks_pit_create(
+    size_t num_buckets, one_sided_ks_cdf_fn *cdf, void *context);
+
+/*
+ * Returns a new accumulator with `num_buckets` buckets, for the CDF
+ * that linearly interpolates `probabilities[i] = F(values[i])`, or
+ * NULL on failure.  Both arrays must have `count > 0` non-decreasing
+ * values, and probabilities must be in [0, 1].  F(x) is
+ * `probabilities[0]` below `values[0]`, and `probabilities[count-1]`
+ * above `values[count - 1]`.  Repeated values describe jumps, and F
+ * is right-continuous: at a repeated value, F is the probability of
+ * its last repeat.  The tables are copied.
+ */
+struct one_sided_ks_pit *one_sided_ks_pit_create_table(size_t num_buckets,
+    const double *values, const double *probabilities, size_t count);
+
+void one_sided_ks_pit_destroy(struct one_sided_ks_pit *pit);
+
+size_t one_sided_ks_pit_num_buckets(const struct one_sided_ks_pit *pit);
+
+/*
+ * Adds an observation `x`.  Returns 0 on success, -1 if F(x) is NaN
+ * or the count would overflow.
+ */
+int one_sided_ks_pit_add(struct one_sided_ks_pit *pit, double x);
+
+/*
+ * Adds an observation that's already been transformed to
+ * `u = F(x)`, like `one_sided_ks_pit_add`.  Values outside [0, 1]
+ * are clamped.
+ */
+int one_sided_ks_pit_add_probability(
+    struct one_sided_ks_pit *pit, double u);
+
+/* Returns the number of observations. */
+uint64_t one_sided_ks_pit_count(const struct one_sided_ks_pit *pit);
+
+/* Returns the number of observations in `bucket`. */
+uint64_t one_sided_ks_pit_bucket_count(
+    const struct one_sided_ks_pit *pit, size_t bucket);
+
+/*
+ * Returns the lower bound on D+, rounded down, or 0 if there is no
+ * observation.
+ */
+double one_sided_ks_pit_d_plus(const struct one_sided_ks_pit *pit);
+
+/* Returns the lower bound on D-, like `one_sided_ks_pit_d_plus`. */
+double one_sided_ks_pit_d_minus(const struct one_sided_ks_pit *pit);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /* !ONE_SIDED_KS_PIT_H */
@@ -0,0 +1,261 @@
+#include "one-sided-ks-pit.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "one-sided-ks.h"
+
+namespace {
+using ::testing::DoubleNear;
+
+// Reference implementation: extremes of k * prefix_i - n * (i + 1).
+void scaled_extremes(
+    const std::vector<uint64_t> &counts, int64_t *max, int64_t *min)
+{
+	const int64_t k = counts.size();
+	int64_t n = 0;
+	int64_t prefix = 0;
+
+	for (const uint64_t count : counts) {
+		n += count;
+	}
+
+	*max = 0;
+	*min = 0;
+	for (int64_t i = 0; i < k; ++i) {
+		prefix += counts[i];
+
+		const int64_t value = k * prefix - n * (i + 1);
+		*max = std::max(*max, value);
+		*min = std::min(*min, value);
+	}
+}
+
+double exponential_cdf(double x, void *)
+{
+	return (x <= 0) ? 0 : -std::expm1(-x);
+}
+
+TEST(OneSidedKsPit, Empty)
+{
+	struct one_sided_ks_pit *pit
+	    = one_sided_ks_pit_create(10, nullptr, nullptr);
+
+	EXPECT_EQ(one_sided_ks_pit_num_buckets(pit), 10);
+	EXPECT_EQ(one_sided_ks_pit_count(pit), 0);
+	EXPECT_EQ(one_sided_ks_pit_d_plus(pit), 0);
+	EXPECT_EQ(one_sided_ks_pit_d_minus(pit), 0);
+	EXPECT_EQ(one_sided_ks_pit_add_probability(pit, NAN), -1);
+	EXPECT_EQ(one_sided_ks_pit_count(pit), 0);
+	one_sided_ks_pit_destroy(pit);
+
+	EXPECT_EQ(one_sided_ks_pit_create(0, nullptr, nullptr), nullptr);
+}
+
+// Returns the bucket for u, in a fresh accumulator with k buckets.
+size_t find_bucket(size_t k, double u)
+{
+	struct one_sided_ks_pit *pit
+	    = one_sided_ks_pit_create(k, nullptr, nullptr);
+	size_t ret = 0;
+
+	one_sided_ks_pit_add_probability(pit, u);
+	while (one_sided_ks_pit_bucket_count(pit, ret) == 0) {
+		++ret;
+	}
+
+	one_sided_ks_pit_destroy(pit);
+	return ret;
+}
+
+// Bucket boundaries are exact: b / k <= u < (b + 1) / k.
+TEST(OneSidedKsPit, Buckets)
+{
+	for (const size_t k : { 1, 3, 7, 10, 100, 1000 }) {
+		for (size_t i = 0; i < k; ++i) {
+			const double edge = 1.0 * i / k;
+
+			const double below = std::nextafter(edge, 0.0);
+			const double above = std::nextafter(edge, 1.0);
+
+			for (const double u : { below, edge, above }) {
+				const size_t bucket = find_bucket(k, u);
+				const long double scaled = (long double)u * k;
+
+				EXPECT_LE(bucket, scaled) << u;
+				EXPECT_LT(scaled, bucket + 1) << u;
+			}
+		}
+
+		EXPECT_EQ(find_bucket(k, 1.0), k - 1);
+		EXPECT_EQ(find_bucket(k, 2.0), k - 1);
+		EXPECT_EQ(find_bucket(k, -1.0), 0);
+	}
+}
+
+// The tree must match a linear scan after every observation.
+TEST(OneSidedKsPit, MatchesScan)
+{
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<double> unif(0, 1);
+
+	for (const size_t k : { 1, 2, 3, 7, 64, 100, 1000 }) {
+		struct one_sided_ks_pit *pit
+		    = one_sided_ks_pit_create(k, nullptr, nullptr);
+		std::vector<uint64_t> counts(k, 0);
+
+		for (size_t i = 1; i <= 5000; ++i) {
+			// Alternate between skewing low and high.
+			const double u = ((i / 500) % 2 == 0)
+			    ? unif(rng) * unif(rng)
+			    : std::sqrt(unif(rng));
+
+			ASSERT_EQ(
+			    one_sided_ks_pit_add_probability(pit, u), 0);
+			++counts[std::min<size_t>(u * k, k - 1)];
+
+			int64_t max;
+			int64_t min;
+			scaled_extremes(counts, &max, &min);
+
+			// A single rounded division of exact integers: the
+			// exact result, rounded down, can't be any higher.
+			const double den = 1.0 * i * k;
+			ASSERT_THAT(one_sided_ks_pit_d_plus(pit),
+			    DoubleNear(max / den, 1e-15));
+			ASSERT_LE(one_sided_ks_pit_d_plus(pit), max / den);
+			ASSERT_THAT(one_sided_ks_pit_d_minus(pit),
+			    DoubleNear(-min / den, 1e-15));
+			ASSERT_LE(one_sided_ks_pit_d_minus(pit), -min / den);
+		}
+
+		EXPECT_EQ(one_sided_ks_pit_count(pit), 5000);
+		one_sided_ks_pit_destroy(pit);
+	}
+}
+
+// The bounds never exceed the exact statistics.
+TEST(OneSidedKsPit, LowerBound)
+{
+	std::mt19937 rng(43);
+	std::exponential_distribution<double> exponential(1.2);
+	struct one_sided_ks_pit *pit
+	    = one_sided_ks_pit_create(100, exponential_cdf, nullptr);
+	std::vector<double> values;
+
+	for (size_t i = 1; i <= 2000; ++i) {
+		const double x = exponential(rng);
+
+		values.push_back(x);
+		ASSERT_EQ(one_sided_ks_pit_add(pit, x), 0);
+		if (i % 97 != 0) {
+			continue;
+		}
+
+		std::sort(values.begin(), values.end());
+		double d_plus = 0;
+		double d_minus = 0;
+		for (size_t j = 0; j < values.size(); ++j) {
+			const double cdf
+			    = exponential_cdf(values[j], nullptr);
+
+			d_plus = std::max(d_plus, (j + 1.0) / i - cdf);
+			d_minus = std::max(d_minus, cdf - 1.0 * j / i);
+		}
+
+		// With 100 buckets, the bounds are within 0.01.
+		ASSERT_LE(one_sided_ks_pit_d_plus(pit), d_plus);
+		ASSERT_GE(one_sided_ks_pit_d_plus(pit), d_plus - 0.0100001);
+		ASSERT_LE(one_sided_ks_pit_d_minus(pit), d_minus);
+		ASSERT_GE(one_sided_ks_pit_d_minus(pit), d_minus - 0.0100001);
+	}
+
+	one_sided_ks_pit_destroy(pit);
+}
+
+TEST(OneSidedKsPit, Table)
+{
+	const double values[] = { 0, 1, 2, 4 };
+	const double probabilities[] = { 0, 0.5, 0.75, 1 };
+	struct one_sided_ks_pit *pit
+	    = one_sided_ks_pit_create_table(4, values, probabilities, 4);
+
+	// F maps these to 0, 0.25, 0.495, 0.5, 0.625, 0.875, 1 and 1.
+	for (const double x : { -1.0, 0.5, 0.99, 1.0, 1.5, 3.0, 4.0, 10.0 }) {
+		ASSERT_EQ(one_sided_ks_pit_add(pit, x), 0);
+	}
+
+	EXPECT_EQ(one_sided_ks_pit_bucket_count(pit, 0), 1);
+	EXPECT_EQ(one_sided_ks_pit_bucket_count(pit, 1), 2);
+	EXPECT_EQ(one_sided_ks_pit_bucket_count(pit, 2), 2);
+	EXPECT_EQ(one_sided_ks_pit_bucket_count(pit, 3), 3);
+	EXPECT_EQ(one_sided_ks_pit_add(pit, NAN), -1);
+	one_sided_ks_pit_destroy(pit);
+
+	const double bad[] = { 0, 0.5, 0.25, 1 };
+	EXPECT_EQ(one_sided_ks_pit_create_table(4, values, bad, 4), nullptr);
+	EXPECT_EQ(one_sided_ks_pit_create_table(4, bad, probabilities, 4),
+	    nullptr);
+}
+
+// Repeated values are jumps in F: observations drawn exactly from that
+// discrete distribution must not reject.
+TEST(OneSidedKsPit, DiscreteTable)
+{
+	const double values[] = { 0, 0, 1, 1, 2, 2, 3, 3 };
+	const double probabilities[]
+	    = { 0, 0.25, 0.25, 0.5, 0.5, 0.75, 0.75, 1 };
+	const double log_eps = std::log(1e-6);
+	const uint64_t min_count = one_sided_ks_find_min_count(log_eps);
+	std::mt19937 rng(45);
+	std::uniform_int_distribution<int> atom(0, 3);
+	struct one_sided_ks_pit *pit = one_sided_ks_pit_create_table(
+	    1000, values, probabilities, 8);
+
+	// F is right-continuous, including at the first value.
+	ASSERT_EQ(one_sided_ks_pit_add(pit, 0), 0);
+	EXPECT_EQ(one_sided_ks_pit_bucket_count(pit, 0), 0);
+
+	for (uint64_t n = 2; n <= 100000; ++n) {
+		ASSERT_EQ(one_sided_ks_pit_add(pit, atom(rng)), 0);
+		ASSERT_LT(one_sided_ks_pit_d_plus(pit),
+		    one_sided_ks_distribution_threshold(
+			n, min_count, log_eps))
+		    << n;
+	}
+
+	one_sided_ks_pit_destroy(pit);
+}
+
+// The observations come from a slightly faster distribution than the
+// reference; D+ should eventually exceed the one-sample threshold.
+TEST(OneSidedKsPit, Reject)
+{
+	const double log_eps = std::log(1e-6);
+	const uint64_t min_count = one_sided_ks_find_min_count(log_eps);
+	std::mt19937 rng(44);
+	std::exponential_distribution<double> exponential(1.1);
+	struct one_sided_ks_pit *pit
+	    = one_sided_ks_pit_create(1000, exponential_cdf, nullptr);
+	uint64_t n = 1;
+
+	for (; n <= 1000000; ++n) {
+		ASSERT_EQ(one_sided_ks_pit_add(pit, exponential(rng)), 0);
+		if (one_sided_ks_pit_d_plus(pit)
+		    >= one_sided_ks_distribution_threshold(
+			n, min_count, log_eps)) {
+			break;
+		}
+	}
+
+	EXPECT_LE(n, 1000000);
+	EXPECT_LT(one_sided_ks_pit_d_minus(pit),
+	    one_sided_ks_distribution_threshold(n, min_count, log_eps));
+	one_sided_ks_pit_destroy(pit);
+}
+} // namespace
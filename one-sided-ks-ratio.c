@@ -0,0 +1,120 @@
+#include "one-sided-ks-ratio.h"
+
+#include <math.h>
+#include <stdint.h>
+
+/* A 192-bit unsigned integer, least significant limb first. */
+struct wide {
+	uint64_t limbs[3];
+};
+
+static struct wide wide_mul(uint64_t x, unsigned __int128 y)
+{
+	const unsigned __int128 lo = (unsigned __int128)x * (uint64_t)y;
+	/* At most (2^64 - 1)^2 + 2^64 - 1 < 2^128. */
+	const unsigned __int128 hi
+	    = (unsigned __int128)x * (uint64_t)(y >> 64)
+	    + (uint64_t)(lo >> 64);
+
+	return (struct wide) {
+		{ (uint64_t)lo, (uint64_t)hi, (uint64_t)(hi >> 64) },
+	};
+}
+
+static int wide_bit_length(struct wide x)
+{
+	for (int i = 2; i >= 0; --i) {
+		if (x.limbs[i] != 0) {
+			return 64 * i + 64 - __builtin_clzll(x.limbs[i]);
+		}
+	}
+
+	return 0;
+}
+
+/* x << shift; the result must fit in 192 bits. */
+static struct wide wide_shift(struct wide x, int shift)
+{
+	const int words = shift / 64;
+	const int bits = shift % 64;
+	struct wide ret = { { 0, 0, 0 } };
+
+	for (int i = 2; i >= words; --i) {
+		ret.limbs[i] = x.limbs[i - words] << bits;
+		if (bits != 0 && i - words > 0) {
+			ret.limbs[i] |= x.limbs[i - words - 1] >> (64 - bits);
+		}
+	}
+
+	return ret;
+}
+
+static int wide_compare(struct wide x, struct wide y)
+{
+	for (int i = 2; i >= 0; --i) {
+		if (x.limbs[i] != y.limbs[i]) {
+			return (x.limbs[i] < y.limbs[i]) ? -1 : 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Returns the sign of `value - num / den`, for a positive and finite
+ * `value`, exactly.
+ */
+static int compare(double value, unsigned __int128 num, unsigned __int128 den)
+{
+	int exponent;
+	/* value = mantissa 2^shift, with an integer mantissa. */
+	const uint64_t mantissa
+	    = (uint64_t)ldexp(frexp(value, &exponent), 53);
+	const int shift = exponent - 53;
+	/* Compare mantissa den 2^shift with num. */
+	struct wide lhs = wide_mul(mantissa, den);
+	struct wide rhs = wide_mul(1, num);
+	const int lhs_bits = wide_bit_length(lhs) + (shift > 0 ? shift : 0);
+	const int rhs_bits = wide_bit_length(rhs) + (shift < 0 ? -shift : 0);
+
+	if (lhs_bits != rhs_bits) {
+		return (lhs_bits < rhs_bits) ? -1 : 1;
+	}
+
+	/* Both sides now fit in max(lhs_bits, rhs_bits) <= 192 bits. */
+	if (shift > 0) {
+		lhs = wide_shift(lhs, shift);
+	} else {
+		rhs = wide_shift(rhs, -shift);
+	}
+
+	return wide_compare(lhs, rhs);
+}
+
+double one_sided_ks_ratio_down(unsigned __int128 num, unsigned __int128 den)
+{
+	double ret;
+
+	if (num == 0) {
+		return 0;
+	}
+
+	/*
+	 * Two rounded conversions and a rounded division are off by
+	 * at most a few ULPs; fix that up with exact comparisons.
+	 */
+	ret = (double)num / (double)den;
+	while (compare(ret, num, den) > 0) {
+		ret = nextafter(ret, 0);
+	}
+
+	for (;;) {
+		const double up = nextafter(ret, INFINITY);
+
+		if (compare(up, num, den) > 0) {
+			return ret;
+		}
+
+		ret = up;
+	}
+}
@@ -0,0 +1,23 @@
+#ifndef ONE_SIDED_KS_RATIO_H
+#define ONE_SIDED_KS_RATIO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Internal helper for the exact accumulators: their statistics are
+ * ratios of (128-bit) integers, and must never be rounded up, or a
+ * test could reject with a statistic that's actually at or below the
+ * threshold.
+ */
+
+/*
+ * Returns `num / den` rounded down to a double, i.e., the greatest
+ * double that is at most `num / den`.  `den` must be positive.
+ */
+double one_sided_ks_ratio_down(unsigned __int128 num, unsigned __int128 den);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /* !ONE_SIDED_KS_RATIO_H */
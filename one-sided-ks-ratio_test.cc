@@ -0,0 +1,94 @@
+#include "one-sided-ks-ratio.h"
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+#include "gtest/gtest.h"
+
+namespace {
+typedef unsigned __int128 u128;
+
+// Reference implementation: long division, one bit at a time, until
+// we have 53 significant bits.
+double reference(u128 num, u128 den)
+{
+	u128 mantissa = num / den;
+	u128 rem = num % den;
+	int exponent = 0;
+
+	if (num == 0) {
+		return 0;
+	}
+
+	while ((mantissa >> 52) == 0) {
+		mantissa <<= 1;
+		--exponent;
+		if (rem >= den - rem) {
+			mantissa |= 1;
+			rem -= den - rem;
+		} else {
+			rem += rem;
+		}
+	}
+
+	while ((mantissa >> 53) != 0) {
+		mantissa >>= 1;
+		++exponent;
+	}
+
+	return std::ldexp(static_cast<double>(mantissa), exponent);
+}
+
+u128 wide(uint64_t hi, uint64_t lo)
+{
+	return (static_cast<u128>(hi) << 64) | lo;
+}
+
+TEST(OneSidedKsRatio, Exact)
+{
+	EXPECT_EQ(0, one_sided_ks_ratio_down(0, 5));
+	EXPECT_EQ(0.25, one_sided_ks_ratio_down(1, 4));
+	EXPECT_EQ(3, one_sided_ks_ratio_down(3, 1));
+	EXPECT_EQ(1, one_sided_ks_ratio_down(wide(7, 3), wide(7, 3)));
+	EXPECT_EQ(std::ldexp(1.0, -126),
+	    one_sided_ks_ratio_down(2, wide(1ULL << 63, 0)));
+}
+
+// Rounding to nearest everywhere ends up a few ULPs above num / den.
+TEST(OneSidedKsRatio, TopOfBinade)
+{
+	const u128 num = 10872782685833286657ULL;
+	const u128 den = 10892592957282919423ULL;
+	const double ratio = one_sided_ks_ratio_down(num, den);
+
+	EXPECT_EQ(reference(num, den), ratio);
+	EXPECT_LT(ratio, static_cast<double>(num) / static_cast<double>(den));
+}
+
+TEST(OneSidedKsRatio, Random)
+{
+	std::mt19937_64 rng(1);
+
+	for (size_t i = 0; i < 100000; ++i) {
+		const uint64_t den = rng() | 1;
+		// Ratios right below 1, then arbitrary ones.
+		const u128 nums[] = {
+			den - (rng() % 4096) - 1,
+			rng(),
+			wide(rng() >> (rng() % 64), rng()),
+		};
+		const u128 dens[] = {
+			den,
+			den,
+			wide(rng() >> (rng() % 64), rng() | 1),
+		};
+
+		for (size_t j = 0; j < 3; ++j) {
+			EXPECT_EQ(reference(nums[j], dens[j]),
+			    one_sided_ks_ratio_down(nums[j], dens[j]))
+			    << i << " " << j;
+		}
+	}
+}
+} // namespace
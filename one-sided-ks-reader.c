@@ -0,0 +1,192 @@
+#include "one-sided-ks-reader.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "one-sided-ks-hist.h"
+#include "one-sided-ks.h"
+
+#define RECORD_SIZE 16
+#define VALUE_OFFSET 8
+
+#define DEFAULT_CHECKPOINT ((uint64_t)1 << 16)
+#define DEFAULT_PRECISION_BITS 7
+#define MAX_PRECISION_BITS 16
+
+/* Compilers turn these into plain loads on little-endian targets. */
+static uint32_t load_le32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16
+	    | (uint32_t)p[3] << 24;
+}
+
+static uint64_t load_le64(const uint8_t *p)
+{
+	return (uint64_t)load_le32(p) | (uint64_t)load_le32(p + 4) << 32;
+}
+
+static size_t num_buckets(unsigned int bits)
+{
+	return (size_t)(65 - bits) << bits;
+}
+
+/*
+ * Values less than 2^bits have their own bucket.  Larger values keep
+ * their top `bits + 1` bits, in 2^bits buckets per power of 2.  The
+ * mapping is non-decreasing, so bucketed CDFs are exact at bucket
+ * boundaries.
+ */
+static size_t find_bucket(uint64_t value, unsigned int bits)
+{
+	if (value < ((uint64_t)1 << bits)) {
+		return value;
+	}
+
+	const unsigned int shift = 63 - __builtin_clzll(value) - bits;
+
+	return ((size_t)shift << bits) + (value >> shift);
+}
+
+/* Returns the first record at or after `i` for `arm`, or `count`. */
+static size_t next_record(
+    const uint8_t *data, size_t count, size_t i, uint32_t arm)
+{
+	while (i < count && load_le32(&data[i * RECORD_SIZE]) != arm) {
+		++i;
+	}
+
+	return i;
+}
+
+/* Updates `result` after `n` pairs; returns whether to reject. */
+static bool check(const uint64_t *a_counts, const uint64_t *b_counts,
+    size_t k, uint64_t n, const struct one_sided_ks_reader_options *options,
+    struct one_sided_ks_reader_result *result)
+{
+	struct one_sided_ks_hist_result hist;
+
+	if (one_sided_ks_hist_dplus(a_counts, b_counts, k, &hist) != 0) {
+		return false;
+	}
+
+	result->d_plus = hist.d_plus;
+	result->threshold = one_sided_ks_pair_threshold(
+	    n, options->min_count, options->log_eps);
+	return result->d_plus > result->threshold;
+}
+
+int one_sided_ks_reader_scan(const void *data, size_t size,
+    const struct one_sided_ks_reader_options *options,
+    struct one_sided_ks_reader_result *result)
+{
+	const uint8_t *records = data;
+	const size_t count = size / RECORD_SIZE;
+	const uint64_t checkpoint = (options->checkpoint == 0)
+	    ? DEFAULT_CHECKPOINT
+	    : options->checkpoint;
+	const unsigned int bits = (options->precision_bits == 0)
+	    ? DEFAULT_PRECISION_BITS
+	    : options->precision_bits;
+
+	if (size % RECORD_SIZE != 0 || bits > MAX_PRECISION_BITS
+	    || !(options->log_eps < 0)) {
+		return -1;
+	}
+
+	const size_t k = num_buckets(bits);
+	uint64_t *a_counts = calloc(k, sizeof(uint64_t));
+	uint64_t *b_counts = calloc(k, sizeof(uint64_t));
+	if (a_counts == NULL || b_counts == NULL) {
+		free(a_counts);
+		free(b_counts);
+		return -1;
+	}
+
+	size_t a = next_record(records, count, 0, 0);
+	size_t b = next_record(records, count, 0, 1);
+	uint64_t n = 0;
+
+	*result = (struct one_sided_ks_reader_result) {
+		.num_records = count,
+		.num_pairs = 0,
+		.reject_index = UINT64_MAX,
+		.d_plus = 0,
+		.threshold = HUGE_VAL,
+	};
+
+	/* Each cursor skips the other arm's records, in place. */
+	while (a < count && b < count) {
+		const size_t last = (a > b) ? a : b;
+		const uint64_t a_value
+		    = load_le64(&records[a * RECORD_SIZE + VALUE_OFFSET]);
+		const uint64_t b_value
+		    = load_le64(&records[b * RECORD_SIZE + VALUE_OFFSET]);
+
+		++a_counts[find_bucket(a_value, bits)];
+		++b_counts[find_bucket(b_value, bits)];
+		++n;
+
+		a = next_record(records, count, a + 1, 0);
+		b = next_record(records, count, b + 1, 1);
+		if ((n % checkpoint == 0 || a == count || b == count)
+		    && check(a_counts, b_counts, k, n, options, result)) {
+			result->num_records = last + 1;
+			result->reject_index = last;
+			break;
+		}
+	}
+
+	result->num_pairs = n;
+	free(a_counts);
+	free(b_counts);
+	return 0;
+}
+
+int one_sided_ks_reader_scan_file(const char *path,
+    const struct one_sided_ks_reader_options *options,
+    struct one_sided_ks_reader_result *result)
+{
+	struct stat st;
+	void *data;
+	size_t size;
+	int flags = MAP_PRIVATE;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	int ret;
+
+	if (fd < 0) {
+		return -1;
+	}
+
+	if (fstat(fd, &st) != 0 || st.st_size < 0
+	    || (uint64_t)st.st_size > SIZE_MAX) {
+		close(fd);
+		return -1;
+	}
+
+	size = (size_t)st.st_size;
+	if (size == 0) {
+		close(fd);
+		return one_sided_ks_reader_scan(NULL, 0, options, result);
+	}
+
+#ifdef MAP_POPULATE
+	flags |= MAP_POPULATE;
+#endif
+	data = mmap(NULL, size, PROT_READ, flags, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return -1;
+	}
+
+	/* Only a hint: read-ahead still works if this fails. */
+	(void)madvise(data, size, MADV_SEQUENTIAL);
+	ret = one_sided_ks_reader_scan(data, size, options, result);
+	munmap(data, size);
+	return ret;
+}
@@ -0,0 +1,71 @@
+#ifndef ONE_SIDED_KS_READER_H
+#define ONE_SIDED_KS_READER_H
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Sequential two-sample test over binary logs of (arm, value)
+ * records, read in place.
+ *
+ * Each record is 16 bytes, little-endian: a uint32_t arm (0 for A, 1
+ * for B; records for any other arm are ignored), 4 reserved bytes,
+ * and a uint64_t value (e.g., a latency in nanoseconds).
+ *
+ * The i-th A record is paired with the i-th B record, and each pair
+ * is counted in log-linear histograms (`precision_bits` significant
+ * bits per value, so each bucket covers a relative range of at most
+ * 2^-precision_bits).  Every `checkpoint` pairs, and after the last
+ * pair, we compute D+ from the histograms with
+ * `one_sided_ks_hist_dplus`, and stop as soon as it exceeds
+ * `one_sided_ks_pair_threshold(n, min_count, log_eps)`.  Bucketing
+ * can only decrease D+, so the test remains valid.
+ */
+struct one_sided_ks_reader_options {
+	uint64_t min_count;
+	double log_eps;
+	/* Pairs between two threshold checks; 0 for 65536. */
+	uint64_t checkpoint;
+	/* At most 16; 0 for 7. */
+	unsigned int precision_bits;
+};
+
+struct one_sided_ks_reader_result {
+	/* Number of records read, up to the rejection if any. */
+	uint64_t num_records;
+	/* Number of complete pairs. */
+	uint64_t num_pairs;
+	/*
+	 * Index of the record that completed the rejecting pair, or
+	 * UINT64_MAX if the test never rejected.
+	 */
+	uint64_t reject_index;
+	/* D+ and the threshold at the last check, or 0 and +infty. */
+	double d_plus;
+	double threshold;
+};
+
+/*
+ * Runs the test over the `size` bytes of records at `data`, which
+ * need not be aligned.  Returns 0 on success, -1 if `size` isn't a
+ * multiple of 16, the options are invalid, or on allocation failure.
+ */
+int one_sided_ks_reader_scan(const void *data, size_t size,
+    const struct one_sided_ks_reader_options *options,
+    struct one_sided_ks_reader_result *result);
+
+/*
+ * Same as `one_sided_ks_reader_scan`, for the file at `path`, which
+ * is mapped read-only (with MAP_POPULATE and MADV_SEQUENTIAL) rather
+ * than copied.  Also returns -1 if the file can't be mapped.
+ */
+int one_sided_ks_reader_scan_file(const char *path,
+    const struct one_sided_ks_reader_options *options,
+    struct one_sided_ks_reader_result *result);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /* !ONE_SIDED_KS_READER_H */
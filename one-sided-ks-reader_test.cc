@@ -0,0 +1,207 @@
+#include "one-sided-ks-reader.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "one-sided-ks-ecdf.h"
+#include "one-sided-ks.h"
+
+namespace {
+const double kLogEps = std::log(1e-6);
+const uint64_t kMinCount = one_sided_ks_find_min_count(kLogEps);
+
+// Appends a little-endian record.
+void append(std::vector<uint8_t> *log, uint32_t arm, uint64_t value)
+{
+	for (size_t i = 0; i < 4; ++i) {
+		log->push_back(uint8_t(arm >> (8 * i)));
+	}
+
+	log->insert(log->end(), 4, 0xff);
+	for (size_t i = 0; i < 8; ++i) {
+		log->push_back(uint8_t(value >> (8 * i)));
+	}
+}
+
+// Interleaves arms at random; B values are shifted up by `shift`.
+std::vector<uint8_t> make_log(size_t count, uint64_t shift, uint64_t seed)
+{
+	std::mt19937_64 rng(seed);
+	std::uniform_int_distribution<uint64_t> value(0, 99);
+	std::vector<uint8_t> ret;
+
+	for (size_t i = 0; i < count; ++i) {
+		const uint32_t arm = rng() % 2;
+
+		append(&ret, arm, value(rng) + (arm == 1 ? shift : 0));
+	}
+
+	return ret;
+}
+
+// Reference implementation: pair records in order with an ecdf, and
+// check after every pair.  Values are less than 2^7, so the reader's
+// buckets are exact.
+uint64_t reference_reject(const std::vector<uint8_t> &log)
+{
+	struct one_sided_ks_ecdf *ecdf = one_sided_ks_ecdf_create(128);
+	std::vector<std::vector<size_t> > pending(2);
+	uint64_t ret = UINT64_MAX;
+	uint64_t n = 0;
+
+	for (size_t i = 0; i < log.size() / 16 && ret == UINT64_MAX; ++i) {
+		const uint32_t arm = log[16 * i];
+
+		if (arm > 1) {
+			continue;
+		}
+
+		pending[arm].push_back(log[16 * i + 8]);
+		if (pending[0].size() > n && pending[1].size() > n) {
+			one_sided_ks_ecdf_add_pair(
+			    ecdf, pending[0][n], pending[1][n]);
+			++n;
+			if (one_sided_ks_ecdf_d_plus(ecdf)
+			    > one_sided_ks_pair_threshold(
+				n, kMinCount, kLogEps)) {
+				ret = i;
+			}
+		}
+	}
+
+	one_sided_ks_ecdf_destroy(ecdf);
+	return ret;
+}
+
+TEST(OneSidedKsReader, Invalid)
+{
+	std::vector<uint8_t> log;
+	struct one_sided_ks_reader_options options
+	    = { kMinCount, kLogEps, 0, 0 };
+	struct one_sided_ks_reader_result result;
+
+	append(&log, 0, 1);
+	EXPECT_EQ(one_sided_ks_reader_scan(
+		      log.data(), log.size() - 1, &options, &result),
+	    -1);
+	options.precision_bits = 17;
+	EXPECT_EQ(one_sided_ks_reader_scan(
+		      log.data(), log.size(), &options, &result),
+	    -1);
+	options.precision_bits = 0;
+	options.log_eps = 0;
+	EXPECT_EQ(one_sided_ks_reader_scan(
+		      log.data(), log.size(), &options, &result),
+	    -1);
+	options.log_eps = kLogEps;
+	EXPECT_EQ(one_sided_ks_reader_scan_file(
+		      "/nonexistent/one-sided-ks", &options, &result),
+	    -1);
+
+	// A lone A record never forms a pair.
+	ASSERT_EQ(one_sided_ks_reader_scan(
+		      log.data(), log.size(), &options, &result),
+	    0);
+	EXPECT_EQ(result.num_records, 1);
+	EXPECT_EQ(result.num_pairs, 0);
+	EXPECT_EQ(result.reject_index, UINT64_MAX);
+	EXPECT_EQ(result.threshold, HUGE_VAL);
+}
+
+TEST(OneSidedKsReader, Accept)
+{
+	std::vector<uint8_t> log = make_log(100000, 0, 1);
+	const struct one_sided_ks_reader_options options
+	    = { kMinCount, kLogEps, 1000, 0 };
+	struct one_sided_ks_reader_result result;
+	uint64_t count[2] = { 0, 0 };
+
+	// Records for other arms don't count.
+	append(&log, 2, 1000);
+	for (size_t i = 0; i < log.size(); i += 16) {
+		if (log[i] < 2) {
+			++count[log[i]];
+		}
+	}
+
+	ASSERT_EQ(one_sided_ks_reader_scan(
+		      log.data(), log.size(), &options, &result),
+	    0);
+	EXPECT_EQ(result.num_records, log.size() / 16);
+	EXPECT_EQ(result.num_pairs, std::min(count[0], count[1]));
+	EXPECT_EQ(result.reject_index, UINT64_MAX);
+	EXPECT_LT(result.d_plus, result.threshold);
+	EXPECT_EQ(reference_reject(log), UINT64_MAX);
+}
+
+// With a checkpoint after every pair, the reader rejects at the same
+// record as a pair-by-pair reference.
+TEST(OneSidedKsReader, Reject)
+{
+	const std::vector<uint8_t> log = make_log(100000, 5, 2);
+	const uint64_t expected = reference_reject(log);
+	struct one_sided_ks_reader_options options
+	    = { kMinCount, kLogEps, 1, 0 };
+	struct one_sided_ks_reader_result result;
+
+	ASSERT_LT(expected, log.size() / 16);
+	ASSERT_EQ(one_sided_ks_reader_scan(
+		      log.data(), log.size(), &options, &result),
+	    0);
+	EXPECT_EQ(result.reject_index, expected);
+	EXPECT_EQ(result.num_records, expected + 1);
+	EXPECT_GT(result.d_plus, result.threshold);
+
+	// Sparser checkpoints can only reject later.
+	options.checkpoint = 1000;
+	ASSERT_EQ(one_sided_ks_reader_scan(
+		      log.data(), log.size(), &options, &result),
+	    0);
+	EXPECT_GE(result.reject_index, expected);
+	EXPECT_LT(result.reject_index, log.size() / 16);
+	EXPECT_EQ(result.num_pairs % 1000, 0);
+}
+
+TEST(OneSidedKsReader, File)
+{
+	const std::vector<uint8_t> log = make_log(10000, 3, 3);
+	const std::string path
+	    = testing::TempDir() + "one-sided-ks-reader_test.bin";
+	const struct one_sided_ks_reader_options options
+	    = { kMinCount, kLogEps, 100, 10 };
+	struct one_sided_ks_reader_result expected;
+	struct one_sided_ks_reader_result result;
+	FILE *file = std::fopen(path.c_str(), "wb");
+
+	ASSERT_NE(file, nullptr);
+	ASSERT_EQ(std::fwrite(log.data(), 1, log.size(), file), log.size());
+	ASSERT_EQ(std::fclose(file), 0);
+
+	ASSERT_EQ(one_sided_ks_reader_scan(
+		      log.data(), log.size(), &options, &expected),
+	    0);
+	ASSERT_EQ(one_sided_ks_reader_scan_file(
+		      path.c_str(), &options, &result),
+	    0);
+	EXPECT_EQ(result.num_records, expected.num_records);
+	EXPECT_EQ(result.num_pairs, expected.num_pairs);
+	EXPECT_EQ(result.reject_index, expected.reject_index);
+	EXPECT_EQ(result.d_plus, expected.d_plus);
+
+	// Empty files are valid, and can't be mapped.
+	file = std::fopen(path.c_str(), "wb");
+	ASSERT_NE(file, nullptr);
+	ASSERT_EQ(std::fclose(file), 0);
+	ASSERT_EQ(one_sided_ks_reader_scan_file(
+		      path.c_str(), &options, &result),
+	    0);
+	EXPECT_EQ(result.num_records, 0);
+	EXPECT_EQ(result.num_pairs, 0);
+	std::remove(path.c_str());
+}
+} // namespace
@@ -0,0 +1,155 @@
+#include "one-sided-ks-recorder.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CACHE_LINE 64
+
+struct one_sided_ks_recorder {
+	size_t num_buckets;
+	size_t num_shards;
+	/* Distance between shards, in counters. */
+	size_t shard_stride;
+	/*
+	 * Shard i's A counts start at counters[i * shard_stride], and
+	 * its B counts at counters[i * shard_stride + num_buckets].
+	 */
+	uint64_t *counters;
+};
+
+/* Round-robin shard assignment for new threads. */
+static size_t next_thread_id = 0;
+static _Thread_local size_t thread_id = SIZE_MAX;
+
+static size_t get_thread_id(void)
+{
+	if (thread_id == SIZE_MAX) {
+		thread_id = __atomic_fetch_add(
+		    &next_thread_id, 1, __ATOMIC_RELAXED);
+	}
+
+	return thread_id;
+}
+
+struct one_sided_ks_recorder *one_sided_ks_recorder_create(
+    size_t num_buckets, size_t num_shards)
+{
+	const size_t per_line = CACHE_LINE / sizeof(uint64_t);
+
+	if (num_buckets == 0 || num_buckets > SIZE_MAX / 4) {
+		return NULL;
+	}
+
+	if (num_shards == 0) {
+		const long num_cpus = sysconf(_SC_NPROCESSORS_CONF);
+
+		num_shards = (num_cpus > 0) ? (size_t)num_cpus : 1;
+	}
+
+	/* Round each shard up to a whole number of cache lines. */
+	const size_t stride
+	    = (2 * num_buckets + per_line - 1) / per_line * per_line;
+	if (stride > SIZE_MAX / sizeof(uint64_t) / num_shards) {
+		return NULL;
+	}
+
+	struct one_sided_ks_recorder *recorder = malloc(sizeof(*recorder));
+	if (recorder == NULL) {
+		return NULL;
+	}
+
+	const size_t size = num_shards * stride * sizeof(uint64_t);
+	recorder->num_buckets = num_buckets;
+	recorder->num_shards = num_shards;
+	recorder->shard_stride = stride;
+	recorder->counters = aligned_alloc(CACHE_LINE, size);
+	if (recorder->counters == NULL) {
+		free(recorder);
+		return NULL;
+	}
+
+	memset(recorder->counters, 0, size);
+	return recorder;
+}
+
+void one_sided_ks_recorder_destroy(struct one_sided_ks_recorder *recorder)
+{
+	if (recorder == NULL) {
+		return;
+	}
+
+	free(recorder->counters);
+	free(recorder);
+}
+
+size_t one_sided_ks_recorder_num_buckets(
+    const struct one_sided_ks_recorder *recorder)
+{
+	return recorder->num_buckets;
+}
+
+size_t one_sided_ks_recorder_num_shards(
+    const struct one_sided_ks_recorder *recorder)
+{
+	return recorder->num_shards;
+}
+
+void one_sided_ks_recorder_record(struct one_sided_ks_recorder *recorder,
+    enum one_sided_ks_arm arm, size_t bucket)
+{
+	assert(bucket < recorder->num_buckets && "bucket out of range");
+	assert((arm == ONE_SIDED_KS_ARM_A || arm == ONE_SIDED_KS_ARM_B)
+	    && "invalid arm");
+
+	const size_t shard = get_thread_id() % recorder->num_shards;
+	uint64_t *counter = &recorder->counters[shard * recorder->shard_stride
+	    + arm * recorder->num_buckets + bucket];
+
+	__atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+void one_sided_ks_recorder_snapshot(
+    const struct one_sided_ks_recorder *recorder, uint64_t *a_counts,
+    uint64_t *b_counts)
+{
+	const size_t num_buckets = recorder->num_buckets;
+
+	memset(a_counts, 0, num_buckets * sizeof(*a_counts));
+	memset(b_counts, 0, num_buckets * sizeof(*b_counts));
+	for (size_t shard = 0; shard < recorder->num_shards; ++shard) {
+		const uint64_t *a
+		    = &recorder->counters[shard * recorder->shard_stride];
+		const uint64_t *b = a + num_buckets;
+
+		for (size_t i = 0; i < num_buckets; ++i) {
+			a_counts[i]
+			    += __atomic_load_n(&a[i], __ATOMIC_RELAXED);
+			b_counts[i]
+			    += __atomic_load_n(&b[i], __ATOMIC_RELAXED);
+		}
+	}
+}
+
+int one_sided_ks_recorder_snapshot_ecdf(
+    const struct one_sided_ks_recorder *recorder,
+    struct one_sided_ks_ecdf *ecdf)
+{
+	const size_t num_buckets = recorder->num_buckets;
+
+	assert(one_sided_ks_ecdf_num_buckets(ecdf) == num_buckets
+	    && "bucket count mismatch");
+
+	uint64_t *counts = malloc(2 * num_buckets * sizeof(uint64_t));
+	if (counts == NULL) {
+		return -1;
+	}
+
+	one_sided_ks_recorder_snapshot(
+	    recorder, counts, counts + num_buckets);
+	one_sided_ks_ecdf_load(ecdf, counts, counts + num_buckets);
+	free(counts);
+	return 0;
+}
@@ -0,0 +1,70 @@
+#ifndef ONE_SIDED_KS_RECORDER_H
+#define ONE_SIDED_KS_RECORDER_H
+#include <stddef.h>
+#include <stdint.h>
+
+#include "one-sided-ks-ecdf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Multi-producer histogram recorder for two-sample tests.
+ *
+ * Each thread records observations to one of `num_shards` copies of
+ * the A and B histograms, each aligned to cache lines.  Recording is
+ * a single relaxed atomic increment, so it's wait-free, and only
+ * contends when more threads than shards are recording at once.
+ *
+ * Snapshots sum all shards into one pair of histograms.  They include
+ * every observation recorded before the snapshot started, and may or
+ * may not include observations recorded concurrently; the sample
+ * sizes are always derived from the snapshotted counts themselves, so
+ * the statistic and the threshold always agree.
+ */
+struct one_sided_ks_recorder;
+
+/*
+ * Returns a recorder for `num_buckets` buckets, with `num_shards`
+ * shards (one per configured CPU if 0), or NULL on failure.
+ *
+ * Memory usage is 16 * num_buckets * num_shards bytes.
+ */
+struct one_sided_ks_recorder *one_sided_ks_recorder_create(
+    size_t num_buckets, size_t num_shards);
+
+void one_sided_ks_recorder_destroy(struct one_sided_ks_recorder *recorder);
+
+size_t one_sided_ks_recorder_num_buckets(
+    const struct one_sided_ks_recorder *recorder);
+
+size_t one_sided_ks_recorder_num_shards(
+    const struct one_sided_ks_recorder *recorder);
+
+/* Records one observation for `arm` in `bucket`.  Thread-safe. */
+void one_sided_ks_recorder_record(struct one_sided_ks_recorder *recorder,
+    enum one_sided_ks_arm arm, size_t bucket);
+
+/*
+ * Sums all shards into `a_counts` and `b_counts`, which must each
+ * have room for `num_buckets` values.  Safe to call concurrently
+ * with `one_sided_ks_recorder_record`.
+ */
+void one_sided_ks_recorder_snapshot(
+    const struct one_sided_ks_recorder *recorder, uint64_t *a_counts,
+    uint64_t *b_counts);
+
+/*
+ * Replaces the contents of `ecdf`, which must have the same number of
+ * buckets as `recorder`, with a snapshot.
+ *
+ * Returns 0 on success, -1 on allocation failure.
+ */
+int one_sided_ks_recorder_snapshot_ecdf(
+    const struct one_sided_ks_recorder *recorder,
+    struct one_sided_ks_ecdf *ecdf);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /* !ONE_SIDED_KS_RECORDER_H */
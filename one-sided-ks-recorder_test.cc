@@ -0,0 +1,148 @@
+#include "one-sided-ks-recorder.h"
+
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "one-sided-ks-ecdf.h"
+#include "one-sided-ks.h"
+
+namespace {
+TEST(OneSidedKsRecorder, SingleThread)
+{
+	struct one_sided_ks_recorder *recorder
+	    = one_sided_ks_recorder_create(10, 3);
+	std::vector<uint64_t> a(10), b(10);
+
+	ASSERT_NE(recorder, nullptr);
+	EXPECT_EQ(one_sided_ks_recorder_num_buckets(recorder), 10);
+	EXPECT_EQ(one_sided_ks_recorder_num_shards(recorder), 3);
+	for (size_t i = 0; i < 10; ++i) {
+		for (size_t j = 0; j <= i; ++j) {
+			one_sided_ks_recorder_record(
+			    recorder, ONE_SIDED_KS_ARM_A, i);
+		}
+
+		one_sided_ks_recorder_record(
+		    recorder, ONE_SIDED_KS_ARM_B, 9 - i);
+	}
+
+	one_sided_ks_recorder_snapshot(recorder, a.data(), b.data());
+	for (size_t i = 0; i < 10; ++i) {
+		EXPECT_EQ(a[i], i + 1);
+		EXPECT_EQ(b[i], 1);
+	}
+
+	one_sided_ks_recorder_destroy(recorder);
+	EXPECT_EQ(one_sided_ks_recorder_create(0, 1), nullptr);
+}
+
+// Hammer the recorder from many threads, with concurrent snapshots.
+TEST(OneSidedKsRecorder, MultiThread)
+{
+	constexpr size_t kThreads = 8;
+	constexpr size_t kPerThread = 100000;
+	constexpr size_t kBuckets = 100;
+	struct one_sided_ks_recorder *recorder
+	    = one_sided_ks_recorder_create(kBuckets, 0);
+	struct one_sided_ks_ecdf *ecdf = one_sided_ks_ecdf_create(kBuckets);
+	std::atomic<bool> done(false);
+	std::vector<std::thread> threads;
+
+	for (size_t t = 0; t < kThreads; ++t) {
+		threads.emplace_back([recorder, t] {
+			for (size_t i = 0; i < kPerThread; ++i) {
+				const size_t bucket = (i * 7 + t) % kBuckets;
+				one_sided_ks_recorder_record(recorder,
+				    (i % 2 == 0) ? ONE_SIDED_KS_ARM_A
+						 : ONE_SIDED_KS_ARM_B,
+				    bucket);
+			}
+		});
+	}
+
+	std::thread snapshotter([&] {
+		uint64_t prev = 0;
+		while (!done.load()) {
+			ASSERT_EQ(one_sided_ks_recorder_snapshot_ecdf(
+				      recorder, ecdf),
+			    0);
+			const uint64_t total = one_sided_ks_ecdf_count(
+						   ecdf, ONE_SIDED_KS_ARM_A)
+			    + one_sided_ks_ecdf_count(
+				ecdf, ONE_SIDED_KS_ARM_B);
+			EXPECT_GE(total, prev);
+			EXPECT_LE(total, kThreads * kPerThread);
+			prev = total;
+		}
+	});
+
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	done.store(true);
+	snapshotter.join();
+
+	std::vector<uint64_t> a(kBuckets), b(kBuckets);
+	one_sided_ks_recorder_snapshot(recorder, a.data(), b.data());
+	uint64_t total_a = 0;
+	uint64_t total_b = 0;
+	for (size_t i = 0; i < kBuckets; ++i) {
+		total_a += a[i];
+		total_b += b[i];
+	}
+
+	EXPECT_EQ(total_a, kThreads * kPerThread / 2);
+	EXPECT_EQ(total_b, kThreads * kPerThread / 2);
+
+	ASSERT_EQ(one_sided_ks_recorder_snapshot_ecdf(recorder, ecdf), 0);
+	EXPECT_EQ(one_sided_ks_ecdf_count(ecdf, ONE_SIDED_KS_ARM_A), total_a);
+	for (size_t i = 0; i < kBuckets; ++i) {
+		EXPECT_EQ(one_sided_ks_ecdf_bucket_count(
+			      ecdf, ONE_SIDED_KS_ARM_B, i),
+		    b[i]);
+	}
+
+	// Same distribution: we should not reject.
+	EXPECT_LT(one_sided_ks_ecdf_d_plus(ecdf),
+	    one_sided_ks_pair_threshold(total_a, 100, std::log(1e-6)));
+	one_sided_ks_ecdf_destroy(ecdf);
+	one_sided_ks_recorder_destroy(recorder);
+}
+
+// Loading a snapshot should be equivalent to adding observations.
+TEST(OneSidedKsRecorder, LoadMatchesAdd)
+{
+	std::mt19937 rng(3);
+	std::uniform_int_distribution<size_t> dist(0, 999);
+	struct one_sided_ks_recorder *recorder
+	    = one_sided_ks_recorder_create(1000, 2);
+	struct one_sided_ks_ecdf *expected = one_sided_ks_ecdf_create(1000);
+	struct one_sided_ks_ecdf *actual = one_sided_ks_ecdf_create(1000);
+
+	for (size_t i = 0; i < 10000; ++i) {
+		const size_t a = dist(rng);
+		const size_t b = dist(rng) / 2;
+
+		one_sided_ks_recorder_record(recorder, ONE_SIDED_KS_ARM_A, a);
+		one_sided_ks_recorder_record(recorder, ONE_SIDED_KS_ARM_B, b);
+		one_sided_ks_ecdf_add_pair(expected, a, b);
+	}
+
+	ASSERT_EQ(one_sided_ks_recorder_snapshot_ecdf(recorder, actual), 0);
+	EXPECT_EQ(one_sided_ks_ecdf_r_plus(actual),
+	    one_sided_ks_ecdf_r_plus(expected));
+	EXPECT_EQ(one_sided_ks_ecdf_r_minus(actual),
+	    one_sided_ks_ecdf_r_minus(expected));
+	EXPECT_EQ(one_sided_ks_ecdf_d_minus(actual),
+	    one_sided_ks_ecdf_d_minus(expected));
+	one_sided_ks_ecdf_destroy(expected);
+	one_sided_ks_ecdf_destroy(actual);
+	one_sided_ks_recorder_destroy(recorder);
+}
+} // namespace
@@ -0,0 +1,401 @@
+#include "one-sided-ks-reject-time.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "one-sided-ks-calibrate.h"
+#include "one-sided-ks.h"
+
+#define MAGIC "OSKR"
+#define MAGIC_SIZE 4
+#define VERSION 1
+
+/* Entries store the quantiles for q = i / GRID_SIZE, 0 <= i <= GRID_SIZE. */
+#define GRID_SIZE 1000
+
+#define DEFAULT_NUM_TRIALS 10000
+#define MAX_NUM_TRIALS ((uint64_t)UINT32_MAX)
+
+/*
+ * Each record is the key, `num_trials`, and the grid, as
+ * little-endian 64-bit words.
+ */
+#define RECORD_WORDS (5 + GRID_SIZE + 1)
+#define RECORD_SIZE (8 * RECORD_WORDS)
+
+struct entry {
+	struct one_sided_ks_reject_time_key key;
+	uint64_t num_trials;
+	uint64_t grid[GRID_SIZE + 1];
+};
+
+struct one_sided_ks_reject_time_cache {
+	char *path;
+	struct one_sided_ks_reject_time_options options;
+	struct entry *entries;
+	size_t num_entries;
+	size_t capacity;
+};
+
+static uint64_t double_bits(double x)
+{
+	uint64_t ret;
+
+	memcpy(&ret, &x, sizeof(ret));
+	return ret;
+}
+
+static double bits_double(uint64_t bits)
+{
+	double ret;
+
+	memcpy(&ret, &bits, sizeof(ret));
+	return ret;
+}
+
+static uint8_t *put_u64(uint8_t *out, uint64_t x)
+{
+	for (size_t i = 0; i < sizeof(x); ++i) {
+		*out++ = (uint8_t)(x >> (8 * i));
+	}
+
+	return out;
+}
+
+static uint64_t get_u64(const uint8_t *in)
+{
+	uint64_t ret = 0;
+
+	for (size_t i = 0; i < sizeof(ret); ++i) {
+		ret |= (uint64_t)in[i] << (8 * i);
+	}
+
+	return ret;
+}
+
+static void encode(const struct entry *entry, uint8_t *out)
+{
+	out = put_u64(out, entry->key.min_count);
+	out = put_u64(out, double_bits(entry->key.log_eps));
+	out = put_u64(out, double_bits(entry->key.delta));
+	out = put_u64(out, entry->key.num_buckets);
+	out = put_u64(out, entry->num_trials);
+	for (size_t i = 0; i <= GRID_SIZE; ++i) {
+		out = put_u64(out, entry->grid[i]);
+	}
+}
+
+static void decode(const uint8_t *in, struct entry *entry)
+{
+	entry->key.min_count = get_u64(&in[0]);
+	entry->key.log_eps = bits_double(get_u64(&in[8]));
+	entry->key.delta = bits_double(get_u64(&in[16]));
+	entry->key.num_buckets = (size_t)get_u64(&in[24]);
+	entry->num_trials = get_u64(&in[32]);
+	for (size_t i = 0; i <= GRID_SIZE; ++i) {
+		entry->grid[i] = get_u64(&in[8 * (5 + i)]);
+	}
+}
+
+static bool key_valid(const struct one_sided_ks_reject_time_key *key)
+{
+	return key->num_buckets >= 2 && key->log_eps < 0
+	    && one_sided_ks_min_count_valid(key->min_count, key->log_eps)
+	    && key->delta > 0
+	    && key->delta * key->num_buckets <= key->num_buckets - 1;
+}
+
+static bool key_eq(const struct one_sided_ks_reject_time_key *x,
+    const struct one_sided_ks_reject_time_key *y)
+{
+	return x->min_count == y->min_count && x->log_eps == y->log_eps
+	    && x->delta == y->delta && x->num_buckets == y->num_buckets;
+}
+
+static struct entry *append(struct one_sided_ks_reject_time_cache *cache)
+{
+	if (cache->num_entries == cache->capacity) {
+		const size_t capacity
+		    = (cache->capacity == 0) ? 4 : 2 * cache->capacity;
+		struct entry *entries;
+
+		if (capacity > SIZE_MAX / sizeof(*entries)) {
+			return NULL;
+		}
+
+		entries
+		    = realloc(cache->entries, capacity * sizeof(*entries));
+		if (entries == NULL) {
+			return NULL;
+		}
+
+		cache->entries = entries;
+		cache->capacity = capacity;
+	}
+
+	return &cache->entries[cache->num_entries++];
+}
+
+/* Loads every record in `file`, which may be empty. */
+static int load(struct one_sided_ks_reject_time_cache *cache, FILE *file)
+{
+	uint8_t header[MAGIC_SIZE + 1];
+	const size_t header_size = fread(header, 1, sizeof(header), file);
+
+	if (header_size == 0 && feof(file)) {
+		return 0;
+	}
+
+	if (header_size != sizeof(header)
+	    || memcmp(header, MAGIC, MAGIC_SIZE) != 0
+	    || header[MAGIC_SIZE] != VERSION) {
+		return -1;
+	}
+
+	for (;;) {
+		uint8_t record[RECORD_SIZE];
+		const size_t size = fread(record, 1, sizeof(record), file);
+		struct entry *entry;
+
+		if (size == 0) {
+			return ferror(file) ? -1 : 0;
+		}
+
+		if (size != sizeof(record)) {
+			return -1;
+		}
+
+		entry = append(cache);
+		if (entry == NULL) {
+			return -1;
+		}
+
+		decode(record, entry);
+		if (!key_valid(&entry->key)) {
+			return -1;
+		}
+	}
+}
+
+/* Writes all entries to a temporary file, and renames it over `path`. */
+static int save(const struct one_sided_ks_reject_time_cache *cache)
+{
+	const size_t length = strlen(cache->path);
+	char *tmp = malloc(length + sizeof(".tmp"));
+	uint8_t record[RECORD_SIZE];
+	FILE *file;
+	bool ok;
+
+	if (tmp == NULL) {
+		return -1;
+	}
+
+	memcpy(tmp, cache->path, length);
+	memcpy(tmp + length, ".tmp", sizeof(".tmp"));
+	file = fopen(tmp, "wb");
+	if (file == NULL) {
+		free(tmp);
+		return -1;
+	}
+
+	ok = fwrite(MAGIC, 1, MAGIC_SIZE, file) == MAGIC_SIZE
+	    && fputc(VERSION, file) == VERSION;
+	for (size_t i = 0; ok && i < cache->num_entries; ++i) {
+		encode(&cache->entries[i], record);
+		ok = fwrite(record, 1, sizeof(record), file)
+		    == sizeof(record);
+	}
+
+	ok = (fclose(file) == 0) && ok;
+	ok = ok && rename(tmp, cache->path) == 0;
+	if (!ok) {
+		remove(tmp);
+	}
+
+	free(tmp);
+	return ok ? 0 : -1;
+}
+
+struct one_sided_ks_reject_time_cache *one_sided_ks_reject_time_cache_create(
+    const char *path, const struct one_sided_ks_reject_time_options *options)
+{
+	struct one_sided_ks_reject_time_cache *cache;
+
+	if (options->num_trials > MAX_NUM_TRIALS) {
+		return NULL;
+	}
+
+	cache = calloc(1, sizeof(*cache));
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	cache->options = *options;
+	if (cache->options.num_trials == 0) {
+		cache->options.num_trials = DEFAULT_NUM_TRIALS;
+	}
+
+	if (path == NULL) {
+		return cache;
+	}
+
+	cache->path = strdup(path);
+	if (cache->path == NULL) {
+		one_sided_ks_reject_time_cache_destroy(cache);
+		return NULL;
+	}
+
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) {
+		return cache;
+	}
+
+	const int ret = load(cache, file);
+	fclose(file);
+	if (ret != 0) {
+		one_sided_ks_reject_time_cache_destroy(cache);
+		return NULL;
+	}
+
+	return cache;
+}
+
+void one_sided_ks_reject_time_cache_destroy(
+    struct one_sided_ks_reject_time_cache *cache)
+{
+	if (cache == NULL) {
+		return;
+	}
+
+	free(cache->path);
+	free(cache->entries);
+	free(cache);
+}
+
+static int cmp_u64(const void *x, const void *y)
+{
+	const uint64_t a = *(const uint64_t *)x;
+	const uint64_t b = *(const uint64_t *)y;
+
+	return (a > b) - (a < b);
+}
+
+/* Runs the trials for `entry->key`, and fills in the rest of `entry`. */
+static int estimate(const struct one_sided_ks_reject_time_cache *cache,
+    struct entry *entry)
+{
+	const struct one_sided_ks_reject_time_key *key = &entry->key;
+	const uint64_t num_trials = cache->options.num_trials;
+	const double expected_iter = one_sided_ks_expected_iter(
+	    key->min_count, key->log_eps, key->delta);
+	const double max_steps
+	    = key->min_count + GRID_SIZE * (expected_iter - key->min_count);
+	const double discrepancy
+	    = key->delta * key->num_buckets / (key->num_buckets - 1);
+	struct one_sided_ks_calibrate_result result;
+	uint64_t *steps;
+
+	if (!(max_steps < 0x1p53)) {
+		return -1;
+	}
+
+	const struct one_sided_ks_calibrate_params params = {
+		.min_count = key->min_count,
+		.log_eps = key->log_eps,
+		.two_sided = false,
+		.range = key->num_buckets,
+		.discrepancy = (discrepancy < 1) ? discrepancy : 1,
+		.max_steps = (uint64_t)ceil(max_steps),
+		.max_trials = num_trials,
+		.seed = cache->options.seed,
+		.num_threads = cache->options.num_threads,
+	};
+
+	steps = malloc(num_trials * sizeof(uint64_t));
+	if (steps == NULL) {
+		return -1;
+	}
+
+	if (one_sided_ks_calibrate_run(&params, &result, steps) != 0) {
+		free(steps);
+		return -1;
+	}
+
+	/* Censored trials are UINT64_MAX, and sort last. */
+	qsort(steps, num_trials, sizeof(uint64_t), cmp_u64);
+	entry->num_trials = num_trials;
+	entry->grid[0] = steps[0];
+	for (uint64_t i = 1; i <= GRID_SIZE; ++i) {
+		entry->grid[i]
+		    = steps[(i * num_trials + GRID_SIZE - 1) / GRID_SIZE - 1];
+	}
+
+	free(steps);
+	return 0;
+}
+
+static const struct entry *find(
+    const struct one_sided_ks_reject_time_cache *cache,
+    const struct one_sided_ks_reject_time_key *key)
+{
+	for (size_t i = 0; i < cache->num_entries; ++i) {
+		const struct entry *entry = &cache->entries[i];
+
+		if (key_eq(&entry->key, key)
+		    && entry->num_trials == cache->options.num_trials) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+int one_sided_ks_reject_time_quantile(
+    struct one_sided_ks_reject_time_cache *cache,
+    const struct one_sided_ks_reject_time_key *key, double q,
+    uint64_t *out)
+{
+	const struct entry *entry;
+
+	if (!key_valid(key) || !(q >= 0 && q <= 1)) {
+		return -1;
+	}
+
+	entry = find(cache, key);
+	if (entry == NULL) {
+		struct entry *fresh = append(cache);
+
+		if (fresh == NULL) {
+			return -1;
+		}
+
+		fresh->key = *key;
+		if (estimate(cache, fresh) != 0) {
+			--cache->num_entries;
+			return -1;
+		}
+
+		if (cache->path != NULL) {
+			(void)save(cache);
+		}
+
+		entry = fresh;
+	}
+
+	/*
+	 * Round up to the next grid point.  q = i / 1000.0 is only the
+	 * double nearest to i / 1000, so if q * 1000 rounds above i,
+	 * that's still grid point i, not i + 1.
+	 */
+	double index = ceil(q * GRID_SIZE);
+
+	if (index > 0 && (index - 1) / GRID_SIZE == q) {
+		--index;
+	}
+
+	*out = entry->grid[(size_t)index];
+	return 0;
+}
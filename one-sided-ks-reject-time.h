@@ -0,0 +1,79 @@
+#ifndef ONE_SIDED_KS_REJECT_TIME_H
+#define ONE_SIDED_KS_REJECT_TIME_H
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Simulated quantiles of the number of pairs before the paired test
+ * rejects, when the actual distance between the two CDFs is `delta`.
+ *
+ * `one_sided_ks_expected_iter` only bounds the mean, and quantiles
+ * derived from it with Markov's inequality are extremely
+ * conservative.  Instead, we run `num_trials` trials with
+ * `one_sided_ks_calibrate_run`, over `num_buckets` values, where B is
+ * replaced by the largest value with probability `delta *
+ * num_buckets / (num_buckets - 1)`, so D+ converges to `delta`.
+ *
+ * Each estimate is summarised as 1001 per-mille quantiles, and cached
+ * in memory and, optionally, in a file, so that later queries for the
+ * same parameters only take a lookup.  Trials stop after `min_count +
+ * 1000 * (expected_iter - min_count)` pairs; by Markov's inequality,
+ * that censors fewer than 0.1% of the trials, in expectation.
+ */
+struct one_sided_ks_reject_time_key {
+	uint64_t min_count;
+	double log_eps;
+	/* Distance between the CDFs, in (0, 1 - 1 / num_buckets]. */
+	double delta;
+	/* At least 2. */
+	size_t num_buckets;
+};
+
+struct one_sided_ks_reject_time_options {
+	/* Trials per estimate; 0 for 10000. */
+	uint64_t num_trials;
+	uint64_t seed;
+	/* 0 for one thread per online CPU. */
+	size_t num_threads;
+};
+
+struct one_sided_ks_reject_time_cache;
+
+/*
+ * Returns a new cache, or NULL on failure.  If `path` is not NULL,
+ * the cache loads all entries in `path`, if it exists, and saves new
+ * entries to `path`.  Entries computed with a different `num_trials`
+ * are preserved, but not used.  Fails if `path` exists but isn't a
+ * valid cache file.
+ *
+ * Caches are not thread-safe.
+ */
+struct one_sided_ks_reject_time_cache *one_sided_ks_reject_time_cache_create(
+    const char *path, const struct one_sided_ks_reject_time_options *options);
+
+void one_sided_ks_reject_time_cache_destroy(
+    struct one_sided_ks_reject_time_cache *cache);
+
+/*
+ * Stores in `out` the least number of pairs by which at least a
+ * fraction `q` of the trials for `key` rejected (rounding `q` up to
+ * the next per-mille), or UINT64_MAX if too many trials were
+ * censored.  Runs the simulation on cache misses, and then rewrites
+ * the cache file (atomically, with a rename); failures to save are
+ * otherwise ignored.
+ *
+ * Returns 0 on success, -1 if `key` or `q` is invalid (`min_count`
+ * must be valid for `log_eps`, and `q` in [0, 1]), or on failure.
+ */
+int one_sided_ks_reject_time_quantile(
+    struct one_sided_ks_reject_time_cache *cache,
+    const struct one_sided_ks_reject_time_key *key, double q,
+    uint64_t *out);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /* !ONE_SIDED_KS_REJECT_TIME_H */
@@ -0,0 +1,210 @@
+#include "one-sided-ks-reject-time.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "one-sided-ks.h"
+
+namespace {
+const double kLogEps = std::log(0.05);
+
+one_sided_ks_reject_time_key make_key(double delta)
+{
+	one_sided_ks_reject_time_key ret;
+
+	ret.min_count = one_sided_ks_find_min_count(kLogEps);
+	ret.log_eps = kLogEps;
+	ret.delta = delta;
+	ret.num_buckets = 10;
+	return ret;
+}
+
+one_sided_ks_reject_time_options make_options(uint64_t seed)
+{
+	one_sided_ks_reject_time_options ret;
+
+	ret.num_trials = 500;
+	ret.seed = seed;
+	ret.num_threads = 0;
+	return ret;
+}
+
+long file_size(const std::string &path)
+{
+	FILE *file = std::fopen(path.c_str(), "rb");
+	long ret;
+
+	if (file == nullptr) {
+		return -1;
+	}
+
+	std::fseek(file, 0, SEEK_END);
+	ret = std::ftell(file);
+	std::fclose(file);
+	return ret;
+}
+
+int quantile(one_sided_ks_reject_time_cache *cache,
+    const one_sided_ks_reject_time_key &key, double q, uint64_t *out)
+{
+	return one_sided_ks_reject_time_quantile(cache, &key, q, out);
+}
+
+one_sided_ks_reject_time_cache *create_cache(
+    const std::string &path, const one_sided_ks_reject_time_options &options)
+{
+	return one_sided_ks_reject_time_cache_create(
+	    path.empty() ? nullptr : path.c_str(), &options);
+}
+
+TEST(OneSidedKsRejectTime, Invalid)
+{
+	const one_sided_ks_reject_time_options options = make_options(1);
+	one_sided_ks_reject_time_cache *cache = create_cache("", options);
+	uint64_t out;
+
+	ASSERT_NE(cache, nullptr);
+
+	one_sided_ks_reject_time_key key = make_key(0);
+	EXPECT_EQ(-1, quantile(cache, key, 0.5, &out));
+
+	// D+ can't exceed 0.9 with 10 buckets.
+	key = make_key(0.95);
+	EXPECT_EQ(-1, quantile(cache, key, 0.5, &out));
+
+	key = make_key(0.1);
+	key.min_count = 1;
+	EXPECT_EQ(-1, quantile(cache, key, 0.5, &out));
+
+	key = make_key(0.1);
+	key.num_buckets = 1;
+	EXPECT_EQ(-1, quantile(cache, key, 0.5, &out));
+
+	key = make_key(0.1);
+	EXPECT_EQ(-1, quantile(cache, key, 1.5, &out));
+	EXPECT_EQ(-1, quantile(cache, key, NAN, &out));
+
+	one_sided_ks_reject_time_cache_destroy(cache);
+}
+
+// Quantiles are non-decreasing, at least min_count, and well below
+// the Markov bounds derived from expected_iter.
+TEST(OneSidedKsRejectTime, Quantiles)
+{
+	const one_sided_ks_reject_time_options options = make_options(1);
+	const one_sided_ks_reject_time_key key = make_key(0.1);
+	const double expected_iter = one_sided_ks_expected_iter(
+	    key.min_count, key.log_eps, key.delta);
+	one_sided_ks_reject_time_cache *cache = create_cache("", options);
+	uint64_t prev = 0;
+
+	ASSERT_NE(cache, nullptr);
+	for (const double q : { 0.0, 0.1, 0.5, 0.9, 0.99, 1.0 }) {
+		uint64_t out;
+
+		ASSERT_EQ(0, quantile(cache, key, q, &out));
+		EXPECT_GE(out, key.min_count) << q;
+		EXPECT_GE(out, prev) << q;
+		prev = out;
+	}
+
+	uint64_t median;
+	uint64_t p90;
+	ASSERT_EQ(0, quantile(cache, key, 0.5, &median));
+	ASSERT_EQ(0, quantile(cache, key, 0.9, &p90));
+	EXPECT_LT(median, expected_iter);
+	EXPECT_LT(p90, key.min_count + 10 * (expected_iter - key.min_count));
+
+	// Intermediate values round up to the next per-mille.
+	uint64_t between;
+	uint64_t next;
+	ASSERT_EQ(0, quantile(cache, key, 0.4995, &between));
+	ASSERT_EQ(0, quantile(cache, key, 0.5, &next));
+	EXPECT_EQ(next, between);
+
+	// Per-mille values i / 1000.0 don't, even if q * 1000 rounds
+	// above i, but anything above them does, even by a hair.
+	for (uint64_t i = 1; i <= 1000; ++i) {
+		uint64_t exact;
+
+		ASSERT_EQ(0,
+		    quantile(cache, key, (i - 0.5) / 1000, &between));
+		ASSERT_EQ(0, quantile(cache, key, i / 1000.0, &exact));
+		EXPECT_EQ(between, exact) << i;
+		if (i == 1000) {
+			break;
+		}
+
+		ASSERT_EQ(0, quantile(cache, key, (i + 0.5) / 1000, &next));
+		ASSERT_EQ(0,
+		    quantile(cache, key, i / 1000.0 + 1e-9, &exact));
+		EXPECT_EQ(next, exact) << i;
+	}
+
+	one_sided_ks_reject_time_cache_destroy(cache);
+}
+
+TEST(OneSidedKsRejectTime, Persist)
+{
+	const std::string path
+	    = testing::TempDir() + "one-sided-ks-reject-time_test.bin";
+	const one_sided_ks_reject_time_key key = make_key(0.2);
+	const one_sided_ks_reject_time_key other = make_key(0.3);
+	one_sided_ks_reject_time_options options = make_options(1);
+	uint64_t expected;
+	uint64_t out;
+
+	std::remove(path.c_str());
+	one_sided_ks_reject_time_cache *cache = create_cache(path, options);
+	ASSERT_NE(cache, nullptr);
+	ASSERT_EQ(0, quantile(cache, key, 0.9, &expected));
+	ASSERT_EQ(0, quantile(cache, other, 0.9, &out));
+	one_sided_ks_reject_time_cache_destroy(cache);
+
+	const long size = file_size(path);
+	ASSERT_GT(size, 0);
+
+	// A different seed would give different quantiles, unless the
+	// entry comes from the file.
+	options = make_options(2);
+	cache = create_cache(path, options);
+	ASSERT_NE(cache, nullptr);
+	ASSERT_EQ(0, quantile(cache, key, 0.9, &out));
+	EXPECT_EQ(expected, out);
+	EXPECT_EQ(size, file_size(path));
+	one_sided_ks_reject_time_cache_destroy(cache);
+
+	// Entries for another number of trials are recomputed, and
+	// preserved.
+	options.num_trials = 100;
+	cache = create_cache(path, options);
+	ASSERT_NE(cache, nullptr);
+	ASSERT_EQ(0, quantile(cache, key, 0.9, &out));
+	one_sided_ks_reject_time_cache_destroy(cache);
+	EXPECT_GT(file_size(path), size);
+
+	options = make_options(2);
+	cache = create_cache(path, options);
+	ASSERT_NE(cache, nullptr);
+	ASSERT_EQ(0, quantile(cache, key, 0.9, &out));
+	EXPECT_EQ(expected, out);
+	one_sided_ks_reject_time_cache_destroy(cache);
+
+	// Partial records are invalid, and so are other files.
+	for (const std::string &contents :
+	    { std::string("OSKR\001xyz"), std::string("not a cache") }) {
+		const size_t size = contents.size();
+		FILE *file = std::fopen(path.c_str(), "wb");
+
+		ASSERT_NE(file, nullptr);
+		ASSERT_EQ(std::fwrite(contents.data(), 1, size, file), size);
+		ASSERT_EQ(std::fclose(file), 0);
+		EXPECT_EQ(create_cache(path, options), nullptr) << contents;
+	}
+
+	std::remove(path.c_str());
+}
+} // namespace
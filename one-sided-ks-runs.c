@@ -0,0 +1,405 @@
+#include "one-sided-ks-runs.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "one-sided-ks-ratio.h"
+
+/* New values accumulate here before we sort them into a run. */
+#define BUFFER_CAPACITY 256
+
+/*
+ * Each run is more than twice as large as the next one, so 64 runs
+ * suffice for any count that fits in a uint64_t.
+ */
+#define MAX_RUNS 64
+
+struct run {
+	double *values;
+	size_t size;
+};
+
+struct arm_runs {
+	uint64_t count;
+	size_t num_runs;
+	/* Sorted runs, from the oldest (and largest) to the newest. */
+	struct run runs[MAX_RUNS];
+	/* Unsorted values, with room for BUFFER_CAPACITY. */
+	double *buffer;
+	size_t buffer_size;
+};
+
+struct one_sided_ks_runs {
+	struct arm_runs arms[2];
+	/* Whether the statistics below predate the last insertion. */
+	bool stale;
+	/* Extreme #{A <= x} - #{B <= x}. */
+	int64_t max_diff;
+	int64_t min_diff;
+	/* Extreme n_B #{A <= x} - n_A #{B <= x}. */
+	__int128 max_scaled;
+	__int128 min_scaled;
+};
+
+struct one_sided_ks_runs *one_sided_ks_runs_create(void)
+{
+	struct one_sided_ks_runs *runs = calloc(1, sizeof(*runs));
+	if (runs == NULL) {
+		return NULL;
+	}
+
+	for (size_t i = 0; i < 2; ++i) {
+		struct arm_runs *arm = &runs->arms[i];
+
+		arm->buffer = malloc(BUFFER_CAPACITY * sizeof(double));
+		if (arm->buffer == NULL) {
+			one_sided_ks_runs_destroy(runs);
+			return NULL;
+		}
+	}
+
+	return runs;
+}
+
+void one_sided_ks_runs_destroy(struct one_sided_ks_runs *runs)
+{
+	if (runs == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < 2; ++i) {
+		struct arm_runs *arm = &runs->arms[i];
+
+		for (size_t j = 0; j < arm->num_runs; ++j) {
+			free(arm->runs[j].values);
+		}
+
+		free(arm->buffer);
+	}
+
+	free(runs);
+}
+
+static int cmp_double(const void *x, const void *y)
+{
+	const double a = *(const double *)x;
+	const double b = *(const double *)y;
+
+	return (a > b) - (a < b);
+}
+
+/*
+ * Merges the two newest runs into one.  Returns 0 on success, -1 on
+ * allocation failure, in which case the runs are unchanged.
+ */
+static int merge_top(struct arm_runs *arm)
+{
+	struct run *x = &arm->runs[arm->num_runs - 2];
+	struct run *y = &arm->runs[arm->num_runs - 1];
+	const size_t size = x->size + y->size;
+	double *merged = malloc(size * sizeof(double));
+	size_t i = 0;
+	size_t j = 0;
+	size_t k = 0;
+
+	if (merged == NULL) {
+		return -1;
+	}
+
+	while (i < x->size && j < y->size) {
+		if (y->values[j] < x->values[i]) {
+			merged[k++] = y->values[j++];
+		} else {
+			merged[k++] = x->values[i++];
+		}
+	}
+
+	while (i < x->size) {
+		merged[k++] = x->values[i++];
+	}
+
+	while (j < y->size) {
+		merged[k++] = y->values[j++];
+	}
+
+	free(x->values);
+	free(y->values);
+	x->values = merged;
+	x->size = size;
+	--arm->num_runs;
+	return 0;
+}
+
+/*
+ * Sorts the buffer and pushes it as the newest run, then merges
+ * runs until each is more than twice as large as the next.  Returns
+ * 0 on success, -1 on allocation failure, in which case the buffer
+ * is unchanged (but maybe sorted).
+ */
+static int flush(struct arm_runs *arm)
+{
+	double *fresh;
+
+	if (arm->buffer_size == 0) {
+		return 0;
+	}
+
+	if (arm->num_runs == MAX_RUNS && merge_top(arm) != 0) {
+		return -1;
+	}
+
+	fresh = malloc(BUFFER_CAPACITY * sizeof(double));
+	if (fresh == NULL) {
+		return -1;
+	}
+
+	qsort(arm->buffer, arm->buffer_size, sizeof(double), cmp_double);
+	arm->runs[arm->num_runs].values = arm->buffer;
+	arm->runs[arm->num_runs].size = arm->buffer_size;
+	++arm->num_runs;
+	arm->buffer = fresh;
+	arm->buffer_size = 0;
+
+	/* Merge failures only leave more runs for checks to walk. */
+	while (arm->num_runs >= 2
+	    && arm->runs[arm->num_runs - 2].size
+		<= 2 * arm->runs[arm->num_runs - 1].size) {
+		if (merge_top(arm) != 0) {
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/* Makes room for one more value in the buffer. */
+static int reserve(struct arm_runs *arm)
+{
+	if (arm->buffer_size < BUFFER_CAPACITY) {
+		return 0;
+	}
+
+	return flush(arm);
+}
+
+static void push(struct arm_runs *arm, double value)
+{
+	arm->buffer[arm->buffer_size++] = value;
+	++arm->count;
+}
+
+int one_sided_ks_runs_add(
+    struct one_sided_ks_runs *runs, enum one_sided_ks_arm arm, double value)
+{
+	/* The merge in `update` could never skip past a NaN. */
+	if (isnan(value) || reserve(&runs->arms[arm]) != 0) {
+		return -1;
+	}
+
+	push(&runs->arms[arm], value);
+	runs->stale = true;
+	return 0;
+}
+
+int one_sided_ks_runs_add_pair(
+    struct one_sided_ks_runs *runs, double a, double b)
+{
+	if (isnan(a) || isnan(b)
+	    || reserve(&runs->arms[ONE_SIDED_KS_ARM_A]) != 0
+	    || reserve(&runs->arms[ONE_SIDED_KS_ARM_B]) != 0) {
+		return -1;
+	}
+
+	push(&runs->arms[ONE_SIDED_KS_ARM_A], a);
+	push(&runs->arms[ONE_SIDED_KS_ARM_B], b);
+	runs->stale = true;
+	return 0;
+}
+
+uint64_t one_sided_ks_runs_count(
+    const struct one_sided_ks_runs *runs, enum one_sided_ks_arm arm)
+{
+	return runs->arms[arm].count;
+}
+
+/*
+ * Merges everything in one sorted run, so the next check only has to
+ * merge what's been added since.  On allocation failure, we can
+ * still walk the remaining runs (and the sorted buffer), just slower.
+ */
+static void compact(struct arm_runs *arm)
+{
+	if (flush(arm) != 0) {
+		qsort(arm->buffer, arm->buffer_size, sizeof(double),
+		    cmp_double);
+	}
+
+	while (arm->num_runs >= 2) {
+		if (merge_top(arm) != 0) {
+			return;
+		}
+	}
+}
+
+/* Walks the union of an arm's runs and buffer in sorted order. */
+struct cursor {
+	size_t num_runs;
+	const double *pos[MAX_RUNS + 1];
+	const double *end[MAX_RUNS + 1];
+};
+
+static void cursor_init(struct cursor *cursor, const struct arm_runs *arm)
+{
+	cursor->num_runs = 0;
+	for (size_t i = 0; i < arm->num_runs; ++i) {
+		cursor->pos[cursor->num_runs] = arm->runs[i].values;
+		cursor->end[cursor->num_runs] = arm->runs[i].values
+		    + arm->runs[i].size;
+		++cursor->num_runs;
+	}
+
+	/* Only non-empty after an allocation failure in `compact`. */
+	cursor->pos[cursor->num_runs] = arm->buffer;
+	cursor->end[cursor->num_runs] = arm->buffer + arm->buffer_size;
+	++cursor->num_runs;
+}
+
+/* Lowers *min to the cursor's least value, if any. */
+static void cursor_min(const struct cursor *cursor, double *min)
+{
+	for (size_t i = 0; i < cursor->num_runs; ++i) {
+		if (cursor->pos[i] < cursor->end[i]
+		    && *cursor->pos[i] < *min) {
+			*min = *cursor->pos[i];
+		}
+	}
+}
+
+/* Skips over all values <= x, and returns how many. */
+static uint64_t cursor_skip(struct cursor *cursor, double x)
+{
+	uint64_t ret = 0;
+
+	for (size_t i = 0; i < cursor->num_runs; ++i) {
+		const double *pos = cursor->pos[i];
+
+		while (pos < cursor->end[i] && *pos <= x) {
+			++pos;
+		}
+
+		ret += pos - cursor->pos[i];
+		cursor->pos[i] = pos;
+	}
+
+	return ret;
+}
+
+/*
+ * Computes the extreme differences between the two ECDFs in one
+ * linear walk.  All values equal to x must be counted in both arms
+ * before we look at the difference at x.
+ */
+static void update(struct one_sided_ks_runs *runs)
+{
+	struct arm_runs *a = &runs->arms[ONE_SIDED_KS_ARM_A];
+	struct arm_runs *b = &runs->arms[ONE_SIDED_KS_ARM_B];
+	const unsigned __int128 n_a = a->count;
+	const unsigned __int128 n_b = b->count;
+	struct cursor cursor_a;
+	struct cursor cursor_b;
+	uint64_t sum_a = 0;
+	uint64_t sum_b = 0;
+
+	if (!runs->stale) {
+		return;
+	}
+
+	compact(a);
+	compact(b);
+	cursor_init(&cursor_a, a);
+	cursor_init(&cursor_b, b);
+	runs->max_diff = 0;
+	runs->min_diff = 0;
+	runs->max_scaled = 0;
+	runs->min_scaled = 0;
+	while (sum_a < n_a || sum_b < n_b) {
+		double x = HUGE_VAL;
+
+		cursor_min(&cursor_a, &x);
+		cursor_min(&cursor_b, &x);
+		sum_a += cursor_skip(&cursor_a, x);
+		sum_b += cursor_skip(&cursor_b, x);
+
+		const int64_t diff = (int64_t)(sum_a - sum_b);
+		const __int128 scaled = (__int128)(n_b * sum_a)
+		    - (__int128)(n_a * sum_b);
+
+		if (diff > runs->max_diff) {
+			runs->max_diff = diff;
+		}
+
+		if (diff < runs->min_diff) {
+			runs->min_diff = diff;
+		}
+
+		if (scaled > runs->max_scaled) {
+			runs->max_scaled = scaled;
+		}
+
+		if (scaled < runs->min_scaled) {
+			runs->min_scaled = scaled;
+		}
+	}
+
+	runs->stale = false;
+}
+
+uint64_t one_sided_ks_runs_r_plus(struct one_sided_ks_runs *runs)
+{
+	update(runs);
+	return runs->max_diff;
+}
+
+uint64_t one_sided_ks_runs_r_minus(struct one_sided_ks_runs *runs)
+{
+	update(runs);
+	return -runs->min_diff;
+}
+
+double one_sided_ks_runs_d_plus(struct one_sided_ks_runs *runs)
+{
+	const uint64_t n_a = runs->arms[ONE_SIDED_KS_ARM_A].count;
+	const uint64_t n_b = runs->arms[ONE_SIDED_KS_ARM_B].count;
+
+	if (n_a == 0 || n_b == 0) {
+		return 0;
+	}
+
+	update(runs);
+	if (n_a == n_b) {
+		return one_sided_ks_ratio_down(runs->max_diff, n_a);
+	}
+
+	return one_sided_ks_ratio_down(
+	    runs->max_scaled, (unsigned __int128)n_a * n_b);
+}
+
+double one_sided_ks_runs_d_minus(struct one_sided_ks_runs *runs)
+{
+	const uint64_t n_a = runs->arms[ONE_SIDED_KS_ARM_A].count;
+	const uint64_t n_b = runs->arms[ONE_SIDED_KS_ARM_B].count;
+
+	if (n_a == 0 || n_b == 0) {
+		return 0;
+	}
+
+	update(runs);
+	if (n_a == n_b) {
+		return one_sided_ks_ratio_down(-runs->min_diff, n_a);
+	}
+
+	return one_sided_ks_ratio_down(
+	    -runs->min_scaled, (unsigned __int128)n_a * n_b);
+}
@@ -0,0 +1,79 @@
+#ifndef ONE_SIDED_KS_RUNS_H
+#define ONE_SIDED_KS_RUNS_H
+#include <stddef.h>
+#include <stdint.h>
+
+#include "one-sided-ks-ecdf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Exact two-sample statistics over raw (unbucketed) values.
+ *
+ * Each arm is a log-structured set of sorted runs: new values go to
+ * a small append buffer; full buffers are sorted and pushed as runs,
+ * and runs are merged, LSM style, whenever the newest run is at
+ * least half as large as the one before it.  There are thus
+ * O(log n) runs of geometrically decreasing sizes, and each
+ * insertion costs amortised O(log n).
+ *
+ * Computing a statistic merges each arm down to a single sorted run,
+ * which later checks reuse: a check only merges the values added
+ * since the previous check into that run, in linear time, and then
+ * walks both runs once.  When both samples have the same size `n`,
+ * compare D+ with `one_sided_ks_pair_threshold(n, min_count,
+ * log_eps)`, or `r_plus` with `one_sided_ks_pair_min_reject`;
+ * otherwise, compare D+ with `one_sided_ks_unpaired_threshold`.
+ *
+ * NaN values are rejected.  Equal values count as ties, across and
+ * within arms.
+ */
+struct one_sided_ks_runs;
+
+/* Returns a new empty set of samples, or NULL on failure. */
+struct one_sided_ks_runs *one_sided_ks_runs_create(void);
+
+void one_sided_ks_runs_destroy(struct one_sided_ks_runs *runs);
+
+/*
+ * Adds `value` to `arm`.  Returns 0 on success, -1 if `value` is NaN,
+ * or on allocation failure.
+ */
+int one_sided_ks_runs_add(
+    struct one_sided_ks_runs *runs, enum one_sided_ks_arm arm, double value);
+
+/*
+ * Adds `a` to A and `b` to B.  Returns 0 on success, -1 if either is
+ * NaN, or on allocation failure, in which case neither value was
+ * added.
+ */
+int one_sided_ks_runs_add_pair(
+    struct one_sided_ks_runs *runs, double a, double b);
+
+/* Returns the number of values in `arm`. */
+uint64_t one_sided_ks_runs_count(
+    const struct one_sided_ks_runs *runs, enum one_sided_ks_arm arm);
+
+/*
+ * Returns max_x [#{A <= x} - #{B <= x}], or 0 if that's negative.
+ * When both samples have `n` values, D+ = r_plus / n.
+ */
+uint64_t one_sided_ks_runs_r_plus(struct one_sided_ks_runs *runs);
+
+/* Same as `one_sided_ks_runs_r_plus`, with A and B swapped. */
+uint64_t one_sided_ks_runs_r_minus(struct one_sided_ks_runs *runs);
+
+/*
+ * Returns D+ = max_x [CDF_A(x) - CDF_B(x)], rounded down, or 0 if
+ * either sample is empty.
+ */
+double one_sided_ks_runs_d_plus(struct one_sided_ks_runs *runs);
+
+/* Returns D- = max_x [CDF_B(x) - CDF_A(x)], like `d_plus`. */
+double one_sided_ks_runs_d_minus(struct one_sided_ks_runs *runs);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /* !ONE_SIDED_KS_RUNS_H */
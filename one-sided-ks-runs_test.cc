@@ -0,0 +1,232 @@
+#include "one-sided-ks-runs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "one-sided-ks.h"
+
+namespace {
+using ::testing::DoubleNear;
+
+// Reference implementation: sort both samples and count.
+int64_t max_count_delta(std::vector<double> x, std::vector<double> y)
+{
+	std::sort(x.begin(), x.end());
+	std::sort(y.begin(), y.end());
+
+	int64_t best = 0;
+	for (const std::vector<double> *v : { &x, &y }) {
+		for (const double value : *v) {
+			const int64_t sum_x
+			    = std::upper_bound(x.begin(), x.end(), value)
+			    - x.begin();
+			const int64_t sum_y
+			    = std::upper_bound(y.begin(), y.end(), value)
+			    - y.begin();
+
+			best = std::max(best, sum_x - sum_y);
+		}
+	}
+
+	return best;
+}
+
+double max_cdf_delta(std::vector<double> x, std::vector<double> y)
+{
+	std::sort(x.begin(), x.end());
+	std::sort(y.begin(), y.end());
+
+	double best = 0;
+	for (const std::vector<double> *v : { &x, &y }) {
+		for (const double value : *v) {
+			const double sum_x
+			    = std::upper_bound(x.begin(), x.end(), value)
+			    - x.begin();
+			const double sum_y
+			    = std::upper_bound(y.begin(), y.end(), value)
+			    - y.begin();
+
+			best = std::max(
+			    best, sum_x / x.size() - sum_y / y.size());
+		}
+	}
+
+	return best;
+}
+
+TEST(OneSidedKsRuns, Empty)
+{
+	struct one_sided_ks_runs *runs = one_sided_ks_runs_create();
+
+	EXPECT_EQ(one_sided_ks_runs_count(runs, ONE_SIDED_KS_ARM_A), 0);
+	EXPECT_EQ(one_sided_ks_runs_count(runs, ONE_SIDED_KS_ARM_B), 0);
+	EXPECT_EQ(one_sided_ks_runs_r_plus(runs), 0);
+	EXPECT_EQ(one_sided_ks_runs_r_minus(runs), 0);
+	EXPECT_EQ(one_sided_ks_runs_d_plus(runs), 0);
+	EXPECT_EQ(one_sided_ks_runs_d_minus(runs), 0);
+
+	// Still 0 with only one sample.
+	ASSERT_EQ(one_sided_ks_runs_add(runs, ONE_SIDED_KS_ARM_A, 1.0), 0);
+	EXPECT_EQ(one_sided_ks_runs_d_plus(runs), 0);
+	EXPECT_EQ(one_sided_ks_runs_d_minus(runs), 0);
+	EXPECT_EQ(one_sided_ks_runs_r_plus(runs), 1);
+	one_sided_ks_runs_destroy(runs);
+}
+
+// Ties across arms must cancel out.
+TEST(OneSidedKsRuns, Ties)
+{
+	struct one_sided_ks_runs *runs = one_sided_ks_runs_create();
+
+	for (size_t i = 0; i < 1000; ++i) {
+		ASSERT_EQ(one_sided_ks_runs_add_pair(runs, 1.0, 1.0), 0);
+	}
+
+	EXPECT_EQ(one_sided_ks_runs_r_plus(runs), 0);
+	EXPECT_EQ(one_sided_ks_runs_r_minus(runs), 0);
+
+	ASSERT_EQ(one_sided_ks_runs_add_pair(runs, 0.0, 2.0), 0);
+	EXPECT_EQ(one_sided_ks_runs_r_plus(runs), 1);
+	EXPECT_EQ(one_sided_ks_runs_r_minus(runs), 0);
+	one_sided_ks_runs_destroy(runs);
+}
+
+// NaN would never be merged past, so it's rejected before it gets in.
+TEST(OneSidedKsRuns, NaN)
+{
+	struct one_sided_ks_runs *runs = one_sided_ks_runs_create();
+	const double nan = std::nan("");
+
+	EXPECT_EQ(one_sided_ks_runs_add(runs, ONE_SIDED_KS_ARM_A, nan), -1);
+	EXPECT_EQ(one_sided_ks_runs_add(runs, ONE_SIDED_KS_ARM_B, nan), -1);
+	EXPECT_EQ(one_sided_ks_runs_add_pair(runs, nan, 1.0), -1);
+	EXPECT_EQ(one_sided_ks_runs_add_pair(runs, 1.0, nan), -1);
+	EXPECT_EQ(one_sided_ks_runs_count(runs, ONE_SIDED_KS_ARM_A), 0);
+	EXPECT_EQ(one_sided_ks_runs_count(runs, ONE_SIDED_KS_ARM_B), 0);
+
+	ASSERT_EQ(one_sided_ks_runs_add_pair(runs, 0.0, 2.0), 0);
+	EXPECT_EQ(one_sided_ks_runs_r_plus(runs), 1);
+	EXPECT_EQ(one_sided_ks_runs_d_plus(runs), 1);
+	one_sided_ks_runs_destroy(runs);
+}
+
+// Interleave insertions and checks, with plenty of ties, and compare
+// with sorting from scratch.
+TEST(OneSidedKsRuns, PairMatchesSort)
+{
+	std::mt19937 rng(42);
+
+	for (const int range : { 1, 3, 100, 1 << 30 }) {
+		std::uniform_int_distribution<int> dist(0, range - 1);
+		std::vector<double> x;
+		std::vector<double> y;
+		struct one_sided_ks_runs *runs = one_sided_ks_runs_create();
+
+		for (size_t i = 1; i <= 5000; ++i) {
+			// Skew B towards higher values.
+			const double a = dist(rng);
+			const double b = std::max(dist(rng), dist(rng));
+
+			x.push_back(a);
+			y.push_back(b);
+			ASSERT_EQ(one_sided_ks_runs_add_pair(runs, a, b), 0);
+			if (i % 97 != 0 && i != 5000) {
+				continue;
+			}
+
+			const int64_t r_plus = max_count_delta(x, y);
+			const int64_t r_minus = max_count_delta(y, x);
+			ASSERT_EQ(one_sided_ks_runs_r_plus(runs), r_plus);
+			ASSERT_EQ(one_sided_ks_runs_r_minus(runs), r_minus);
+			ASSERT_THAT(one_sided_ks_runs_d_plus(runs),
+			    DoubleNear(1.0 * r_plus / i, 1e-15));
+			ASSERT_LE(
+			    one_sided_ks_runs_d_plus(runs), 1.0 * r_plus / i);
+			ASSERT_THAT(one_sided_ks_runs_d_minus(runs),
+			    DoubleNear(1.0 * r_minus / i, 1e-15));
+		}
+
+		EXPECT_EQ(one_sided_ks_runs_count(runs, ONE_SIDED_KS_ARM_A),
+		    5000);
+		EXPECT_EQ(one_sided_ks_runs_count(runs, ONE_SIDED_KS_ARM_B),
+		    5000);
+		one_sided_ks_runs_destroy(runs);
+	}
+}
+
+TEST(OneSidedKsRuns, UnpairedMatchesSort)
+{
+	std::mt19937 rng(43);
+	std::uniform_real_distribution<double> unif(0, 1);
+	std::uniform_int_distribution<int> coin(0, 3);
+	std::vector<double> x;
+	std::vector<double> y;
+	struct one_sided_ks_runs *runs = one_sided_ks_runs_create();
+
+	for (size_t i = 1; i <= 10000; ++i) {
+		// B gets 3x as many values as A, and they're larger.
+		if (coin(rng) == 0) {
+			const double a = std::round(100 * unif(rng));
+
+			x.push_back(a);
+			ASSERT_EQ(one_sided_ks_runs_add(
+				      runs, ONE_SIDED_KS_ARM_A, a),
+			    0);
+		} else {
+			const double b
+			    = std::round(100 * std::sqrt(unif(rng)));
+
+			y.push_back(b);
+			ASSERT_EQ(one_sided_ks_runs_add(
+				      runs, ONE_SIDED_KS_ARM_B, b),
+			    0);
+		}
+
+		if (i % 331 != 0 || x.empty() || y.empty()) {
+			continue;
+		}
+
+		ASSERT_THAT(one_sided_ks_runs_d_plus(runs),
+		    DoubleNear(max_cdf_delta(x, y), 1e-14));
+		ASSERT_THAT(one_sided_ks_runs_d_minus(runs),
+		    DoubleNear(max_cdf_delta(y, x), 1e-14));
+		ASSERT_EQ(
+		    one_sided_ks_runs_r_plus(runs), max_count_delta(x, y));
+	}
+
+	one_sided_ks_runs_destroy(runs);
+}
+
+// A has a small shift: we should reject, eventually.
+TEST(OneSidedKsRuns, Reject)
+{
+	const double log_eps = std::log(1e-6);
+	const uint64_t min_count = one_sided_ks_find_min_count(log_eps);
+	std::mt19937 rng(44);
+	std::normal_distribution<double> normal;
+	struct one_sided_ks_runs *runs = one_sided_ks_runs_create();
+	uint64_t n = 0;
+
+	for (; n < 1000000; ++n) {
+		ASSERT_EQ(one_sided_ks_runs_add_pair(
+			      runs, normal(rng) - 0.1, normal(rng)),
+		    0);
+		if ((n + 1) % 1024 == 0
+		    && one_sided_ks_runs_d_plus(runs)
+			>= one_sided_ks_pair_threshold(
+			    n + 1, min_count, log_eps)) {
+			break;
+		}
+	}
+
+	EXPECT_LT(n, 1000000);
+	EXPECT_LT(one_sided_ks_runs_d_minus(runs),
+	    one_sided_ks_pair_threshold(n + 1, min_count, log_eps));
+	one_sided_ks_runs_destroy(runs);
+}
+} // namespace
@@ -0,0 +1,408 @@
+#include "one-sided-ks-snapshot.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAGIC "OSKS"
+#define MAGIC_SIZE 4
+
+/* A LEB128 encoding of a uint64_t takes at most 10 bytes. */
+#define MAX_VARINT_SIZE 10
+
+/* The body may not contain more than INT64_MAX observations per arm. */
+#define MAX_TOTAL ((uint64_t)INT64_MAX)
+
+static const enum one_sided_ks_arm arms[] = {
+	ONE_SIDED_KS_ARM_A,
+	ONE_SIDED_KS_ARM_B,
+};
+
+static size_t varint_size(uint64_t x)
+{
+	size_t ret = 1;
+
+	for (; x >= 0x80; x >>= 7) {
+		++ret;
+	}
+
+	return ret;
+}
+
+static uint8_t *put_varint(uint8_t *out, uint64_t x)
+{
+	for (; x >= 0x80; x >>= 7) {
+		*out++ = (uint8_t)(x | 0x80);
+	}
+
+	*out++ = (uint8_t)x;
+	return out;
+}
+
+static uint8_t *put_double(uint8_t *out, double x)
+{
+	uint64_t bits;
+
+	memcpy(&bits, &x, sizeof(bits));
+	for (size_t i = 0; i < sizeof(bits); ++i) {
+		*out++ = (uint8_t)(bits >> (8 * i));
+	}
+
+	return out;
+}
+
+/* Bounds-checked cursor over an encoded snapshot. */
+struct reader {
+	const uint8_t *pos;
+	const uint8_t *end;
+};
+
+static int get_varint(struct reader *reader, uint64_t *out)
+{
+	uint64_t ret = 0;
+
+	for (unsigned int shift = 0; shift < 64; shift += 7) {
+		if (reader->pos == reader->end) {
+			return -1;
+		}
+
+		const uint8_t byte = *reader->pos++;
+
+		/* The 10th byte may only hold the top bit. */
+		if (shift == 63 && byte > 1) {
+			return -1;
+		}
+
+		ret |= (uint64_t)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0) {
+			*out = ret;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+static int get_double(struct reader *reader, double *out)
+{
+	uint64_t bits = 0;
+
+	if (reader->end - reader->pos < (ptrdiff_t)sizeof(bits)) {
+		return -1;
+	}
+
+	for (size_t i = 0; i < sizeof(bits); ++i) {
+		bits |= (uint64_t)*reader->pos++ << (8 * i);
+	}
+
+	memcpy(out, &bits, sizeof(bits));
+	return 0;
+}
+
+static size_t count_nonzero(
+    const struct one_sided_ks_ecdf *ecdf, enum one_sided_ks_arm arm)
+{
+	const size_t num_buckets = one_sided_ks_ecdf_num_buckets(ecdf);
+	size_t ret = 0;
+
+	for (size_t i = 0; i < num_buckets; ++i) {
+		ret += (one_sided_ks_ecdf_bucket_count(ecdf, arm, i) != 0);
+	}
+
+	return ret;
+}
+
+/*
+ * Returns an upper bound on the body size of a snapshot with
+ * `num_buckets` buckets (at most ONE_SIDED_KS_SNAPSHOT_MAX_BUCKETS):
+ * parameters, then, for each arm, two counts and a (gap, count) pair
+ * per bucket.
+ */
+static size_t max_body_size(size_t num_buckets)
+{
+	const size_t per_bucket
+	    = varint_size(num_buckets - 1) + MAX_VARINT_SIZE;
+
+	return MAX_VARINT_SIZE + sizeof(double) + varint_size(num_buckets)
+	    + 2 * (2 * MAX_VARINT_SIZE + num_buckets * per_bucket);
+}
+
+static size_t body_size(const struct one_sided_ks_ecdf *ecdf,
+    const struct one_sided_ks_snapshot_params *params)
+{
+	const size_t num_buckets = one_sided_ks_ecdf_num_buckets(ecdf);
+	size_t ret = varint_size(params->min_count) + sizeof(double)
+	    + varint_size(num_buckets);
+
+	for (size_t j = 0; j < 2; ++j) {
+		const enum one_sided_ks_arm arm = arms[j];
+		size_t next = 0;
+
+		ret += varint_size(one_sided_ks_ecdf_count(ecdf, arm));
+		ret += varint_size(count_nonzero(ecdf, arm));
+		for (size_t i = 0; i < num_buckets; ++i) {
+			const uint64_t count
+			    = one_sided_ks_ecdf_bucket_count(ecdf, arm, i);
+
+			if (count != 0) {
+				ret += varint_size(i - next)
+				    + varint_size(count);
+				next = i + 1;
+			}
+		}
+	}
+
+	return ret;
+}
+
+size_t one_sided_ks_snapshot_size(const struct one_sided_ks_ecdf *ecdf,
+    const struct one_sided_ks_snapshot_params *params)
+{
+	const size_t body = body_size(ecdf, params);
+
+	return MAGIC_SIZE + 1 + varint_size(body) + body;
+}
+
+size_t one_sided_ks_snapshot_serialize(const struct one_sided_ks_ecdf *ecdf,
+    const struct one_sided_ks_snapshot_params *params, uint8_t *buf,
+    size_t capacity)
+{
+	const size_t num_buckets = one_sided_ks_ecdf_num_buckets(ecdf);
+	const size_t body = body_size(ecdf, params);
+	uint8_t *out = buf;
+
+	if (capacity < MAGIC_SIZE + 1 + varint_size(body) + body
+	    || num_buckets > ONE_SIDED_KS_SNAPSHOT_MAX_BUCKETS) {
+		return 0;
+	}
+
+	memcpy(out, MAGIC, MAGIC_SIZE);
+	out += MAGIC_SIZE;
+	*out++ = ONE_SIDED_KS_SNAPSHOT_VERSION;
+	out = put_varint(out, body);
+
+	out = put_varint(out, params->min_count);
+	out = put_double(out, params->log_eps);
+	out = put_varint(out, num_buckets);
+	for (size_t j = 0; j < 2; ++j) {
+		const enum one_sided_ks_arm arm = arms[j];
+		size_t next = 0;
+
+		out = put_varint(out, one_sided_ks_ecdf_count(ecdf, arm));
+		out = put_varint(out, count_nonzero(ecdf, arm));
+		for (size_t i = 0; i < num_buckets; ++i) {
+			const uint64_t count
+			    = one_sided_ks_ecdf_bucket_count(ecdf, arm, i);
+
+			if (count != 0) {
+				out = put_varint(out, i - next);
+				out = put_varint(out, count);
+				next = i + 1;
+			}
+		}
+	}
+
+	return out - buf;
+}
+
+/* Decodes the counts for one arm into `counts`, which must be zero. */
+static int decode_arm(
+    struct reader *reader, uint64_t *counts, size_t num_buckets)
+{
+	uint64_t total;
+	uint64_t num_nonzero;
+	uint64_t sum = 0;
+	size_t next = 0;
+
+	if (get_varint(reader, &total) != 0 || total > MAX_TOTAL
+	    || get_varint(reader, &num_nonzero) != 0
+	    || num_nonzero > num_buckets) {
+		return -1;
+	}
+
+	for (uint64_t j = 0; j < num_nonzero; ++j) {
+		uint64_t gap;
+		uint64_t count;
+
+		if (get_varint(reader, &gap) != 0
+		    || gap >= num_buckets - next
+		    || get_varint(reader, &count) != 0 || count == 0
+		    || count > total - sum) {
+			return -1;
+		}
+
+		counts[next + gap] = count;
+		sum += count;
+		next += gap + 1;
+	}
+
+	return (sum == total) ? 0 : -1;
+}
+
+struct one_sided_ks_ecdf *one_sided_ks_snapshot_deserialize(
+    const uint8_t *buf, size_t size,
+    struct one_sided_ks_snapshot_params *params)
+{
+	struct reader reader = { .pos = buf, .end = buf + size };
+	struct one_sided_ks_snapshot_params decoded;
+	struct one_sided_ks_ecdf *ecdf = NULL;
+	uint64_t *counts[2] = { NULL, NULL };
+	uint64_t body;
+	uint64_t num_buckets;
+
+	if (size < MAGIC_SIZE + 1 || memcmp(buf, MAGIC, MAGIC_SIZE) != 0
+	    || buf[MAGIC_SIZE] != ONE_SIDED_KS_SNAPSHOT_VERSION) {
+		return NULL;
+	}
+
+	reader.pos += MAGIC_SIZE + 1;
+	if (get_varint(&reader, &body) != 0
+	    || body != (uint64_t)(reader.end - reader.pos)) {
+		return NULL;
+	}
+
+	if (get_varint(&reader, &decoded.min_count) != 0
+	    || get_double(&reader, &decoded.log_eps) != 0
+	    || get_varint(&reader, &num_buckets) != 0 || num_buckets == 0
+	    || num_buckets > ONE_SIDED_KS_SNAPSHOT_MAX_BUCKETS
+	    || body > max_body_size(num_buckets)) {
+		return NULL;
+	}
+
+	counts[0] = calloc(num_buckets, sizeof(uint64_t));
+	counts[1] = calloc(num_buckets, sizeof(uint64_t));
+	if (counts[0] != NULL && counts[1] != NULL
+	    && decode_arm(&reader, counts[0], num_buckets) == 0
+	    && decode_arm(&reader, counts[1], num_buckets) == 0
+	    && reader.pos == reader.end) {
+		ecdf = one_sided_ks_ecdf_create(num_buckets);
+	}
+
+	if (ecdf != NULL) {
+		one_sided_ks_ecdf_load(ecdf, counts[0], counts[1]);
+		*params = decoded;
+	}
+
+	free(counts[0]);
+	free(counts[1]);
+	return ecdf;
+}
+
+int one_sided_ks_snapshot_merge(struct one_sided_ks_ecdf *dst,
+    const struct one_sided_ks_snapshot_params *dst_params,
+    const struct one_sided_ks_ecdf *src,
+    const struct one_sided_ks_snapshot_params *src_params)
+{
+	const size_t num_buckets = one_sided_ks_ecdf_num_buckets(dst);
+
+	if (num_buckets != one_sided_ks_ecdf_num_buckets(src)
+	    || dst_params->min_count != src_params->min_count
+	    || dst_params->log_eps != src_params->log_eps) {
+		return -1;
+	}
+
+	for (size_t j = 0; j < 2; ++j) {
+		if (one_sided_ks_ecdf_count(src, arms[j])
+		    > MAX_TOTAL - one_sided_ks_ecdf_count(dst, arms[j])) {
+			return -1;
+		}
+	}
+
+	/* Sum the histograms, and rebuild the tree once. */
+	uint64_t *counts[2] = {
+		calloc(num_buckets, sizeof(uint64_t)),
+		calloc(num_buckets, sizeof(uint64_t)),
+	};
+	int ret = -1;
+
+	if (counts[0] != NULL && counts[1] != NULL) {
+		for (size_t j = 0; j < 2; ++j) {
+			for (size_t i = 0; i < num_buckets; ++i) {
+				counts[j][i]
+				    = one_sided_ks_ecdf_bucket_count(
+					  dst, arms[j], i)
+				    + one_sided_ks_ecdf_bucket_count(
+					src, arms[j], i);
+			}
+		}
+
+		one_sided_ks_ecdf_load(dst, counts[0], counts[1]);
+		ret = 0;
+	}
+
+	free(counts[0]);
+	free(counts[1]);
+	return ret;
+}
+
+int one_sided_ks_snapshot_write(FILE *file,
+    const struct one_sided_ks_ecdf *ecdf,
+    const struct one_sided_ks_snapshot_params *params)
+{
+	const size_t size = one_sided_ks_snapshot_size(ecdf, params);
+	uint8_t *buf = malloc(size);
+	int ret = -1;
+
+	if (buf == NULL) {
+		return -1;
+	}
+
+	if (one_sided_ks_snapshot_serialize(ecdf, params, buf, size) == size
+	    && fwrite(buf, 1, size, file) == size) {
+		ret = 0;
+	}
+
+	free(buf);
+	return ret;
+}
+
+struct one_sided_ks_ecdf *one_sided_ks_snapshot_read(
+    FILE *file, struct one_sided_ks_snapshot_params *params)
+{
+	uint8_t header[MAGIC_SIZE + 1 + MAX_VARINT_SIZE];
+	size_t header_size = MAGIC_SIZE + 1;
+	uint64_t body = 0;
+	struct one_sided_ks_ecdf *ret = NULL;
+	uint8_t *buf;
+
+	if (fread(header, 1, header_size, file) != header_size) {
+		return NULL;
+	}
+
+	/* Decode the body length one byte at a time. */
+	for (unsigned int shift = 0;; shift += 7) {
+		const int c = getc(file);
+
+		if (c == EOF || header_size == sizeof(header)) {
+			return NULL;
+		}
+
+		header[header_size++] = (uint8_t)c;
+		if (shift < 64) {
+			body |= (uint64_t)(c & 0x7f) << shift;
+		}
+
+		if ((c & 0x80) == 0) {
+			break;
+		}
+	}
+
+	/* Don't let a corrupted length make us allocate anything big. */
+	if (body > max_body_size(ONE_SIDED_KS_SNAPSHOT_MAX_BUCKETS)) {
+		return NULL;
+	}
+
+	buf = malloc(header_size + body);
+	if (buf == NULL) {
+		return NULL;
+	}
+
+	memcpy(buf, header, header_size);
+	if (fread(buf + header_size, 1, body, file) == body) {
+		ret = one_sided_ks_snapshot_deserialize(
+		    buf, header_size + body, params);
+	}
+
+	free(buf);
+	return ret;
+}
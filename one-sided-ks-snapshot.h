@@ -0,0 +1,96 @@
+#ifndef ONE_SIDED_KS_SNAPSHOT_H
+#define ONE_SIDED_KS_SNAPSHOT_H
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "one-sided-ks-ecdf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Portable snapshots of two-sample test state, so that shards can
+ * accumulate histograms locally, and ship them to an aggregator that
+ * merges them before comparing with `one_sided_ks_pair_threshold`.
+ *
+ * A snapshot holds the test parameters, the number of buckets, and,
+ * for each arm, the total count and the non-empty buckets.  The
+ * encoding is a 4-byte magic ("OSKS"), a version byte, the length of
+ * the rest as a varint, then the body: unsigned LEB128 varints for
+ * all integers, and `log_eps` as a little-endian IEEE double.
+ * Buckets are delta-coded, so sparse histograms stay small.
+ *
+ * Snapshots are self-delimiting, so a file may hold a sequence of
+ * them.
+ */
+#define ONE_SIDED_KS_SNAPSHOT_VERSION 1
+
+/*
+ * Snapshots may not have more buckets than this, so that a corrupted
+ * header can't make the decoder allocate much more than 64 MB.
+ */
+#define ONE_SIDED_KS_SNAPSHOT_MAX_BUCKETS ((size_t)1 << 20)
+
+/* Test parameters carried along with the histograms. */
+struct one_sided_ks_snapshot_params {
+	uint64_t min_count;
+	double log_eps;
+};
+
+/* Returns the encoded size of `ecdf` and `params`, in bytes. */
+size_t one_sided_ks_snapshot_size(const struct one_sided_ks_ecdf *ecdf,
+    const struct one_sided_ks_snapshot_params *params);
+
+/*
+ * Encodes `ecdf` and `params` to `buf`.  Returns the number of bytes
+ * written, or 0 if `capacity` is less than
+ * `one_sided_ks_snapshot_size`, or if `ecdf` has more than
+ * ONE_SIDED_KS_SNAPSHOT_MAX_BUCKETS buckets.
+ */
+size_t one_sided_ks_snapshot_serialize(const struct one_sided_ks_ecdf *ecdf,
+    const struct one_sided_ks_snapshot_params *params, uint8_t *buf,
+    size_t capacity);
+
+/*
+ * Decodes the snapshot in the `size` bytes at `buf` into a new
+ * accumulator, and stores its parameters in `params`.  Returns NULL
+ * if the snapshot is malformed, doesn't span exactly `size` bytes,
+ * has a different version, has more than
+ * ONE_SIDED_KS_SNAPSHOT_MAX_BUCKETS buckets, or on allocation
+ * failure.
+ */
+struct one_sided_ks_ecdf *one_sided_ks_snapshot_deserialize(
+    const uint8_t *buf, size_t size,
+    struct one_sided_ks_snapshot_params *params);
+
+/*
+ * Adds the counts in `src` to `dst`, in linear time.  Merging is
+ * associative and commutative.  Returns 0 on success, -1 if the
+ * parameters or the numbers of buckets differ, if the totals would
+ * exceed INT64_MAX, or on allocation failure, in which case `dst` is
+ * unchanged.
+ */
+int one_sided_ks_snapshot_merge(struct one_sided_ks_ecdf *dst,
+    const struct one_sided_ks_snapshot_params *dst_params,
+    const struct one_sided_ks_ecdf *src,
+    const struct one_sided_ks_snapshot_params *src_params);
+
+/* Appends a snapshot to `file`.  Returns 0 on success, -1 on failure. */
+int one_sided_ks_snapshot_write(FILE *file,
+    const struct one_sided_ks_ecdf *ecdf,
+    const struct one_sided_ks_snapshot_params *params);
+
+/*
+ * Reads the next snapshot from `file`, like
+ * `one_sided_ks_snapshot_deserialize`.  Returns NULL at end of file,
+ * or on failure, including a declared length too long for
+ * ONE_SIDED_KS_SNAPSHOT_MAX_BUCKETS buckets, before allocating it.
+ */
+struct one_sided_ks_ecdf *one_sided_ks_snapshot_read(
+    FILE *file, struct one_sided_ks_snapshot_params *params);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /* !ONE_SIDED_KS_SNAPSHOT_H */
@@ -0,0 +1,315 @@
+#include "one-sided-ks-snapshot.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "one-sided-ks-ecdf.h"
+#include "one-sided-ks.h"
+
+namespace {
+const struct one_sided_ks_snapshot_params kParams = { 20, -13.8 };
+
+// Fills `ecdf` with `count` random pairs, skewed towards low buckets.
+void fill(struct one_sided_ks_ecdf *ecdf, size_t count, uint64_t seed)
+{
+	const size_t num_buckets = one_sided_ks_ecdf_num_buckets(ecdf);
+	std::mt19937_64 rng(seed);
+	std::geometric_distribution<size_t> dist(0.05);
+
+	for (size_t i = 0; i < count; ++i) {
+		one_sided_ks_ecdf_add_pair(ecdf, dist(rng) % num_buckets,
+		    dist(rng) % num_buckets);
+	}
+}
+
+void expect_same(
+    const struct one_sided_ks_ecdf *x, const struct one_sided_ks_ecdf *y)
+{
+	const size_t num_buckets = one_sided_ks_ecdf_num_buckets(x);
+
+	ASSERT_EQ(one_sided_ks_ecdf_num_buckets(y), num_buckets);
+	for (const enum one_sided_ks_arm arm :
+	    { ONE_SIDED_KS_ARM_A, ONE_SIDED_KS_ARM_B }) {
+		EXPECT_EQ(one_sided_ks_ecdf_count(x, arm),
+		    one_sided_ks_ecdf_count(y, arm));
+		for (size_t i = 0; i < num_buckets; ++i) {
+			EXPECT_EQ(one_sided_ks_ecdf_bucket_count(x, arm, i),
+			    one_sided_ks_ecdf_bucket_count(y, arm, i));
+		}
+	}
+
+	EXPECT_EQ(one_sided_ks_ecdf_r_plus(x), one_sided_ks_ecdf_r_plus(y));
+	EXPECT_EQ(one_sided_ks_ecdf_r_minus(x), one_sided_ks_ecdf_r_minus(y));
+}
+
+std::vector<uint8_t> serialize(const struct one_sided_ks_ecdf *ecdf)
+{
+	std::vector<uint8_t> ret(one_sided_ks_snapshot_size(ecdf, &kParams));
+
+	EXPECT_EQ(one_sided_ks_snapshot_serialize(
+		      ecdf, &kParams, ret.data(), ret.size()),
+	    ret.size());
+	return ret;
+}
+
+TEST(OneSidedKsSnapshot, RoundTrip)
+{
+	struct one_sided_ks_ecdf *ecdf = one_sided_ks_ecdf_create(1000);
+	struct one_sided_ks_snapshot_params params;
+
+	fill(ecdf, 10000, 1);
+	one_sided_ks_ecdf_add(ecdf, ONE_SIDED_KS_ARM_A, 999, 1ULL << 40);
+
+	std::vector<uint8_t> buf = serialize(ecdf);
+	// Sparse histograms only pay for non-empty buckets.
+	EXPECT_LT(buf.size(), 1000);
+	EXPECT_EQ(one_sided_ks_snapshot_serialize(
+		      ecdf, &kParams, buf.data(), buf.size() - 1),
+	    0);
+
+	struct one_sided_ks_ecdf *copy = one_sided_ks_snapshot_deserialize(
+	    buf.data(), buf.size(), &params);
+	ASSERT_NE(copy, nullptr);
+	EXPECT_EQ(params.min_count, kParams.min_count);
+	EXPECT_EQ(params.log_eps, kParams.log_eps);
+	expect_same(ecdf, copy);
+
+	one_sided_ks_ecdf_destroy(copy);
+	one_sided_ks_ecdf_destroy(ecdf);
+}
+
+TEST(OneSidedKsSnapshot, Malformed)
+{
+	struct one_sided_ks_ecdf *ecdf = one_sided_ks_ecdf_create(100);
+	struct one_sided_ks_snapshot_params params;
+
+	fill(ecdf, 1000, 2);
+
+	const std::vector<uint8_t> buf = serialize(ecdf);
+	for (size_t size = 0; size < buf.size(); ++size) {
+		EXPECT_EQ(one_sided_ks_snapshot_deserialize(
+			      buf.data(), size, &params),
+		    nullptr);
+	}
+
+	// Flipping any single byte must not crash, and mostly fails.
+	for (size_t i = 0; i < buf.size(); ++i) {
+		std::vector<uint8_t> corrupt = buf;
+
+		corrupt[i] ^= 0x80;
+		one_sided_ks_ecdf_destroy(one_sided_ks_snapshot_deserialize(
+		    corrupt.data(), corrupt.size(), &params));
+	}
+
+	std::vector<uint8_t> version = buf;
+	version[4] = ONE_SIDED_KS_SNAPSHOT_VERSION + 1;
+	EXPECT_EQ(one_sided_ks_snapshot_deserialize(
+		      version.data(), version.size(), &params),
+	    nullptr);
+
+	std::vector<uint8_t> trailing = buf;
+	trailing.push_back(0);
+	EXPECT_EQ(one_sided_ks_snapshot_deserialize(
+		      trailing.data(), trailing.size(), &params),
+	    nullptr);
+
+	one_sided_ks_ecdf_destroy(ecdf);
+}
+
+void put_varint(std::vector<uint8_t> *out, uint64_t x)
+{
+	for (; x >= 0x80; x >>= 7) {
+		out->push_back(uint8_t(x | 0x80));
+	}
+
+	out->push_back(uint8_t(x));
+}
+
+// A snapshot of `num_buckets` empty buckets, encoded by hand.
+std::vector<uint8_t> empty_snapshot(uint64_t num_buckets)
+{
+	std::vector<uint8_t> body;
+	std::vector<uint8_t> ret = { 'O', 'S', 'K', 'S',
+		ONE_SIDED_KS_SNAPSHOT_VERSION };
+
+	put_varint(&body, kParams.min_count);
+	body.insert(body.end(), 8, 0);
+	put_varint(&body, num_buckets);
+	body.insert(body.end(), 4, 0);
+	put_varint(&ret, body.size());
+	ret.insert(ret.end(), body.begin(), body.end());
+	return ret;
+}
+
+// Sizes in the header can't make the decoder allocate arbitrary
+// amounts of memory.
+TEST(OneSidedKsSnapshot, CorruptedHeader)
+{
+	struct one_sided_ks_snapshot_params params;
+
+	std::vector<uint8_t> buf
+	    = empty_snapshot(ONE_SIDED_KS_SNAPSHOT_MAX_BUCKETS);
+	struct one_sided_ks_ecdf *ecdf = one_sided_ks_snapshot_deserialize(
+	    buf.data(), buf.size(), &params);
+	ASSERT_NE(ecdf, nullptr);
+	EXPECT_EQ(one_sided_ks_ecdf_num_buckets(ecdf),
+	    ONE_SIDED_KS_SNAPSHOT_MAX_BUCKETS);
+	one_sided_ks_ecdf_destroy(ecdf);
+
+	for (const uint64_t num_buckets :
+	    { uint64_t(ONE_SIDED_KS_SNAPSHOT_MAX_BUCKETS) + 1,
+		uint64_t(1) << 40, uint64_t(SIZE_MAX) }) {
+		buf = empty_snapshot(num_buckets);
+		EXPECT_EQ(one_sided_ks_snapshot_deserialize(
+			      buf.data(), buf.size(), &params),
+		    nullptr)
+		    << num_buckets;
+	}
+
+	// We can't encode more buckets either.
+	ecdf = one_sided_ks_ecdf_create(
+	    ONE_SIDED_KS_SNAPSHOT_MAX_BUCKETS + 1);
+	ASSERT_NE(ecdf, nullptr);
+	buf.resize(one_sided_ks_snapshot_size(ecdf, &kParams));
+	EXPECT_EQ(one_sided_ks_snapshot_serialize(
+		      ecdf, &kParams, buf.data(), buf.size()),
+	    0);
+	one_sided_ks_ecdf_destroy(ecdf);
+
+	// A file that declares a huge body fails before allocating it.
+	for (const uint64_t body : { uint64_t(1) << 40, uint64_t(-1) }) {
+		std::vector<uint8_t> header = { 'O', 'S', 'K', 'S',
+			ONE_SIDED_KS_SNAPSHOT_VERSION };
+		FILE *file = std::tmpfile();
+
+		ASSERT_NE(file, nullptr);
+		put_varint(&header, body);
+		header.insert(header.end(), 64, 0);
+		ASSERT_EQ(std::fwrite(header.data(), 1, header.size(), file),
+		    header.size());
+		std::rewind(file);
+		EXPECT_EQ(one_sided_ks_snapshot_read(file, &params), nullptr)
+		    << body;
+		std::fclose(file);
+	}
+}
+
+// Merging shards in any order matches accumulating everything in
+// one place.
+TEST(OneSidedKsSnapshot, Merge)
+{
+	constexpr size_t kBuckets = 200;
+	struct one_sided_ks_ecdf *whole = one_sided_ks_ecdf_create(kBuckets);
+	struct one_sided_ks_ecdf *left = one_sided_ks_ecdf_create(kBuckets);
+	struct one_sided_ks_ecdf *right = one_sided_ks_ecdf_create(kBuckets);
+	std::vector<struct one_sided_ks_ecdf *> shards;
+
+	for (uint64_t seed = 0; seed < 3; ++seed) {
+		shards.push_back(one_sided_ks_ecdf_create(kBuckets));
+		fill(shards.back(), 1000 * (seed + 1), seed);
+		fill(whole, 1000 * (seed + 1), seed);
+	}
+
+	// (s0 + s1) + s2
+	ASSERT_EQ(one_sided_ks_snapshot_merge(
+		      left, &kParams, shards[0], &kParams),
+	    0);
+	ASSERT_EQ(one_sided_ks_snapshot_merge(
+		      left, &kParams, shards[1], &kParams),
+	    0);
+	ASSERT_EQ(one_sided_ks_snapshot_merge(
+		      left, &kParams, shards[2], &kParams),
+	    0);
+	// s2 + (s1 + s0)
+	ASSERT_EQ(one_sided_ks_snapshot_merge(
+		      shards[1], &kParams, shards[0], &kParams),
+	    0);
+	ASSERT_EQ(one_sided_ks_snapshot_merge(
+		      right, &kParams, shards[2], &kParams),
+	    0);
+	ASSERT_EQ(one_sided_ks_snapshot_merge(
+		      right, &kParams, shards[1], &kParams),
+	    0);
+
+	expect_same(whole, left);
+	expect_same(whole, right);
+
+	// Parameters and bucket counts must agree.
+	const struct one_sided_ks_snapshot_params other
+	    = { kParams.min_count, std::log(1e-3) };
+	struct one_sided_ks_ecdf *small = one_sided_ks_ecdf_create(10);
+
+	EXPECT_EQ(one_sided_ks_snapshot_merge(
+		      left, &kParams, shards[0], &other),
+	    -1);
+	EXPECT_EQ(
+	    one_sided_ks_snapshot_merge(left, &kParams, small, &kParams), -1);
+	expect_same(whole, left);
+
+	one_sided_ks_ecdf_destroy(small);
+	for (struct one_sided_ks_ecdf *shard : shards) {
+		one_sided_ks_ecdf_destroy(shard);
+	}
+
+	one_sided_ks_ecdf_destroy(right);
+	one_sided_ks_ecdf_destroy(left);
+	one_sided_ks_ecdf_destroy(whole);
+}
+
+// Each shard appends its snapshot to a local file, and the aggregator
+// reads and merges them all before checking the threshold.
+TEST(OneSidedKsSnapshot, File)
+{
+	constexpr size_t kBuckets = 50;
+	constexpr size_t kShards = 4;
+	struct one_sided_ks_ecdf *whole = one_sided_ks_ecdf_create(kBuckets);
+	struct one_sided_ks_ecdf *merged = one_sided_ks_ecdf_create(kBuckets);
+	struct one_sided_ks_snapshot_params params;
+	FILE *file = std::tmpfile();
+
+	ASSERT_NE(file, nullptr);
+	for (size_t i = 0; i < kShards; ++i) {
+		struct one_sided_ks_ecdf *shard
+		    = one_sided_ks_ecdf_create(kBuckets);
+
+		fill(shard, 500, 10 + i);
+		fill(whole, 500, 10 + i);
+		ASSERT_EQ(
+		    one_sided_ks_snapshot_write(file, shard, &kParams), 0);
+		one_sided_ks_ecdf_destroy(shard);
+	}
+
+	std::rewind(file);
+	for (size_t i = 0; i < kShards; ++i) {
+		struct one_sided_ks_ecdf *shard
+		    = one_sided_ks_snapshot_read(file, &params);
+
+		ASSERT_NE(shard, nullptr);
+		ASSERT_EQ(one_sided_ks_snapshot_merge(
+			      merged, &kParams, shard, &params),
+		    0);
+		one_sided_ks_ecdf_destroy(shard);
+	}
+
+	EXPECT_EQ(one_sided_ks_snapshot_read(file, &params), nullptr);
+	EXPECT_TRUE(std::feof(file));
+	expect_same(whole, merged);
+
+	const uint64_t n
+	    = one_sided_ks_ecdf_count(merged, ONE_SIDED_KS_ARM_A);
+	EXPECT_EQ(n, kShards * 500);
+	EXPECT_EQ(one_sided_ks_ecdf_d_plus(merged),
+	    one_sided_ks_ecdf_d_plus(whole));
+	EXPECT_LT(one_sided_ks_ecdf_d_plus(merged),
+	    one_sided_ks_pair_threshold(
+		n, params.min_count, params.log_eps));
+
+	std::fclose(file);
+	one_sided_ks_ecdf_destroy(merged);
+	one_sided_ks_ecdf_destroy(whole);
+}
+} // namespace
@@ -1,16 +1,20 @@
 #include "one-sided-ks.h"
 
+#include <algorithm>
 #include <cfloat>
 #include <climits>
 #include <cmath>
+#include <cstdlib>
 #include <iostream>
 #include <random>
+#include <thread>
 #include <tuple>
 #include <vector>
 
 #include "external/csm/csm.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "one-sided-ks-calibrate.h"
 
 namespace {
 double inv_occurrence(const std::vector<size_t> &x)
@@ -68,30 +72,41 @@ double max_uniform_cdf_delta(const std::vector<size_t> &x)
 	return max_delta;
 }
 
-// Returns whether the evidence lets us reject the equality hypothesis.
-bool uniform_eq_test(
-    size_t range, size_t repeat, size_t min_count, double log_eps)
+// Bazel runs the shards of this test in parallel: split the cores
+// between them, rather than running one thread per core in each.
+size_t threads_per_shard()
 {
-	std::random_device dev;
-	std::mt19937 rng(dev());
+	const char *shards = std::getenv("TEST_TOTAL_SHARDS");
+	const long num_shards = (shards != nullptr) ? std::atol(shards) : 1;
+	const size_t num_cpus = std::thread::hardware_concurrency();
 
-	std::uniform_int_distribution<size_t> dist(0, range - 1);
-	std::vector<size_t> x(range, 0);
-	std::vector<size_t> y(range, 0);
-
-	for (size_t i = 0; i < repeat; ++i) {
-		++x[dist(rng)];
-		++y[dist(rng)];
-
-		const double delta = max_cdf_delta(x, y);
-		const double threshold = one_sided_ks_pair_threshold_fast(
-		    i + 1, min_count, log_eps);
-		if (delta > threshold) {
-			return true;
-		}
-	}
+	return std::max<size_t>(1, num_cpus / std::max(1L, num_shards));
+}
 
-	return false;
+// Paired tests run on this shard's cores, with the calibration
+// harness.  Like `max_cdf_delta`, they compare CDFs in both
+// directions, and, by default, compare D against
+// `one_sided_ks_pair_threshold_fast`.  Print the seed to reproduce
+// failures.
+one_sided_ks_calibrate_params pair_params(double discrepancy,
+    uint64_t max_steps, uint64_t max_trials, double target_rate)
+{
+	std::random_device dev;
+	one_sided_ks_calibrate_params ret = {};
+
+	ret.min_count = 100;
+	ret.log_eps = std::log(0.01) + one_sided_ks_eq;
+	ret.two_sided = true;
+	ret.fast_threshold = true;
+	ret.range = 10;
+	ret.discrepancy = discrepancy;
+	ret.max_steps = max_steps;
+	ret.max_trials = max_trials;
+	ret.target_rate = target_rate;
+	ret.csm_log_eps = std::log(1e-4);
+	ret.seed = (uint64_t(dev()) << 32) | dev();
+	ret.num_threads = threads_per_shard();
+	return ret;
 }
 
 // Same thing, but test directly against the uniform distribution.
@@ -123,34 +138,46 @@ bool uniform_distribution_eq_test(
 // should have a false positive rate less than the eps of 0.01.
 TEST(OneSidedKs, UniformPair)
 {
-	size_t total = 0;
-	size_t failures = 0;
+	const one_sided_ks_calibrate_params params
+	    = pair_params(0, 500000, 10000, 0.01);
+	one_sided_ks_calibrate_result result;
 
 #ifndef NDEBUG
 	std::cout << "This test suite needs a few minutes in optimized mode. "
 		     "Debug mode may take for approximately ever."
 		  << std::endl;
 #endif
-	for (size_t i = 0; i < 10000; ++i) {
-		++total;
-		if (uniform_eq_test(
-			10, 500000, 100, std::log(0.01) + one_sided_ks_eq)) {
-			++failures;
-		}
-
-		if (csm(total, 0.01, failures, std::log(1e-4), nullptr)
-		    != 0) {
-			std::cout << "Actual rate " << 1.0 * failures / total
-				  << ": " << failures << " / " << total
-				  << "\n";
-			EXPECT_LE(1.0 * failures / total, 0.01)
-			    << failures << " / " << total;
-			return;
-		}
-	}
+	ASSERT_EQ(0, one_sided_ks_calibrate_run(&params, &result, nullptr));
+	ASSERT_TRUE(result.stopped)
+	    << "Too many iterations " << result.num_trials << "("
+	    << result.num_rejections << ") seed " << params.seed;
+	std::cout << "Actual rate " << result.rejection_rate << ": "
+		  << result.num_rejections << " / " << result.num_trials
+		  << "\n";
+	EXPECT_LE(result.rejection_rate, 0.01)
+	    << result.num_rejections << " / " << result.num_trials
+	    << " seed " << params.seed;
+}
 
-	EXPECT_TRUE(false) << "Too many iterations " << total << "("
-			   << failures << ")";
+// Same, with the integer cutoffs of a
+// `one_sided_ks_pair_reject_iter`.
+TEST(OneSidedKs, UniformPairRejectIter)
+{
+	one_sided_ks_calibrate_params params
+	    = pair_params(0, 500000, 10000, 0.01);
+	one_sided_ks_calibrate_result result;
+
+	params.fast_threshold = false;
+	ASSERT_EQ(0, one_sided_ks_calibrate_run(&params, &result, nullptr));
+	ASSERT_TRUE(result.stopped)
+	    << "Too many iterations " << result.num_trials << "("
+	    << result.num_rejections << ") seed " << params.seed;
+	std::cout << "Actual rate " << result.rejection_rate << ": "
+		  << result.num_rejections << " / " << result.num_trials
+		  << "\n";
+	EXPECT_LE(result.rejection_rate, 0.01)
+	    << result.num_rejections << " / " << result.num_trials
+	    << " seed " << params.seed;
 }
 
 TEST(OneSidedKs, UniformDistribution)
@@ -185,40 +212,65 @@ TEST(OneSidedKs, UniformDistribution)
 			   << failures << ")";
 }
 
-constexpr double kDiscrepancyRate = 0.025;
-
-// Like the EQ test, but differ in kDiscrepancyRate of cases.
-std::pair<bool, size_t> uniform_neq_test(
+// Same thing, with 9 observations from the second distribution for
+// each observation from the first.
+bool uniform_unpaired_eq_test(
     size_t range, size_t repeat, size_t min_count, double log_eps)
 {
 	std::random_device dev;
 	std::mt19937 rng(dev());
 
-	// First, generate all the sets.
-	std::bernoulli_distribution error(kDiscrepancyRate);
 	std::uniform_int_distribution<size_t> dist(0, range - 1);
 	std::vector<size_t> x(range, 0);
 	std::vector<size_t> y(range, 0);
 
 	for (size_t i = 0; i < repeat; ++i) {
 		++x[dist(rng)];
-		if (error(rng)) {
-			++y[range - 1];
-		} else {
+		for (size_t j = 0; j < 9; ++j) {
 			++y[dist(rng)];
 		}
 
 		const double delta = max_cdf_delta(x, y);
-		const double threshold = one_sided_ks_pair_threshold_fast(
-		    i + 1, min_count, log_eps);
+		const double threshold = one_sided_ks_unpaired_threshold_fast(
+		    i + 1, 9 * (i + 1), min_count, log_eps);
 		if (delta > threshold) {
-			return { true, i + 1 };
+			return true;
 		}
 	}
 
-	return { false, SIZE_MAX };
+	return false;
 }
 
+TEST(OneSidedKs, UniformUnpaired)
+{
+	size_t total = 0;
+	size_t failures = 0;
+
+	for (size_t i = 0; i < 10000; ++i) {
+		++total;
+		if (uniform_unpaired_eq_test(
+			10, 100000, 100, std::log(0.01) + one_sided_ks_eq)) {
+			++failures;
+		}
+
+		if (csm(total, 0.01, failures, std::log(1e-4), nullptr)
+		    != 0) {
+			std::cout << "Actual rate " << 1.0 * failures / total
+				  << ": " << failures << " / " << total
+				  << "\n";
+			EXPECT_LE(1.0 * failures / total, 0.01)
+			    << failures << " / " << total;
+			return;
+		}
+	}
+
+	EXPECT_TRUE(false) << "Too many iterations " << total << "("
+			   << failures << ")";
+}
+
+constexpr double kDiscrepancyRate = 0.025;
+
+// Like the EQ test, but differ in kDiscrepancyRate of cases.
 std::pair<bool, size_t> uniform_distribution_neq_test(
     size_t range, size_t repeat, size_t min_count, double log_eps)
 {
@@ -253,38 +305,26 @@ std::pair<bool, size_t> uniform_distribution_neq_test(
 // iterations.  We should have a ridiculous false negative rate.
 TEST(OneSidedKs, NonUniformPair)
 {
-	size_t total = 0;
-	size_t successes = 0;
-	double total_iter = 0;
-
-	for (size_t i = 0; i < 20000; ++i) {
-		++total;
-
-		bool different;
-		size_t num_iter;
-		std::tie(different, num_iter) = uniform_neq_test(
-		    10, 100000, 100, std::log(0.01) + one_sided_ks_eq);
-		if (different) {
-			total_iter += num_iter;
-			++successes;
-		}
-
-		if (csm(total, 0.999, successes, std::log(1e-4), nullptr)
-		    != 0) {
-			std::cout
-			    << "Actual rate " << 1.0 * successes / total
-			    << " " << successes << " / " << total << " - "
-			    << total_iter / std::max<size_t>(1, successes)
-			    << "\n";
-			EXPECT_GE(1.0 * successes / total, 0.99)
-			    << successes << " / " << total;
-			return;
-		}
+	const one_sided_ks_calibrate_params params
+	    = pair_params(kDiscrepancyRate, 100000, 20000, 0.999);
+	one_sided_ks_calibrate_result result;
+
+	ASSERT_EQ(0, one_sided_ks_calibrate_run(&params, &result, nullptr));
+	if (!result.stopped) {
+		EXPECT_EQ(result.num_trials, result.num_rejections)
+		    << "Should not have any failure after "
+		    << result.num_trials << " tests ("
+		    << result.mean_reject_steps << " iter/test) seed "
+		    << params.seed;
+		return;
 	}
 
-	EXPECT_EQ(total, successes)
-	    << "Should not have any failure after " << total << " tests ("
-	    << total_iter / std::max<size_t>(1, successes) << " iter/test)";
+	std::cout << "Actual rate " << result.rejection_rate << " "
+		  << result.num_rejections << " / " << result.num_trials
+		  << " - " << result.mean_reject_steps << "\n";
+	EXPECT_GE(result.rejection_rate, 0.99)
+	    << result.num_rejections << " / " << result.num_trials
+	    << " seed " << params.seed;
 }
 
 TEST(OneSidedKs, NonUniformDistribution)
@@ -329,39 +369,25 @@ TEST(OneSidedKs, NonUniformPairExpectedIter)
 {
 	const double expected_iter = one_sided_ks_expected_iter(
 	    100, std::log(0.01) + one_sided_ks_eq, kDiscrepancyRate);
-
-	size_t total = 0;
-	size_t successes = 0;
-	double total_iter = 0;
+	// A trial succeeds when it rejects in fewer than expected_iter
+	// steps.
+	const one_sided_ks_calibrate_params params = pair_params(
+	    kDiscrepancyRate, uint64_t(std::ceil(expected_iter)) - 1, 10000,
+	    0.5);
+	one_sided_ks_calibrate_result result;
 
 	// Given the long-tailed nature of the number of iterations,
 	// the median should be lower than the expected value.
-	for (size_t i = 0; i < 10000; ++i) {
-		++total;
-
-		bool different;
-		size_t num_iter;
-		std::tie(different, num_iter) = uniform_neq_test(
-		    10, 100000, 100, std::log(0.01) + one_sided_ks_eq);
-		total_iter += num_iter;
-		if (different && num_iter < expected_iter) {
-			++successes;
-		}
-
-		if (csm(total, 0.5, successes, std::log(1e-4), nullptr)
-		    != 0) {
-			std::cout << "Average iter " << total_iter / total
-				  << " expected " << expected_iter
-				  << " hit ratio: " << 1.0 * successes / total
-				  << "\n";
-			EXPECT_GE(1.0 * successes / total, 0.5)
-			    << successes << " / " << total;
-			return;
-		}
-	}
-
-	EXPECT_TRUE(false) << "Too many iterations " << total << "("
-			   << successes << " in " << total_iter << ")";
+	ASSERT_EQ(0, one_sided_ks_calibrate_run(&params, &result, nullptr));
+	ASSERT_TRUE(result.stopped)
+	    << "Too many iterations " << result.num_trials << "("
+	    << result.num_rejections << ") seed " << params.seed;
+	std::cout << "Average iter " << result.mean_reject_steps
+		  << " expected " << expected_iter
+		  << " hit ratio: " << result.rejection_rate << "\n";
+	EXPECT_GE(result.rejection_rate, 0.5)
+	    << result.num_rejections << " / " << result.num_trials
+	    << " seed " << params.seed;
 }
 
 } // namespace
@@ -0,0 +1,148 @@
+#include "one-sided-ks-table.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "one-sided-ks.h"
+
+#define SUBRANGE_BITS ONE_SIDED_KS_TABLE_SUBRANGE_BITS
+
+/* We need n >= 2^SUBRANGE_BITS to index the tail. */
+static const uint64_t min_max_n = (1ULL << SUBRANGE_BITS) - 1;
+
+/*
+ * Computing bounds and evaluating `sqrt(bound / n)` incur fewer than
+ * 8 roundings to nearest, each with relative error at most 2^-53.
+ * Scaling the bound up by 2^-48 more than makes up for that.
+ */
+static const double tail_slack = 1 + 0x1p-48;
+
+/*
+ * Tail ranges are identified by the position k of the most
+ * significant bit of n, and the next SUBRANGE_BITS bits.
+ */
+static inline size_t tail_index(uint64_t n)
+{
+	const unsigned int k = 63 - __builtin_clzll(n);
+	const uint64_t sub
+	    = (n >> (k - SUBRANGE_BITS)) & ((1ULL << SUBRANGE_BITS) - 1);
+
+	return ((size_t)k << SUBRANGE_BITS) | sub;
+}
+
+/* Max n in the tail range at `index`. */
+static inline uint64_t tail_range_max(size_t index)
+{
+	const unsigned int k = index >> SUBRANGE_BITS;
+	const uint64_t sub = index & ((1ULL << SUBRANGE_BITS) - 1);
+	const uint64_t top = (1ULL << SUBRANGE_BITS) + sub + 1;
+
+	/* Wraps around to UINT64_MAX for the last range. */
+	return (top << (k - SUBRANGE_BITS)) - 1;
+}
+
+static struct one_sided_ks_table *table_create(uint64_t min_count,
+    double log_eps, uint64_t max_n,
+    double threshold_fn(uint64_t, uint64_t, double))
+{
+	assert(log_eps <= 0
+	    && "log_eps must be negative (for a false positive rate < 1).");
+
+	if (log_eps < 0
+	    && one_sided_ks_min_count_valid(min_count, log_eps) == 0) {
+		min_count = one_sided_ks_find_min_count(log_eps);
+	}
+
+	if (max_n < min_max_n) {
+		max_n = min_max_n;
+	}
+
+	if (max_n >= SIZE_MAX / sizeof(double)) {
+		return NULL;
+	}
+
+	struct one_sided_ks_table *table = malloc(sizeof(*table));
+	if (table == NULL) {
+		return NULL;
+	}
+
+	table->min_count = min_count;
+	table->max_n = max_n;
+	table->thresholds = malloc((max_n + 1) * sizeof(double));
+	if (table->thresholds == NULL) {
+		free(table);
+		return NULL;
+	}
+
+	for (uint64_t n = 0; n <= max_n; ++n) {
+		table->thresholds[n] = threshold_fn(n, min_count, log_eps);
+	}
+
+	/*
+	 * n threshold(n)^2 is (1 + 1/n)(2 log n + log b) for the
+	 * two-sample test, and (2 log n + log b) / 2 for the
+	 * one-sample test.  Both are increasing for n >= min_count
+	 * when min_count is valid, so the value at the end of each
+	 * range bounds the whole range.
+	 */
+	for (size_t i = 0; i < 64 << SUBRANGE_BITS; ++i) {
+		if ((i >> SUBRANGE_BITS) < SUBRANGE_BITS) {
+			table->tail_bounds[i] = HUGE_VAL;
+			continue;
+		}
+
+		const uint64_t hi = tail_range_max(i);
+		const double threshold = threshold_fn(hi, min_count, log_eps);
+		if (threshold <= 0) {
+			/* log_eps >= 0: always reject. */
+			table->tail_bounds[i] = threshold;
+			continue;
+		}
+
+		table->tail_bounds[i]
+		    = tail_slack * (threshold * threshold) * (double)hi;
+	}
+
+	return table;
+}
+
+struct one_sided_ks_table *one_sided_ks_pair_table_create(
+    uint64_t min_count, double log_eps, uint64_t max_n)
+{
+	return table_create(
+	    min_count, log_eps, max_n, one_sided_ks_pair_threshold_fast);
+}
+
+struct one_sided_ks_table *one_sided_ks_distribution_table_create(
+    uint64_t min_count, double log_eps, uint64_t max_n)
+{
+	return table_create(min_count, log_eps, max_n,
+	    one_sided_ks_distribution_threshold_fast);
+}
+
+void one_sided_ks_table_destroy(struct one_sided_ks_table *table)
+{
+	if (table == NULL) {
+		return;
+	}
+
+	free(table->thresholds);
+	free(table);
+}
+
+double one_sided_ks_table_tail_threshold(
+    const struct one_sided_ks_table *table, uint64_t n)
+{
+	if (n < table->min_count) {
+		return HUGE_VAL;
+	}
+
+	const double bound = table->tail_bounds[tail_index(n)];
+	if (bound <= 0) {
+		return bound;
+	}
+
+	return sqrt(bound / n);
+}
@@ -0,0 +1,76 @@
+#ifndef ONE_SIDED_KS_TABLE_H
+#define ONE_SIDED_KS_TABLE_H
+#include <math.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * Precomputed thresholds for a fixed pair of `min_count` and
+ * `log_eps`.
+ *
+ * Thresholds for `n <= max_n` are the exact values returned by
+ * `one_sided_ks_pair_threshold` or
+ * `one_sided_ks_distribution_threshold`, in a flat array.  Past
+ * `max_n`, we split each power-of-two range in 8 sub-ranges, and
+ * store an upper bound `bound` on `n threshold(n)^2` in each
+ * sub-range: `threshold(n) <= sqrt(bound / n)`, which is within
+ * about 1% of the direct threshold, without any call to log.
+ */
+
+/* Number of sub-ranges in each [2^k, 2^(k + 1)) range. */
+#define ONE_SIDED_KS_TABLE_SUBRANGE_BITS 3
+
+struct one_sided_ks_table {
+	uint64_t min_count;
+	uint64_t max_n;
+	/* thresholds[n] for 0 <= n <= max_n. */
+	double *thresholds;
+	/* Upper bounds on n threshold(n)^2, indexed by tail_index. */
+	double tail_bounds[64 << ONE_SIDED_KS_TABLE_SUBRANGE_BITS];
+};
+
+/*
+ * Returns a table of thresholds for the two-sample test with
+ * `min_count` and `log_eps`, with direct lookups up to at least
+ * `max_n`, or NULL on allocation failure.
+ *
+ * Like `one_sided_ks_pair_threshold`, replaces `min_count` with
+ * `one_sided_ks_find_min_count(log_eps)` if it's invalid.
+ */
+struct one_sided_ks_table *one_sided_ks_pair_table_create(
+    uint64_t min_count, double log_eps, uint64_t max_n);
+
+/*
+ * Same as `one_sided_ks_pair_table_create`, for
+ * `one_sided_ks_distribution_threshold`.
+ */
+struct one_sided_ks_table *one_sided_ks_distribution_table_create(
+    uint64_t min_count, double log_eps, uint64_t max_n);
+
+void one_sided_ks_table_destroy(struct one_sided_ks_table *table);
+
+/* Slow path of `one_sided_ks_table_threshold`, for n > max_n. */
+double one_sided_ks_table_tail_threshold(
+    const struct one_sided_ks_table *table, uint64_t n);
+
+/*
+ * Returns an upper bound for the threshold at sample size `n`.  The
+ * return value is identical to the table's threshold function when
+ * `n <= table->max_n`, and may be slightly higher otherwise.
+ */
+static inline double one_sided_ks_table_threshold(
+    const struct one_sided_ks_table *table, uint64_t n)
+{
+	if (n <= table->max_n) {
+		return table->thresholds[n];
+	}
+
+	return one_sided_ks_table_tail_threshold(table, n);
+}
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /* !ONE_SIDED_KS_TABLE_H */
@@ -0,0 +1,120 @@
+#include "one-sided-ks-table.h"
+
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "one-sided-ks.h"
+
+namespace {
+using ::testing::Ge;
+using ::testing::Le;
+
+std::vector<uint64_t> tail_points(uint64_t max_n)
+{
+	std::vector<uint64_t> ret;
+
+	for (uint64_t n = max_n + 1; n < max_n + 5000; ++n) {
+		ret.push_back(n);
+	}
+
+	for (uint64_t n = max_n + 1; n < (1ULL << 63); n += n / 7 + 1) {
+		ret.push_back(n);
+		ret.push_back(2 * n - 1);
+	}
+
+	ret.push_back(UINT64_MAX);
+	return ret;
+}
+
+// Direct lookups should be exactly the scalar thresholds.
+TEST(OneSidedKsTable, DirectLookup)
+{
+	const double log_eps = std::log(1e-6) + one_sided_ks_eq;
+	struct one_sided_ks_table *pair
+	    = one_sided_ks_pair_table_create(100, log_eps, 10000);
+	struct one_sided_ks_table *distribution
+	    = one_sided_ks_distribution_table_create(100, log_eps, 10000);
+
+	ASSERT_NE(pair, nullptr);
+	ASSERT_NE(distribution, nullptr);
+	for (uint64_t n = 0; n <= 10000; ++n) {
+		EXPECT_EQ(one_sided_ks_table_threshold(pair, n),
+		    one_sided_ks_pair_threshold(n, 100, log_eps));
+		EXPECT_EQ(one_sided_ks_table_threshold(distribution, n),
+		    one_sided_ks_distribution_threshold(n, 100, log_eps));
+	}
+
+	one_sided_ks_table_destroy(pair);
+	one_sided_ks_table_destroy(distribution);
+}
+
+// Past max_n, we should have a slightly conservative bound.
+TEST(OneSidedKsTable, TailBound)
+{
+	const double log_eps = std::log(1e-4);
+	struct one_sided_ks_table *pair
+	    = one_sided_ks_pair_table_create(20, log_eps, 100);
+	struct one_sided_ks_table *distribution
+	    = one_sided_ks_distribution_table_create(20, log_eps, 100);
+
+	for (const uint64_t n : tail_points(100)) {
+		const double expected_pair
+		    = one_sided_ks_pair_threshold(n, 20, log_eps);
+		const double expected_distribution
+		    = one_sided_ks_distribution_threshold(n, 20, log_eps);
+		const double actual_pair
+		    = one_sided_ks_table_threshold(pair, n);
+		const double actual_distribution
+		    = one_sided_ks_table_threshold(distribution, n);
+
+		// The scalar thresholds are a few ULPs above the
+		// actual threshold.
+		EXPECT_THAT(actual_pair, Ge(expected_pair * (1 - 1e-14)))
+		    << n;
+		EXPECT_THAT(actual_pair, Le(expected_pair * 1.01)) << n;
+		EXPECT_THAT(actual_distribution,
+		    Ge(expected_distribution * (1 - 1e-14)))
+		    << n;
+		EXPECT_THAT(
+		    actual_distribution, Le(expected_distribution * 1.01))
+		    << n;
+	}
+
+	one_sided_ks_table_destroy(pair);
+	one_sided_ks_table_destroy(distribution);
+}
+
+// When min_count > max_n, the tail must still return +infty below
+// min_count.
+TEST(OneSidedKsTable, TailMinCount)
+{
+	struct one_sided_ks_table *table
+	    = one_sided_ks_pair_table_create(1000, std::log(1e-6), 10);
+
+	EXPECT_EQ(one_sided_ks_table_threshold(table, 999), HUGE_VAL);
+	EXPECT_LT(one_sided_ks_table_threshold(table, 1000), 1.0);
+	EXPECT_GE(one_sided_ks_table_threshold(table, 1000),
+	    one_sided_ks_pair_threshold(1000, 1000, std::log(1e-6)));
+	one_sided_ks_table_destroy(table);
+}
+
+// Invalid min counts are replaced, like the safe scalar functions.
+TEST(OneSidedKsTable, InvalidMinCount)
+{
+	struct one_sided_ks_table *table
+	    = one_sided_ks_pair_table_create(2, std::log(1e-6), 100);
+	const uint64_t min_count
+	    = one_sided_ks_find_min_count(std::log(1e-6));
+
+	EXPECT_EQ(table->min_count, min_count);
+	EXPECT_EQ(one_sided_ks_table_threshold(table, min_count - 1),
+	    HUGE_VAL);
+	EXPECT_EQ(one_sided_ks_table_threshold(table, min_count),
+	    one_sided_ks_pair_threshold(min_count, 2, std::log(1e-6)));
+	one_sided_ks_table_destroy(table);
+}
+} // namespace
@@ -0,0 +1,342 @@
+#include "one-sided-ks-uniform.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "one-sided-ks-isa.h"
+#include "one-sided-ks-ratio.h"
+
+#define MAX_LOG2_BUCKETS 24
+
+/* Keep k * n within int64_t, with room for prefix sums. */
+#define MAX_SCALED_COUNT ((uint64_t)1 << 62)
+
+struct one_sided_ks_uniform {
+	unsigned int log2_buckets;
+	size_t num_buckets;
+	uint64_t total;
+	uint64_t max_total;
+	/* Whether max/min predate the last insertion. */
+	bool stale;
+	/* Extreme prefix sums of k count_i - n. */
+	int64_t max;
+	int64_t min;
+	uint64_t *counts;
+};
+
+struct one_sided_ks_uniform *one_sided_ks_uniform_create(
+    unsigned int log2_buckets)
+{
+	if (log2_buckets > MAX_LOG2_BUCKETS) {
+		return NULL;
+	}
+
+	struct one_sided_ks_uniform *uniform = calloc(1, sizeof(*uniform));
+	if (uniform == NULL) {
+		return NULL;
+	}
+
+	uniform->log2_buckets = log2_buckets;
+	uniform->num_buckets = (size_t)1 << log2_buckets;
+	uniform->max_total = MAX_SCALED_COUNT >> log2_buckets;
+	uniform->counts = calloc(uniform->num_buckets, sizeof(uint64_t));
+	if (uniform->counts == NULL) {
+		one_sided_ks_uniform_destroy(uniform);
+		return NULL;
+	}
+
+	return uniform;
+}
+
+void one_sided_ks_uniform_destroy(struct one_sided_ks_uniform *uniform)
+{
+	if (uniform == NULL) {
+		return;
+	}
+
+	free(uniform->counts);
+	free(uniform);
+}
+
+size_t one_sided_ks_uniform_num_buckets(
+    const struct one_sided_ks_uniform *uniform)
+{
+	return uniform->num_buckets;
+}
+
+static size_t find_bucket(const struct one_sided_ks_uniform *uniform,
+    uint64_t x)
+{
+	/* Shifting a uint64_t by 64 is undefined. */
+	if (uniform->log2_buckets == 0) {
+		return 0;
+	}
+
+	return x >> (64 - uniform->log2_buckets);
+}
+
+int one_sided_ks_uniform_add(
+    struct one_sided_ks_uniform *uniform, uint64_t x)
+{
+	if (uniform->total >= uniform->max_total) {
+		return -1;
+	}
+
+	++uniform->counts[find_bucket(uniform, x)];
+	++uniform->total;
+	uniform->stale = true;
+	return 0;
+}
+
+int one_sided_ks_uniform_add_batch(
+    struct one_sided_ks_uniform *uniform, const uint64_t *x, size_t count)
+{
+	if (count > uniform->max_total - uniform->total) {
+		return -1;
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		++uniform->counts[find_bucket(uniform, x[i])];
+	}
+
+	uniform->total += count;
+	uniform->stale = true;
+	return 0;
+}
+
+int one_sided_ks_uniform_add_double(
+    struct one_sided_ks_uniform *uniform, double u)
+{
+	size_t bucket = uniform->num_buckets - 1;
+
+	if (isnan(u) || uniform->total >= uniform->max_total) {
+		return -1;
+	}
+
+	/* Scaling by a power of 2 is exact, and so is floor. */
+	if (!(u > 0)) {
+		bucket = 0;
+	} else if (u < 1) {
+		bucket = (size_t)floor(ldexp(u, uniform->log2_buckets));
+	}
+
+	++uniform->counts[bucket];
+	++uniform->total;
+	uniform->stale = true;
+	return 0;
+}
+
+uint64_t one_sided_ks_uniform_count(
+    const struct one_sided_ks_uniform *uniform)
+{
+	return uniform->total;
+}
+
+uint64_t one_sided_ks_uniform_bucket_count(
+    const struct one_sided_ks_uniform *uniform, size_t bucket)
+{
+	if (bucket >= uniform->num_buckets) {
+		return 0;
+	}
+
+	return uniform->counts[bucket];
+}
+
+/* Running state for a scan over buckets. */
+struct scan {
+	int64_t sum;
+	int64_t max;
+	int64_t min;
+};
+
+/*
+ * Extends `scan` with prefix sums of (count_i << shift) - n, for i in
+ * [begin, end).
+ */
+static void scan_scalar(const uint64_t *counts, size_t begin, size_t end,
+    unsigned int shift, int64_t n, struct scan *scan)
+{
+	int64_t sum = scan->sum;
+	int64_t max = scan->max;
+	int64_t min = scan->min;
+
+	for (size_t i = begin; i < end; ++i) {
+		sum += (int64_t)(counts[i] << shift) - n;
+		max = (sum > max) ? sum : max;
+		min = (sum < min) ? sum : min;
+	}
+
+	scan->sum = sum;
+	scan->max = max;
+	scan->min = min;
+}
+
+typedef void scan_kernel_fn(const uint64_t *counts, size_t num_buckets,
+    unsigned int shift, int64_t n, struct scan *scan);
+
+static void scan_kernel_scalar(const uint64_t *counts, size_t num_buckets,
+    unsigned int shift, int64_t n, struct scan *scan)
+{
+	scan_scalar(counts, 0, num_buckets, shift, n, scan);
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+
+#define ONE_SIDED_KS_SIMD 1
+
+#define AVX2 __attribute__((__target__("avx2")))
+
+/*
+ * Each iteration computes the in-register inclusive prefix sums of
+ * 4 buckets, in 2 shift-and-add steps, independently of the running
+ * total, which then only costs one add per iteration.
+ */
+static AVX2 void scan_kernel_avx2(const uint64_t *counts,
+    size_t num_buckets, unsigned int shift, int64_t n, struct scan *scan)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i vn = _mm256_set1_epi64x(n);
+	const __m128i vshift = _mm_cvtsi32_si128(shift);
+	__m256i sum = _mm256_set1_epi64x(scan->sum);
+	__m256i max = _mm256_set1_epi64x(scan->max);
+	__m256i min = _mm256_set1_epi64x(scan->min);
+	size_t i = 0;
+
+	for (; i + 4 <= num_buckets; i += 4) {
+		__m256i w = _mm256_sub_epi64(
+		    _mm256_sll_epi64(
+			_mm256_loadu_si256((const __m256i *)&counts[i]),
+			vshift),
+		    vn);
+
+		/* [w0, w1, w2, w3] + [0, w0, w1, w2] */
+		w = _mm256_add_epi64(w,
+		    _mm256_blend_epi32(
+			_mm256_permute4x64_epi64(w, _MM_SHUFFLE(2, 1, 0, 0)),
+			zero, 0x03));
+		/* + [0, 0, w0, w0 + w1] */
+		w = _mm256_add_epi64(
+		    w, _mm256_permute2x128_si256(w, w, 0x08));
+
+		const __m256i total
+		    = _mm256_permute4x64_epi64(w, _MM_SHUFFLE(3, 3, 3, 3));
+		const __m256i v = _mm256_add_epi64(w, sum);
+
+		sum = _mm256_add_epi64(sum, total);
+		max = _mm256_blendv_epi8(max, v, _mm256_cmpgt_epi64(v, max));
+		min = _mm256_blendv_epi8(min, v, _mm256_cmpgt_epi64(min, v));
+	}
+
+	int64_t maxes[4];
+	int64_t mins[4];
+
+	_mm256_storeu_si256((__m256i *)maxes, max);
+	_mm256_storeu_si256((__m256i *)mins, min);
+	scan->sum = _mm256_extract_epi64(sum, 0);
+	for (size_t j = 0; j < 4; ++j) {
+		scan->max = (maxes[j] > scan->max) ? maxes[j] : scan->max;
+		scan->min = (mins[j] < scan->min) ? mins[j] : scan->min;
+	}
+
+	scan_scalar(counts, i, num_buckets, shift, n, scan);
+}
+
+#define AVX512 __attribute__((__target__("avx512f")))
+
+/* Same as `scan_kernel_avx2`, 8 buckets at a time, in 3 steps. */
+static AVX512 void scan_kernel_avx512(const uint64_t *counts,
+    size_t num_buckets, unsigned int shift, int64_t n, struct scan *scan)
+{
+	const __m512i zero = _mm512_setzero_si512();
+	const __m512i vn = _mm512_set1_epi64(n);
+	const __m512i last = _mm512_set1_epi64(7);
+	const __m128i vshift = _mm_cvtsi32_si128(shift);
+	__m512i sum = _mm512_set1_epi64(scan->sum);
+	__m512i max = _mm512_set1_epi64(scan->max);
+	__m512i min = _mm512_set1_epi64(scan->min);
+	size_t i = 0;
+
+	for (; i + 8 <= num_buckets; i += 8) {
+		__m512i w = _mm512_sub_epi64(
+		    _mm512_sll_epi64(_mm512_loadu_si512(&counts[i]), vshift),
+		    vn);
+
+		/* Shift lanes up by 1, 2 and 4, filling with zeros. */
+		w = _mm512_add_epi64(w, _mm512_alignr_epi64(w, zero, 7));
+		w = _mm512_add_epi64(w, _mm512_alignr_epi64(w, zero, 6));
+		w = _mm512_add_epi64(w, _mm512_alignr_epi64(w, zero, 4));
+
+		const __m512i total = _mm512_permutexvar_epi64(last, w);
+		const __m512i v = _mm512_add_epi64(w, sum);
+
+		sum = _mm512_add_epi64(sum, total);
+		max = _mm512_max_epi64(max, v);
+		min = _mm512_min_epi64(min, v);
+	}
+
+	const int64_t vector_max = _mm512_reduce_max_epi64(max);
+	const int64_t vector_min = _mm512_reduce_min_epi64(min);
+
+	scan->sum = _mm_cvtsi128_si64(_mm512_castsi512_si128(sum));
+	scan->max = (vector_max > scan->max) ? vector_max : scan->max;
+	scan->min = (vector_min < scan->min) ? vector_min : scan->min;
+	scan_scalar(counts, i, num_buckets, shift, n, scan);
+}
+
+#undef AVX512
+#undef AVX2
+#endif
+
+static void update(struct one_sided_ks_uniform *uniform)
+{
+	struct scan scan = { 0, 0, 0 };
+
+	if (!uniform->stale) {
+		return;
+	}
+
+	scan_kernel_fn *kernel = scan_kernel_scalar;
+#ifdef ONE_SIDED_KS_SIMD
+	switch (one_sided_ks_isa_get()) {
+	case ONE_SIDED_KS_ISA_AVX512:
+		kernel = scan_kernel_avx512;
+		break;
+	case ONE_SIDED_KS_ISA_AVX2:
+		kernel = scan_kernel_avx2;
+		break;
+	case ONE_SIDED_KS_ISA_SCALAR:
+		break;
+	}
+#endif
+
+	kernel(uniform->counts, uniform->num_buckets, uniform->log2_buckets,
+	    uniform->total, &scan);
+	uniform->max = scan.max;
+	uniform->min = scan.min;
+	uniform->stale = false;
+}
+
+double one_sided_ks_uniform_d_plus(struct one_sided_ks_uniform *uniform)
+{
+	if (uniform->total == 0) {
+		return 0;
+	}
+
+	update(uniform);
+	return one_sided_ks_ratio_down(uniform->max,
+	    (unsigned __int128)uniform->total * uniform->num_buckets);
+}
+
+double one_sided_ks_uniform_d_minus(struct one_sided_ks_uniform *uniform)
+{
+	if (uniform->total == 0) {
+		return 0;
+	}
+
+	update(uniform);
+	return one_sided_ks_ratio_down(-uniform->min,
+	    (unsigned __int128)uniform->total * uniform->num_buckets);
+}
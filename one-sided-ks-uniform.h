@@ -0,0 +1,86 @@
+#ifndef ONE_SIDED_KS_UNIFORM_H
+#define ONE_SIDED_KS_UNIFORM_H
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/*
+ * One-sample statistics against Uniform(0, 1), for high-throughput
+ * streams like RNG or hash function outputs, or any stream after a
+ * probability-integral transform.
+ *
+ * Observations are 64-bit fixed-point fractions (x / 2^64), and land
+ * in one of k = 2^log2_buckets buckets with a single shift.  With
+ * `prefix_i` the number of observations in buckets 0 to i, and `n`
+ * the total,
+ *
+ *   D+ >= max_i [prefix_i / n - (i + 1) / k],
+ *   D- >= max_i [(i + 1) / k - prefix_i / n],
+ *
+ * and we compute both lower bounds exactly, in one pass over the
+ * buckets, as the extreme prefix sums of k count_i - n, with SIMD
+ * (AVX2 or AVX-512) when available.  Compare them with
+ * `one_sided_ks_distribution_threshold_fast(n, min_count, log_eps)`;
+ * they're never more than 1 / k below the exact statistics.
+ *
+ * The statistics are cached until the next insertion.
+ */
+struct one_sided_ks_uniform;
+
+/*
+ * Returns a new accumulator with 2^log2_buckets buckets, or NULL on
+ * failure.  `log2_buckets` must be at most 24.
+ */
+struct one_sided_ks_uniform *one_sided_ks_uniform_create(
+    unsigned int log2_buckets);
+
+void one_sided_ks_uniform_destroy(struct one_sided_ks_uniform *uniform);
+
+size_t one_sided_ks_uniform_num_buckets(
+    const struct one_sided_ks_uniform *uniform);
+
+/*
+ * Adds the observation x / 2^64.  Returns 0 on success, -1 if the
+ * count would exceed 2^62 / num_buckets.
+ */
+int one_sided_ks_uniform_add(
+    struct one_sided_ks_uniform *uniform, uint64_t x);
+
+/*
+ * Adds `count` observations, like `one_sided_ks_uniform_add`.  On
+ * failure, none of the observations is added.
+ */
+int one_sided_ks_uniform_add_batch(
+    struct one_sided_ks_uniform *uniform, const uint64_t *x, size_t count);
+
+/*
+ * Adds an observation `u` in [0, 1]; values outside that range are
+ * clamped.  Returns 0 on success, -1 if `u` is NaN or the count
+ * would overflow.
+ */
+int one_sided_ks_uniform_add_double(
+    struct one_sided_ks_uniform *uniform, double u);
+
+/* Returns the number of observations. */
+uint64_t one_sided_ks_uniform_count(
+    const struct one_sided_ks_uniform *uniform);
+
+/* Returns the number of observations in `bucket`. */
+uint64_t one_sided_ks_uniform_bucket_count(
+    const struct one_sided_ks_uniform *uniform, size_t bucket);
+
+/*
+ * Returns the lower bound on D+, rounded down, or 0 if there is no
+ * observation.
+ */
+double one_sided_ks_uniform_d_plus(struct one_sided_ks_uniform *uniform);
+
+/* Returns the lower bound on D-, like `one_sided_ks_uniform_d_plus`. */
+double one_sided_ks_uniform_d_minus(struct one_sided_ks_uniform *uniform);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /* !ONE_SIDED_KS_UNIFORM_H */
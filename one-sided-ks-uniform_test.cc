@@ -0,0 +1,210 @@
+#include "one-sided-ks-uniform.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "one-sided-ks-isa.h"
+#include "one-sided-ks.h"
+
+namespace {
+using ::testing::DoubleNear;
+
+// Reference implementation: extremes of k * prefix_i - n * (i + 1).
+void scaled_extremes(
+    const std::vector<uint64_t> &counts, int64_t *max, int64_t *min)
+{
+	const int64_t k = counts.size();
+	int64_t n = 0;
+	int64_t prefix = 0;
+
+	for (const uint64_t count : counts) {
+		n += count;
+	}
+
+	*max = 0;
+	*min = 0;
+	for (int64_t i = 0; i < k; ++i) {
+		prefix += counts[i];
+
+		const int64_t value = k * prefix - n * (i + 1);
+		*max = std::max(*max, value);
+		*min = std::min(*min, value);
+	}
+}
+
+TEST(OneSidedKsUniform, Empty)
+{
+	struct one_sided_ks_uniform *uniform = one_sided_ks_uniform_create(4);
+
+	EXPECT_EQ(one_sided_ks_uniform_num_buckets(uniform), 16);
+	EXPECT_EQ(one_sided_ks_uniform_count(uniform), 0);
+	EXPECT_EQ(one_sided_ks_uniform_d_plus(uniform), 0);
+	EXPECT_EQ(one_sided_ks_uniform_d_minus(uniform), 0);
+	EXPECT_EQ(one_sided_ks_uniform_add_double(uniform, NAN), -1);
+	EXPECT_EQ(one_sided_ks_uniform_count(uniform), 0);
+	one_sided_ks_uniform_destroy(uniform);
+
+	EXPECT_EQ(one_sided_ks_uniform_create(25), nullptr);
+}
+
+TEST(OneSidedKsUniform, Buckets)
+{
+	struct one_sided_ks_uniform *uniform = one_sided_ks_uniform_create(2);
+
+	ASSERT_EQ(one_sided_ks_uniform_add(uniform, 0), 0);
+	ASSERT_EQ(one_sided_ks_uniform_add(uniform, (1ULL << 62) - 1), 0);
+	ASSERT_EQ(one_sided_ks_uniform_add(uniform, 1ULL << 62), 0);
+	ASSERT_EQ(one_sided_ks_uniform_add(uniform, UINT64_MAX), 0);
+	ASSERT_EQ(one_sided_ks_uniform_add_double(uniform, -1), 0);
+	ASSERT_EQ(one_sided_ks_uniform_add_double(uniform, 0.25), 0);
+	ASSERT_EQ(one_sided_ks_uniform_add_double(
+		      uniform, std::nextafter(0.75, 0.0)),
+	    0);
+	ASSERT_EQ(one_sided_ks_uniform_add_double(uniform, 1), 0);
+
+	EXPECT_EQ(one_sided_ks_uniform_bucket_count(uniform, 0), 3);
+	EXPECT_EQ(one_sided_ks_uniform_bucket_count(uniform, 1), 2);
+	EXPECT_EQ(one_sided_ks_uniform_bucket_count(uniform, 2), 1);
+	EXPECT_EQ(one_sided_ks_uniform_bucket_count(uniform, 3), 2);
+	EXPECT_EQ(one_sided_ks_uniform_count(uniform), 8);
+	one_sided_ks_uniform_destroy(uniform);
+
+	// A single bucket always has D+ = D- = 0.
+	uniform = one_sided_ks_uniform_create(0);
+	ASSERT_EQ(one_sided_ks_uniform_add(uniform, 12345), 0);
+	EXPECT_EQ(one_sided_ks_uniform_bucket_count(uniform, 0), 1);
+	EXPECT_EQ(one_sided_ks_uniform_d_plus(uniform), 0);
+	EXPECT_EQ(one_sided_ks_uniform_d_minus(uniform), 0);
+	one_sided_ks_uniform_destroy(uniform);
+}
+
+// Every scan kernel the host supports must match a scalar reference,
+// including for bucket counts smaller than a vector, and the scalar
+// kernel exactly.
+TEST(OneSidedKsUniform, MatchesScan)
+{
+	const one_sided_ks_isa old_limit
+	    = one_sided_ks_isa_set_limit(ONE_SIDED_KS_ISA_SCALAR);
+	std::vector<double> scalar;
+
+	for (int level = ONE_SIDED_KS_ISA_SCALAR;
+	     level <= one_sided_ks_isa_supported(); ++level) {
+		std::mt19937_64 rng(42);
+		std::vector<double> results;
+
+		one_sided_ks_isa_set_limit(one_sided_ks_isa(level));
+		for (const unsigned int log2 : { 1, 2, 3, 4, 5, 10, 16 }) {
+			const size_t k = size_t(1) << log2;
+			struct one_sided_ks_uniform *uniform
+			    = one_sided_ks_uniform_create(log2);
+			std::vector<uint64_t> counts(k, 0);
+			std::vector<uint64_t> batch;
+
+			for (size_t i = 1; i <= 200; ++i) {
+				// Alternate between skewing low and high.
+				batch.clear();
+				for (size_t j = 0; j < 100; ++j) {
+					const uint64_t x = (i / 20 % 2 == 0)
+					    ? std::min(rng(), rng())
+					    : std::max(rng(), rng());
+
+					batch.push_back(x);
+					++counts[x >> (64 - log2)];
+				}
+
+				ASSERT_EQ(
+				    one_sided_ks_uniform_add_batch(uniform,
+					batch.data(), batch.size()),
+				    0);
+
+				int64_t max;
+				int64_t min;
+				scaled_extremes(counts, &max, &min);
+
+				// A single rounded division of exact
+				// integers: the exact result, rounded down,
+				// can't be any higher.
+				const double den = 100.0 * i * k;
+				const double d_plus
+				    = one_sided_ks_uniform_d_plus(uniform);
+				const double d_minus
+				    = one_sided_ks_uniform_d_minus(uniform);
+				ASSERT_THAT(
+				    d_plus, DoubleNear(max / den, 1e-15));
+				ASSERT_LE(d_plus, max / den);
+				ASSERT_THAT(
+				    d_minus, DoubleNear(-min / den, 1e-15));
+				ASSERT_LE(d_minus, -min / den);
+				results.push_back(d_plus);
+				results.push_back(d_minus);
+			}
+
+			one_sided_ks_uniform_destroy(uniform);
+		}
+
+		if (level == ONE_SIDED_KS_ISA_SCALAR) {
+			scalar = results;
+		} else {
+			EXPECT_EQ(scalar, results) << level;
+		}
+	}
+
+	one_sided_ks_isa_set_limit(old_limit);
+}
+
+// With 2^24 buckets, we can accept at most 2^38 observations.
+TEST(OneSidedKsUniform, Overflow)
+{
+	struct one_sided_ks_uniform *uniform
+	    = one_sided_ks_uniform_create(24);
+	const uint64_t max_total = (1ULL << 62) >> 24;
+	std::vector<uint64_t> batch(1000, 0);
+
+	ASSERT_EQ(one_sided_ks_uniform_add_batch(
+		      uniform, batch.data(), batch.size()),
+	    0);
+	// We must fail before reading any value.
+	EXPECT_EQ(one_sided_ks_uniform_add_batch(
+		      uniform, batch.data(), max_total - 999),
+	    -1);
+	EXPECT_EQ(one_sided_ks_uniform_count(uniform), batch.size());
+	one_sided_ks_uniform_destroy(uniform);
+}
+
+// A slightly biased RNG should be rejected, and D- should stay below
+// the threshold.
+TEST(OneSidedKsUniform, Reject)
+{
+	const double log_eps = std::log(1e-6);
+	const uint64_t min_count = one_sided_ks_find_min_count(log_eps);
+	std::mt19937_64 rng(43);
+	std::uniform_int_distribution<int> coin(0, 99);
+	struct one_sided_ks_uniform *uniform
+	    = one_sided_ks_uniform_create(10);
+	uint64_t n = 1;
+
+	for (; n <= 10000000; ++n) {
+		// One value in 100 is the min of two.
+		const uint64_t x = rng();
+		const uint64_t y = (coin(rng) == 0) ? std::min(x, rng()) : x;
+
+		ASSERT_EQ(one_sided_ks_uniform_add(uniform, y), 0);
+		if (n % 1000 == 0
+		    && one_sided_ks_uniform_d_plus(uniform)
+			>= one_sided_ks_distribution_threshold_fast(
+			    n, min_count, log_eps)) {
+			break;
+		}
+	}
+
+	EXPECT_LE(n, 10000000);
+	EXPECT_LT(one_sided_ks_uniform_d_minus(uniform),
+	    one_sided_ks_distribution_threshold_fast(n, min_count, log_eps));
+	one_sided_ks_uniform_destroy(uniform);
+}
+} // namespace
@@ -1,4 +1,5 @@
 #include "one-sided-ks.h"
+#include "one-sided-ks-inline.h"
 
 #include <assert.h>
 #include <float.h>
@@ -8,6 +9,8 @@
 #include <stdint.h>
 #include <string.h>
 
+#include "one-sided-ks-isa.h"
+
 /*
  * This first section handles safe rounding. It's unlikely to make any
  * practical difference, but I tend to like extreme p values (e.g.,
@@ -24,76 +27,40 @@ const double one_sided_ks_eq = -0.6931471805599454;
 /* -log 2 rounded away from 0. */
 const double one_sided_ks_class = -0.6931471805599454;
 
-/* sqrt(1/2) rounded up. */
-static const double sqrt_half_up = 0.7071067811865476;
-
-/* log 1/2 rounded down = -log 2. */
-static const double log_half_down = -0.6931471805599454;
-
-static inline uint64_t float_bits(double x)
-{
-	uint64_t bits;
-	uint64_t mask;
-
-	memcpy(&bits, &x, sizeof(bits));
-	/* extract the sign bit. */
-	mask = (int64_t)bits >> 63;
-	/*
-	 * If negative, flip the significand bits to convert from
-	 * sign-magnitude to 2's complement.
-	 */
-	return bits ^ (mask >> 1);
-}
-
-static inline double bits_float(uint64_t bits)
-{
-	double ret;
-	uint64_t mask;
-
-	mask = (int64_t)bits >> 63;
-	/* Undo the bit-flipping above. */
-	bits ^= (mask >> 1);
-	memcpy(&ret, &bits, sizeof(ret));
-	return ret;
-}
-
-static inline double next_k(double x, uint64_t delta)
-{
-	return bits_float(float_bits(x) + delta);
-}
-
-__attribute__((__unused__)) static inline double next(double x)
-{
-	return next_k(x, 1);
-}
-
-static inline double prev_k(double x, uint64_t delta)
-{
-	return bits_float(float_bits(x) - delta);
-}
-
-__attribute__((__unused__)) static inline double prev(double x)
-{
-	return prev_k(x, 1);
-}
-
-/* Assume libm is off by < 4 ULPs. */
-static const uint64_t libm_error_limit = 4;
-
-static inline double log_up(double x)
-{
-	return next_k(log(x), libm_error_limit);
-}
-
-static inline double log_down(double x)
-{
-	return prev_k(log(x), libm_error_limit);
-}
-
-static inline double sqrt_up(double x)
+/*
+ * The rounding helpers, and the upper bounds on thresholds, live in
+ * one-sided-ks-inline.h so that callers can inline them.
+ */
+#define sqrt_half_up one_sided_ks_inline_sqrt_half_up
+#define log_half_down one_sided_ks_inline_log_half_down
+#define log_error_limit one_sided_ks_inline_log_error_limit
+#define ln2_hi one_sided_ks_inline_ln2_hi
+#define ln2_lo one_sided_ks_inline_ln2_lo
+#define log_lg1 one_sided_ks_inline_lg1
+#define log_lg2 one_sided_ks_inline_lg2
+#define log_lg3 one_sided_ks_inline_lg3
+#define log_lg4 one_sided_ks_inline_lg4
+#define log_lg5 one_sided_ks_inline_lg5
+#define log_lg6 one_sided_ks_inline_lg6
+#define log_lg7 one_sided_ks_inline_lg7
+#define float_bits(X) one_sided_ks_inline_float_bits(X)
+#define bits_float(BITS) one_sided_ks_inline_bits_float(BITS)
+#define next_k(X, DELTA) one_sided_ks_inline_next_k(X, DELTA)
+#define next(X) one_sided_ks_inline_next(X)
+#define prev_k(X, DELTA) one_sided_ks_inline_prev_k(X, DELTA)
+#define prev(X) one_sided_ks_inline_prev(X)
+#define log_up(X) one_sided_ks_inline_log_up(X)
+#define log_down(X) one_sided_ks_inline_log_down(X)
+#define sqrt_up(X) one_sided_ks_inline_sqrt_up(X)
+#define log_b_up(M, LOG_EPS) one_sided_ks_inline_log_b_up(M, LOG_EPS)
+#define pair_f_up(X, LOG_B) one_sided_ks_inline_pair_f_up(X, LOG_B)
+#define distribution_threshold_up(X, LOG_B)                                  \
+	one_sided_ks_inline_distribution_threshold_up(X, LOG_B)
+
+/* A real function, since we pass it to invert_threshold. */
+static double threshold_up(double x, double log_b_up)
 {
-	/* sqrt is supposed to be rounded correctly. */
-	return next(sqrt(x));
+	return one_sided_ks_inline_threshold_up(x, log_b_up);
 }
 
 static inline double sqrt_down(double x)
@@ -135,11 +102,7 @@ int one_sided_ks_check_constants(void)
 	return ret;
 }
 
-/*
- * f(x) / x, where f(x) = ((x + 1)(2 log x + log b))^1/2, rounded up for
- * the two-sample case, and .
- */
-static double threshold_up(double x, double log_b_up)
+static double pair_f_down(double x, double log_b_down)
 {
 	/* Exact up to 2^53. */
 	const double xp1 = x + 1;
@@ -148,41 +111,25 @@ static double threshold_up(double x, double log_b_up)
 	 *
 	 * x = 1 is exact, and so is the multiplication by 2.
 	 */
-	const double f_x2 = next(xp1 * next(2 * log_up(x) + log_b_up));
+	const double f_x2 = prev(xp1 * prev(2 * log_down(x) + log_b_down));
 
-	return next(sqrt_up(f_x2) / x);
+	return sqrt_down(f_x2);
 }
 
-/*
- * f(x) / x, where f(x) = (x (2 log x + log b))^1/2 for one-sample.
- *
- * We work with P[D+(n) >= r / n] <= exp[-2 r^2 / n], so it suffices
- * for f^2(x) / n = 2 log x + log b.
- */
-static double distribution_threshold_up(double x, double log_b_up)
+static double threshold_down(double x, double log_b_down)
 {
-	/*
-	 * compute f(x)^2 = x (2 log x + log b).
-	 *
-	 * x = 1 is exact, and so is the multiplication by 2.
-	 */
-	const double f_x2 = next(x * next(2 * log_up(x) + log_b_up));
-
-	return next(sqrt_half_up * next(sqrt_up(f_x2) / x));
+	return prev(pair_f_down(x, log_b_down) / x);
 }
 
-static double threshold_down(double x, double log_b_down)
+/*
+ * f(x) = (x (2 log x + log b) / 2)^1/2, rounded down, for the
+ * one-sample case.
+ */
+static double distribution_f_down(double x, double log_b_down)
 {
-	/* Exact up to 2^53. */
-	const double xp1 = x + 1;
-	/*
-	 * compute f(x)^2 = (x + 1)(2 log x + log b).
-	 *
-	 * x = 1 is exact, and so is the multiplication by 2.
-	 */
-	const double f_x2 = prev(xp1 * prev(2 * log_down(x) + log_b_down));
+	const double f_x2 = prev(x * prev(2 * log_down(x) + log_b_down));
 
-	return prev(sqrt_down(f_x2) / x);
+	return prev(prev(sqrt_half_up) * sqrt_down(f_x2));
 }
 
 /*
@@ -190,14 +137,34 @@ static double threshold_down(double x, double log_b_down)
  *
  * log(b) = -log(eps) - log(min_count - 1).
  */
-static double log_b_up(uint64_t min_count, double log_eps)
+static double log_b_down(uint64_t min_count, double log_eps)
 {
-	return next(-log_down(min_count - 1.0) - log_eps);
+	return prev(-log_up(min_count - 1.0) - log_eps);
 }
 
-static double log_b_down(uint64_t min_count, double log_eps)
+/*
+ * Returns `min_count` if it is valid for `log_eps`, and the least
+ * valid min_count otherwise.
+ *
+ * Validity is monotonic in min_count, so comparing with the
+ * (memoised) least valid min_count is equivalent to
+ * one_sided_ks_min_count_valid, without any call to log.
+ */
+static uint64_t valid_min_count(uint64_t min_count, double log_eps)
 {
-	return prev(-log_up(min_count - 1.0) - log_eps);
+	const uint64_t least = one_sided_ks_find_min_count(log_eps);
+
+	if (min_count >= least) {
+		return min_count;
+	}
+
+	/* find_min_count gives up past 2^63; min_count may be ok. */
+	if (least == SIZE_MAX
+	    && one_sided_ks_min_count_valid(min_count, log_eps) != 0) {
+		return min_count;
+	}
+
+	return least;
 }
 
 double one_sided_ks_pair_threshold(
@@ -206,9 +173,7 @@ double one_sided_ks_pair_threshold(
 	assert(log_eps <= 0
 	    && "log_eps must be negative (for a false positive rate < 1).");
 
-	if (one_sided_ks_min_count_valid(min_count, log_eps) == 0) {
-		min_count = one_sided_ks_find_min_count(log_eps);
-	}
+	min_count = valid_min_count(min_count, log_eps);
 
 	return one_sided_ks_pair_threshold_fast(n, min_count, log_eps);
 }
@@ -216,7 +181,58 @@ double one_sided_ks_pair_threshold(
 double one_sided_ks_pair_threshold_fast(
     uint64_t n, uint64_t min_count, double log_eps)
 {
-	if (n < min_count) {
+	return one_sided_ks_inline_pair_threshold_fast(n, min_count, log_eps);
+}
+
+double one_sided_ks_distribution_threshold(
+    uint64_t n, uint64_t min_count, double log_eps)
+{
+	assert(log_eps <= 0
+	    && "log_eps must be negative (for a false positive rate < 1).");
+
+	min_count = valid_min_count(min_count, log_eps);
+
+	return one_sided_ks_distribution_threshold_fast(
+	    n, min_count, log_eps);
+}
+
+double one_sided_ks_distribution_threshold_fast(
+    uint64_t n, uint64_t min_count, double log_eps)
+{
+	return one_sided_ks_inline_distribution_threshold_fast(
+	    n, min_count, log_eps);
+}
+
+/*
+ * Unpaired two-sample thresholds.
+ *
+ * When F_A <= F_B, the triangle inequality gives
+ *
+ *   sup [F_A^n_a - F_B^n_b] <= sup [F_A^n_a - F_A] + sup [F_B - F_B^n_b],
+ *
+ * and each term on the right-hand side is a one-sample statistic
+ * for its own stream of observations.  Splitting the false positive
+ * budget evenly between the two one-sample confidence sequences
+ * bounds the probability that either ever exceeds its threshold,
+ * regardless of how observations interleave between A and B.
+ */
+double one_sided_ks_unpaired_threshold(
+    uint64_t n_a, uint64_t n_b, uint64_t min_count, double log_eps)
+{
+	assert(log_eps <= 0
+	    && "log_eps must be negative (for a false positive rate < 1).");
+
+	const double log_half_eps = log_eps + one_sided_ks_eq;
+	min_count = valid_min_count(min_count, log_half_eps);
+
+	return one_sided_ks_unpaired_threshold_fast(
+	    n_a, n_b, min_count, log_eps);
+}
+
+double one_sided_ks_unpaired_threshold_fast(
+    uint64_t n_a, uint64_t n_b, uint64_t min_count, double log_eps)
+{
+	if (n_a < min_count || n_b < min_count) {
 		return HUGE_VAL;
 	}
 
@@ -224,39 +240,664 @@ double one_sided_ks_pair_threshold_fast(
 		return -HUGE_VAL;
 	}
 
-	if (log_eps > log_half_down) {
-		log_eps = log_half_down;
+	const double log_b = log_b_up(min_count, log_eps + one_sided_ks_eq);
+	return next(distribution_threshold_up(n_a, log_b)
+	    + distribution_threshold_up(n_b, log_b));
+}
+
+/*
+ * Integer rejection counts.
+ *
+ * With n pairs, the two-sample statistic is always r / n for some
+ * integer r, and r / n > f(n) / n iff r > f(n).  Taking the floor of
+ * f(n) rounded up, plus one, yields a conservative integer cutoff.
+ */
+static uint64_t pair_min_reject(uint64_t n, double log_b_up)
+{
+	const double f = pair_f_up(n, log_b_up);
+
+	/* NaN never rejects. */
+	if (!(f < 0x1p64)) {
+		return UINT64_MAX;
 	}
 
-	return threshold_up(n, log_b_up(min_count, log_eps));
+	return (uint64_t)f + 1;
 }
 
-double one_sided_ks_distribution_threshold(
+uint64_t one_sided_ks_pair_min_reject(
     uint64_t n, uint64_t min_count, double log_eps)
 {
 	assert(log_eps <= 0
 	    && "log_eps must be negative (for a false positive rate < 1).");
 
-	if (one_sided_ks_min_count_valid(min_count, log_eps) == 0) {
-		min_count = one_sided_ks_find_min_count(log_eps);
-	}
+	min_count = valid_min_count(min_count, log_eps);
 
-	return one_sided_ks_distribution_threshold_fast(
-	    n, min_count, log_eps);
+	return one_sided_ks_pair_min_reject_fast(n, min_count, log_eps);
 }
 
-double one_sided_ks_distribution_threshold_fast(
+uint64_t one_sided_ks_pair_min_reject_fast(
     uint64_t n, uint64_t min_count, double log_eps)
 {
 	if (n < min_count) {
-		return HUGE_VAL;
+		return UINT64_MAX;
 	}
 
 	if (log_eps >= 0) {
-		return -HUGE_VAL;
+		return 0;
+	}
+
+	if (log_eps > log_half_down) {
+		log_eps = log_half_down;
 	}
 
-	return distribution_threshold_up(n, log_b_up(min_count, log_eps));
+	return pair_min_reject(n, log_b_up(min_count, log_eps));
+}
+
+void one_sided_ks_pair_reject_iter_init(
+    struct one_sided_ks_pair_reject_iter *iter, uint64_t n,
+    uint64_t min_count, double log_eps)
+{
+	assert(log_eps <= 0
+	    && "log_eps must be negative (for a false positive rate < 1).");
+
+	min_count = valid_min_count(min_count, log_eps);
+
+	if (log_eps > log_half_down) {
+		log_eps = log_half_down;
+	}
+
+	*iter = (struct one_sided_ks_pair_reject_iter) {
+		.n = n,
+		.min_count = min_count,
+		.log_eps = log_eps,
+	};
+
+	one_sided_ks_pair_reject_iter_refill(iter);
+}
+
+/*
+ * f is increasing for n >= min_count (when min_count is valid), so
+ * if f_up(hi) < r_min, r_min is also a valid cutoff for all n in
+ * [iter->n, hi].  Gallop then bisect for the largest such hi we can
+ * find, and resume at hi + 1.
+ */
+void one_sided_ks_pair_reject_iter_refill(
+    struct one_sided_ks_pair_reject_iter *iter)
+{
+	const uint64_t n = iter->n;
+
+	if (n < iter->min_count) {
+		iter->r_min = UINT64_MAX;
+		iter->next_n = iter->min_count;
+		return;
+	}
+
+	if (iter->log_eps >= 0) {
+		iter->r_min = 0;
+		iter->next_n = UINT64_MAX;
+		return;
+	}
+
+	const double log_b = log_b_up(iter->min_count, iter->log_eps);
+	const uint64_t r_min = pair_min_reject(n, log_b);
+
+	iter->r_min = r_min;
+	if (r_min == UINT64_MAX) {
+		iter->next_n = UINT64_MAX;
+		return;
+	}
+
+	/* Invariant: f_up(low) < r_min; f_up(high) >= r_min, or overflow. */
+	uint64_t low = n;
+	uint64_t high = n;
+	for (uint64_t step = 1;; step *= 2) {
+		if (high > UINT64_MAX - step) {
+			high = UINT64_MAX;
+			break;
+		}
+
+		high += step;
+		if (pair_min_reject(high, log_b) > r_min) {
+			break;
+		}
+
+		low = high;
+	}
+
+	while (low + 1 < high) {
+		const uint64_t pivot = low + (high - low) / 2;
+
+		if (pair_min_reject(pivot, log_b) > r_min) {
+			high = pivot;
+		} else {
+			low = pivot;
+		}
+	}
+
+	iter->next_n = (low == UINT64_MAX) ? UINT64_MAX : low + 1;
+}
+
+/*
+ * Skip-ahead scheduling.
+ *
+ * With n samples, each new sample (pair) increases the numerator of
+ * D+ by at most 1, so m D+(m) <= n D+(n) + (m - n) for m > n, and we
+ * can only reject at m if n D+(n) + m - n > f(m) = m threshold(m).
+ *
+ * f is increasing, so, if n D+(n) + hi - n <= f(lo) for lo <= hi,
+ * we also know n D+(n) + m - n <= f(lo) <= f(m) for all m in
+ * [lo, hi]: we can't reject before hi + 1.  Iterating that argument
+ * with lo = hi converges geometrically (with rate f'), and only
+ * relies on lower bounds for f.
+ */
+
+/* Largest double <= n. */
+static double u64_down(uint64_t n)
+{
+	const double ret = n;
+
+	return (ret < 0x1p64 && (uint64_t)ret <= n) ? ret : prev(ret);
+}
+
+static uint64_t next_check(uint64_t n, double d_plus, uint64_t min_count,
+    double log_eps, double f_down(double x, double log_b_down))
+{
+	if (log_eps >= 0) {
+		return n + 1;
+	}
+
+	if (d_plus < 0) {
+		d_plus = 0;
+	}
+
+	/*
+	 * Upper bound on the numerator, with slack for a few ULPs of
+	 * error in d_plus.
+	 */
+	const double numerator = next_k(u64_down(n) * d_plus, 4);
+	const double log_b = log_b_down(min_count, log_eps);
+	/* We can't reject at or before hi. */
+	uint64_t hi = (n >= min_count) ? n : min_count - 1;
+
+	for (size_t i = 0; i < 32 && hi < UINT64_MAX - 1; ++i) {
+		const double f = f_down(u64_down(hi), log_b);
+		if (!(f > numerator)) {
+			break;
+		}
+
+		const double bound
+		    = prev(prev(f - numerator) + u64_down(n));
+		if (!(bound >= hi + 1.0)) {
+			break;
+		}
+
+		const uint64_t new_hi
+		    = (bound >= 0x1p64) ? UINT64_MAX - 1 : (uint64_t)bound;
+		if (new_hi <= hi) {
+			break;
+		}
+
+		hi = new_hi;
+	}
+
+	return hi + 1;
+}
+
+uint64_t one_sided_ks_pair_next_check(
+    uint64_t n, double d_plus, uint64_t min_count, double log_eps)
+{
+	assert(log_eps <= 0
+	    && "log_eps must be negative (for a false positive rate < 1).");
+
+	min_count = valid_min_count(min_count, log_eps);
+
+	if (log_eps < 0 && log_eps > log_half_down) {
+		log_eps = log_half_down;
+	}
+
+	return next_check(n, d_plus, min_count, log_eps, pair_f_down);
+}
+
+uint64_t one_sided_ks_distribution_next_check(
+    uint64_t n, double d_plus, uint64_t min_count, double log_eps)
+{
+	assert(log_eps <= 0
+	    && "log_eps must be negative (for a false positive rate < 1).");
+
+	min_count = valid_min_count(min_count, log_eps);
+
+	return next_check(
+	    n, d_plus, min_count, log_eps, distribution_f_down);
+}
+
+/*
+ * Batched thresholds.
+ *
+ * Validation and `log_b_up` only depend on `min_count` and `log_eps`,
+ * so we hoist them out of the loop, and evaluate `threshold_up` or
+ * `distribution_threshold_up` with SIMD kernels when the CPU supports
+ * them.  The kernels compute log with a branch-free version of
+ * `one_sided_ks_inline_log`, and perform the same sequence of
+ * operations as the scalar code, so the results are identical.
+ */
+typedef void batch_kernel_fn(const uint64_t *n, size_t count,
+    uint64_t min_count, double log_b, double *out);
+
+static void pair_threshold_batch_scalar(const uint64_t *n, size_t count,
+    uint64_t min_count, double log_b, double *out)
+{
+	for (size_t i = 0; i < count; ++i) {
+		out[i] = (n[i] < min_count) ? HUGE_VAL
+					    : threshold_up(n[i], log_b);
+	}
+}
+
+static void distribution_threshold_batch_scalar(const uint64_t *n,
+    size_t count, uint64_t min_count, double log_b, double *out)
+{
+	for (size_t i = 0; i < count; ++i) {
+		out[i] = (n[i] < min_count)
+		    ? HUGE_VAL
+		    : distribution_threshold_up(n[i], log_b);
+	}
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+
+#define ONE_SIDED_KS_SIMD 1
+
+/* 2^52 + 2^51: adding an int64 in (-2^51, 2^51) yields its double. */
+static const double int_to_double_magic = 6755399441055744.0;
+
+#define AVX2 __attribute__((__target__("avx2")))
+
+static AVX2 inline __m256d avx2_bits_float(__m256i bits)
+{
+	const __m256i mask
+	    = _mm256_cmpgt_epi64(_mm256_setzero_si256(), bits);
+
+	return _mm256_castsi256_pd(
+	    _mm256_xor_si256(bits, _mm256_srli_epi64(mask, 1)));
+}
+
+static AVX2 inline __m256i avx2_float_bits(__m256d x)
+{
+	const __m256i bits = _mm256_castpd_si256(x);
+	const __m256i mask
+	    = _mm256_cmpgt_epi64(_mm256_setzero_si256(), bits);
+
+	return _mm256_xor_si256(bits, _mm256_srli_epi64(mask, 1));
+}
+
+static AVX2 inline __m256d avx2_next_k(__m256d x, uint64_t delta)
+{
+	return avx2_bits_float(_mm256_add_epi64(
+	    avx2_float_bits(x), _mm256_set1_epi64x(delta)));
+}
+
+static AVX2 inline __m256d avx2_next(__m256d x)
+{
+	return avx2_next_k(x, 1);
+}
+
+/* Correctly rounded uint64 -> double, like a C conversion. */
+static AVX2 inline __m256d avx2_u64_to_double(__m256i x)
+{
+	/* 2^52 + low 32 bits, and 2^84 + high 32 bits * 2^32. */
+	const __m256i lo = _mm256_or_si256(
+	    _mm256_and_si256(x, _mm256_set1_epi64x(0xFFFFFFFFULL)),
+	    _mm256_set1_epi64x(0x4330000000000000ULL));
+	const __m256i hi = _mm256_or_si256(_mm256_srli_epi64(x, 32),
+	    _mm256_set1_epi64x(0x4530000000000000ULL));
+	/* Exact: hi * 2^32 - 2^52. */
+	const __m256d hi_d = _mm256_sub_pd(_mm256_castsi256_pd(hi),
+	    _mm256_set1_pd(19342813118337666422669312.0));
+
+	/* The only rounding step. */
+	return _mm256_add_pd(hi_d, _mm256_castsi256_pd(lo));
+}
+
+/* fdlibm's log, for positive normal x, without the |f| < 2^-20 case. */
+static AVX2 inline __m256d avx2_log(__m256d x)
+{
+	const __m256i bits = _mm256_castpd_si256(x);
+	const __m256i low_word
+	    = _mm256_and_si256(bits, _mm256_set1_epi64x(0xFFFFFFFFULL));
+	__m256i hx = _mm256_srli_epi64(bits, 32);
+	__m256i k = _mm256_sub_epi64(
+	    _mm256_srli_epi64(hx, 20), _mm256_set1_epi64x(1023));
+	hx = _mm256_and_si256(hx, _mm256_set1_epi64x(0x000FFFFF));
+
+	/* Normalise x or x / 2 to [sqrt(2)/2, sqrt(2)). */
+	const __m256i i = _mm256_and_si256(
+	    _mm256_add_epi64(hx, _mm256_set1_epi64x(0x95F64)),
+	    _mm256_set1_epi64x(0x100000));
+	const __m256i new_hx = _mm256_or_si256(
+	    hx, _mm256_xor_si256(i, _mm256_set1_epi64x(0x3FF00000)));
+	k = _mm256_add_epi64(k, _mm256_srli_epi64(i, 20));
+
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d f = _mm256_sub_pd(
+	    _mm256_castsi256_pd(_mm256_or_si256(
+		_mm256_slli_epi64(new_hx, 32), low_word)),
+	    one);
+	const __m256d s
+	    = _mm256_div_pd(f, _mm256_add_pd(_mm256_set1_pd(2.0), f));
+	const __m256d dk = _mm256_sub_pd(
+	    _mm256_castsi256_pd(_mm256_add_epi64(k,
+		_mm256_castpd_si256(_mm256_set1_pd(int_to_double_magic)))),
+	    _mm256_set1_pd(int_to_double_magic));
+	const __m256d z = _mm256_mul_pd(s, s);
+	const __m256d w = _mm256_mul_pd(z, z);
+	const __m256d t1 = _mm256_mul_pd(w,
+	    _mm256_add_pd(_mm256_set1_pd(log_lg2),
+		_mm256_mul_pd(w,
+		    _mm256_add_pd(_mm256_set1_pd(log_lg4),
+			_mm256_mul_pd(w, _mm256_set1_pd(log_lg6))))));
+	const __m256d t2 = _mm256_mul_pd(z,
+	    _mm256_add_pd(_mm256_set1_pd(log_lg1),
+		_mm256_mul_pd(w,
+		    _mm256_add_pd(_mm256_set1_pd(log_lg3),
+			_mm256_mul_pd(w,
+			    _mm256_add_pd(_mm256_set1_pd(log_lg5),
+				_mm256_mul_pd(
+				    w, _mm256_set1_pd(log_lg7))))))));
+	const __m256d R = _mm256_add_pd(t2, t1);
+	const __m256d hi = _mm256_mul_pd(dk, _mm256_set1_pd(ln2_hi));
+	const __m256d lo = _mm256_mul_pd(dk, _mm256_set1_pd(ln2_lo));
+
+	/* (hx - 0x6147a) | (0x6b851 - hx) > 0 */
+	const __m256i big = _mm256_cmpgt_epi64(
+	    _mm256_or_si256(
+		_mm256_sub_epi64(hx, _mm256_set1_epi64x(0x6147A)),
+		_mm256_sub_epi64(_mm256_set1_epi64x(0x6B851), hx)),
+	    _mm256_setzero_si256());
+
+	const __m256d hfsq
+	    = _mm256_mul_pd(_mm256_set1_pd(0.5), _mm256_mul_pd(f, f));
+	const __m256d big_ret = _mm256_sub_pd(hi,
+	    _mm256_sub_pd(
+		_mm256_sub_pd(hfsq,
+		    _mm256_add_pd(
+			_mm256_mul_pd(s, _mm256_add_pd(hfsq, R)), lo)),
+		f));
+	const __m256d small_ret = _mm256_sub_pd(hi,
+	    _mm256_sub_pd(
+		_mm256_sub_pd(_mm256_mul_pd(s, _mm256_sub_pd(f, R)), lo), f));
+
+	return _mm256_blendv_pd(small_ret, big_ret, _mm256_castsi256_pd(big));
+}
+
+/* Lanes where n < min_count, i.e., where the threshold is +infty. */
+static AVX2 inline __m256d avx2_below_min(__m256i n, uint64_t min_count)
+{
+	const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+
+	return _mm256_castsi256_pd(_mm256_cmpgt_epi64(
+	    _mm256_xor_si256(_mm256_set1_epi64x(min_count), sign),
+	    _mm256_xor_si256(n, sign)));
+}
+
+/* Mirrors `threshold_up`. */
+static AVX2 inline __m256d avx2_threshold_up(__m256d x, double log_b_up)
+{
+	const __m256d xp1 = _mm256_add_pd(x, _mm256_set1_pd(1.0));
+	const __m256d log_x
+	    = avx2_next_k(avx2_log(x), log_error_limit);
+	const __m256d f_x2 = avx2_next(_mm256_mul_pd(xp1,
+	    avx2_next(_mm256_add_pd(_mm256_add_pd(log_x, log_x),
+		_mm256_set1_pd(log_b_up)))));
+
+	return avx2_next(
+	    _mm256_div_pd(avx2_next(_mm256_sqrt_pd(f_x2)), x));
+}
+
+/* Mirrors `distribution_threshold_up`. */
+static AVX2 inline __m256d avx2_distribution_threshold_up(
+    __m256d x, double log_b_up)
+{
+	const __m256d log_x
+	    = avx2_next_k(avx2_log(x), log_error_limit);
+	const __m256d f_x2 = avx2_next(_mm256_mul_pd(x,
+	    avx2_next(_mm256_add_pd(_mm256_add_pd(log_x, log_x),
+		_mm256_set1_pd(log_b_up)))));
+
+	return avx2_next(_mm256_mul_pd(_mm256_set1_pd(sqrt_half_up),
+	    avx2_next(_mm256_div_pd(
+		avx2_next(_mm256_sqrt_pd(f_x2)), x))));
+}
+
+#define DEFINE_AVX2_BATCH(NAME, THRESHOLD)                                   \
+	static AVX2 void NAME(const uint64_t *n, size_t count,               \
+	    uint64_t min_count, double log_b, double *out)                   \
+	{                                                                    \
+		const __m256d inf = _mm256_set1_pd(HUGE_VAL);                \
+		size_t i = 0;                                                \
+                                                                             \
+		for (; i + 4 <= count; i += 4) {                             \
+			const __m256i ni = _mm256_loadu_si256(               \
+			    (const __m256i *)(n + i));                       \
+			const __m256d ret = THRESHOLD(                       \
+			    avx2_u64_to_double(ni), log_b);                  \
+			_mm256_storeu_pd(out + i,                            \
+			    _mm256_blendv_pd(                                \
+				ret, inf, avx2_below_min(ni, min_count)));   \
+		}                                                            \
+                                                                             \
+		if (i < count) {                                             \
+			uint64_t tail_n[4] = { 0 };                          \
+			double tail_out[4];                                  \
+                                                                             \
+			memcpy(tail_n, n + i, (count - i) * sizeof(*n));     \
+			NAME(tail_n, 4, min_count, log_b, tail_out);         \
+			memcpy(out + i, tail_out,                            \
+			    (count - i) * sizeof(*out));                     \
+		}                                                            \
+	}
+
+DEFINE_AVX2_BATCH(pair_threshold_batch_avx2, avx2_threshold_up)
+DEFINE_AVX2_BATCH(
+    distribution_threshold_batch_avx2, avx2_distribution_threshold_up)
+#undef DEFINE_AVX2_BATCH
+
+#define AVX512 __attribute__((__target__("avx512f,avx512dq")))
+
+static AVX512 inline __m512i avx512_float_bits(__m512d x)
+{
+	const __m512i bits = _mm512_castpd_si512(x);
+
+	return _mm512_xor_si512(
+	    bits, _mm512_srli_epi64(_mm512_srai_epi64(bits, 63), 1));
+}
+
+static AVX512 inline __m512d avx512_bits_float(__m512i bits)
+{
+	return _mm512_castsi512_pd(_mm512_xor_si512(
+	    bits, _mm512_srli_epi64(_mm512_srai_epi64(bits, 63), 1)));
+}
+
+static AVX512 inline __m512d avx512_next_k(__m512d x, uint64_t delta)
+{
+	return avx512_bits_float(_mm512_add_epi64(
+	    avx512_float_bits(x), _mm512_set1_epi64(delta)));
+}
+
+static AVX512 inline __m512d avx512_next(__m512d x)
+{
+	return avx512_next_k(x, 1);
+}
+
+/* Same as `avx2_log`. */
+static AVX512 inline __m512d avx512_log(__m512d x)
+{
+	const __m512i bits = _mm512_castpd_si512(x);
+	const __m512i low_word
+	    = _mm512_and_si512(bits, _mm512_set1_epi64(0xFFFFFFFFULL));
+	__m512i hx = _mm512_srli_epi64(bits, 32);
+	__m512i k = _mm512_sub_epi64(
+	    _mm512_srli_epi64(hx, 20), _mm512_set1_epi64(1023));
+	hx = _mm512_and_si512(hx, _mm512_set1_epi64(0x000FFFFF));
+
+	const __m512i i = _mm512_and_si512(
+	    _mm512_add_epi64(hx, _mm512_set1_epi64(0x95F64)),
+	    _mm512_set1_epi64(0x100000));
+	const __m512i new_hx = _mm512_or_si512(
+	    hx, _mm512_xor_si512(i, _mm512_set1_epi64(0x3FF00000)));
+	k = _mm512_add_epi64(k, _mm512_srli_epi64(i, 20));
+
+	const __m512d f = _mm512_sub_pd(
+	    _mm512_castsi512_pd(_mm512_or_si512(
+		_mm512_slli_epi64(new_hx, 32), low_word)),
+	    _mm512_set1_pd(1.0));
+	const __m512d s
+	    = _mm512_div_pd(f, _mm512_add_pd(_mm512_set1_pd(2.0), f));
+	const __m512d dk = _mm512_cvtepi64_pd(k);
+	const __m512d z = _mm512_mul_pd(s, s);
+	const __m512d w = _mm512_mul_pd(z, z);
+	const __m512d t1 = _mm512_mul_pd(w,
+	    _mm512_add_pd(_mm512_set1_pd(log_lg2),
+		_mm512_mul_pd(w,
+		    _mm512_add_pd(_mm512_set1_pd(log_lg4),
+			_mm512_mul_pd(w, _mm512_set1_pd(log_lg6))))));
+	const __m512d t2 = _mm512_mul_pd(z,
+	    _mm512_add_pd(_mm512_set1_pd(log_lg1),
+		_mm512_mul_pd(w,
+		    _mm512_add_pd(_mm512_set1_pd(log_lg3),
+			_mm512_mul_pd(w,
+			    _mm512_add_pd(_mm512_set1_pd(log_lg5),
+				_mm512_mul_pd(
+				    w, _mm512_set1_pd(log_lg7))))))));
+	const __m512d R = _mm512_add_pd(t2, t1);
+	const __m512d hi = _mm512_mul_pd(dk, _mm512_set1_pd(ln2_hi));
+	const __m512d lo = _mm512_mul_pd(dk, _mm512_set1_pd(ln2_lo));
+	const __mmask8 big = _mm512_cmpgt_epi64_mask(
+	    _mm512_or_si512(_mm512_sub_epi64(hx, _mm512_set1_epi64(0x6147A)),
+		_mm512_sub_epi64(_mm512_set1_epi64(0x6B851), hx)),
+	    _mm512_setzero_si512());
+
+	const __m512d hfsq
+	    = _mm512_mul_pd(_mm512_set1_pd(0.5), _mm512_mul_pd(f, f));
+	const __m512d big_ret = _mm512_sub_pd(hi,
+	    _mm512_sub_pd(
+		_mm512_sub_pd(hfsq,
+		    _mm512_add_pd(
+			_mm512_mul_pd(s, _mm512_add_pd(hfsq, R)), lo)),
+		f));
+	const __m512d small_ret = _mm512_sub_pd(hi,
+	    _mm512_sub_pd(
+		_mm512_sub_pd(_mm512_mul_pd(s, _mm512_sub_pd(f, R)), lo), f));
+
+	return _mm512_mask_blend_pd(big, small_ret, big_ret);
+}
+
+static AVX512 inline __m512d avx512_threshold_up(__m512d x, double log_b_up)
+{
+	const __m512d xp1 = _mm512_add_pd(x, _mm512_set1_pd(1.0));
+	const __m512d log_x
+	    = avx512_next_k(avx512_log(x), log_error_limit);
+	const __m512d f_x2 = avx512_next(_mm512_mul_pd(xp1,
+	    avx512_next(_mm512_add_pd(_mm512_add_pd(log_x, log_x),
+		_mm512_set1_pd(log_b_up)))));
+
+	return avx512_next(
+	    _mm512_div_pd(avx512_next(_mm512_sqrt_pd(f_x2)), x));
+}
+
+static AVX512 inline __m512d avx512_distribution_threshold_up(
+    __m512d x, double log_b_up)
+{
+	const __m512d log_x
+	    = avx512_next_k(avx512_log(x), log_error_limit);
+	const __m512d f_x2 = avx512_next(_mm512_mul_pd(x,
+	    avx512_next(_mm512_add_pd(_mm512_add_pd(log_x, log_x),
+		_mm512_set1_pd(log_b_up)))));
+
+	return avx512_next(_mm512_mul_pd(_mm512_set1_pd(sqrt_half_up),
+	    avx512_next(_mm512_div_pd(
+		avx512_next(_mm512_sqrt_pd(f_x2)), x))));
+}
+
+#define DEFINE_AVX512_BATCH(NAME, THRESHOLD)                                 \
+	static AVX512 void NAME(const uint64_t *n, size_t count,             \
+	    uint64_t min_count, double log_b, double *out)                   \
+	{                                                                    \
+		const __m512i min = _mm512_set1_epi64(min_count);            \
+		const __m512d inf = _mm512_set1_pd(HUGE_VAL);                \
+                                                                             \
+		for (size_t i = 0; i < count; i += 8) {                      \
+			const __mmask8 live = (count - i >= 8)               \
+			    ? 0xFF                                           \
+			    : (__mmask8)((1U << (count - i)) - 1);           \
+			const __m512i ni                                     \
+			    = _mm512_maskz_loadu_epi64(live, n + i);         \
+			const __m512d ret = THRESHOLD(                       \
+			    _mm512_cvtepu64_pd(ni), log_b);                  \
+			const __mmask8 below                                 \
+			    = _mm512_cmplt_epu64_mask(ni, min);              \
+			_mm512_mask_storeu_pd(out + i, live,                 \
+			    _mm512_mask_blend_pd(below, ret, inf));          \
+		}                                                            \
+	}
+
+DEFINE_AVX512_BATCH(pair_threshold_batch_avx512, avx512_threshold_up)
+DEFINE_AVX512_BATCH(
+    distribution_threshold_batch_avx512, avx512_distribution_threshold_up)
+#undef DEFINE_AVX512_BATCH
+#undef AVX512
+#undef AVX2
+#endif
+
+static void threshold_batch(const uint64_t *n, size_t count,
+    uint64_t min_count, double log_eps, double *out, bool pair)
+{
+	assert(log_eps <= 0
+	    && "log_eps must be negative (for a false positive rate < 1).");
+
+	if (log_eps >= 0) {
+		for (size_t i = 0; i < count; ++i) {
+			out[i] = (n[i] < min_count) ? HUGE_VAL : -HUGE_VAL;
+		}
+
+		return;
+	}
+
+	min_count = valid_min_count(min_count, log_eps);
+
+	if (pair && log_eps > log_half_down) {
+		log_eps = log_half_down;
+	}
+
+	batch_kernel_fn *kernel = pair ? pair_threshold_batch_scalar
+				       : distribution_threshold_batch_scalar;
+#ifdef ONE_SIDED_KS_SIMD
+	switch (one_sided_ks_isa_get()) {
+	case ONE_SIDED_KS_ISA_AVX512:
+		kernel = pair ? pair_threshold_batch_avx512
+			      : distribution_threshold_batch_avx512;
+		break;
+	case ONE_SIDED_KS_ISA_AVX2:
+		kernel = pair ? pair_threshold_batch_avx2
+			      : distribution_threshold_batch_avx2;
+		break;
+	case ONE_SIDED_KS_ISA_SCALAR:
+		break;
+	}
+#endif
+
+	kernel(n, count, min_count, log_b_up(min_count, log_eps), out);
+}
+
+void one_sided_ks_pair_threshold_batch(const uint64_t *n, size_t count,
+    uint64_t min_count, double log_eps, double *out)
+{
+	threshold_batch(n, count, min_count, log_eps, out, true);
+}
+
+void one_sided_ks_distribution_threshold_batch(const uint64_t *n,
+    size_t count, uint64_t min_count, double log_eps, double *out)
+{
+	threshold_batch(n, count, min_count, log_eps, out, false);
 }
 
 /*
@@ -279,14 +920,8 @@ int one_sided_ks_min_count_valid(uint64_t min_count, double log_eps)
 	return prev(log_eps + (min_count - 1)) >= log_up(min_count + 1.0);
 }
 
-uint64_t one_sided_ks_find_min_count(double log_eps)
+static uint64_t find_min_count(double log_eps)
 {
-	assert(log_eps <= 0
-	    && "log_eps must be negative (for a false positive rate < 1).");
-	if (log_eps >= 0) {
-		return 0;
-	}
-
 	/*
 	 * Galloping search for a min_count that satisfies
 	 * one_sided_ks_min_count_valid.
@@ -327,12 +962,157 @@ uint64_t one_sided_ks_find_min_count(double log_eps)
 	return high;
 }
 
+/*
+ * find_min_count is memoised in a small direct-mapped cache, keyed
+ * on the bit pattern of log_eps.  Each slot is a seqlock: writers
+ * make `seq` odd while they update the slot, and readers retry (or
+ * rather, recompute) if `seq` changed under them.  Writers that
+ * find a slot busy don't wait, they just skip the cache.
+ *
+ * Zero-initialised slots have the key of log_eps = +0.0, which we
+ * never look up.
+ */
+#define MIN_COUNT_CACHE_BITS 6
+
+struct min_count_cache_slot {
+	uint64_t seq;
+	uint64_t key;
+	uint64_t value;
+};
+
+static struct min_count_cache_slot
+    min_count_cache[1UL << MIN_COUNT_CACHE_BITS];
+
+static struct min_count_cache_slot *min_count_cache_slot(uint64_t key)
+{
+	/* Fibonacci hashing: the multiplier is 2^64 / phi. */
+	const uint64_t hash = key * 0x9E3779B97F4A7C15ULL;
+
+	return &min_count_cache[hash >> (64 - MIN_COUNT_CACHE_BITS)];
+}
+
+static bool min_count_cache_lookup(uint64_t key, uint64_t *value)
+{
+	struct min_count_cache_slot *slot = min_count_cache_slot(key);
+	const uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+	if ((seq & 1) != 0) {
+		return false;
+	}
+
+	const uint64_t slot_key
+	    = __atomic_load_n(&slot->key, __ATOMIC_RELAXED);
+	const uint64_t slot_value
+	    = __atomic_load_n(&slot->value, __ATOMIC_RELAXED);
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (slot_key != key
+	    || __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq) {
+		return false;
+	}
+
+	*value = slot_value;
+	return true;
+}
+
+static void min_count_cache_insert(uint64_t key, uint64_t value)
+{
+	struct min_count_cache_slot *slot = min_count_cache_slot(key);
+	uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+
+	if ((seq & 1) != 0
+	    || !__atomic_compare_exchange_n(&slot->seq, &seq, seq + 1,
+		false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		return;
+	}
+
+	/* Order the odd `seq` before the updates. */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&slot->key, key, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->value, value, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+uint64_t one_sided_ks_find_min_count(double log_eps)
+{
+	assert(log_eps <= 0
+	    && "log_eps must be negative (for a false positive rate < 1).");
+	if (log_eps >= 0) {
+		return 0;
+	}
+
+	const uint64_t key = float_bits(log_eps);
+	uint64_t ret;
+
+	if (min_count_cache_lookup(key, &ret)) {
+		return ret;
+	}
+
+	ret = find_min_count(log_eps);
+	min_count_cache_insert(key, ret);
+	return ret;
+}
+
+/*
+ * Estimates the x such that f(x) / x = target for the two-sample
+ * f(x)^2 = (x + 1)(2 log x + log b), without any care for rounding.
+ *
+ * We find the root of
+ *
+ *   h(y) = log[(x + 1)(2y + log b)] - 2y - 2 log target, x = e^y,
+ *
+ * with Newton's method, safeguarded by bisection on a bracket in
+ * [log min_count, log DBL_MAX].  h'(y) is close to -1, so a handful
+ * of iterations usually suffice.
+ */
+static double pair_threshold_guess(
+    uint64_t min_count, double target, double log_b)
+{
+	const double log_target2 = 2 * log(target);
+	/* Invariant: h(low) > 0 > h(high). */
+	double low = log(min_count);
+	double high = log(DBL_MAX);
+	/* Start from the fixed point x = (2 log x + log b) / target^2. */
+	double y = fmax(low, log(fmax(1.0, log_b + 2 * low)) - log_target2);
+
+	for (size_t i = 0; i < 32; ++i) {
+		const double x = exp(y);
+		const double log_term = 2 * y + log_b;
+
+		if (!(y >= low && y <= high) || log_term <= 0) {
+			y = low + (high - low) / 2;
+			continue;
+		}
+
+		const double h
+		    = log1p(x) + log(log_term) - 2 * y - log_target2;
+		if (h > 0) {
+			low = y;
+		} else {
+			high = y;
+		}
+
+		const double dh = x / (x + 1) + 2 / log_term - 2;
+		const double step = h / dh;
+		y -= step;
+		if (fabs(step) < 0x1p-40 * fmax(1.0, fabs(y))) {
+			break;
+		}
+	}
+
+	return exp(y);
+}
+
 /*
  * threshold is a monotonically decreasing function of x > 0
  *
  * If rounding up, find the min x s.t. threshold(x, log_b) <= target.
  *
  * If rounding down, find the max x s.t. threshold(x, log_b) >= target
+ *
+ * pair_threshold_guess gets us within a few ULPs of the answer; we
+ * then gallop away from the guess until we have a verified bracket,
+ * and bisect that bracket down to adjacent floats.
  */
 static double invert_threshold(uint64_t min_count, double target, bool up,
     double threshold(double x, double log_b), double log_b)
@@ -346,29 +1126,61 @@ static double invert_threshold(uint64_t min_count, double target, bool up,
 	}
 
 	/*
-	 * Invariant: threshold(low, log_b) > target
-	 *            threshold(high, log_b) < target;
+	 * `above(x)` is threshold(x) > target when rounding up, and
+	 * threshold(x) >= target when rounding down.  NaN thresholds
+	 * (overflow for huge x) count as above.
+	 *
+	 * Invariant: above(low) and !above(high).
 	 */
-	double low = min_count;
-	double high = DBL_MAX;
-	for (size_t i = 0; i < 64; ++i) {
-		const uint64_t low_bits = float_bits(low);
-		const uint64_t high_bits = float_bits(high);
-		const double pivot
-		    = bits_float(low_bits + (high_bits - low_bits) / 2);
-		const double fx = threshold(pivot, log_b);
-		if (fx == target) {
-			return pivot;
+#define ABOVE(BITS)                                                          \
+	(up ? !(threshold(bits_float(BITS), log_b) <= target)                \
+	    : !(threshold(bits_float(BITS), log_b) < target))
+	uint64_t low = float_bits(min_count);
+	uint64_t high = float_bits(DBL_MAX);
+	const double guess = pair_threshold_guess(min_count, target, log_b);
+
+	/* Also false for NaN. */
+	if (guess > min_count && guess < DBL_MAX) {
+		const uint64_t bits = float_bits(guess);
+		const bool guess_above = ABOVE(bits);
+
+		if (guess_above) {
+			low = bits;
+		} else {
+			high = bits;
 		}
 
-		if (fx < target) {
-			high = pivot;
-		} else {
+		for (uint64_t width = 4; high - low > width; width *= 2) {
+			if (guess_above) {
+				if (!ABOVE(low + width)) {
+					high = low + width;
+					break;
+				}
+
+				low += width;
+			} else {
+				if (ABOVE(high - width)) {
+					low = high - width;
+					break;
+				}
+
+				high -= width;
+			}
+		}
+	}
+
+	while (high - low > 1) {
+		const uint64_t pivot = low + (high - low) / 2;
+
+		if (ABOVE(pivot)) {
 			low = pivot;
+		} else {
+			high = pivot;
 		}
 	}
+#undef ABOVE
 
-	return (up ? high : low);
+	return bits_float(up ? high : low);
 }
 
 /*
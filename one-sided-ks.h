@@ -1,5 +1,6 @@
 #ifndef ONE_SIDED_KS_H
 #define ONE_SIDED_KS_H
+#include <stddef.h>
 #include <stdint.h>
 
 #ifdef __cplusplus
@@ -97,6 +98,139 @@ double one_sided_ks_distribution_threshold(
 double one_sided_ks_distribution_threshold_fast(
     uint64_t n, uint64_t min_count, double log_eps);
 
+/*
+ * Given `n_a` datapoints from the first distribution and `n_b` from
+ * the second, returns a `threshold` such that, if the supremum of the
+ * difference between the two empirical CDFs exceeds `threshold`, we
+ * can conclude that the first distribution is not always less than or
+ * equal to the second.
+ *
+ * Like `one_sided_ks_pair_threshold`, the probability of false
+ * positive over an infinite stream of data is at most
+ * `exp(log_eps)`, however observations interleave between the two
+ * samples.  The threshold is the sum of one-sample thresholds for
+ * `n_a` and `n_b` with half the false positive budget each, so it's
+ * roughly sqrt(2) times `one_sided_ks_pair_threshold` when
+ * `n_a = n_b`, but only ~sqrt(1/2) times as large when `n_b >> n_a`:
+ * prefer the paired test for balanced samples.
+ *
+ * `min_count` applies to each sample, and should be valid for
+ * `log_eps + one_sided_ks_eq`.  When `n_a < min_count` or
+ * `n_b < min_count`, this function immediately returns +infty.
+ */
+double one_sided_ks_unpaired_threshold(
+    uint64_t n_a, uint64_t n_b, uint64_t min_count, double log_eps);
+
+/*
+ * Same as `one_sided_ks_unpaired_threshold`, without any safety check.
+ */
+double one_sided_ks_unpaired_threshold_fast(
+    uint64_t n_a, uint64_t n_b, uint64_t min_count, double log_eps);
+
+/*
+ * With `n` pairs of datapoints, the supremum of the difference
+ * between the two empirical CDFs is always `r / n`, for an integer
+ * `r`.  Returns the least `r` such that `r / n` definitely exceeds
+ * `one_sided_ks_pair_threshold(n, min_count, log_eps)`, before
+ * rounding: if `r >= one_sided_ks_pair_min_reject(n, ...)`, we can
+ * reject the null hypothesis.
+ *
+ * Returns UINT64_MAX when `n < min_count`.
+ */
+uint64_t one_sided_ks_pair_min_reject(
+    uint64_t n, uint64_t min_count, double log_eps);
+
+/*
+ * Same as `one_sided_ks_pair_min_reject`, without any safety check.
+ */
+uint64_t one_sided_ks_pair_min_reject_fast(
+    uint64_t n, uint64_t min_count, double log_eps);
+
+/*
+ * Tracks `one_sided_ks_pair_min_reject` as `n` increases one pair at
+ * a time.  `r_min` only changes every O(sqrt(n / log n)) pairs, so
+ * the iterator only calls log a few times whenever `r_min` changes,
+ * and is otherwise an integer increment and comparison.
+ *
+ * `r_min` is always a conservative cutoff, but may occasionally
+ * differ from `one_sided_ks_pair_min_reject` by one, because of
+ * rounding.
+ */
+struct one_sided_ks_pair_reject_iter {
+	/* The current number of pairs. */
+	uint64_t n;
+	/* Reject when r >= r_min. */
+	uint64_t r_min;
+	/* r_min is valid for n < next_n. */
+	uint64_t next_n;
+	uint64_t min_count;
+	double log_eps;
+};
+
+/*
+ * Initialises `iter` for `n` pairs.  Like
+ * `one_sided_ks_pair_threshold`, replaces `min_count` with
+ * `one_sided_ks_find_min_count(log_eps)` when invalid.
+ */
+void one_sided_ks_pair_reject_iter_init(
+    struct one_sided_ks_pair_reject_iter *iter, uint64_t n,
+    uint64_t min_count, double log_eps);
+
+/* Recomputes `r_min` and `next_n` for the current `n`. */
+void one_sided_ks_pair_reject_iter_refill(
+    struct one_sided_ks_pair_reject_iter *iter);
+
+/*
+ * Advances `iter` by one pair, and returns the new `r_min`.
+ */
+static inline uint64_t one_sided_ks_pair_reject_iter_next(
+    struct one_sided_ks_pair_reject_iter *iter)
+{
+	if (++iter->n >= iter->next_n) {
+		one_sided_ks_pair_reject_iter_refill(iter);
+	}
+
+	return iter->r_min;
+}
+
+/*
+ * Given the supremum `d_plus` of the difference between the two
+ * empirical CDFs for `n` pairs, returns a conservative estimate of
+ * the least `m > n` for which the two-sample test might reject: each
+ * pair can only increase `n * d_plus` by 1, so
+ * `one_sided_ks_pair_threshold(m, min_count, log_eps)` can't be
+ * exceeded before the return value.
+ *
+ * Callers may skip computing the statistic and checking the
+ * threshold until they have that many pairs.  `d_plus` may be off
+ * by a couple ULPs.
+ */
+uint64_t one_sided_ks_pair_next_check(
+    uint64_t n, double d_plus, uint64_t min_count, double log_eps);
+
+/*
+ * Same as `one_sided_ks_pair_next_check`, for
+ * `one_sided_ks_distribution_threshold`.
+ */
+uint64_t one_sided_ks_distribution_next_check(
+    uint64_t n, double d_plus, uint64_t min_count, double log_eps);
+
+/*
+ * Batched versions of `one_sided_ks_pair_threshold` and
+ * `one_sided_ks_distribution_threshold`: writes the threshold for
+ * sample size `n[i]` to `out[i]`, for `i < count`.
+ *
+ * Safety checks happen once per call, and the thresholds are
+ * computed with SIMD (AVX2 or AVX-512) when available.  The values
+ * are identical to the scalar functions' (the library must be compiled
+ * with -ffp-contract=off).
+ */
+void one_sided_ks_pair_threshold_batch(const uint64_t *n, size_t count,
+    uint64_t min_count, double log_eps, double *out);
+
+void one_sided_ks_distribution_threshold_batch(const uint64_t *n,
+    size_t count, uint64_t min_count, double log_eps, double *out);
+
 /*
  * Determines whether `min_count` is high enough to achieve a log
  * error rate of at most `log_eps`, which must be negative.
@@ -105,7 +239,13 @@ double one_sided_ks_distribution_threshold_fast(
  */
 int one_sided_ks_min_count_valid(uint64_t min_count, double log_eps);
 
-/* Computes the min `min_count` for `log_eps`, which must be negative. */
+/*
+ * Computes the min `min_count` for `log_eps`, which must be negative.
+ *
+ * Results are memoised in a small lock-free cache, so repeated calls
+ * with the same `log_eps` are cheap, and safe from any thread.  The
+ * non-`_fast` entry points use the same cache to validate `min_count`.
+ */
 uint64_t one_sided_ks_find_min_count(double log_eps);
 
 /*
@@ -0,0 +1,328 @@
+#include "one-sided-ks.h"
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "one-sided-ks-hist.h"
+#include "one-sided-ks-inline.h"
+#include "one-sided-ks-table.h"
+
+// Google Benchmark reports the time per call; items_per_second is
+// the number of calls (or batched thresholds) per second.
+//
+// Most benchmarks take two arguments: log2(n) and -log10(eps).
+namespace {
+void n_eps_args(benchmark::internal::Benchmark *b)
+{
+	for (const int log_n : { 4, 10, 16, 24, 32, 40 }) {
+		for (const int log10_eps : { 3, 6, 9 }) {
+			b->Args({ log_n, log10_eps });
+		}
+	}
+}
+
+void eps_args(benchmark::internal::Benchmark *b)
+{
+	for (const int log10_eps : { 1, 3, 6, 9, 12 }) {
+		b->Arg(log10_eps);
+	}
+}
+
+double arg_log_eps(const benchmark::State &state, size_t index)
+{
+	return -std::log(10.0) * state.range(index);
+}
+
+uint64_t arg_n(const benchmark::State &state, size_t index)
+{
+	return uint64_t(1) << state.range(index);
+}
+
+// Benchmarks a function of (n, min_count, log_eps).
+template <typename Fn> void bench_n_eps(benchmark::State &state, Fn fn)
+{
+	uint64_t n = arg_n(state, 0);
+	const double log_eps = arg_log_eps(state, 1);
+	const uint64_t min_count = one_sided_ks_find_min_count(log_eps);
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(n);
+		benchmark::DoNotOptimize(fn(n, min_count, log_eps));
+	}
+
+	state.SetItemsProcessed(state.iterations());
+}
+
+void BM_PairThreshold(benchmark::State &state)
+{
+	bench_n_eps(state, one_sided_ks_pair_threshold);
+}
+BENCHMARK(BM_PairThreshold)->Apply(n_eps_args);
+
+// min_count = 0 is never valid, so we must look up the least valid one.
+void BM_PairThresholdDefault(benchmark::State &state)
+{
+	bench_n_eps(state, [](uint64_t n, uint64_t, double log_eps) {
+		return one_sided_ks_pair_threshold(n, 0, log_eps);
+	});
+}
+BENCHMARK(BM_PairThresholdDefault)->Apply(n_eps_args);
+
+void BM_PairThresholdFast(benchmark::State &state)
+{
+	bench_n_eps(state, one_sided_ks_pair_threshold_fast);
+}
+BENCHMARK(BM_PairThresholdFast)->Apply(n_eps_args);
+
+// Same computation, with log_b_up hoisted out of the loop.
+void BM_PairThresholdInline(benchmark::State &state)
+{
+	uint64_t n = arg_n(state, 0);
+	const double log_eps = arg_log_eps(state, 1);
+	const uint64_t min_count = one_sided_ks_find_min_count(log_eps);
+	const double log_b_up
+	    = one_sided_ks_inline_log_b_up(min_count, log_eps);
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(n);
+		benchmark::DoNotOptimize(
+		    one_sided_ks_inline_threshold_up(n, log_b_up));
+	}
+
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PairThresholdInline)->Apply(n_eps_args);
+
+void BM_DistributionThreshold(benchmark::State &state)
+{
+	bench_n_eps(state, one_sided_ks_distribution_threshold);
+}
+BENCHMARK(BM_DistributionThreshold)->Apply(n_eps_args);
+
+void BM_DistributionThresholdFast(benchmark::State &state)
+{
+	bench_n_eps(state, one_sided_ks_distribution_threshold_fast);
+}
+BENCHMARK(BM_DistributionThresholdFast)->Apply(n_eps_args);
+
+// One sample is 4x as large as the other.
+void BM_UnpairedThreshold(benchmark::State &state)
+{
+	bench_n_eps(
+	    state, [](uint64_t n, uint64_t min_count, double log_eps) {
+		    return one_sided_ks_unpaired_threshold(
+			n, 4 * n, min_count, log_eps);
+	    });
+}
+BENCHMARK(BM_UnpairedThreshold)->Apply(n_eps_args);
+
+void BM_UnpairedThresholdFast(benchmark::State &state)
+{
+	bench_n_eps(
+	    state, [](uint64_t n, uint64_t min_count, double log_eps) {
+		    return one_sided_ks_unpaired_threshold_fast(
+			n, 4 * n, min_count, log_eps);
+	    });
+}
+BENCHMARK(BM_UnpairedThresholdFast)->Apply(n_eps_args);
+
+void BM_PairMinReject(benchmark::State &state)
+{
+	bench_n_eps(state, one_sided_ks_pair_min_reject);
+}
+BENCHMARK(BM_PairMinReject)->Apply(n_eps_args);
+
+void BM_PairMinRejectFast(benchmark::State &state)
+{
+	bench_n_eps(state, one_sided_ks_pair_min_reject_fast);
+}
+BENCHMARK(BM_PairMinRejectFast)->Apply(n_eps_args);
+
+// Amortised cost of stepping the iterator by one observation.
+void BM_PairRejectIter(benchmark::State &state)
+{
+	const uint64_t n = arg_n(state, 0);
+	const double log_eps = arg_log_eps(state, 1);
+	const uint64_t min_count = one_sided_ks_find_min_count(log_eps);
+	struct one_sided_ks_pair_reject_iter iter;
+
+	one_sided_ks_pair_reject_iter_init(&iter, n, min_count, log_eps);
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(
+		    one_sided_ks_pair_reject_iter_next(&iter));
+	}
+
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PairRejectIter)->Apply(n_eps_args);
+
+// D+ at half the threshold, so we can usually skip ahead.
+void BM_PairNextCheck(benchmark::State &state)
+{
+	const uint64_t n = arg_n(state, 0);
+	const double log_eps = arg_log_eps(state, 1);
+	const uint64_t min_count = one_sided_ks_find_min_count(log_eps);
+	const double d_plus
+	    = one_sided_ks_pair_threshold(n, min_count, log_eps) / 2;
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(one_sided_ks_pair_next_check(
+		    n, d_plus, min_count, log_eps));
+	}
+
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PairNextCheck)->Apply(n_eps_args);
+
+void BM_DistributionNextCheck(benchmark::State &state)
+{
+	const uint64_t n = arg_n(state, 0);
+	const double log_eps = arg_log_eps(state, 1);
+	const uint64_t min_count = one_sided_ks_find_min_count(log_eps);
+	const double d_plus
+	    = one_sided_ks_distribution_threshold(n, min_count, log_eps)
+	    / 2;
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(one_sided_ks_distribution_next_check(
+		    n, d_plus, min_count, log_eps));
+	}
+
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DistributionNextCheck)->Apply(n_eps_args);
+
+// Items are individual thresholds, 1024 per call, starting at n.
+template <typename Fn> void bench_batch(benchmark::State &state, Fn fn)
+{
+	constexpr size_t kCount = 1024;
+	const uint64_t n = arg_n(state, 0);
+	const double log_eps = arg_log_eps(state, 1);
+	const uint64_t min_count = one_sided_ks_find_min_count(log_eps);
+	std::vector<uint64_t> ns(kCount);
+	std::vector<double> out(kCount);
+
+	for (size_t i = 0; i < kCount; ++i) {
+		ns[i] = n + i;
+	}
+
+	for (auto _ : state) {
+		fn(ns.data(), kCount, min_count, log_eps, out.data());
+		benchmark::ClobberMemory();
+	}
+
+	state.SetItemsProcessed(state.iterations() * kCount);
+}
+
+void BM_PairThresholdBatch(benchmark::State &state)
+{
+	bench_batch(state, one_sided_ks_pair_threshold_batch);
+}
+BENCHMARK(BM_PairThresholdBatch)->Apply(n_eps_args);
+
+void BM_DistributionThresholdBatch(benchmark::State &state)
+{
+	bench_batch(state, one_sided_ks_distribution_threshold_batch);
+}
+BENCHMARK(BM_DistributionThresholdBatch)->Apply(n_eps_args);
+
+void BM_PairTableThreshold(benchmark::State &state)
+{
+	uint64_t n = arg_n(state, 0);
+	const double log_eps = arg_log_eps(state, 1);
+	const uint64_t min_count = one_sided_ks_find_min_count(log_eps);
+	struct one_sided_ks_table *table
+	    = one_sided_ks_pair_table_create(min_count, log_eps, 1 << 16);
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(n);
+		benchmark::DoNotOptimize(
+		    one_sided_ks_table_threshold(table, n));
+	}
+
+	state.SetItemsProcessed(state.iterations());
+	one_sided_ks_table_destroy(table);
+}
+BENCHMARK(BM_PairTableThreshold)->Apply(n_eps_args);
+
+void BM_FindMinCount(benchmark::State &state)
+{
+	double log_eps = arg_log_eps(state, 0);
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(log_eps);
+		benchmark::DoNotOptimize(
+		    one_sided_ks_find_min_count(log_eps));
+	}
+
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FindMinCount)->Apply(eps_args);
+
+void BM_MinCountValid(benchmark::State &state)
+{
+	const double log_eps = arg_log_eps(state, 0);
+	uint64_t min_count = one_sided_ks_find_min_count(log_eps);
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(min_count);
+		benchmark::DoNotOptimize(
+		    one_sided_ks_min_count_valid(min_count, log_eps));
+	}
+
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MinCountValid)->Apply(eps_args);
+
+// Arguments: -log10(eps), and delta in thousandths.
+void BM_ExpectedIter(benchmark::State &state)
+{
+	const double log_eps = arg_log_eps(state, 0);
+	const uint64_t min_count = one_sided_ks_find_min_count(log_eps);
+	double delta = state.range(1) / 1000.0;
+
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(delta);
+		benchmark::DoNotOptimize(
+		    one_sided_ks_expected_iter(min_count, log_eps, delta));
+	}
+
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ExpectedIter)->Apply([](benchmark::internal::Benchmark *b) {
+	for (const int log10_eps : { 3, 6, 9 }) {
+		for (const int delta : { 1, 10, 100, 500 }) {
+			b->Args({ log10_eps, delta });
+		}
+	}
+});
+
+// Argument: log10(k).  Items are buckets.
+void BM_HistDPlus(benchmark::State &state)
+{
+	const size_t k = std::pow(10, state.range(0));
+	std::mt19937_64 rng(42);
+	std::uniform_int_distribution<uint64_t> count(0, 100);
+	std::vector<uint64_t> a(k);
+	std::vector<uint64_t> b(k);
+	struct one_sided_ks_hist_result result;
+
+	for (size_t i = 0; i < k; ++i) {
+		a[i] = count(rng);
+		b[i] = count(rng);
+	}
+
+	for (auto _ : state) {
+		one_sided_ks_hist_dplus(a.data(), b.data(), k, &result);
+		benchmark::DoNotOptimize(result);
+	}
+
+	state.SetItemsProcessed(state.iterations() * k);
+}
+BENCHMARK(BM_HistDPlus)->DenseRange(2, 6);
+} // namespace
+
+BENCHMARK_MAIN();
@@ -3,10 +3,14 @@
 #include <cfloat>
 #include <climits>
 #include <cmath>
+#include <random>
+#include <thread>
 #include <tuple>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "one-sided-ks-isa.h"
 
 namespace {
 using ::testing::DoubleNear;
@@ -86,6 +90,330 @@ TEST(OneSidedKs, ThresholdMonotonicCount)
 	    Lt(one_sided_ks_distribution_threshold(10000, 1000, -4)));
 }
 
+// The batch thresholds should be upper bounds, and match the scalar
+// thresholds to a few ULPs.
+TEST(OneSidedKs, BatchThresholds)
+{
+	const double log_eps = std::log(1e-6);
+	const uint64_t min_count = 40;
+	std::vector<uint64_t> ns;
+
+	for (uint64_t i = 0; i < 1000; ++i) {
+		ns.push_back(i);
+	}
+
+	for (uint64_t i = 1000; i < (1ULL << 62); i += i / 3) {
+		ns.push_back(i);
+	}
+
+	ns.push_back(UINT64_MAX);
+	// Make sure we exercise the tail.
+	ns.push_back(12345);
+
+	std::vector<double> pair(ns.size());
+	std::vector<double> distribution(ns.size());
+	one_sided_ks_pair_threshold_batch(
+	    ns.data(), ns.size(), min_count, log_eps, pair.data());
+	one_sided_ks_distribution_threshold_batch(
+	    ns.data(), ns.size(), min_count, log_eps, distribution.data());
+
+	const long double log_b = -std::log(min_count - 1.0L) - log_eps;
+	for (size_t i = 0; i < ns.size(); ++i) {
+		const uint64_t n = ns[i];
+		const double expected_pair
+		    = one_sided_ks_pair_threshold(n, min_count, log_eps);
+		const double expected_distribution
+		    = one_sided_ks_distribution_threshold(
+			n, min_count, log_eps);
+
+		if (n < min_count) {
+			EXPECT_EQ(pair[i], HUGE_VAL);
+			EXPECT_EQ(distribution[i], HUGE_VAL);
+			continue;
+		}
+
+		// The SIMD kernels perform the same operations.
+		EXPECT_EQ(pair[i], expected_pair) << n;
+		EXPECT_EQ(distribution[i], expected_distribution) << n;
+
+		const long double x = n;
+		const long double fx2 = 2 * std::log(x) + log_b;
+		EXPECT_GE(pair[i], std::sqrt((x + 1) * fx2) / x) << n;
+		EXPECT_GE(distribution[i], std::sqrt(0.5L * x * fx2) / x)
+		    << n;
+	}
+}
+
+// Batches go through the same safety checks as the scalar functions.
+// Force each instruction set the host supports, and compare with
+// the scalar kernels bit for bit, whatever the dispatcher prefers.
+TEST(OneSidedKs, BatchThresholdsEveryIsa)
+{
+	const double log_eps = std::log(1e-6);
+	const uint64_t min_count = 40;
+	std::mt19937_64 rng(1);
+	std::vector<uint64_t> ns;
+
+	for (uint64_t i = 0; i < 200; ++i) {
+		ns.push_back(i);
+	}
+
+	// Every magnitude, including above 2^53, where the u64 to
+	// double conversion rounds.
+	for (int shift = 6; shift < 64; ++shift) {
+		for (size_t i = 0; i < 20; ++i) {
+			ns.push_back((rng() >> (63 - shift)) | 1);
+		}
+	}
+
+	ns.push_back(UINT64_MAX);
+	ns.push_back(UINT64_MAX - 1);
+	// An odd count, for the tails.
+	ns.push_back(12345);
+
+	const one_sided_ks_isa old_limit
+	    = one_sided_ks_isa_set_limit(ONE_SIDED_KS_ISA_SCALAR);
+	std::vector<double> pair(ns.size());
+	std::vector<double> distribution(ns.size());
+	one_sided_ks_pair_threshold_batch(
+	    ns.data(), ns.size(), min_count, log_eps, pair.data());
+	one_sided_ks_distribution_threshold_batch(
+	    ns.data(), ns.size(), min_count, log_eps, distribution.data());
+	for (size_t i = 0; i < ns.size(); ++i) {
+		EXPECT_EQ(pair[i],
+		    one_sided_ks_pair_threshold(ns[i], min_count, log_eps))
+		    << ns[i];
+		EXPECT_EQ(distribution[i],
+		    one_sided_ks_distribution_threshold(
+			ns[i], min_count, log_eps))
+		    << ns[i];
+	}
+
+	for (int level = ONE_SIDED_KS_ISA_AVX2;
+	     level <= one_sided_ks_isa_supported(); ++level) {
+		std::vector<double> simd_pair(ns.size());
+		std::vector<double> simd_distribution(ns.size());
+
+		one_sided_ks_isa_set_limit(one_sided_ks_isa(level));
+		ASSERT_EQ(one_sided_ks_isa_get(), level);
+		for (size_t count = ns.size() - 7; count <= ns.size();
+		     ++count) {
+			one_sided_ks_pair_threshold_batch(ns.data(), count,
+			    min_count, log_eps, simd_pair.data());
+			one_sided_ks_distribution_threshold_batch(ns.data(),
+			    count, min_count, log_eps,
+			    simd_distribution.data());
+			for (size_t i = 0; i < count; ++i) {
+				EXPECT_EQ(pair[i], simd_pair[i])
+				    << level << " " << ns[i];
+				EXPECT_EQ(
+				    distribution[i], simd_distribution[i])
+				    << level << " " << ns[i];
+			}
+		}
+	}
+
+	one_sided_ks_isa_set_limit(old_limit);
+}
+
+TEST(OneSidedKs, BatchThresholdsSafe)
+{
+	const uint64_t ns[] = { 2, 5, 6, 7, 100 };
+	double out[5];
+
+	// Min count 6 is too low for eps = 1e-6.
+	one_sided_ks_pair_threshold_batch(ns, 5, 6, std::log(1e-6), out);
+	for (size_t i = 0; i < 5; ++i) {
+		const double expected
+		    = one_sided_ks_pair_threshold(ns[i], 6, std::log(1e-6));
+
+		EXPECT_EQ(out[i], expected);
+	}
+
+	// Nothing to do.
+	one_sided_ks_distribution_threshold_batch(
+	    nullptr, 0, 6, std::log(1e-6), nullptr);
+}
+
+// r_min should be the least integer above n * threshold, modulo
+// conservative rounding.
+TEST(OneSidedKs, PairMinReject)
+{
+	const double log_eps = std::log(1e-6);
+	const uint64_t min_count = 40;
+	const long double log_b = -std::log(min_count - 1.0L) - log_eps;
+
+	EXPECT_EQ(one_sided_ks_pair_min_reject(39, min_count, log_eps),
+	    UINT64_MAX);
+	for (uint64_t n = min_count; n < (1ULL << 62); n += n / 16) {
+		const uint64_t r_min
+		    = one_sided_ks_pair_min_reject(n, min_count, log_eps);
+		const long double x = n;
+		const long double f
+		    = std::sqrt((x + 1) * (2 * std::log(x) + log_b));
+
+		EXPECT_GT(r_min, f) << n;
+		EXPECT_LE(r_min - 1, f * (1 + 1e-12L)) << n;
+		EXPECT_GT(1.0 * r_min / n,
+		    one_sided_ks_pair_threshold(n, min_count, log_eps)
+			* (1 - 1e-14))
+		    << n;
+	}
+}
+
+// The iterator should track the direct computation, and never be
+// less conservative.
+TEST(OneSidedKs, PairRejectIter)
+{
+	const double log_eps = std::log(1e-6) + one_sided_ks_eq;
+	struct one_sided_ks_pair_reject_iter iter;
+
+	one_sided_ks_pair_reject_iter_init(&iter, 0, 10, log_eps);
+	const uint64_t min_count = iter.min_count;
+	EXPECT_EQ(min_count, one_sided_ks_find_min_count(log_eps));
+	EXPECT_EQ(iter.r_min, UINT64_MAX);
+	for (uint64_t n = 1; n < 1000000; ++n) {
+		const uint64_t r_min
+		    = one_sided_ks_pair_reject_iter_next(&iter);
+
+		ASSERT_EQ(iter.n, n);
+		ASSERT_EQ(r_min,
+		    one_sided_ks_pair_min_reject(n, min_count, log_eps))
+		    << n;
+	}
+
+	const long double log_b = -std::log(min_count - 1.0L)
+	    - static_cast<long double>(log_eps);
+	one_sided_ks_pair_reject_iter_init(
+	    &iter, 1ULL << 40, min_count, log_eps);
+	for (size_t i = 0; i < 1000000; ++i) {
+		const long double x = iter.n;
+		const long double f
+		    = std::sqrt((x + 1) * (2 * std::log(x) + log_b));
+
+		ASSERT_GT(iter.r_min, f) << iter.n;
+		ASSERT_LE(iter.r_min - 1, f * (1 + 1e-12L)) << iter.n;
+		one_sided_ks_pair_reject_iter_next(&iter);
+	}
+}
+
+// We should never skip a sample size where the statistic could
+// exceed the threshold, and we should skip most of the rest.
+TEST(OneSidedKs, NextCheck)
+{
+	const double log_eps = std::log(1e-6);
+	const uint64_t min_count = one_sided_ks_find_min_count(log_eps);
+
+	for (const uint64_t n : { 0UL, 5UL, 100UL, 1000UL, 12345UL,
+		 1000000UL, 1UL << 40 }) {
+		for (const double fraction : { 0.0, 0.1, 0.5, 0.9, 0.99 }) {
+			const double pair = one_sided_ks_pair_threshold(
+			    n, min_count, log_eps);
+			const double distribution
+			    = one_sided_ks_distribution_threshold(
+				n, min_count, log_eps);
+			const double d_pair
+			    = (pair < 1) ? fraction * pair : fraction;
+			const double d_distribution = (distribution < 1)
+			    ? fraction * distribution
+			    : fraction;
+			const uint64_t next_pair
+			    = one_sided_ks_pair_next_check(
+				n, d_pair, min_count, log_eps);
+			const uint64_t next_distribution
+			    = one_sided_ks_distribution_next_check(
+				n, d_distribution, min_count, log_eps);
+
+			ASSERT_GT(next_pair, n);
+			ASSERT_GT(next_distribution, n);
+			ASSERT_GE(next_pair, min_count);
+			ASSERT_GE(next_distribution, min_count);
+
+			// Worst case: every sample pushes the statistic up.
+			const auto max_d = [&](uint64_t m, double d) {
+				return (n * d + (m - n)) / m;
+			};
+
+			const uint64_t stride = 1
+			    + std::max(next_pair, next_distribution) / 10000;
+			for (uint64_t m = n + 1; m < next_pair; m += stride) {
+				ASSERT_LE(max_d(m, d_pair),
+				    one_sided_ks_pair_threshold(
+					m, min_count, log_eps))
+				    << n << " " << fraction << " " << m;
+			}
+
+			for (uint64_t m = n + 1; m < next_distribution;
+			     m += stride) {
+				ASSERT_LE(max_d(m, d_distribution),
+				    one_sided_ks_distribution_threshold(
+					m, min_count, log_eps))
+				    << n << " " << fraction << " " << m;
+			}
+
+			// We should be close to the actual cutoff.
+			const uint64_t slack = 2 + (next_pair - n) / 100;
+			EXPECT_GT(max_d(next_pair + slack, d_pair),
+			    one_sided_ks_pair_threshold(
+				next_pair + slack, min_count, log_eps))
+			    << n << " " << fraction;
+			EXPECT_GT(max_d(next_distribution + slack,
+				      d_distribution),
+			    one_sided_ks_distribution_threshold(
+				next_distribution + slack, min_count,
+				log_eps))
+			    << n << " " << fraction;
+		}
+	}
+}
+
+// The unpaired threshold should be the sum of one-sample thresholds,
+// each with half the false positive budget.
+TEST(OneSidedKs, UnpairedThreshold)
+{
+	const double log_eps = std::log(1e-6);
+	const double log_half_eps = log_eps + one_sided_ks_eq;
+	const uint64_t min_count = one_sided_ks_find_min_count(log_half_eps);
+
+	EXPECT_EQ(one_sided_ks_unpaired_threshold(
+		      min_count - 1, 1000, min_count, log_eps),
+	    HUGE_VAL);
+	EXPECT_EQ(one_sided_ks_unpaired_threshold(
+		      1000, min_count - 1, min_count, log_eps),
+	    HUGE_VAL);
+	for (uint64_t n_a = min_count; n_a < 1000000; n_a += n_a / 3) {
+		for (uint64_t n_b = min_count; n_b < 1000000;
+		     n_b += n_b / 2) {
+			const double expected
+			    = one_sided_ks_distribution_threshold(
+				  n_a, min_count, log_half_eps)
+			    + one_sided_ks_distribution_threshold(
+				n_b, min_count, log_half_eps);
+			const double actual = one_sided_ks_unpaired_threshold(
+			    n_a, n_b, min_count, log_eps);
+
+			EXPECT_GE(actual, expected);
+			EXPECT_THAT(actual, DoubleNear(expected, 1e-15));
+			EXPECT_EQ(actual,
+			    one_sided_ks_unpaired_threshold(
+				n_b, n_a, min_count, log_eps));
+			EXPECT_LT(one_sided_ks_unpaired_threshold(
+				      n_a, 10 * n_b, min_count, log_eps),
+			    actual);
+		}
+	}
+
+	// Invalid min counts are replaced.
+	EXPECT_EQ(one_sided_ks_unpaired_threshold(1000, 1000, 2, log_eps),
+	    one_sided_ks_unpaired_threshold(
+		1000, 1000, min_count, log_eps));
+
+	// Lopsided samples should do better than pairing.
+	EXPECT_LT(one_sided_ks_unpaired_threshold(
+		      1000, 99000, min_count, log_eps),
+	    one_sided_ks_pair_threshold(1000, min_count, log_eps));
+}
+
 TEST(OneSidedKs, MinCountGolden)
 {
 	// Paper says 6.
@@ -119,6 +447,51 @@ TEST(OneSidedKs, FindMinCountGolden)
 	EXPECT_EQ(one_sided_ks_find_min_count(-HUGE_VAL), SIZE_MAX);
 }
 
+// find_min_count is memoised; make sure the cache doesn't mix up
+// values, even when threads race to fill colliding slots.
+TEST(OneSidedKs, FindMinCountCache)
+{
+	std::vector<double> log_eps;
+	std::vector<uint64_t> expected;
+
+	for (double eps = 0.5; eps > 1e-100; eps /= 1.7) {
+		const double x = std::log(eps);
+		const uint64_t min_count = one_sided_ks_find_min_count(x);
+
+		log_eps.push_back(x);
+		expected.push_back(min_count);
+		ASSERT_NE(one_sided_ks_min_count_valid(min_count, x), 0);
+		ASSERT_EQ(one_sided_ks_min_count_valid(min_count - 1, x), 0);
+		EXPECT_EQ(one_sided_ks_find_min_count(x), min_count);
+	}
+
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < 4; ++t) {
+		threads.emplace_back([&, t] {
+			for (size_t i = 0; i < 100000; ++i) {
+				const size_t j
+				    = (i * (t + 1)) % log_eps.size();
+				const uint64_t actual
+				    = one_sided_ks_find_min_count(log_eps[j]);
+
+				ASSERT_EQ(actual, expected[j]);
+			}
+		});
+	}
+
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	// Invalid min_counts still get replaced.
+	EXPECT_EQ(one_sided_ks_pair_threshold(1000, 0, log_eps[5]),
+	    one_sided_ks_pair_threshold_fast(1000, expected[5], log_eps[5]));
+	EXPECT_EQ(one_sided_ks_pair_threshold(
+		      1000, expected[5] + 1, log_eps[5]),
+	    one_sided_ks_pair_threshold_fast(
+		1000, expected[5] + 1, log_eps[5]));
+}
+
 TEST(OneSidedKs, ExpectedIterEdgeCase)
 {
 	// Numerical trickery makes this computation extra conservative, but
@@ -130,4 +503,53 @@ TEST(OneSidedKs, ExpectedIterEdgeCase)
 	EXPECT_THAT(one_sided_ks_expected_iter(1000, -1, DBL_MIN),
 	    DoubleNear(DBL_MAX, 1.0));
 }
+
+// Inverse of f(x) / x, by bisection in long double.
+long double reference_inverse(
+    long double target, uint64_t min_count, double log_eps)
+{
+	const long double log_b = -std::log((long double)min_count - 1)
+	    - (long double)log_eps;
+	long double low = min_count;
+	long double high = 1e300L;
+
+	for (size_t i = 0; i < 2000; ++i) {
+		const long double x = (low + high) / 2;
+		const long double fx
+		    = std::sqrt((x + 1) * (2 * std::log(x) + log_b));
+
+		if (fx / x > target) {
+			low = x;
+		} else {
+			high = x;
+		}
+	}
+
+	return high;
+}
+
+// The expected iteration count should be conservative, but tight.
+TEST(OneSidedKs, ExpectedIterReference)
+{
+	for (const double eps : { 0.05, 1e-3, 1e-6, 1e-12 }) {
+		const double log_eps = std::log(eps);
+		const uint64_t min_count
+		    = one_sided_ks_find_min_count(log_eps);
+		double prev = 0;
+
+		for (double delta = 1e-1; delta > 1e-7; delta /= 1.5) {
+			const double actual = one_sided_ks_expected_iter(
+			    min_count, log_eps, delta);
+			const long double g
+			    = reference_inverse(delta, min_count, log_eps);
+			const long double expected = reference_inverse(
+			    delta - min_count / g, min_count, log_eps);
+
+			EXPECT_GE(actual, expected);
+			EXPECT_LE(actual, expected * (1 + 1e-9));
+			EXPECT_GT(actual, prev);
+			prev = actual;
+		}
+	}
+}
 } // namespace